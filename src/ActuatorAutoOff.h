@@ -49,7 +49,7 @@ public:
 	}
 
 private:
-	uint16_t lastActiveTime;
+	ticks_seconds_t lastActiveTime;
 	uint16_t timeout;
 	Actuator* target;
 	bool active;
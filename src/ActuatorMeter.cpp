@@ -0,0 +1,170 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "ActuatorMeter.h"
+#include "ChamberManager.h"
+
+ActuatorMeter actuatorMeter;
+
+ChamberActuatorStats ActuatorMeter::stats[BREWPI_CHAMBERS];
+ActuatorMeter::ChamberMeter ActuatorMeter::meters[BREWPI_CHAMBERS];
+uint8_t ActuatorMeter::unsaved = 0;
+
+static_assert(BREWPI_CHAMBERS<=8, "one bit per chamber");
+
+// upper limits of the run length bins, in seconds. Runs shorter than the minimum on time were cut short.
+static const uint16_t RUN_BIN_LIMITS[ActuatorStats::RUN_BINS-1] = { 180, 600, 1800, 3600, 10800 };
+
+static ActuatorStats& statsOf(ChamberActuatorStats& chamber, uint8_t output)
+{
+	return output==METERED_COOLER ? chamber.cooler : chamber.heater;
+}
+
+void ActuatorMeter::load()
+{
+	unsaved = 0;
+	memset(meters, 0, sizeof(meters));
+	for (uint8_t i=0; i<BREWPI_CHAMBERS; i++)
+		eepromAccess.readActuatorStats(stats[i], i);
+}
+
+uint8_t ActuatorMeter::runBin(ticks_seconds_t length)
+{
+	uint8_t bin = 0;
+	while (bin<ActuatorStats::RUN_BINS-1 && length>=RUN_BIN_LIMITS[bin])
+		bin++;
+	return bin;
+}
+
+void ActuatorMeter::update(ActuatorStats& s, Meter& m, bool active, ticks_seconds_t now, ticks_seconds_t elapsed,
+	uint8_t slot)
+{
+	if (m.active) {
+		s.onSeconds += elapsed;
+		ticks_seconds_t on = m.recentOn[slot]+elapsed;
+		m.recentOn[slot] = on<SLOT_SECONDS ? on : SLOT_SECONDS;
+	}
+	else
+		s.offSeconds += elapsed;
+
+	if (active==m.active)
+		return;
+	if (active) {
+		s.starts++;
+		if (m.recentStarts[slot]<UINT8_MAX)
+			m.recentStarts[slot]++;
+		ticks_seconds_t rest = now-m.since;
+		if (m.switched && (!s.minOffTime || rest<s.minOffTime))
+			s.minOffTime = rest;
+	}
+	else if (m.switched) {
+		uint8_t bin = runBin(now-m.since);
+		if (s.runs[bin]<UINT16_MAX)
+			s.runs[bin]++;
+	}
+	m.since = now;
+	m.switched = true;
+	m.active = active;
+}
+
+void ActuatorMeter::update(bool cooling, bool heating)
+{
+	uint8_t chamber = chamberManager.current();
+	ChamberMeter& cm = meters[chamber];
+	ticks_seconds_t now = ticks.seconds();
+	ticks_seconds_t slot = now/SLOT_SECONDS;
+	ticks_seconds_t elapsed = 0;
+	if (!cm.started) {
+		cm.started = true;
+		cm.lastSave = now;
+	}
+	else {
+		elapsed = now-cm.lastUpdate;
+		// clear the slots that have come round again since the last update
+		for (ticks_seconds_t s=cm.slot+1; s<=slot && s<=cm.slot+SLOTS; s++) {
+			for (uint8_t i=0; i<METERED_OUTPUTS; i++) {
+				cm.outputs[i].recentStarts[s%SLOTS] = 0;
+				cm.outputs[i].recentOn[s%SLOTS] = 0;
+			}
+		}
+	}
+	cm.slot = slot;
+	cm.lastUpdate = now;
+
+	update(stats[chamber].cooler, cm.outputs[METERED_COOLER], cooling, now, elapsed, slot%SLOTS);
+	update(stats[chamber].heater, cm.outputs[METERED_HEATER], heating, now, elapsed, slot%SLOTS);
+	if (now-cm.lastSave>=ACTUATOR_STATS_SAVE_INTERVAL) {
+		cm.lastSave = now;
+		unsaved |= 1<<chamber;
+	}
+}
+
+void ActuatorMeter::flush(bool all)
+{
+	if (all) {
+		ticks_seconds_t now = ticks.seconds();
+		for (uint8_t i=0; i<BREWPI_CHAMBERS; i++) {
+			if (meters[i].started) {
+				meters[i].lastSave = now;
+				unsaved |= 1<<i;
+			}
+		}
+	}
+	for (uint8_t i=0; unsaved; i++) {
+		if (unsaved & (1<<i))
+			eepromAccess.writeActuatorStats(i, stats[i]);
+		unsaved &= ~(1<<i);
+	}
+}
+
+void ActuatorMeter::reset()
+{
+	uint8_t chamber = chamberManager.current();
+	ChamberMeter& cm = meters[chamber];
+	memset(&stats[chamber], 0, sizeof(stats[chamber]));
+	for (uint8_t i=0; i<METERED_OUTPUTS; i++) {
+		memset(cm.outputs[i].recentStarts, 0, sizeof(cm.outputs[i].recentStarts));
+		memset(cm.outputs[i].recentOn, 0, sizeof(cm.outputs[i].recentOn));
+		cm.outputs[i].switched = false;		// the rest before the next start began before the reset
+	}
+	unsaved &= ~(1<<chamber);
+	eepromAccess.writeActuatorStats(chamber, stats[chamber]);
+}
+
+const ActuatorStats& ActuatorMeter::get(uint8_t output)
+{
+	return statsOf(stats[chamberManager.current()], output);
+}
+
+uint16_t ActuatorMeter::startsLastHour(uint8_t output)
+{
+	const Meter& m = meters[chamberManager.current()].outputs[output];
+	uint16_t starts = 0;
+	for (uint8_t i=0; i<SLOTS; i++)
+		starts += m.recentStarts[i];
+	return starts;
+}
+
+uint16_t ActuatorMeter::onLastHour(uint8_t output)
+{
+	const Meter& m = meters[chamberManager.current()].outputs[output];
+	uint16_t on = 0;
+	for (uint8_t i=0; i<SLOTS; i++)
+		on += m.recentOn[i];
+	return on;
+}
@@ -0,0 +1,97 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "EepromStructs.h"
+#include "Ticks.h"
+
+enum MeteredOutput {
+	METERED_COOLER = 0,
+	METERED_HEATER = 1,
+	METERED_OUTPUTS
+};
+
+/**
+ * Counts the starts, run time and rests of the cooler and heater of each chamber, to keep an eye on compressor wear.
+ * The outputs are metered as they are set each control tick, so all of it is fixed size and costs a few additions
+ * per tick. The counters are saved to flash every ACTUATOR_STATS_SAVE_INTERVAL seconds and carry on after a restart.
+ *
+ * Alongside the saved counters, the starts and on time of the last hour are kept in RAM, in 10 minute slots.
+ */
+class ActuatorMeter
+{
+public:
+	/**
+	 * Loads the saved counters of every chamber.
+	 */
+	static void load();
+
+	/**
+	 * Meters the outputs of the current chamber, as they have just been set.
+	 */
+	static void update(bool cooling, bool heating);
+
+	/**
+	 * Saves the counters of the chambers that are due, or of every chamber in use when all is set, as before a
+	 * reset.
+	 */
+	static void flush(bool all=false);
+
+	/**
+	 * Clears the counters of the current chamber, and saves them.
+	 */
+	static void reset();
+
+	static const ActuatorStats& get(uint8_t output);
+
+	/** Starts in the last hour. */
+	static uint16_t startsLastHour(uint8_t output);
+
+	/** Seconds on in the last hour. */
+	static uint16_t onLastHour(uint8_t output);
+
+private:
+	static const uint8_t SLOTS = 6;
+	static const uint16_t SLOT_SECONDS = 600;
+
+	struct Meter {
+		ticks_seconds_t since;			// when the output last switched on or off
+		uint8_t recentStarts[SLOTS];
+		uint16_t recentOn[SLOTS];		// seconds
+		bool active;
+		bool switched;					// since is known: the output has switched since startup
+	};
+
+	struct ChamberMeter {
+		Meter outputs[METERED_OUTPUTS];
+		ticks_seconds_t lastUpdate;
+		ticks_seconds_t lastSave;
+		ticks_seconds_t slot;			// the 10 minute slot of the last update, counted from startup
+		bool started;					// updated since startup
+	};
+
+	static void update(ActuatorStats& stats, Meter& meter, bool active, ticks_seconds_t now, ticks_seconds_t elapsed,
+		uint8_t slot);
+	static uint8_t runBin(ticks_seconds_t length);
+
+	static ChamberActuatorStats stats[BREWPI_CHAMBERS];
+	static ChamberMeter meters[BREWPI_CHAMBERS];
+	static uint8_t unsaved;				// a bit for each chamber whose counters are due to be saved
+};
+
+extern ActuatorMeter actuatorMeter;
@@ -0,0 +1,144 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+#include "Autotune.h"
+#include "ChamberManager.h"
+
+PidAutotune pidAutotune;
+
+AutotuneStatus PidAutotune::status = AUTOTUNE_IDLE;
+uint8_t PidAutotune::chamber;
+bool PidAutotune::pending;
+bool PidAutotune::heating;
+temperature PidAutotune::amplitude;
+bool PidAutotune::started;
+ticks_seconds_t PidAutotune::startTime;
+uint32_t PidAutotune::lastSwitch;
+temperature PidAutotune::cycleMax;
+temperature PidAutotune::cycleMin;
+uint8_t PidAutotune::cycles;
+uint8_t PidAutotune::measured;
+uint32_t PidAutotune::sumPeriod;
+uint32_t PidAutotune::sumSwing;
+temperature PidAutotune::ultimateGain;
+uint32_t PidAutotune::ultimatePeriod;
+ControlConstants PidAutotune::proposal;
+
+// the relay switches this far past the setting, so sensor noise does not make it chatter
+const temperature AUTOTUNE_HYSTERESIS = TEMP_FIXED_POINT_SCALE/8;	// 0.125 deg
+
+void PidAutotune::start(const ControlConstants& cc)
+{
+	status = AUTOTUNE_RUNNING;
+	chamber = chamberManager.current();
+	pending = false;
+	amplitude = min(intToTempDiff(AUTOTUNE_RELAY_AMPLITUDE), cc.pidMax);
+	started = false;
+	startTime = ticks.seconds();
+	lastSwitch = 0;
+	cycles = 0;
+	measured = 0;
+	sumPeriod = 0;
+	sumSwing = 0;
+}
+
+void PidAutotune::stop()
+{
+	if (status==AUTOTUNE_RUNNING && chamber==chamberManager.current())
+		status = AUTOTUNE_IDLE;
+}
+
+bool PidAutotune::mayStart()
+{
+	return !isRunning() && (!isPending() || chamber==chamberManager.current());
+}
+
+bool PidAutotune::apply(ControlConstants& cc)
+{
+	if (status!=AUTOTUNE_DONE || chamber!=chamberManager.current())
+		return false;
+	cc.Kp = proposal.Kp;
+	cc.Ki = proposal.Ki;
+	cc.Kd = proposal.Kd;
+	pending = false;
+	return true;
+}
+
+temperature PidAutotune::update(temperature beer, temperature setting, const ControlConstants& cc)
+{
+	if (status!=AUTOTUNE_RUNNING || chamber!=chamberManager.current() || beer==INVALID_TEMP || setting==INVALID_TEMP)
+		return INVALID_TEMP;
+
+	if (!started) {
+		started = true;
+		heating = beer<setting;
+		cycleMax = beer;
+		cycleMin = beer;
+	}
+	uint32_t seconds = ticks.seconds()-startTime;
+	if (seconds>=AUTOTUNE_TIMEOUT*3600UL) {
+		status = AUTOTUNE_FAILED;
+		return INVALID_TEMP;
+	}
+
+	cycleMax = max(cycleMax, beer);
+	cycleMin = min(cycleMin, beer);
+	if (heating && beer>setting+AUTOTUNE_HYSTERESIS)
+		heating = false;
+	else if (!heating && beer<setting-AUTOTUNE_HYSTERESIS) {
+		heating = true;
+		// each switch to heating ends a cycle. The first whole cycle is left out, since it still carries
+		// the beer's approach to the setting.
+		if (lastSwitch && ++cycles>1) {
+			sumPeriod += seconds-lastSwitch;
+			sumSwing += cycleMax-cycleMin;
+			measured++;
+		}
+		lastSwitch = seconds;
+		cycleMax = beer;
+		cycleMin = beer;
+		if (measured==AUTOTUNE_CYCLES) {
+			finish(cc);
+			return INVALID_TEMP;
+		}
+	}
+	temperature fridge = heating ? setting+amplitude : setting-amplitude;
+	return constrain(fridge, cc.tempSettingMin, cc.tempSettingMax);
+}
+
+void PidAutotune::finish(const ControlConstants& cc)
+{
+	ultimatePeriod = sumPeriod/measured;
+	uint32_t swing = sumSwing/measured;
+	if (!swing)
+		swing = 1;
+
+	// Ku = 4d/(pi*a), where the amplitude a is half the swing. pi is taken as 355/113.
+	int64_t ku = int64_t(amplitude)*8*113*TEMP_FIXED_POINT_SCALE/(355*int64_t(swing));
+	ultimateGain = constrainTemp16(long_temperature(ku));
+
+	// Tyreus-Luyben: Kp = Ku/2.2, Ti = 2.2*Tu, Td = Tu/6.3
+	int64_t kp = ku*10/22;
+	proposal = cc;
+	proposal.Kp = constrainTemp16(long_temperature(kp));
+	// the integral adds up the error once a minute, so Ki = Kp/Ti with Ti in minutes
+	proposal.Ki = constrainTemp16(long_temperature(kp*60*10/(22*int64_t(ultimatePeriod))));
+	// the slope is per hour, and of the beer rather than the error, so Kd = -Kp*Td with Td in hours
+	proposal.Kd = constrainTemp16(long_temperature(-kp*int64_t(ultimatePeriod)*10/(63*3600L)));
+	status = AUTOTUNE_DONE;
+	pending = true;
+}
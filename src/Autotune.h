@@ -0,0 +1,127 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+#include "EepromStructs.h"
+#include "Ticks.h"
+
+enum AutotuneStatus {
+	AUTOTUNE_IDLE = 0,			// not run since boot
+	AUTOTUNE_RUNNING = 1,
+	AUTOTUNE_DONE = 2,			// finished, the proposed constants are ready
+	AUTOTUNE_FAILED = 3			// did not settle into a steady oscillation in time
+};
+
+/**
+ * Tunes the beer PID with relay feedback (Astrom-Hagglund) in MODE_AUTOTUNE.
+ *
+ * The relay switches the fridge setting between beer setting + and - the relay amplitude whenever the beer crosses
+ * its setting, with a little hysteresis. The fridge state machine follows the fridge setting as in any other mode,
+ * so the compressor and heater keep their minimum on, off and switch times. The beer settles into an oscillation
+ * whose period is the ultimate period Tu, and whose amplitude gives the ultimate gain Ku = 4d/(pi*a). Once
+ * AUTOTUNE_CYCLES cycles have been measured after the first one, Kp, Ki and Kd are proposed from Ku and Tu with the
+ * Tyreus-Luyben rules, which overshoot less than Ziegler-Nichols on a slow process like a fermenting beer.
+ *
+ * The proposed constants are only applied on request. Since the relay output is an offset of the fridge setting
+ * from the beer setting, just like the PID output, Ku and Tu describe the same loop that the constants control.
+ *
+ * One chamber is tuned at a time, and a proposal is held for its chamber until it is applied or discarded: another
+ * chamber does not start a run in the meantime. Nothing here touches hardware, so a run can be followed against the
+ * Simulator.
+ */
+class PidAutotune
+{
+public:
+	/**
+	 * Starts tuning the current chamber.
+	 */
+	static void start(const ControlConstants& cc);
+
+	/**
+	 * Abandons the run in progress if it is of the current chamber. The results of a finished run are kept.
+	 */
+	static void stop();
+
+	/**
+	 * false while the proposal of another chamber waits to be applied or discarded.
+	 */
+	static bool mayStart();
+
+	/**
+	 * Copies the proposed Kp, Ki and Kd to cc, which must be the constants of the current chamber.
+	 * /return false if there is no proposal, or it is of another chamber.
+	 */
+	static bool apply(ControlConstants& cc);
+
+	/**
+	 * Drops the proposal, so other chambers may be tuned. The results stay readable.
+	 */
+	static void discard() { pending = false; }
+
+	/**
+	 * Advances the relay from the slow filtered beer temperature. Times are taken from ticks, so the run does not
+	 * depend on how often this is called.
+	 * /return the fridge setting, or INVALID_TEMP when the current chamber is not being tuned.
+	 */
+	static temperature update(temperature beer, temperature setting, const ControlConstants& cc);
+
+	static AutotuneStatus getStatus() { return status; }
+	static bool isRunning() { return status==AUTOTUNE_RUNNING; }
+
+	/** true when done, and the proposal has been neither applied nor discarded. */
+	static bool isPending() { return status==AUTOTUNE_DONE && pending; }
+
+	/** The chamber of the run in progress or the last one, counted from 0 like chamberManager.current(). */
+	static uint8_t getChamber() { return chamber; }
+
+	/** Full cycles of the relay completed so far, including the ones used to settle. */
+	static uint8_t getCycles() { return cycles; }
+
+	/** The ultimate gain, in the fixed point format of the PID factors. Valid when done. */
+	static temperature getUltimateGain() { return ultimateGain; }
+
+	/** The ultimate period, in seconds. Valid when done. */
+	static uint32_t getUltimatePeriod() { return ultimatePeriod; }
+
+	/** The proposed Kp, Ki and Kd, in the remaining fields. Valid when done. */
+	static const ControlConstants& getProposal() { return proposal; }
+
+private:
+	static void finish(const ControlConstants& cc);
+
+	static AutotuneStatus status;
+	static uint8_t chamber;
+	static bool pending;			// the proposal has not been applied or discarded
+	static bool heating;			// the relay output, true when the fridge is set above the beer setting
+	static temperature amplitude;	// d, the offset of the fridge setting from the beer setting
+	static bool started;			// the relay has been set from the first reading
+	static ticks_seconds_t startTime;
+	static uint32_t lastSwitch;		// seconds since the start at the start of the current cycle, 0 before the first
+	static temperature cycleMax;
+	static temperature cycleMin;
+	static uint8_t cycles;
+	static uint8_t measured;		// cycles added to the sums below
+	static uint32_t sumPeriod;
+	static uint32_t sumSwing;		// of the peak to peak swing of the beer in each cycle
+	static temperature ultimateGain;
+	static uint32_t ultimatePeriod;
+	static ControlConstants proposal;
+};
+
+extern PidAutotune pidAutotune;
@@ -0,0 +1,83 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "BeerControl.h"
+
+// the beer's own outputs come on this far from the setting, and go off when it is reached
+#define BEER_OUTPUT_HYSTERESIS (intToTempDiff(1)/4)		// 0.25
+
+void BeerControl::reset()
+{
+	beerDiff = 0;
+	beerSlope = 0;
+	diffIntegral = 0;
+	fridgeDemand = INVALID_TEMP;
+	integralUpdateCounter = 0;
+}
+
+void BeerControl::updatePID(const ControlConstants& cc, temperature fridgeSetting, bool idle, bool lead)
+{
+	temperature beerSetting = cs.beerSetting;
+	if (beerSetting==INVALID_TEMP || !sensor->isConnected()) {
+		fridgeDemand = INVALID_TEMP;
+		return;
+	}
+
+	beerDiff = beerSetting - sensor->readSlowFiltered();
+	beerSlope = sensor->readSlope();
+
+	if (integralUpdateCounter++ == 60) {
+		integralUpdateCounter = 0;
+		// as for the first beer, except the integrator winds down while another beer sets the fridge,
+		// since the fridge is then not acting on this beer's error.
+		temperature integratorUpdate;
+		if (!idle)
+			integratorUpdate = 0;
+		else if (!lead || abs(beerDiff) >= cc.iMaxError)
+			integratorUpdate = -(diffIntegral >> 3);
+		else if ((beerDiff > 0) == (diffIntegral > 0)) {
+			bool saturated = fridgeSetting >= cc.tempSettingMax || fridgeSetting <= cc.tempSettingMin
+				|| abs(fridgeSetting - beerSetting) >= cc.pidMax;
+			integratorUpdate = saturated ? 0 : beerDiff;
+		}
+		else
+			integratorUpdate = beerDiff*2;	// decrease faster than increase
+		diffIntegral = diffIntegral + integratorUpdate;
+	}
+
+	long_temperature demand = beerSetting;
+	demand += multiplyFactorTemperatureDiff(cc.Kp, beerDiff);
+	demand += multiplyFactorTemperatureDiffLong(cc.Ki, diffIntegral);
+	demand += multiplyFactorTemperatureDiff(cc.Kd, beerSlope);
+
+	temperature lowerBound = (beerSetting <= cc.tempSettingMin + cc.pidMax) ? cc.tempSettingMin : beerSetting - cc.pidMax;
+	temperature upperBound = (beerSetting >= cc.tempSettingMax - cc.pidMax) ? cc.tempSettingMax : beerSetting + cc.pidMax;
+	fridgeDemand = constrain(constrainTemp16(demand), lowerBound, upperBound);
+}
+
+void BeerControl::updateOutputs(temperature setting, bool enabled)
+{
+	bool heat = false, cool = false;
+	if (enabled && setting!=INVALID_TEMP && sensor->isConnected()) {
+		temperature temp = sensor->readFastFiltered();
+		heat = temp < setting - BEER_OUTPUT_HYSTERESIS || (heater->isActive() && temp < setting);
+		cool = temp > setting + BEER_OUTPUT_HYSTERESIS || (cooler->isActive() && temp > setting);
+	}
+	heater->setActive(heat);
+	cooler->setActive(cool);
+}
@@ -0,0 +1,62 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+#include "TempSensor.h"
+#include "Actuator.h"
+#include "EepromStructs.h"
+
+/**
+ * A beer in a chamber. The chamber holds BREWPI_BEERS of them, and the first is the one TempControl has always
+ * controlled: its sensor is also TempControl::beerSensor, and its setting and PID state are TempControl::cs and cv.
+ *
+ * Each further beer runs its own PID on its own setting, which yields the fridge setting it would like. TempControl
+ * arbitrates between the beers: the coldest demand wins the fridge, and a beer that needs warming meanwhile can
+ * have a heat wrap (DEVICE_BEER_HEAT), and one that needs cooling a glycol valve or similar (DEVICE_BEER_COOL).
+ */
+struct BeerControl {
+	TempSensor* sensor;
+	Actuator* heater;
+	Actuator* cooler;
+	ControlSettings cs;				// only beerSetting is used, the mode is the chamber's
+
+	// PID state, as in ControlVariables
+	temperature beerDiff;
+	temperature beerSlope;
+	long_temperature diffIntegral;
+	temperature fridgeDemand;		// the fridge setting this beer asks for, INVALID_TEMP when it has none
+	uint8_t integralUpdateCounter;
+
+	/**
+	 * Clears the PID state.
+	 */
+	void reset();
+
+	/**
+	 * Updates fridgeDemand from the beer's setting and temperature.
+	 * /param lead true if this beer's demand set the fridge last time, in which case the integrator may be updated.
+	 */
+	void updatePID(const ControlConstants& cc, temperature fridgeSetting, bool idle, bool lead);
+
+	/**
+	 * Switches the beer's own outputs to bring it to setting, or off when disabled.
+	 */
+	void updateOutputs(temperature setting, bool enabled);
+};
@@ -0,0 +1,131 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+#include "BeerProfile.h"
+#include "TempControl.h"
+#include "ChamberManager.h"
+
+BeerProfile beerProfile;
+
+BeerProfile::ChamberProfile BeerProfile::profiles[BREWPI_CHAMBERS];
+uint8_t BeerProfile::running = 0;
+uint8_t BeerProfile::unsaved = 0;
+
+static_assert(BREWPI_CHAMBERS<=8, "one bit per chamber");
+
+uint8_t BeerProfile::chamber()
+{
+	return chamberManager.current();
+}
+
+void BeerProfile::load()
+{
+	running = 0;
+	unsaved = 0;
+	for (uint8_t i=0; i<BREWPI_CHAMBERS; i++) {
+		ChamberProfile& p = profiles[i];
+		eepromAccess.readBeerProfile(p.record, i);
+		eepromAccess.readProfileProgress(p.progress, i);
+		if (p.record.count>BeerProfileRecord::MAX_POINTS)
+			p.record.count = 0;
+	}
+}
+
+bool BeerProfile::set(const ProfilePoint* points, uint8_t count)
+{
+	if (count>BeerProfileRecord::MAX_POINTS)
+		return false;
+	for (uint8_t i=0; i<count; i++) {
+		if ((i && points[i].minutes<=points[i-1].minutes) || points[i].temp==INVALID_TEMP
+			|| points[i].temp<tempControl.cc.tempSettingMin || points[i].temp>tempControl.cc.tempSettingMax)
+			return false;
+	}
+
+	uint8_t c = chamber();
+	ChamberProfile& p = profiles[c];
+	memset(&p.record, 0, sizeof(p.record));
+	memcpy(p.record.points, points, count*sizeof(ProfilePoint));
+	p.record.count = count;
+	p.progress.elapsed = 0;
+	p.millis = 0;
+	running &= ~(1<<c);
+	unsaved &= ~(1<<c);
+	// uploads are rare, so both are written right away
+	eepromAccess.writeBeerProfile(c, p.record);
+	eepromAccess.writeProfileProgress(c, p.progress);
+	return true;
+}
+
+temperature BeerProfile::advance(bool active)
+{
+	uint8_t c = chamber();
+	uint8_t bit = 1<<c;
+	ChamberProfile& p = profiles[c];
+	if (!active || !p.record.count) {
+		running &= ~bit;
+		return INVALID_TEMP;
+	}
+
+	ticks_millis_t now = ticks.millis();
+	uint32_t end = p.record.points[p.record.count-1].minutes*60UL;
+	if ((running & bit) && p.progress.elapsed<end) {
+		uint32_t millis = p.millis + (now - p.lastMillis);
+		uint32_t before = p.progress.elapsed;
+		p.progress.elapsed += millis/1000;
+		p.millis = millis%1000;
+		if (p.progress.elapsed>=end)
+			p.progress.elapsed = end;
+		// save when the profile finishes, so it is not run again from the last save after a restart
+		if (p.progress.elapsed/BEER_PROFILE_SAVE_INTERVAL!=before/BEER_PROFILE_SAVE_INTERVAL || p.progress.elapsed==end)
+			unsaved |= bit;
+	}
+	running |= bit;
+	p.lastMillis = now;
+	return settingAt(p.record, p.progress.elapsed);
+}
+
+void BeerProfile::flush()
+{
+	for (uint8_t i=0; unsaved; i++) {
+		if (unsaved & (1<<i))
+			eepromAccess.writeProfileProgress(i, profiles[i].progress);
+		unsaved &= ~(1<<i);
+	}
+}
+
+/**
+ * Interpolates linearly between the points either side of the given time. Before the first point and after the last,
+ * the setting of the nearest point is held.
+ */
+temperature BeerProfile::settingAt(const BeerProfileRecord& record, uint32_t seconds)
+{
+	if (!record.count)
+		return INVALID_TEMP;
+	const ProfilePoint* points = record.points;
+	for (uint8_t i=0; i<record.count; i++) {
+		uint32_t end = points[i].minutes*60UL;
+		if (seconds>=end)
+			continue;
+		if (!i)
+			return points[0].temp;
+		uint32_t start = points[i-1].minutes*60UL;
+		int32_t rise = int32_t(points[i].temp) - points[i-1].temp;
+		// the product can take up to 39 bits
+		return points[i-1].temp + temperature(int64_t(rise)*(seconds-start)/int32_t(end-start));
+	}
+	return points[record.count-1].temp;
+}
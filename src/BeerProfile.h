@@ -0,0 +1,86 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "EepromStructs.h"
+#include "Ticks.h"
+
+/**
+ * A beer temperature profile stored on the controller, one for each chamber. In MODE_BEER_PROFILE the controller
+ * interpolates the beer setting from the profile itself each control tick, so the profile carries on without the Pi
+ * through network outages and restarts.
+ *
+ * There is no wall clock, so the profile runs on the time it has spent in MODE_BEER_PROFILE: the clock stops while
+ * the chamber is in another mode, and while the controller is off. The progress is saved to flash every
+ * BEER_PROFILE_SAVE_INTERVAL seconds, so a restart sets the profile back by at most that long.
+ *
+ * Without a stored profile, MODE_BEER_PROFILE follows the beer setting sent by the Pi, as before.
+ */
+class BeerProfile
+{
+public:
+	/**
+	 * Loads the stored profile and progress of every chamber.
+	 */
+	static void load();
+
+	/**
+	 * Replaces the profile of the current chamber, and starts it from the beginning. count may be 0 to remove it.
+	 * The times must increase from one point to the next, and the temperatures be within the setting limits.
+	 * /return false if the profile is not valid, in which case the current profile is kept.
+	 */
+	static bool set(const ProfilePoint* points, uint8_t count);
+
+	/**
+	 * Advances the profile of the current chamber to now, once per control tick.
+	 * /param active true when the chamber is in MODE_BEER_PROFILE. Otherwise the profile's clock is stopped.
+	 * /return the beer setting, or INVALID_TEMP when the chamber has no profile or it is not running.
+	 */
+	static temperature advance(bool active);
+
+	/**
+	 * Saves the progress of the profiles that have moved on since they were last saved.
+	 */
+	static void flush();
+
+	static uint8_t count() { return profiles[chamber()].record.count; }
+	static const ProfilePoint& point(uint8_t i) { return profiles[chamber()].record.points[i]; }
+	static uint32_t elapsed() { return profiles[chamber()].progress.elapsed; }
+
+	/**
+	 * The setting of the current chamber's profile at its current progress, or INVALID_TEMP if there is no profile.
+	 */
+	static temperature setting() { return settingAt(profiles[chamber()].record, elapsed()); }
+
+private:
+	struct ChamberProfile {
+		BeerProfileRecord record;
+		ProfileProgress progress;
+		ticks_millis_t lastMillis;	// when the progress was last advanced
+		uint16_t millis;			// milliseconds not yet counted in progress.elapsed
+	};
+
+	static uint8_t chamber();
+	static temperature settingAt(const BeerProfileRecord& record, uint32_t seconds);
+
+	static ChamberProfile profiles[BREWPI_CHAMBERS];
+	static uint8_t running;		// a bit for each chamber whose profile clock is counting
+	static uint8_t unsaved;		// a bit for each chamber whose progress is due to be saved
+};
+
+extern BeerProfile beerProfile;
@@ -53,7 +53,7 @@
 #endif
 #include "ConfigDefault.h"
 
-#include <Arduino.h>
+#include <Arduino.h>						// the native build finds the stand-in in test/native first
 
 #include "Actuator.h"
 
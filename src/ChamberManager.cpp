@@ -0,0 +1,148 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+#include "ChamberManager.h"
+#include "EepromManager.h"
+#include "EepromFormat.h"
+#include "TempSensorDisconnected.h"
+
+extern ValueSensor<bool> defaultSensor;
+extern ValueActuator defaultActuator;
+extern DisconnectedTempSensor defaultTempSensor;
+
+static_assert(BREWPI_CHAMBERS>=1 && BREWPI_CHAMBERS<=EepromFormat::MAX_CHAMBERS, "BREWPI_CHAMBERS out of range");
+
+ChamberManager chamberManager;
+
+Chamber ChamberManager::chambers[BREWPI_CHAMBERS];
+uint8_t ChamberManager::currentChamber = 0;
+uint8_t ChamberManager::chamberCount = 1;
+
+Chamber::Chamber()
+{
+	memset(this, 0, sizeof(*this));
+	// the sensors and the beer outputs are set up by TempControl::init when the chamber comes into use
+	ambientSensor = &defaultTempSensor;
+	heater = cooler = light = fan = &defaultActuator;
+	door = &defaultSensor;
+}
+
+void Chamber::swapIn()
+{
+	tempControl.beerSensor = beerSensor;
+	tempControl.fridgeSensor = fridgeSensor;
+	tempControl.ambientSensor = ambientSensor;
+	tempControl.heater = heater;
+	tempControl.cooler = cooler;
+	tempControl.light = light;
+	tempControl.fan = fan;
+	tempControl.door = door;
+	memcpy(tempControl.beers, beers, sizeof(beers));
+	tempControl.cc = cc;
+	tempControl.cs = cs;
+	tempControl.cv = cv;
+	tempControl.storedBeerSetting = storedBeerSetting;
+	tempControl.lastIdleTime = lastIdleTime;
+	tempControl.lastHeatTime = lastHeatTime;
+	tempControl.lastCoolTime = lastCoolTime;
+	tempControl.waitTime = waitTime;
+	tempControl.state = state;
+	tempControl.doPosPeakDetect = doPosPeakDetect;
+	tempControl.doNegPeakDetect = doNegPeakDetect;
+	tempControl.doorOpen = doorOpen;
+	tempControl.leadBeer = leadBeer;
+}
+
+void Chamber::swapOut()
+{
+	beerSensor = tempControl.beerSensor;
+	fridgeSensor = tempControl.fridgeSensor;
+	ambientSensor = tempControl.ambientSensor;
+	heater = tempControl.heater;
+	cooler = tempControl.cooler;
+	light = tempControl.light;
+	fan = tempControl.fan;
+	door = tempControl.door;
+	memcpy(beers, tempControl.beers, sizeof(beers));
+	cc = tempControl.cc;
+	cs = tempControl.cs;
+	cv = tempControl.cv;
+	storedBeerSetting = tempControl.storedBeerSetting;
+	lastIdleTime = tempControl.lastIdleTime;
+	lastHeatTime = tempControl.lastHeatTime;
+	lastCoolTime = tempControl.lastCoolTime;
+	waitTime = tempControl.waitTime;
+	state = tempControl.state;
+	doPosPeakDetect = tempControl.doPosPeakDetect;
+	doNegPeakDetect = tempControl.doNegPeakDetect;
+	doorOpen = tempControl.doorOpen;
+	leadBeer = tempControl.leadBeer;
+}
+
+bool ChamberManager::switchChamber(uint8_t chamber)
+{
+	if (chamber>=BREWPI_CHAMBERS)
+		return false;
+	// chambers come into use in order, so any before this one are set up first
+	while (chamberCount<=chamber) {
+		uint8_t next = chamberCount++;
+		swapTo(next);
+		activate(next);
+	}
+	swapTo(chamber);
+	return true;
+}
+
+void ChamberManager::swapTo(uint8_t chamber)
+{
+	if (chamber==currentChamber)
+		return;
+	chambers[currentChamber].swapOut();
+	currentChamber = chamber;
+	chambers[currentChamber].swapIn();
+}
+
+/**
+ * Sets up the chamber that is swapped in, with its stored settings or the defaults.
+ */
+void ChamberManager::activate(uint8_t chamber)
+{
+	tempControl.init();
+	eepromManager.loadChamberSettings(chamber);
+}
+
+void ChamberManager::update()
+{
+	uint8_t selected = currentChamber;
+	for (uint8_t i=0; i<chamberCount; i++) {
+		if (i==selected)
+			continue;
+		switchChamber(i);
+		tempControl.updateTemperatures();
+		tempControl.detectPeaks();
+		tempControl.updatePID();
+		tempControl.updateState();
+		tempControl.updateOutputs();
+	}
+	switchChamber(selected);
+}
+
+void ChamberManager::reset()
+{
+	switchChamber(0);
+	chamberCount = 1;
+}
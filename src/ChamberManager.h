@@ -0,0 +1,134 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "TempControl.h"
+
+/**
+ * The control state of a chamber while it is not the one swapped into TempControl.
+ */
+class Chamber
+{
+public:
+	Chamber();
+
+	/**
+	 * Copies this chamber's state into TempControl.
+	 */
+	void swapIn();
+
+	/**
+	 * Copies the state in TempControl back into this chamber.
+	 */
+	void swapOut();
+
+private:
+	TempSensor* beerSensor;
+	TempSensor* fridgeSensor;
+	BasicTempSensor* ambientSensor;
+	Actuator* heater;
+	Actuator* cooler;
+	Actuator* light;
+	Actuator* fan;
+	Sensor<bool>* door;
+	BeerControl beers[BREWPI_BEERS];
+
+	ControlConstants cc;
+	ControlSettings cs;
+	ControlVariables cv;
+	temperature storedBeerSetting;
+
+	ticks_seconds_t lastIdleTime;
+	ticks_seconds_t lastHeatTime;
+	ticks_seconds_t lastCoolTime;
+	ticks_seconds_t waitTime;
+
+	uint8_t state;
+	bool doPosPeakDetect;
+	bool doNegPeakDetect;
+	bool doorOpen;
+	uint8_t leadBeer;
+};
+
+/**
+ * Runs up to BREWPI_CHAMBERS chambers from the one static TempControl, as described in TempControl.h: the
+ * current chamber is swapped into TempControl, and the others are kept in Chamber objects. Each control tick,
+ * every other chamber in use is swapped in, updated and swapped out again, so all chambers are updated in
+ * the same tick while the bulk of the code keeps working against TempControl.
+ *
+ * The current chamber is the one the display, the menu and the PiLink commands work on.
+ * Chambers are counted from 0 here; in device definitions and on PiLink they are counted from 1.
+ * The first chamber is always in use. Further chambers come into use when a device is installed in them
+ * or they are selected, along with any chambers before them.
+ */
+class ChamberManager
+{
+public:
+	static uint8_t current() { return currentChamber; }
+	static uint8_t count() { return chamberCount; }
+
+	/**
+	 * Makes the given chamber the current one, bringing it into use if needed.
+	 * Returns false if there is no such chamber.
+	 */
+	static bool switchChamber(uint8_t chamber);
+
+	/**
+	 * Runs the control update for every chamber in use other than the current one.
+	 * Called after the current chamber has been updated.
+	 */
+	static void update();
+
+	/**
+	 * Takes all but the first chamber out of use, and makes the first the current one.
+	 * Their devices must have been uninstalled.
+	 */
+	static void reset();
+
+private:
+	static void swapTo(uint8_t chamber);
+	static void activate(uint8_t chamber);
+
+	static Chamber chambers[BREWPI_CHAMBERS];	// the entry for the current chamber is stale while it is swapped in
+	static uint8_t currentChamber;
+	static uint8_t chamberCount;
+};
+
+extern ChamberManager chamberManager;
+
+/**
+ * Swaps a chamber in for as long as the object exists, and the previously current chamber back in afterwards.
+ * chamber is counted from 1, as in device definitions, and 0 means the current chamber.
+ */
+class ChamberSwitch
+{
+public:
+	ChamberSwitch(uint8_t chamber) : previous(chamberManager.current()) {
+		ok = !chamber || chamberManager.switchChamber(chamber-1);
+	}
+	~ChamberSwitch() { chamberManager.switchChamber(previous); }
+
+	/**
+	 * false if the chamber does not exist, and the current chamber is still in place.
+	 */
+	bool switched() const { return ok; }
+
+private:
+	uint8_t previous;
+	bool ok;
+};
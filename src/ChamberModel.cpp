@@ -0,0 +1,135 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+#include "ChamberModel.h"
+#include "ChamberManager.h"
+
+ChamberModel chamberModel;
+
+ThermalModel ChamberModel::models[BREWPI_CHAMBERS];
+ChamberModel::Sampler ChamberModel::samplers[BREWPI_CHAMBERS];
+
+// learning rates of the two equations, as a shift. The beer changes by less than a sensor step in a model step,
+// so its error is mostly noise and it learns more slowly.
+const uint8_t MODEL_FRIDGE_RATE = 2;
+const uint8_t MODEL_BEER_RATE = 5;
+
+// keeps the correction bounded when all inputs are near 0
+const int64_t MODEL_REGULARIZATION = int64_t(TEMP_FIXED_POINT_SCALE)*TEMP_FIXED_POINT_SCALE/16;
+
+void ThermalModel::step(ModelState& s, temperature room, temperature heaterDuty, temperature coolerDuty) const
+{
+	int64_t toFridge = int64_t(fridge[FRIDGE_BEER])*(s.beer-s.fridge)
+		+ (int64_t(fridge[FRIDGE_HEAT])*heaterDuty << MODEL_STATE_BITS)
+		+ (int64_t(fridge[FRIDGE_COOL])*coolerDuty << MODEL_STATE_BITS);
+	if (room!=INVALID_TEMP)
+		toFridge += int64_t(fridge[FRIDGE_ROOM])*((int32_t(room)<<MODEL_STATE_BITS) - s.fridge);
+	int64_t toBeer = int64_t(beer[BEER_FRIDGE])*(s.fridge-s.beer)
+		+ (int64_t(beer[BEER_FERMENT])*TEMP_FIXED_POINT_SCALE << MODEL_STATE_BITS);
+	s.fridge += int32_t(toFridge>>16);
+	s.beer += int32_t(toBeer>>16);
+}
+
+void ChamberModel::reset()
+{
+	uint8_t chamber = chamberManager.current();
+	ThermalModel& m = models[chamber];
+	// typical values for a fridge with a small heater, per minute
+	m.fridge[ThermalModel::FRIDGE_BEER] = 1311;		// 0.02
+	m.fridge[ThermalModel::FRIDGE_ROOM] = 655;		// 0.01
+	m.fridge[ThermalModel::FRIDGE_HEAT] = 32768;		// 0.5 deg
+	m.fridge[ThermalModel::FRIDGE_COOL] = -65536;	// -1 deg
+	m.beer[ThermalModel::BEER_FRIDGE] = 131;			// 0.002
+	m.beer[ThermalModel::BEER_FERMENT] = 0;
+	m.samples = 0;
+	m.fridgeError = 0;
+	m.beerError = 0;
+	Sampler& s = samplers[chamber];
+	s.ticks = 0;
+	s.heatTicks = 0;
+	s.coolTicks = 0;
+	s.disturbed = true;
+}
+
+const ThermalModel& ChamberModel::get()
+{
+	return models[chamberManager.current()];
+}
+
+/**
+ * Corrects the coefficients theta so that they predict change from the inputs phi a little better.
+ */
+void ChamberModel::learn(int32_t* theta, const temperature* phi, uint8_t terms, temperature change, uint8_t rateShift,
+	temperature& error)
+{
+	int64_t predicted = 0;
+	int64_t norm = MODEL_REGULARIZATION;
+	for (uint8_t i=0; i<terms; i++) {
+		predicted += int64_t(theta[i])*phi[i];
+		norm += int32_t(phi[i])*phi[i];
+	}
+	int32_t e = change - int32_t((predicted+0x8000)>>16);
+	// divide rather than shift, so the rounding of small corrections doesn't drift the coefficients down
+	for (uint8_t i=0; i<terms; i++)
+		theta[i] += int32_t(((int64_t(e)*phi[i]) << (16-rateShift))/norm);
+	int32_t size = e<0 ? -e : e;
+	error += temperature((min(size, int32_t(INT16_MAX)) - error) >> 4);
+}
+
+void ChamberModel::update(bool heating, bool cooling, bool disturbed)
+{
+	uint8_t chamber = chamberManager.current();
+	Sampler& s = samplers[chamber];
+	ThermalModel& m = models[chamber];
+	temperature beer = tempControl.beerSensor->isConnected() ? tempControl.beerSensor->readFastFiltered() : INVALID_TEMP;
+	temperature fridge = tempControl.fridgeSensor->isConnected() ? tempControl.fridgeSensor->readFastFiltered() : INVALID_TEMP;
+	if (beer==INVALID_TEMP || fridge==INVALID_TEMP || disturbed)
+		s.disturbed = true;
+	s.heatTicks += heating;
+	s.coolTicks += cooling;
+	if (++s.ticks<MODEL_STEP)
+		return;
+
+	if (!s.disturbed) {
+		temperature room = tempControl.ambientSensor->read();
+		temperature fridgeInputs[ThermalModel::FRIDGE_TERMS] = {
+			temperature(s.beer-s.fridge),
+			temperature(room==INVALID_TEMP ? 0 : room-s.fridge),
+			temperature(int32_t(s.heatTicks)*TEMP_FIXED_POINT_SCALE/s.ticks),
+			temperature(int32_t(s.coolTicks)*TEMP_FIXED_POINT_SCALE/s.ticks)
+		};
+		learn(m.fridge, fridgeInputs, ThermalModel::FRIDGE_TERMS, fridge-s.fridge, MODEL_FRIDGE_RATE, m.fridgeError);
+		temperature beerInputs[ThermalModel::BEER_TERMS] = { temperature(s.fridge-s.beer), TEMP_FIXED_POINT_SCALE };
+		learn(m.beer, beerInputs, ThermalModel::BEER_TERMS, beer-s.beer, MODEL_BEER_RATE, m.beerError);
+
+		// heat flows from warm to cold, and the heater can't cool
+		m.fridge[ThermalModel::FRIDGE_BEER] = max(m.fridge[ThermalModel::FRIDGE_BEER], int32_t(0));
+		m.fridge[ThermalModel::FRIDGE_ROOM] = max(m.fridge[ThermalModel::FRIDGE_ROOM], int32_t(0));
+		m.fridge[ThermalModel::FRIDGE_HEAT] = max(m.fridge[ThermalModel::FRIDGE_HEAT], int32_t(0));
+		m.fridge[ThermalModel::FRIDGE_COOL] = min(m.fridge[ThermalModel::FRIDGE_COOL], int32_t(0));
+		m.beer[ThermalModel::BEER_FRIDGE] = max(m.beer[ThermalModel::BEER_FRIDGE], int32_t(0));
+		if (m.samples<UINT16_MAX)
+			m.samples++;
+	}
+
+	s.beer = beer;
+	s.fridge = fridge;
+	s.ticks = 0;
+	s.heatTicks = 0;
+	s.coolTicks = 0;
+	s.disturbed = beer==INVALID_TEMP || fridge==INVALID_TEMP;
+}
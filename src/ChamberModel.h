@@ -0,0 +1,108 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+
+/**
+ * Temperatures stepped forward by the model, kept with MODEL_STATE_BITS more fraction bits than a temperature so
+ * that the small change of the beer in one step is not lost to rounding.
+ */
+#define MODEL_STATE_BITS 8
+
+struct ModelState {
+	int32_t beer;
+	int32_t fridge;
+
+	void set(temperature beerTemp, temperature fridgeTemp) {
+		beer = int32_t(beerTemp)<<MODEL_STATE_BITS;
+		fridge = int32_t(fridgeTemp)<<MODEL_STATE_BITS;
+	}
+	temperature beerTemp() const { return temperature(beer>>MODEL_STATE_BITS); }
+	temperature fridgeTemp() const { return temperature(fridge>>MODEL_STATE_BITS); }
+};
+
+/**
+ * A first order thermal model of a chamber, per model step of MODEL_STEP control ticks:
+ *
+ *	fridge' = fridge + kBeer*(beer-fridge) + kRoom*(room-fridge) + heat*heaterDuty + cool*coolerDuty
+ *	beer' = beer + kFridge*(fridge-beer) + ferment
+ *
+ * The coefficients are in 16.16 fixed point. The duties are the fraction of the step an output was on, with
+ * 1 as TEMP_FIXED_POINT_SCALE, so heat and cool are the change of the fridge in a step with the output always on.
+ */
+struct ThermalModel {
+	enum { FRIDGE_BEER, FRIDGE_ROOM, FRIDGE_HEAT, FRIDGE_COOL, FRIDGE_TERMS };
+	enum { BEER_FRIDGE, BEER_FERMENT, BEER_TERMS };
+	int32_t fridge[FRIDGE_TERMS];
+	int32_t beer[BEER_TERMS];
+	uint16_t samples;			// steps learned from, saturating
+	temperature fridgeError;	// average size of the error of the fridge predicted one step ahead
+	temperature beerError;
+
+	/**
+	 * Moves the state one step forward. room may be INVALID_TEMP when there is no room sensor.
+	 */
+	void step(ModelState& s, temperature room, temperature heaterDuty, temperature coolerDuty) const;
+};
+
+/**
+ * Identifies a ThermalModel of each chamber online, in every mode, from how the temperatures respond to the outputs.
+ *
+ * Every MODEL_STEP control ticks, the change of the fridge and beer temperatures since the last step is compared
+ * with what the model predicted, and the coefficients are corrected by normalized least mean squares, all in
+ * integer math. Steps with the door open or a sensor disconnected are left out. The model starts from typical
+ * values and is not saved, so it is relearned after a restart.
+ */
+class ChamberModel
+{
+public:
+	/**
+	 * Resets the model of the current chamber to the starting values.
+	 */
+	static void reset();
+
+	/**
+	 * Learns from the current chamber, once per control tick, before the outputs are updated for the tick.
+	 * disturbed is true when the door is open, or the outputs are not under control, so the tick is left out.
+	 */
+	static void update(bool heating, bool cooling, bool disturbed);
+
+	/**
+	 * The model of the current chamber.
+	 */
+	static const ThermalModel& get();
+
+private:
+	struct Sampler {
+		temperature beer;			// at the start of the step, or INVALID_TEMP
+		temperature fridge;
+		uint8_t ticks;
+		uint8_t heatTicks;
+		uint8_t coolTicks;
+		bool disturbed;				// the door was opened or a sensor was lost during the step
+	};
+
+	static void learn(int32_t* theta, const temperature* phi, uint8_t terms, temperature change, uint8_t rateShift,
+		temperature& error);
+
+	static ThermalModel models[BREWPI_CHAMBERS];
+	static Sampler samplers[BREWPI_CHAMBERS];
+};
+
+extern ChamberModel chamberModel;
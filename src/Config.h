@@ -250,4 +250,4 @@
 
 #define BUFFER_PILINK_PRINTS 1
 
-#define FORCE_DEVICE_DEFAULTS 1	 // Locks Chamber 1/Beer 1
+#define FORCE_DEVICE_DEFAULTS 1	 // Defaults to Chamber 1/Beer 1 unless a valid chamber/beer is given
@@ -214,3 +214,161 @@
 #endif
 
 
+
+/*
+ * Longest interval (in seconds) between attempts to re-initialize a disconnected onewire temp sensor.
+ * The interval starts at 1 second and doubles after each failed attempt.
+ */
+#ifndef ONEWIRE_TEMP_SENSOR_MAX_BACKOFF
+#define ONEWIRE_TEMP_SENSOR_MAX_BACKOFF 64
+#endif
+
+/*
+ * Size in bytes of the preallocated file holding the settings log. Larger logs are compacted less often.
+ */
+#ifndef SETTINGS_LOG_SIZE
+#define SETTINGS_LOG_SIZE 4096
+#endif
+
+/*
+ * Time in milliseconds that changed settings are held in RAM before being written to flash.
+ * Changes made within this time are combined into a single write.
+ */
+#ifndef SETTINGS_WRITE_DELAY
+#define SETTINGS_WRITE_DELAY 5000
+#endif
+
+/*
+ * Size in bytes of the on-flash temperature history. At one sample a minute, a steady chamber uses a few
+ * KB a day, so the default holds a few weeks.
+ */
+#ifndef HISTORY_LOG_SIZE
+#define HISTORY_LOG_SIZE 131072
+#endif
+
+/*
+ * Seconds between history samples.
+ */
+#ifndef HISTORY_SAMPLE_INTERVAL
+#define HISTORY_SAMPLE_INTERVAL 60
+#endif
+
+/*
+ * Number of control ticks (one a second) kept in RAM for the recent history command. Each takes 14 bytes.
+ */
+#ifndef RECENT_HISTORY_TICKS
+#define RECENT_HISTORY_TICKS 300
+#endif
+
+/*
+ * Number of chambers one controller can drive. Each chamber has its own devices, settings and control state.
+ */
+#ifndef BREWPI_CHAMBERS
+#define BREWPI_CHAMBERS 4
+#endif
+
+/*
+ * Number of beers one chamber can hold, each with its own sensor, setting and PID, and optional heat and cool outputs.
+ */
+#ifndef BREWPI_BEERS
+#define BREWPI_BEERS 3
+#endif
+
+/*
+ * Number of tasks the main loop scheduler can hold, periodic and one-shot together.
+ */
+#ifndef SCHEDULER_TASKS
+#define SCHEDULER_TASKS 12
+#endif
+
+/*
+ * Seconds between saves of the progress of a beer profile running on the controller. A restart sets the profile
+ * back by at most this long.
+ */
+#ifndef BEER_PROFILE_SAVE_INTERVAL
+#define BEER_PROFILE_SAVE_INTERVAL 600
+#endif
+
+/*
+ * Autotune: how far in whole degrees the relay sets the fridge above and below the beer setting (at most pidMax),
+ * how many cycles are measured once the first has settled, and after how many hours a run that has not
+ * finished is given up.
+ */
+#ifndef AUTOTUNE_RELAY_AMPLITUDE
+#define AUTOTUNE_RELAY_AMPLITUDE 4
+#endif
+
+#ifndef AUTOTUNE_CYCLES
+#define AUTOTUNE_CYCLES 3
+#endif
+
+#ifndef AUTOTUNE_TIMEOUT
+#define AUTOTUNE_TIMEOUT 168
+#endif
+
+/*
+ * Control ticks (seconds) in one step of the learned chamber model, which is also how often the model
+ * predictive mode decides whether to heat, cool or idle. At most 255.
+ */
+#ifndef MODEL_STEP
+#define MODEL_STEP 60
+#endif
+
+/*
+ * Model predictive mode: how many model steps ahead each decision looks, and how much a start of the heater or
+ * compressor costs, as the same cost as the beer being 1 degree off for this many model steps. With the default
+ * horizon, 3 lets the beer drift about 0.15 degrees before a start pays off.
+ */
+#ifndef MPC_HORIZON
+#define MPC_HORIZON 120
+#endif
+
+#ifndef MPC_START_PENALTY
+#define MPC_START_PENALTY 3
+#endif
+
+/*
+ * Number of fridge state transitions kept in RAM for the state trace command. Each takes 16 bytes.
+ */
+#ifndef STATE_TRACE_SIZE
+#define STATE_TRACE_SIZE 32
+#endif
+
+/*
+ * Seconds between saves of the start and run time counters of the heater and cooler. A restart loses at most
+ * this much of the counts.
+ */
+#ifndef ACTUATOR_STATS_SAVE_INTERVAL
+#define ACTUATOR_STATS_SAVE_INTERVAL 3600
+#endif
+
+/*
+ * How many hours ahead the forecast command looks, unless asked for another number, how many hours it can be asked
+ * for, and how many points of the forecast beer and fridge temperatures it sends.
+ * The forecast runs within the command, so the longest one has to fit in the 100 ms the control step may start late
+ * (CONTROL_DEADLINE in the sketch). A model step takes about 25 ns on a PC. Allowing 10 us for it on the
+ * device, the 7200 steps of 120 hours take 72 ms. The response reports the time it took.
+ */
+#ifndef FORECAST_HOURS
+#define FORECAST_HOURS 48
+#endif
+
+#ifndef FORECAST_MAX_HOURS
+#define FORECAST_MAX_HOURS 120
+#endif
+
+#ifndef FORECAST_POINTS
+#define FORECAST_POINTS 24
+#endif
+
+/*
+ * Read the onewire temp sensors on the primary bus in the background with OneWireAsync, so the control loop
+ * doesn't spend ~10ms per sensor with interrupts masked. Readings are then one second older.
+ */
+#ifndef BREWPI_ONEWIRE_ASYNC
+#if defined(ESP8266) || !defined(ARDUINO)
+#define BREWPI_ONEWIRE_ASYNC 1
+#else
+#define BREWPI_ONEWIRE_ASYNC 0
+#endif
+#endif
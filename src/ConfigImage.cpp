@@ -0,0 +1,114 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include <stddef.h>
+#include "ConfigImage.h"
+#include "EepromManager.h"
+#include "SettingsManager.h"
+#include "OneWire.h"
+
+uint16_t ConfigImage::build(uint8_t* image, uint16_t size)
+{
+	if (size<sizeof(ConfigImageHeader))
+		return 0;
+	eepromManager.flushSettings();
+
+	ConfigImageHeader& header = *(ConfigImageHeader*)image;
+	uint8_t* records = image+sizeof(header);
+	uint16_t length = settingsLog.exportRecords(records, size-sizeof(header), CONFIG_IMAGE_SKIPPED_RECORDS);
+	if (!length)
+		return 0;
+
+#ifdef ESP8266_WiFi
+	String name = eepromManager.fetchmDNSName();
+	SettingsRecordHeader& h = *(SettingsRecordHeader*)(records+length);
+	uint8_t n = min(name.length(), (unsigned int)CONFIG_MDNS_NAME_MAX);
+	if (length+sizeof(h)+n > size-sizeof(header))
+		return 0;
+	h.magic = SETTINGS_RECORD_MAGIC;
+	h.type = CONFIG_RECORD_MDNS_NAME;
+	h.id = 0;
+	h.version = 0;
+	h.length = n;
+	memcpy(records+length+sizeof(h), name.c_str(), n);
+	h.crc = SettingsLog::recordCrc(records+length);
+	length += sizeof(h)+n;
+#endif
+
+	header.magic = CONFIG_IMAGE_MAGIC;
+	header.format = CONFIG_IMAGE_FORMAT;
+	header.reserved = 0;
+	header.length = length;
+	header.crc = OneWire::crc16(records, length);
+	return sizeof(header)+length;
+}
+
+ConfigImageResult ConfigImage::apply(const uint8_t* image, uint16_t length)
+{
+	const ConfigImageHeader& header = *(const ConfigImageHeader*)image;
+	if (length<sizeof(header) || header.magic!=CONFIG_IMAGE_MAGIC || header.format!=CONFIG_IMAGE_FORMAT
+		|| header.length!=length-sizeof(header))
+		return CONFIG_IMAGE_BAD_HEADER;
+	const uint8_t* records = image+sizeof(header);
+	if (header.crc!=OneWire::crc16(records, header.length))
+		return CONFIG_IMAGE_BAD_CHECKSUM;
+
+	// split off the mDNS name, which must be last, and check that the first chamber's settings and constants are there
+	uint16_t settingsLength = header.length;
+	const SettingsRecordHeader* name = NULL;
+	bool hasSettings = false, hasConstants = false;
+	for (uint16_t offset = 0; offset<header.length; ) {
+		const SettingsRecordHeader& h = *(const SettingsRecordHeader*)(records+offset);
+		if (name || offset+sizeof(h)>header.length || offset+sizeof(h)+h.length>header.length)
+			return CONFIG_IMAGE_BAD_RECORD;
+		if (h.type==CONFIG_RECORD_MDNS_NAME) {
+			if (h.magic!=SETTINGS_RECORD_MAGIC || h.length>CONFIG_MDNS_NAME_MAX || h.crc!=SettingsLog::recordCrc(records+offset))
+				return CONFIG_IMAGE_BAD_RECORD;
+			for (uint8_t i=0; i<h.length; i++)
+				if (!isalnum(records[offset+sizeof(h)+i]))
+					return CONFIG_IMAGE_BAD_RECORD;
+			name = &h;
+			settingsLength = offset;
+		}
+		hasSettings |= h.type==SETTINGS_RECORD_CONTROL_SETTINGS && h.id==0;
+		hasConstants |= h.type==SETTINGS_RECORD_CONTROL_CONSTANTS && h.id==0;
+		offset += sizeof(h)+h.length;
+	}
+	if (!hasSettings || !hasConstants || !settingsLog.validRecords(records, settingsLength))
+		return CONFIG_IMAGE_BAD_RECORD;
+
+	if (!settingsLog.replace(records, settingsLength, CONFIG_IMAGE_SKIPPED_RECORDS))
+		return CONFIG_IMAGE_WRITE_FAILED;
+
+#ifdef ESP8266_WiFi
+	if (name && name->length) {
+		char buffer[CONFIG_MDNS_NAME_MAX+1];
+		memcpy(buffer, name+1, name->length);
+		buffer[name->length] = 0;
+		eepromManager.savemDNSName(buffer);		// takes effect at the next restart
+	}
+#endif
+
+	// reload from the new records. Settings still pending in RAM are replaced too, so flushing them later writes nothing.
+	settingsManager.loadSettings();
+	return CONFIG_IMAGE_OK;
+}
+
+#endif
@@ -0,0 +1,98 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include "SettingsLog.h"
+#include "EepromStructs.h"
+
+#define CONFIG_IMAGE_MAGIC 0x4942		// "BI"
+const uint8_t CONFIG_IMAGE_FORMAT = 1;
+
+/**
+ * Record type that only appears in images. The mDNS name is kept in its own file rather than the settings log.
+ */
+const uint8_t CONFIG_RECORD_MDNS_NAME = 0x80;
+const uint8_t CONFIG_MDNS_NAME_MAX = 20;
+
+/**
+ * Starts an image. It is followed by length bytes of records in the settings log format, with the
+ * optional mDNS name record last.
+ */
+struct ConfigImageHeader {
+	uint16_t magic;
+	uint8_t format;
+	uint8_t reserved;
+	uint16_t length;
+	uint16_t crc;			// crc16 of the records
+};
+
+/**
+ * Records that belong to the running controller rather than its configuration: the beer profile progress and the
+ * actuator counters. They are left out of an image, and kept when one is applied.
+ */
+const uint8_t CONFIG_IMAGE_SKIPPED_RECORDS = SETTINGS_RECORD_BIT(SETTINGS_RECORD_PROFILE_PROGRESS)
+	| SETTINGS_RECORD_BIT(SETTINGS_RECORD_ACTUATOR_STATS);
+
+/**
+ * Room for the current version of every record in an image, with the mDNS name.
+ */
+const uint16_t CONFIG_IMAGE_MAX = sizeof(ConfigImageHeader)
+	+ (SETTINGS_LOG_RECORDS-2*SETTINGS_LOG_CHAMBERS+1)*sizeof(SettingsRecordHeader)
+	+ SETTINGS_LOG_CHAMBERS*(SETTINGS_LOG_BEERS*sizeof(ControlSettings)+sizeof(ControlConstants))
+	+ SETTINGS_LOG_DEVICES*sizeof(DeviceConfig)
+	+ SETTINGS_LOG_CHAMBERS*sizeof(BeerProfileRecord)
+	+ CONFIG_MDNS_NAME_MAX;
+
+enum ConfigImageResult {
+	CONFIG_IMAGE_OK = 0,
+	CONFIG_IMAGE_BAD_ENCODING = 1,	// not valid base64
+	CONFIG_IMAGE_TOO_LARGE = 2,
+	CONFIG_IMAGE_BAD_HEADER = 3,	// not an image, or an image format this firmware does not know
+	CONFIG_IMAGE_BAD_CHECKSUM = 4,
+	CONFIG_IMAGE_BAD_RECORD = 5,	// a record is malformed or of an unknown type, or settings or constants are missing
+	CONFIG_IMAGE_WRITE_FAILED = 6
+};
+
+/**
+ * The whole configuration - control constants and settings of every chamber, every device slot and the mDNS
+ * name - as a single versioned and checksummed image, so a controller can be backed up and restored in one
+ * command each way instead of replaying the settings and device definitions one by one.
+ *
+ * The records carry their layout version, so an image taken with earlier firmware is upgraded on import
+ * in the same way as the settings log is at boot.
+ */
+class ConfigImage
+{
+public:
+	/**
+	 * Writes pending settings and builds an image of the stored configuration.
+	 * Returns the length of the image, or 0 if it does not fit in size bytes.
+	 */
+	static uint16_t build(uint8_t* image, uint16_t size);
+
+	/**
+	 * Checks the image as a whole and only then replaces the stored configuration with it, in a single write
+	 * of the settings log, and applies it.
+	 */
+	static ConfigImageResult apply(const uint8_t* image, uint16_t length);
+};
+
+#endif
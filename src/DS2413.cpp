@@ -23,11 +23,98 @@
 
 #include "DS2413.h"
 
+DS2413Latch* DS2413::latches = NULL;
+uint8_t DS2413::batchDepth = 0;
+
+/*
+ * A valid PIO status byte has the upper nibble set to the complement of the lower nibble.
+ */
+static inline bool validStatus(uint8_t status)
+{
+	return (status>>4)==((~status)&0xF);
+}
+
+/*
+ * The output latch bits of a PIO status byte (b1 PIOA, b3 PIOB), as written: bit 0 PIOA, bit 1 PIOB.
+ */
+static inline uint8_t latchState(uint8_t status)
+{
+	return (status&0x8)>>2 | (status&2)>>1;
+}
+
+void DS2413::acquireLatch()
+{
+	releaseLatch();
+	for (DS2413Latch* l = latches; l; l = l->next) {
+		if (l->oneWire==oneWire && !memcmp(l->address, address, sizeof(DeviceAddress))) {
+			l->refs++;
+			latch = l;
+			return;
+		}
+	}
+	latch = new DS2413Latch();
+	if (!latch)
+		return;
+	latch->oneWire = oneWire;
+	memcpy(latch->address, address, sizeof(DeviceAddress));
+	latch->desired = 0xFF;		// not yet set
+	latch->written = 0;
+	latch->known = false;
+	latch->checked = 0;
+	latch->refs = 1;
+	latch->next = latches;
+	latches = latch;
+}
+
+void DS2413::releaseLatch()
+{
+	if (!latch)
+		return;
+	if (--latch->refs==0) {
+		DS2413Latch** link = &latches;
+		while (*link!=latch)
+			link = &(*link)->next;
+		*link = latch->next;
+		delete latch;
+	}
+	latch = NULL;
+}
+
+bool DS2413::flush(DS2413Latch* latch)
+{
+	if (latch->desired==0xFF)
+		return true;		// nothing requested yet
+	if (latch->known && latch->written==latch->desired) {
+		if (ticks.millis()-latch->checked < DS2413_LATCH_CHECK_INTERVAL)
+			return true;
+		byte result = accessRead(latch->oneWire, latch->address, 3);
+		if (!(result&ACCESS_READ_ERROR) && latchState(result)==latch->written) {
+			latch->checked = ticks.millis();
+			return true;
+		}
+		latch->known = false;	// lost power or unreachable: write it again
+	}
+	latch->known = accessWrite(latch->oneWire, latch->address, latch->desired);
+	if (latch->known) {
+		latch->written = latch->desired;
+		latch->checked = ticks.millis();
+	}
+	return latch->known;
+}
+
+void DS2413::endBatch()
+{
+	if (batchDepth && --batchDepth)
+		return;
+	for (DS2413Latch* l = latches; l; l = l->next)
+		flush(l);
+}
+
 
 
 /*
 	* Read all values at once, both current state and sensed values. The read performs data-integrity checks.
-	* Returns a negative result if the device cannot be read successfully within the given number of tries.
+	* Sets ACCESS_READ_ERROR in the result if the device cannot be read successfully within the given number of tries.
 	* The lower 4-bits are the values as described under PIO ACCESSS READ [F5h] in the ds2413 datasheet:	 
 	* b0: PIOA state
 	* b1: PIOA output latch state
@@ -35,7 +122,16 @@
 	* b3: PIOB output latch state
 	*/
 byte DS2413::accessRead(uint8_t maxTries) /* const */
-{		
+{
+	byte result = accessRead(oneWire, address, maxTries);
+	// a failed read, or a latch other than the one last written, means the confirmed state can't be trusted
+	if (latch && latch->known && ((result&ACCESS_READ_ERROR) || latchState(result)!=latch->written))
+		latch->known = false;
+	return result;
+}
+
+byte DS2413::accessRead(OneWire* oneWire, const uint8_t* address, uint8_t maxTries)
+{
 	#define ACCESS_READ 0xF5
 		
 	oneWire->reset();
@@ -47,28 +143,28 @@ byte DS2413::accessRead(uint8_t maxTries) /* const */
 	do 
 	{
 		data = oneWire->read();
-		success = (data>>4)==(!data&0xF);
+		success = validStatus(data);
 		data &= 0xF;
 	} while (!success && maxTries-->0);
 		
 	oneWire->reset();		
-	return success ? data : data|0x80;
+	return success ? data : data|ACCESS_READ_ERROR;
 }
 	
 /*
 	* Writes the state of all PIOs in one operation.
 	* /param b pio data - PIOA is bit 0 (lsb), PIOB is bit 1	 
 	* /param maxTries the maximum number of attempts before giving up.
-	* /return true on success
+	* /return true when the device acknowledged the write and the returned PIO status shows the requested latch state
 	*/
-bool DS2413::accessWrite(uint8_t b, uint8_t maxTries)
+bool DS2413::accessWrite(OneWire* oneWire, const uint8_t* address, uint8_t b, uint8_t maxTries)
 {
 	#define ACCESS_WRITE 0x5A
 	#define ACK_SUCCESS 0xAA
 	#define ACK_ERROR 0xFF
 		
 	b |= 0xFC;   		/* Upper 6 bits should be set to 1's */
-	uint8_t ack = 0;
+	bool success = false;
 	do
 	{
 		oneWire->reset();
@@ -79,16 +175,17 @@ bool DS2413::accessWrite(uint8_t b, uint8_t maxTries)
 		/* data is sent again, inverted to guard against transmission errors */
 		oneWire->write(~b);
 		/* Acknowledgement byte, 0xAA for success, 0xFF for failure. */
-		ack = oneWire->read();
+		uint8_t ack = oneWire->read();
 						
-		if (ack==ACK_SUCCESS)
-			oneWire->read();		// status byte sent after ack
-			
-		//out.print("tries "); out.print(maxTries); out.print(" ack ");out.print(ack, HEX);out.print(" newValues ");out.print(newSettings, HEX);
-		//out.println();
-	} while (ack!=ACK_SUCCESS && maxTries-->0);
+		if (ack==ACK_SUCCESS) {
+			// The status byte sent after the ack has the same layout as an access read.
+			// Check the latch bits (b1 PIOA, b3 PIOB) match what was written.
+			uint8_t status = oneWire->read();
+			success = validStatus(status) && latchState(status)==(b&0x3);
+		}
+	} while (!success && maxTries-->0);
 		
 	oneWire->reset();
-	return ack==ACK_SUCCESS;
+	return success;
 }
 
@@ -20,11 +20,10 @@
 
 #pragma once
 
-#ifdef ARDUINO
-
 #include "Brewpi.h"
 #include "OneWire.h"
 #include "PiLink.h"
+#include "Ticks.h"
 
 typedef uint8_t DeviceAddress[8];
 typedef uint8_t pio_t;
@@ -38,8 +37,32 @@ typedef uint8_t pio_t;
 #define DS2413_SUPPORT_SENSE 1
 #endif
 
+// How often, in milliseconds, a latch that is not being changed is read back to check the chip still holds it.
+// A brown-out resets the chip to both channels off, which would otherwise go unnoticed.
+#ifndef DS2413_LATCH_CHECK_INTERVAL
+#define DS2413_LATCH_CHECK_INTERVAL 10000
+#endif
+
 #define  DS2413_FAMILY_ID 0x3A
 
+/*
+ * The output latch state of one physical DS2413, shared by all DS2413 instances that address the same chip.
+ * Writes to either PIO update the desired state; the chip is only written when the desired state differs
+ * from the state last confirmed by the device. The confirmed state is forgotten when a read of the chip fails or
+ * shows a different latch, and is read back every DS2413_LATCH_CHECK_INTERVAL.
+ */
+struct DS2413Latch
+{
+	OneWire* oneWire;
+	DeviceAddress address;
+	uint8_t desired;		// bit 0 PIOA latch, bit 1 PIOB latch
+	uint8_t written;		// last value confirmed by the device, only meaningful when known is true
+	bool known;
+	ticks_millis_t checked;	// when written was last confirmed
+	uint8_t refs;
+	DS2413Latch* next;
+};
+
 /*
  * Provides access to a OneWire-addressable dual-channel I/O device. 
  * The channel latch can be set to on (false) or off (true).
@@ -52,9 +75,14 @@ class DS2413
 {
 public:
 	
-	DS2413()
+	DS2413() : latch(NULL)
 	{		
 	}
+	
+	~DS2413()
+	{
+		releaseLatch();
+	}
 
 	/*
 	 * Initializes this ds2413.
@@ -65,6 +93,7 @@ public:
 	{
 		this->oneWire = oneWire;
 		memcpy(this->address, address, sizeof(DeviceAddress));
+		acquireLatch();
 	}
 
 #if DS2413_DYNAMIC_ADDRESS 
@@ -72,9 +101,21 @@ public:
 	{
 		this->oneWire = oneWire;
 		getAddress(oneWire, this->address, 0);
+		acquireLatch();
 	}
 #endif	
 
+	/*
+	 * Starts collecting channel writes. Writes made until the matching endBatch() are
+	 * combined per chip and sent in a single transaction. Batches may be nested.
+	 */
+	static void beginBatch() { batchDepth++; }
+	
+	/*
+	 * Ends a batch. When the outermost batch ends, each chip whose combined latch state changed is written.
+	 */
+	static void endBatch();
+
 	/*
 	 * Determines if the device is connected. Note that the value returned here is potentially stale immediately on return,
 	 * and should only be used for status reporting. In particular, a return value of true does not provide any guarantee
@@ -82,20 +123,23 @@ public:
 	 */
 	bool isConnected()
 	{
-		return validAddress(oneWire, this->address) && accessRead()>=0;
+		return validAddress(oneWire, this->address) && !(accessRead()&ACCESS_READ_ERROR);
 	}
 	
 	// assumes pio is either 0 or 1, which translates to masks 0x1 and 0x2
-	uint8_t pioMask(pio_t pio) { return pio++; }
+	uint8_t pioMask(pio_t pio) { return 1<<pio; }
 
 	/*
 	 * Reads the output state of a given channel, defaulting to a given value on error.
-	 * Note that for a read to make sense the channel must be off (value written is 1).
+	 * The latch state confirmed by the last write is used when available, so this only goes out on the bus
+	 * when the state of the chip is not known.
 	 */
 	bool channelRead(pio_t pio, bool defaultValue)
 	{
+		if (latch && latch->known)
+			return (latch->written & pioMask(pio));
 		byte result = channelReadAll();		
-		if (result<0)
+		if (result&ACCESS_READ_ERROR)
 			return defaultValue;
 		return (result & pioMask(pio));
 	}
@@ -108,7 +152,7 @@ public:
 	bool channelSense(pio_t pio, bool defaultValue)
 	{
 		byte result = channelSenseAll();
-		if (result<0)
+		if (result&ACCESS_READ_ERROR)
 			return defaultValue;
 		return (result & pioMask(pio));
 	}
@@ -116,43 +160,51 @@ public:
 	uint8_t channelSenseAll()
 	{
 		byte result = accessRead();
-		// save bit3 and bit1 (PIO
-		return result<0 ? result : ((result&0x4)>>1 | (result&1));
+		// save bit2 and bit0 (PIO state)
+		return (result&ACCESS_READ_ERROR) ? result : ((result&0x4)>>1 | (result&1));
 	}
 
 #endif
 	/*
 	 * Performs a simultaneous read of both channels.
-	 * /return <0 if there was an error otherwise bit 1 is channel A state, bit 2 is channel B state.
+	 * /return ACCESS_READ_ERROR set if there was an error otherwise bit 0 is channel A state, bit 1 is channel B state.
 	 */
 	uint8_t channelReadAll()
 	{
 		byte result = accessRead();
-		// save bit3 and bit1 (PIO
-		return result<0 ? result : ((result&0x8)>>2 | (result&2)>>1);
+		// save bit3 and bit1 (PIO latch)
+		return (result&ACCESS_READ_ERROR) ? result : ((result&0x8)>>2 | (result&2)>>1);
 	}
 	
 	/*
 	 * Writes to the latch for a given PIO.
+	 * Inside a batch the write is deferred until endBatch(), and true is returned.
 	 * /param set	1 to switch the pin off, 0 to switch on. 
 	 */
 	bool channelWrite(pio_t pio, bool set)
 	{
-		bool ok = false;
-		byte result = channelReadAll();
-		if (result>=0) {
-			uint8_t mask = pioMask(pio);
-			if (set)
-				result |= mask;
-			else
-				result &= ~mask;
-			ok = channelWriteAll((uint8_t)result);
-		}		
-		return ok;
+		if (!latch)
+			return false;
+		uint8_t mask = pioMask(pio);
+		if (!latch->known && latch->desired==0xFF) {
+			// first write to this chip - preserve the other channel
+			byte result = channelReadAll();
+			if (result&ACCESS_READ_ERROR)
+				return false;
+			latch->desired = result;
+		}
+		if (set)
+			latch->desired |= mask;
+		else
+			latch->desired &= ~mask;
+		return batchDepth ? true : flush(latch);
 	}
 	
 	bool channelWriteAll(uint8_t values) {
-		return accessWrite(values);
+		if (!latch)
+			return false;
+		latch->desired = values & 0x3;
+		return batchDepth ? true : flush(latch);
 	}
 	
 	DeviceAddress& getDeviceAddress()
@@ -189,11 +241,25 @@ public:
 		return false;
 	}
 #endif	
+	// set in the result of accessRead() and the channel read functions when the device could not be read
+	static const uint8_t ACCESS_READ_ERROR = 0x80;
+
 private:
 
+	/*
+	 * Finds the latch for this chip, creating it if this is the first instance that addresses it.
+	 */
+	void acquireLatch();
+	void releaseLatch();
+	
+	/*
+	 * Writes the latch to the chip if the desired state is not known to be the current state.
+	 */
+	static bool flush(DS2413Latch* latch);
+
 	/*
 	 * Read all values at once, both current state and sensed values. The read performs data-integrity checks.
-	 * Returns a negative result if the device cannot be read successfully within the given number of tries.
+	 * Sets ACCESS_READ_ERROR in the result if the device cannot be read successfully within the given number of tries.
 	 * The lower 4-bits are the values as described under PIO ACCESSS READ [F5h] in the ds2413 datasheet:	 
 	 * b0: PIOA state
 	 * b1: PIOA output latch state
@@ -201,17 +267,20 @@ private:
 	 * b3: PIOB output latch state
 	 */
 	byte accessRead(uint8_t maxTries=3);
+	static byte accessRead(OneWire* oneWire, const uint8_t* address, uint8_t maxTries);
 	
 	/*
 	 * Writes the state of all PIOs in one operation.
 	 * /param b pio data - PIOA is bit 0 (lsb), PIOB is bit 1	 
 	 * /param maxTries the maximum number of attempts before giving up.
-	 * /return true on success
+	 * /return true when the device acknowledged the write and the returned PIO status shows the requested latch state
 	 */
-	bool accessWrite(uint8_t b, uint8_t maxTries=3);
+	static bool accessWrite(OneWire* oneWire, const uint8_t* address, uint8_t b, uint8_t maxTries=3);
 
 	OneWire* oneWire;	
 	DeviceAddress address;	
+	DS2413Latch* latch;
+	
+	static DS2413Latch* latches;
+	static uint8_t batchDepth;
 };
-
-#endif
\ No newline at end of file
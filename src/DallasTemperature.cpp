@@ -15,7 +15,7 @@
 #include "Ticks.h"
 
 
-#if ARDUINO >= 100
+#if ARDUINO >= 100 || !defined(ARDUINO)
 #include "Arduino.h"
 #else
 extern "C" {
@@ -573,10 +573,35 @@ int16_t DallasTemperature::calculateTemperature(const uint8_t* deviceAddress, ui
 // DallasTemperature.h. It is a large negative number outside the
 // operating range of the device
 int16_t DallasTemperature::getTempRaw(const uint8_t* deviceAddress)
+{
+    ReadStatus status;
+    return getTempRaw(deviceAddress, status);
+}
+
+// as getTempRaw(), but also reports why a read failed
+int16_t DallasTemperature::getTempRaw(const uint8_t* deviceAddress, ReadStatus& status)
 {
     ScratchPad scratchPad;
-    if (isConnected(deviceAddress, scratchPad) && !detectedReset(scratchPad)) return calculateTemperature(deviceAddress, scratchPad);	
-    return DEVICE_DISCONNECTED;		// use a value that the sensor could not ordinarily measure
+    if (!isConnected(deviceAddress, scratchPad)) {
+        status = READ_CRC_ERROR;
+        return DEVICE_DISCONNECTED;		// use a value that the sensor could not ordinarily measure
+    }
+    return decodeScratchPad(deviceAddress, scratchPad, status);
+}
+
+// as getTempRaw(), for a scratchpad read by the caller, e.g. in the background with OneWireAsync
+int16_t DallasTemperature::decodeScratchPad(const uint8_t* deviceAddress, uint8_t* scratchPad, ReadStatus& status)
+{
+    if (_wire->crc8(scratchPad, 8) != scratchPad[SCRATCHPAD_CRC]) {
+        status = READ_CRC_ERROR;
+        return DEVICE_DISCONNECTED;
+    }
+    if (detectedReset(scratchPad)) {
+        status = READ_RESET_DETECTED;
+        return DEVICE_DISCONNECTED;
+    }
+    status = READ_OK;
+    return calculateTemperature(deviceAddress, scratchPad);
 }
 
 #if REQUIRESTEMPCONVERSION
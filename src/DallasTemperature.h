@@ -229,6 +229,18 @@ class DallasTemperature
   int16_t getTemp(const uint8_t* address) { return getTempRaw(address); }
   
   int16_t getTempRaw(const uint8_t* deviceAddress);  // changed return type from uint32 to int16 (Elco, BrewPi)
+
+  // reason a call to getTempRaw() returned DEVICE_DISCONNECTED
+  enum ReadStatus {
+	READ_OK = 0,
+	READ_CRC_ERROR = 1,			// scratchpad CRC mismatch, includes a missing device
+	READ_RESET_DETECTED = 2		// device lost power since initConnection()
+  };
+
+  int16_t getTempRaw(const uint8_t* deviceAddress, ReadStatus& status);
+
+  // as getTempRaw(), for a scratchpad the caller has read. Only the crc is checked, not the power supply.
+  int16_t decodeScratchPad(const uint8_t* deviceAddress, uint8_t* scratchPad, ReadStatus& status);
   
 #if REQUIRESTEMPCONVERSION
   // returns temperature in degrees C
@@ -28,6 +28,8 @@
 #include "TempSensorExternal.h"
 #include "PiLink.h"
 #include "EepromFormat.h"
+#include "DeviceRegistry.h"
+#include "ChamberManager.h"
 
 #define CALIBRATION_OFFSET_PRECISION (4)
 
@@ -53,6 +55,9 @@ DisconnectedTempSensor defaultTempSensor;
 #if !BREWPI_SIMULATE
 #ifdef oneWirePin
 OneWire DeviceManager::primaryOneWireBus(oneWirePin);
+#if BREWPI_ONEWIRE_ASYNC
+OneWireAsync DeviceManager::primaryOneWireAsync(oneWirePin);
+#endif
 #else
 OneWire DeviceManager::beerSensorBus(beerSensorPin);
 OneWire DeviceManager::fridgeSensorBus(fridgeSensorPin);
@@ -75,6 +80,17 @@ OneWire* DeviceManager::oneWireBus(uint8_t pin) {
 	return NULL;
 }
 
+/**
+ * The background reader of the bus on the given pin, or NULL if sensors on the pin are read directly.
+ */
+OneWireAsync* DeviceManager::oneWireAsync(uint8_t pin) {
+#if !BREWPI_SIMULATE && BREWPI_ONEWIRE_ASYNC && defined(oneWirePin)
+	if (pin == oneWirePin)
+		return &primaryOneWireAsync;
+#endif
+	return NULL;
+}
+
 bool DeviceManager::firstDeviceOutput;
 
 bool DeviceManager::isDefaultTempSensor(BasicTempSensor* sensor) {
@@ -87,14 +103,20 @@ bool DeviceManager::isDefaultTempSensor(BasicTempSensor* sensor) {
  */
 void DeviceManager::setupUnconfiguredDevices()
 {	
-	// right now, uninstall doesn't care about chamber/beer distinction.
-	// but this will need to match beer/function when multiferment is available
+	// the chamber devices are found whatever the beer, and uninstalling is idempotent, so each beer can
+	// simply go through all functions.
 	DeviceConfig cfg;	
-	cfg.chamber = 1; cfg.beer = 1;		
-	for (uint8_t i=0; i<DEVICE_MAX; i++) {
-		cfg.deviceFunction = DeviceFunction(i);
-		uninstallDevice(cfg);
-	}			
+	for (uint8_t chamber=chamberManager.count(); chamber>0; chamber--) {
+		cfg.chamber = chamber;
+		for (uint8_t beer=1; beer<=BREWPI_BEERS; beer++) {
+			cfg.beer = beer;
+			for (uint8_t i=0; i<DEVICE_MAX; i++) {
+				cfg.deviceFunction = DeviceFunction(i);
+				uninstallDevice(cfg);
+			}
+		}
+	}
+	chamberManager.reset();
 }
 
 
@@ -124,7 +146,8 @@ void* DeviceManager::createDevice(DeviceConfig& config, DeviceType dt)
 		#if BREWPI_SIMULATE
 			return new ExternalTempSensor(false);// initially disconnected, so init doesn't populate the filters with the default value of 0.0
 		#else
-			return new OneWireTempSensor(oneWireBus(config.hw.pinNr), config.hw.address, config.hw.calibration);
+			return new OneWireTempSensor(oneWireBus(config.hw.pinNr), config.hw.address, config.hw.calibration,
+				oneWireAsync(config.hw.pinNr));
 		#endif
 
 #if BREWPI_DS2413
@@ -142,69 +165,6 @@ void* DeviceManager::createDevice(DeviceConfig& config, DeviceType dt)
 	return NULL;
 }
 
-/**
- * Returns the pointer to where the device pointer resides. This can be used to delete the current device and install a new one. 
- * For Temperature sensors, the returned pointer points to a TempSensor*. The basic device can be fetched by calling
- * TempSensor::getSensor().
- */
-inline void** deviceTarget(DeviceConfig& config)
-{
-	// for multichamber, will write directly to the multi-chamber managed storage.
-	// later...	
-	if (config.chamber>1 || config.beer>1)
-		return NULL;
-	
-	void** ppv;
-	switch (config.deviceFunction) {
-	case DEVICE_CHAMBER_ROOM_TEMP:
-		ppv = (void**)&tempControl.ambientSensor;
-		break;
-	case DEVICE_CHAMBER_DOOR:
-		ppv = (void**)&tempControl.door;
-		break;
-	case DEVICE_CHAMBER_LIGHT:
-		ppv = (void**)&tempControl.light;
-		break;
-	case DEVICE_CHAMBER_HEAT:
-		ppv = (void**)&tempControl.heater;
-		break;
-	case DEVICE_CHAMBER_COOL:
-		ppv = (void**)&tempControl.cooler;
-		break;
-	case DEVICE_CHAMBER_TEMP:
-		ppv = (void**)&tempControl.fridgeSensor;
-		break;
-	case DEVICE_CHAMBER_FAN:
-		ppv = (void**)&tempControl.fan;
-		break;		
-	
-	case DEVICE_BEER_TEMP:
-		ppv = (void**)&tempControl.beerSensor;
-		break;
-	default:
-		ppv = NULL;
-	}
-	return ppv;
-}
-
-// A pointer to a "temp sensor" may be a TempSensor* or a BasicTempSensor* .
-// These functions allow uniform treatment.
-inline bool isBasicSensor(DeviceFunction function) {
-	// currently only ambient sensor is basic. The others are wrapped in a TempSensor.
-	return function==DEVICE_CHAMBER_ROOM_TEMP;
-}
-
-inline BasicTempSensor& unwrapSensor(DeviceFunction f, void* pv) {
-	return isBasicSensor(f) ? *(BasicTempSensor*)pv : ((TempSensor*)pv)->sensor();
-}
-
-inline void setSensor(DeviceFunction f, void** ppv, BasicTempSensor* sensor) {
-	if (isBasicSensor(f)) 
-		*ppv = sensor;
-	else
-		((TempSensor*)*ppv)->setSensor(sensor);
-}
-
 /**
  * Removes an installed device.
  * /param config The device to remove. The fields that are used are
@@ -213,9 +173,12 @@ inline void setSensor(DeviceFunction f, void** ppv, BasicTempSensor* sensor) {
 
 void DeviceManager::uninstallDevice(DeviceConfig& config)
 {
+	ChamberSwitch chamber(config.chamber);
+	if (!chamber.switched())
+		return;
 	DeviceType dt = deviceType(config.deviceFunction);
-	void** ppv = deviceTarget(config);	
-	if (ppv==NULL)
+	const DeviceHandle* h = deviceRegistry.handle(config);
+	if (h==NULL)
 		return;
 	
 	BasicTempSensor* s;
@@ -224,38 +187,41 @@ void DeviceManager::uninstallDevice(DeviceConfig& config)
 			break;
 		case DEVICETYPE_TEMP_SENSOR:
 			// sensor may be wrapped in a TempSensor class, or may stand alone.
-			s = &unwrapSensor(config.deviceFunction, *ppv);
+			s = &h->sensor();
 			if (s!=&defaultTempSensor) {
-				setSensor(config.deviceFunction, ppv, &defaultTempSensor);
+				h->setSensor(&defaultTempSensor);
 //				DEBUG_ONLY(logInfoInt(INFO_UNINSTALL_TEMP_SENSOR, config.deviceFunction));
 				delete s;
 			}
 			break;
 		case DEVICETYPE_SWITCH_ACTUATOR:
-			if (*ppv!=&defaultActuator) {
+			if (*h->actuator!=&defaultActuator) {
 //				DEBUG_ONLY(logInfoInt(INFO_UNINSTALL_ACTUATOR, config.deviceFunction));
-				delete (Actuator*)*ppv;
-				*ppv = &defaultActuator;
+				delete *h->actuator;
+				*h->actuator = &defaultActuator;
 			}
 			break;
 		case DEVICETYPE_SWITCH_SENSOR:
-			if (*ppv!=&defaultSensor) {
+			if (*h->switchSensor!=&defaultSensor) {
 //				DEBUG_ONLY(logInfoInt(INFO_UNINSTALL_SWITCH_SENSOR, config.deviceFunction));
-				delete (SwitchSensor*)*ppv;
-				*ppv = &defaultSensor;
+				delete *h->switchSensor;
+				*h->switchSensor = &defaultSensor;
 			}
 			break;
 	}		
 }
 
 /**
- * Creates and installs a device in the current chamber. 
+ * Creates and installs a device in the chamber it is configured for, or the current chamber when there is none.
  */
 void DeviceManager::installDevice(DeviceConfig& config)
 {	
+	ChamberSwitch chamber(config.chamber);
+	if (!chamber.switched())
+		return;
 	DeviceType dt = deviceType(config.deviceFunction);
-	void** ppv = deviceTarget(config);
-	if (ppv==NULL || config.hw.deactivate)
+	const DeviceHandle* h = deviceRegistry.handle(config);
+	if (h==NULL || config.hw.deactivate)
 		return;
 		
 	BasicTempSensor* s;
@@ -267,15 +233,16 @@ void DeviceManager::installDevice(DeviceConfig& config)
 			DEBUG_ONLY(logInfoInt(INFO_INSTALL_TEMP_SENSOR, config.deviceFunction));
 			// sensor may be wrapped in a TempSensor class, or may stand alone.
 			s = (BasicTempSensor*)createDevice(config, dt);
-			if (*ppv==NULL){
+			if (s==NULL){
 				logErrorInt(ERROR_OUT_OF_MEMORY_FOR_DEVICE, config.deviceFunction);
+				break;
 			}
-			if (isBasicSensor(config.deviceFunction)) {
+			if (h->basicTempSensor) {
 				s->init();
-				*ppv = s;				
+				*h->basicTempSensor = s;
 			}
 			else {
-				ts = ((TempSensor*)*ppv);
+				ts = *h->tempSensor;
 				ts->setSensor(s);
 				ts->init();
 			}
@@ -284,11 +251,18 @@ void DeviceManager::installDevice(DeviceConfig& config)
 #endif			
 			break;
 		case DEVICETYPE_SWITCH_ACTUATOR:
+			DEBUG_ONLY(logInfoInt(INFO_INSTALL_DEVICE, config.deviceFunction));
+			*h->actuator = (Actuator*)createDevice(config, dt);
+#if (BREWPI_DEBUG > 0)
+			if (*h->actuator==NULL)
+				logErrorInt(ERROR_OUT_OF_MEMORY_FOR_DEVICE, config.deviceFunction);
+#endif			
+			break;
 		case DEVICETYPE_SWITCH_SENSOR:
 			DEBUG_ONLY(logInfoInt(INFO_INSTALL_DEVICE, config.deviceFunction));
-			*ppv = createDevice(config, dt);
+			*h->switchSensor = (SwitchSensor*)createDevice(config, dt);
 #if (BREWPI_DEBUG > 0)
-			if (*ppv==NULL)
+			if (*h->switchSensor==NULL)
 				logErrorInt(ERROR_OUT_OF_MEMORY_FOR_DEVICE, config.deviceFunction);
 #endif			
 			break;
@@ -381,10 +355,13 @@ void DeviceManager::parseDeviceDefinition()
 		return;
 
 #ifdef FORCE_DEVICE_DEFAULTS
-	// If FORCE_DEVICE_DEFAULTS is set, overwrite the chamber/beer number to prevent user error.
-	dev.chamber = 1;
-	if (dev.deviceFunction >= 9 && dev.deviceFunction <= 15)
-		dev.beer = 1;
+	// If FORCE_DEVICE_DEFAULTS is set, overwrite chamber and beer numbers that are out of range, to prevent user error.
+	if (!inRangeInt8(dev.chamber, 1, BREWPI_CHAMBERS))
+		dev.chamber = 1;
+	if (dev.deviceFunction >= 9 && dev.deviceFunction <= 15) {
+		if (!inRangeInt8(dev.beer, 1, BREWPI_BEERS))
+			dev.beer = 1;
+	}
 	else
 		dev.beer = 0;
 #endif
@@ -394,7 +371,7 @@ void DeviceManager::parseDeviceDefinition()
 	DeviceConfig original;
 	
 	// todo - should ideally check if the eeprom is correctly initialized.
-	eepromManager.fetchDevice(original, dev.id);
+	deviceRegistry.fetch(original, dev.id);
 	memcpy(&target, &original, sizeof(target));
 
 //	piLink.print("Dev Chamber: %d, Dev Beer: %d, Dev Function: %d, Dev Hardware: %d, Dev PinNr: %d\r\n", dev.chamber, dev.beer, dev.deviceFunction, dev.deviceHardware, dev.pinNr);
@@ -438,7 +415,7 @@ void DeviceManager::parseDeviceDefinition()
 		// also remove any existing device for the new function, since install overwrites any existing definition.
 		uninstallDevice(target);
 		installDevice(target);		
-		eepromManager.storeDevice(target, dev.id);		
+		deviceRegistry.store(target, dev.id);		
 	}	
 	else {
 		logError(ERROR_DEVICE_DEFINITION_UPDATE_SPEC_INVALID);
@@ -616,7 +593,7 @@ void DeviceManager::printDevice(device_slot_t slot, DeviceConfig& config, const
 	
 bool DeviceManager::allDevices(DeviceConfig& config, uint8_t deviceIndex)
 {	
-	return eepromManager.fetchDevice(config, deviceIndex);
+	return deviceRegistry.fetch(config, deviceIndex);
 }	
 
 void parseBytes(uint8_t* data, const char* s, uint8_t len) {
@@ -895,26 +872,29 @@ void UpdateDeviceState(DeviceDisplay& dd, DeviceConfig& dc, char* val)
 	if (dt==DEVICETYPE_NONE)
 		return;
 		
-	void** ppv = deviceTarget(dc);
-	if (ppv==NULL)
+	ChamberSwitch chamber(dc.chamber);
+	if (!chamber.switched())
+		return;
+	const DeviceHandle* h = deviceRegistry.handle(dc);
+	if (h==NULL)
 		return;
 
 	if (dd.write>=0 && dt==DEVICETYPE_SWITCH_ACTUATOR) {
 		// write value to a specific device. For now, only actuators are relevant targets
 		DEBUG_ONLY(logInfoInt(INFO_SETTING_ACTIVATOR_STATE, dd.write!=0));
-		((Actuator*)*ppv)->setActive(dd.write!=0);
+		(*h->actuator)->setActive(dd.write!=0);
 	}
 	else if (dd.value==1) {		// read values 
 		if (dt==DEVICETYPE_SWITCH_SENSOR) {
-			sprintf_P(val, STR_FMT_U, (unsigned int) ((SwitchSensor*)*ppv)->sense()!=0); // cheaper than itoa, because it overlaps with vsnprintf
+			sprintf_P(val, STR_FMT_U, (unsigned int) (*h->switchSensor)->sense()!=0); // cheaper than itoa, because it overlaps with vsnprintf
 		}
 		else if (dt==DEVICETYPE_TEMP_SENSOR) {
-			BasicTempSensor& s = unwrapSensor(dc.deviceFunction, *ppv);
+			BasicTempSensor& s = h->sensor();
 			temperature temp = s.read();
 			tempToString(val, temp, 3, 9);
 		}
 		else if (dt==DEVICETYPE_SWITCH_ACTUATOR) {
-			sprintf_P(val, STR_FMT_U, (unsigned int) ((Actuator*)*ppv)->isActive()!=0);			
+			sprintf_P(val, STR_FMT_U, (unsigned int) (*h->actuator)->isActive()!=0);			
 		}
 	}
 }
@@ -157,6 +157,7 @@ void HandleDeviceDisplay(const char* key, const char* value, void* pv);
 void UpdateDeviceState(DeviceDisplay& dd, DeviceConfig& dc, char* val);
 
 class OneWire;
+class OneWireAsync;
 
 class DeviceManager
 {
@@ -266,12 +267,16 @@ private:
 	static void beginDeviceOutput() { firstDeviceOutput = true; }
 
 	static OneWire* oneWireBus(uint8_t pin);
+	static OneWireAsync* oneWireAsync(uint8_t pin);
 
 #ifdef ARDUINO
 	
 // There is no reason to separate the OneWire busses - if we have a single bus, use it.
 #ifdef oneWirePin
 	static OneWire primaryOneWireBus;
+#if BREWPI_ONEWIRE_ASYNC
+	static OneWireAsync primaryOneWireAsync;
+#endif
 #else
 	static OneWire beerSensorBus;
 	static OneWire fridgeSensorBus;        
@@ -0,0 +1,120 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "DeviceRegistry.h"
+#include "TempControl.h"
+#include "EepromManager.h"
+#include "ChamberManager.h"
+
+DeviceRegistry deviceRegistry;
+
+DeviceConfig DeviceRegistry::configs[MAX_DEVICE_SLOT];
+bool DeviceRegistry::loaded = false;
+
+// indexed by DeviceFunction. For multichamber, the current chamber's devices are swapped in to tempControl.
+const DeviceHandle DeviceRegistry::handles[DEVICE_MAX] = {
+	{ NULL, NULL, NULL, NULL },								// DEVICE_NONE
+	{ NULL, NULL, NULL, &tempControl.door },				// DEVICE_CHAMBER_DOOR
+	{ NULL, NULL, &tempControl.heater, NULL },				// DEVICE_CHAMBER_HEAT
+	{ NULL, NULL, &tempControl.cooler, NULL },				// DEVICE_CHAMBER_COOL
+	{ NULL, NULL, &tempControl.light, NULL },				// DEVICE_CHAMBER_LIGHT
+	{ &tempControl.fridgeSensor, NULL, NULL, NULL },		// DEVICE_CHAMBER_TEMP
+	{ NULL, &tempControl.ambientSensor, NULL, NULL },		// DEVICE_CHAMBER_ROOM_TEMP
+	{ NULL, NULL, &tempControl.fan, NULL },					// DEVICE_CHAMBER_FAN
+	{ NULL, NULL, NULL, NULL },								// DEVICE_CHAMBER_RESERVED1
+	{ &tempControl.beerSensor, NULL, NULL, NULL },			// DEVICE_BEER_TEMP, of the first beer
+	{ NULL, NULL, NULL, NULL },								// DEVICE_BEER_TEMP2
+	{ NULL, NULL, NULL, NULL },								// DEVICE_BEER_HEAT, see beerHandle()
+	{ NULL, NULL, NULL, NULL },								// DEVICE_BEER_COOL, see beerHandle()
+	{ NULL, NULL, NULL, NULL },								// DEVICE_BEER_SG
+	{ NULL, NULL, NULL, NULL },								// DEVICE_BEER_RESERVED1
+	{ NULL, NULL, NULL, NULL },								// DEVICE_BEER_RESERVED2
+};
+
+void DeviceRegistry::load()
+{
+	eepromAccess.readDeviceDefinitions(configs, MAX_DEVICE_SLOT);
+	loaded = true;
+}
+
+void DeviceRegistry::reset()
+{
+	memset(configs, 0, sizeof(configs));
+	loaded = true;
+}
+
+void DeviceRegistry::unload()
+{
+	memset(configs, 0, sizeof(configs));
+	loaded = false;
+}
+
+bool DeviceRegistry::fetch(DeviceConfig& config, device_slot_t slot)
+{
+	bool ok = (loaded && slot>=0 && slot<MAX_DEVICE_SLOT);
+	if (ok)
+		memcpy(&config, &configs[slot], sizeof(DeviceConfig));
+	return ok;
+}
+
+bool DeviceRegistry::store(const DeviceConfig& config, device_slot_t slot)
+{
+	bool ok = (loaded && slot>=0 && slot<MAX_DEVICE_SLOT);
+	if (ok && memcmp(&config, &configs[slot], sizeof(DeviceConfig))) {
+		memcpy(&configs[slot], &config, sizeof(DeviceConfig));
+		eepromAccess.writeDeviceDefinition(slot, config, sizeof(DeviceConfig));
+	}
+	return ok;
+}
+
+/**
+ * The devices of the beers are in their BeerControl, other than the first beer's sensor, which is in the table.
+ */
+const DeviceHandle* DeviceRegistry::beerHandle(const DeviceConfig& config)
+{
+	static DeviceHandle h;
+	memset(&h, 0, sizeof(h));
+	BeerControl& beer = tempControl.beers[config.beer-1];
+	switch (config.deviceFunction) {
+		case DEVICE_BEER_TEMP:
+			h.tempSensor = &beer.sensor;
+			break;
+		case DEVICE_BEER_HEAT:
+			h.actuator = &beer.heater;
+			break;
+		case DEVICE_BEER_COOL:
+			h.actuator = &beer.cooler;
+			break;
+		default:
+			return NULL;
+	}
+	return &h;
+}
+
+const DeviceHandle* DeviceRegistry::handle(const DeviceConfig& config)
+{
+	// for multichamber, the chamber manager swaps the device's chamber in before it is installed.
+	if ((config.chamber && config.chamber-1!=chamberManager.current()) || config.beer>BREWPI_BEERS || config.deviceFunction>=DEVICE_MAX)
+		return NULL;
+	if (config.beer && deviceOwner(config.deviceFunction)==DEVICE_OWNER_BEER
+		&& (config.beer>1 || config.deviceFunction!=DEVICE_BEER_TEMP))
+		return beerHandle(config);
+
+	const DeviceHandle* h = &handles[config.deviceFunction];
+	return (h->tempSensor || h->basicTempSensor || h->actuator || h->switchSensor) ? h : NULL;
+}
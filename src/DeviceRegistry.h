@@ -0,0 +1,95 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "DeviceManager.h"
+#include "TempSensor.h"
+#include "Actuator.h"
+#include "Sensor.h"
+
+/**
+ * Where an installed device lives in the controller. At most one of the pointers is set, matching the
+ * DeviceType of the function. Temp sensors are either wrapped in a TempSensor (beer, fridge) or
+ * stand alone as a BasicTempSensor (room).
+ */
+struct DeviceHandle {
+	TempSensor** tempSensor;
+	BasicTempSensor** basicTempSensor;
+	Actuator** actuator;
+	SwitchSensor** switchSensor;
+
+	BasicTempSensor& sensor() const {
+		return basicTempSensor ? **basicTempSensor : (*tempSensor)->sensor();
+	}
+
+	void setSensor(BasicTempSensor* sensor) const {
+		if (basicTempSensor)
+			*basicTempSensor = sensor;
+		else
+			(*tempSensor)->setSensor(sensor);
+	}
+};
+
+/**
+ * Keeps the device definitions in RAM, so that listing devices and looking them up costs no flash access.
+ * The definitions are read once when the settings are applied and written back only when a slot changes.
+ *
+ * Also maps each (chamber, beer, function) to a typed handle on the controller field the device is installed
+ * into, replacing the old switch over the function and the untyped void** targets.
+ */
+class DeviceRegistry
+{
+public:
+	/**
+	 * Reads all device definitions from the persistent store.
+	 */
+	static void load();
+
+	/**
+	 * Marks the store as initialized with no devices defined.
+	 */
+	static void reset();
+
+	/**
+	 * Forgets all definitions. Fetching fails until load() or reset() is called.
+	 */
+	static void unload();
+
+	static bool fetch(DeviceConfig& config, device_slot_t slot);
+
+	/**
+	 * Updates a slot, writing it to the persistent store only if it differs from the cached definition.
+	 */
+	static bool store(const DeviceConfig& config, device_slot_t slot);
+
+	/**
+	 * Returns the handle for the device described by config, or NULL if the function cannot be installed
+	 * in that chamber/beer.
+	 */
+	static const DeviceHandle* handle(const DeviceConfig& config);
+
+private:
+	static const DeviceHandle* beerHandle(const DeviceConfig& config);
+
+	static DeviceConfig configs[MAX_DEVICE_SLOT];
+	static bool loaded;
+	static const DeviceHandle handles[DEVICE_MAX];
+};
+
+extern DeviceRegistry deviceRegistry;
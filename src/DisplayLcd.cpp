@@ -36,7 +36,7 @@
 
 uint8_t LcdDisplay::stateOnDisplay;
 uint8_t LcdDisplay::flags;
-#if defined(BREWPI_IIC)
+#if defined(BREWPI_IIC) && defined(ARDUINO)
 LcdDriver LcdDisplay::lcd(0x27, 20, 4);  // NOTE - The address here doesn't get used. Address is autodetected at startup.
 #else
 LcdDriver LcdDisplay::lcd;
@@ -198,6 +198,13 @@ void LcdDisplay::printMode(void){
 		case MODE_TEST:
 			lcd.print_P(PSTR("** Testing **"));
 			break;
+		case MODE_MODEL_PREDICTIVE:
+			lcd.print_P(STR_Beer_);
+			lcd.print_P(PSTR("Model"));
+			break;
+		case MODE_AUTOTUNE:
+			lcd.print_P(PSTR("Autotuning"));
+			break;
 		default:
 			lcd.print_P(PSTR("Invalid mode"));
 			break;
@@ -207,7 +214,7 @@ void LcdDisplay::printMode(void){
 
 // print the current state on the last line of the lcd
 void LcdDisplay::printState(void){
-	uint16_t time = UINT16_MAX; // init to max
+	ticks_seconds_t time = UINT32_MAX; // init to max
 	uint8_t state = tempControl.getDisplayState();
 	if(state != stateOnDisplay){ //only print static text when state has changed
 		stateOnDisplay = state;
@@ -260,7 +267,7 @@ void LcdDisplay::printState(void){
 		lcd.print_P(part2);		
 		lcd.printSpacesToRestOfLine();
 	}
-	uint16_t sinceIdleTime = tempControl.timeSinceIdle();
+	ticks_seconds_t sinceIdleTime = tempControl.timeSinceIdle();
 	if(state==IDLE){
 		time = 	min(tempControl.timeSinceCooling(), tempControl.timeSinceHeating());
 	}
@@ -277,12 +284,12 @@ void LcdDisplay::printState(void){
 	else if(state == WAITING_TO_COOL || state == WAITING_TO_HEAT){
 		time = tempControl.getWaitTime();
 	}
-	if(time != UINT_MAX){
-		char timeString[10];
+	if(time != UINT32_MAX){
+		char timeString[14];
 #if DISPLAY_TIME_HMS  // 96 bytes more space required. 
-		unsigned int minutes = time/60;		
-		unsigned int hours = minutes/60;
-		int stringLength = sprintf_P(timeString, PSTR("%dh%02dm%02d"), hours, minutes%60, time%60);
+		unsigned long minutes = time/60;		
+		unsigned long hours = minutes/60;
+		int stringLength = sprintf_P(timeString, PSTR("%luh%02lum%02lu"), hours, minutes%60, (unsigned long)(time%60));
 		char * printString = timeString;
 		if(!hours){
 			printString = &timeString[2];
@@ -301,7 +308,9 @@ void LcdDisplay::printState(void){
 
 void LcdDisplay::printWiFiStartup(void){
 	String ap_station_name;
+#ifdef ESP8266
 	toggleBacklight = false;  // Assuming we need this
+#endif
 
 	lcd.setCursor(0,0);
 	// Factoring prints out of switch has negative effect on code size in this function
@@ -327,7 +336,9 @@ void LcdDisplay::printWiFiStartup(void){
 }
 
 void LcdDisplay::printWiFi(void){
+#ifdef ESP8266
 	toggleBacklight = false;  // Assuming we need this
+#endif
 
 	lcd.setCursor(0,0);
 	// Factoring prints out of switch has negative effect on code size in this function
@@ -352,7 +363,9 @@ void LcdDisplay::printWiFi(void){
 #endif
 
 void LcdDisplay::printEEPROMStartup(void){
+#ifdef ESP8266
 	toggleBacklight = false;  // Assuming we need this
+#endif
 
 	lcd.setCursor(0,0);
 	// Factoring prints out of switch has negative effect on code size in this function
@@ -16,61 +16,20 @@
 */
 
 
-#ifndef ESP8266
+#if defined(ARDUINO) && !defined(ESP8266)
 // Generate an error if we have been incorrectly included in an Arduino build
 #error Incorrect processor type!
 #endif
 
-#include <FS.h>
 #include "EepromStructs.h"
 #include "EepromFormat.h"
-
-
-
-#define SPIFFS_controlConstants_fname "/controlConstants"
-#define SPIFFS_controlSettings_fname "/controlSettings"
-#define SPIFFS_device_fname_prepend "/dev"
+#include "SettingsLog.h"
 
 #define MAX_SPIFFS_DEVICES EepromFormat::MAX_DEVICES
 
-//TODO - Clean this up
+// Each struct is stored as a record in the settings log, see SettingsLog.h
 class ESPEepromAccess
 {
-private:
-	template <class T> static bool writeBlockToFile(String target_name, T& data) {
-		File out_file = SPIFFS.open(target_name, "w");
-		if (out_file) {
-			out_file.write((const uint8_t*)&data, sizeof(data));
-			out_file.close();
-			return true;
-		} else {
-			// TODO - log this
-			return false;
-		}
-	}
-
-	template <class T> static bool readBlockFromFile(String target_name, T& data) {
-		// This creates some issues, as there is an assumption in most places readBlockFromFile is used that it will
-		// always overwrite &data. Need to go back & re-read where it gets used to make sure we are still OK
-		if(!doesFileExist(target_name))
-			return false;
-
-		File in_file = SPIFFS.open(target_name, "r");
-		if (in_file) {
-			uint8_t holding[sizeof(data)];
-			in_file.read(holding, sizeof(data));
-			memcpy(&data, holding, sizeof(data));
-			in_file.close();
-			return true;
-		}
-        return false;
-	}
-
-    static bool doesFileExist(String target_name) {
-		return SPIFFS.exists(target_name);
-    }
-
-
 public:
 	// Since we're basically switching to using SPIFFS for everything, I don't want these to compile
 /*	static uint8_t readByte(eptr_t offset) {
@@ -85,58 +44,87 @@ public:
         while (size-->0) *p++ = 0;
     }
 
-	static void readControlSettings(ControlSettings& target, eptr_t offset, uint16_t size) {
-		/* Unlike readDeviceDefinition, controlSettings & controlConstants are both properly initialized elsewhere.
-		 * Regardless, due to the tweak we made to readBlockFromFile, I'm going to explicitly add a call here to clear
-		 * the memory just in case. */
+	/**
+	 * The settings are no longer stored at an EEPROM offset, but the offset within EepromFormat still tells
+	 * which chamber and beer they belong to, which gives the record id.
+	 */
+	static uint8_t recordIdOf(eptr_t offset);	// defined in EepromManager.cpp, since EepromFormat.h includes this file
 
-		if(!readBlockFromFile(SPIFFS_controlSettings_fname, target))
+	static void readControlSettings(ControlSettings& target, eptr_t offset, uint16_t size) {
+		if(!settingsLog.read(SETTINGS_RECORD_CONTROL_SETTINGS, recordIdOf(offset), &target, sizeof(target)))
 			clear((uint8_t*)&target, sizeof(target));  // This mimics the behavior where previously the EEPROM would have been 0ed out.
 	}
 
 	static void readControlConstants(ControlConstants& target, eptr_t offset, uint16_t size) {
-        if(!readBlockFromFile(SPIFFS_controlConstants_fname, target))
-            clear((uint8_t*)&target, sizeof(target));
+		if(!settingsLog.read(SETTINGS_RECORD_CONTROL_CONSTANTS, recordIdOf(offset), &target, sizeof(target)))
+			clear((uint8_t*)&target, sizeof(target));
 	}
 
-
 	static void readDeviceDefinition(DeviceConfig& target, int8_t deviceID, uint16_t size) {
-        char buf[20];
-        sprintf(buf, "%s%d", SPIFFS_device_fname_prepend, deviceID);
-        if(!readBlockFromFile(buf, target)) // deviceID was previously an offset in memory - now it's a sequential #
-			clear((uint8_t*)&target, sizeof(target));  // This mimics the behavior where previously the EEPROM would have been 0ed out.
+		if(!settingsLog.read(SETTINGS_RECORD_DEVICE, deviceID, &target, sizeof(target)))
+			clear((uint8_t*)&target, sizeof(target));
+	}
+
+	/**
+	 * Reads the definitions of slots 0..count-1 in one pass over the settings log.
+	 */
+	static void readDeviceDefinitions(DeviceConfig* targets, uint8_t count) {
+		settingsLog.readAll(SETTINGS_RECORD_DEVICE, count, targets, sizeof(DeviceConfig));
 	}
 
 	static void writeControlSettings(eptr_t target, ControlSettings& source, uint16_t size) {
-		writeBlockToFile(SPIFFS_controlSettings_fname, source);
+		settingsLog.write(SETTINGS_RECORD_CONTROL_SETTINGS, recordIdOf(target), &source, sizeof(source), CONTROL_SETTINGS_VERSION);
 	}
 
 	static void writeControlConstants(eptr_t target, ControlConstants& source, uint16_t size) {
-        writeBlockToFile(SPIFFS_controlConstants_fname, source);
+		settingsLog.write(SETTINGS_RECORD_CONTROL_CONSTANTS, recordIdOf(target), &source, sizeof(source), CONTROL_CONSTANTS_VERSION);
 	}
 
 	static void writeDeviceDefinition(int8_t deviceID, const DeviceConfig& source, uint16_t size) {
-        char buf[20];
-        sprintf(buf, "%s%d", SPIFFS_device_fname_prepend, deviceID);
-        writeBlockToFile(buf, source);  // deviceID was previously an offset in memory - now it's a sequential #
-//		logWarningIntString(0, sizeof(source), "writeDeviceDefinition called");
+		settingsLog.write(SETTINGS_RECORD_DEVICE, deviceID, &source, sizeof(source), DEVICE_CONFIG_VERSION);
 	}
 
-    static bool hasSettings() {
-        return doesFileExist(SPIFFS_controlSettings_fname);
-    }
+	static void readBeerProfile(BeerProfileRecord& target, uint8_t chamber) {
+		if(!settingsLog.read(SETTINGS_RECORD_BEER_PROFILE, chamber, &target, sizeof(target)))
+			clear((uint8_t*)&target, sizeof(target));
+	}
+
+	static void readProfileProgress(ProfileProgress& target, uint8_t chamber) {
+		if(!settingsLog.read(SETTINGS_RECORD_PROFILE_PROGRESS, chamber, &target, sizeof(target)))
+			clear((uint8_t*)&target, sizeof(target));
+	}
 
-    static void zapData() {
-        // This gets a bit tricky -- we can't just do SPIFFS.format because that would wipe out the mDNS name
-        int i;
+	static void writeBeerProfile(uint8_t chamber, const BeerProfileRecord& source) {
+		settingsLog.write(SETTINGS_RECORD_BEER_PROFILE, chamber, &source, sizeof(source), BEER_PROFILE_VERSION);
+	}
 
-        if(doesFileExist(SPIFFS_controlConstants_fname)) SPIFFS.remove(SPIFFS_controlConstants_fname);
-        if(doesFileExist(SPIFFS_controlSettings_fname)) SPIFFS.remove(SPIFFS_controlSettings_fname);
+	static void writeProfileProgress(uint8_t chamber, const ProfileProgress& source) {
+		settingsLog.write(SETTINGS_RECORD_PROFILE_PROGRESS, chamber, &source, sizeof(source), PROFILE_PROGRESS_VERSION);
+	}
 
-        char buf[20];
-        for(i=0;i<MAX_SPIFFS_DEVICES;i++) {
-            sprintf(buf, "%s%d", SPIFFS_device_fname_prepend, i);
-            if(doesFileExist(buf)) SPIFFS.remove(buf);
-        }
-    }
+	static void readActuatorStats(ChamberActuatorStats& target, uint8_t chamber) {
+		if(!settingsLog.read(SETTINGS_RECORD_ACTUATOR_STATS, chamber, &target, sizeof(target)))
+			clear((uint8_t*)&target, sizeof(target));
+	}
+
+	static void writeActuatorStats(uint8_t chamber, const ChamberActuatorStats& source) {
+		settingsLog.write(SETTINGS_RECORD_ACTUATOR_STATS, chamber, &source, sizeof(source), ACTUATOR_STATS_VERSION);
+	}
+
+	static bool hasSettings(uint8_t chamber=0) {
+		return settingsLog.contains(SETTINGS_RECORD_CONTROL_SETTINGS, chamber);
+	}
+
+	static bool hasConstants(uint8_t chamber) {
+		return settingsLog.contains(SETTINGS_RECORD_CONTROL_CONSTANTS, chamber);
+	}
+
+	static bool hasSettingsAt(eptr_t offset) {
+		return settingsLog.contains(SETTINGS_RECORD_CONTROL_SETTINGS, recordIdOf(offset));
+	}
+
+	static void zapData() {
+		// The mDNS name is kept in its own file, so it survives this.
+		settingsLog.erase();
+	}
 };
@@ -36,9 +36,9 @@ typedef ArduinoEepromAccess EepromAccess;
 
 #else
 
-#include "ArrayEepromAccess.h"
-
-typedef ArrayEepromAccess EepromAccess;
+// Off-device, settings go through the same log as on the ESP8266, on top of the simulated flash in HostFS.
+#include "ESPEepromAccess.h"
+typedef ESPEepromAccess EepromAccess;
 
 #endif
 
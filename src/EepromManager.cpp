@@ -25,10 +25,34 @@
 #include "TempControl.h"
 #include "EepromFormat.h"
 #include "PiLink.h"
+#include "DeviceRegistry.h"
+#include "ChamberManager.h"
+#include "BeerProfile.h"
+#include "ActuatorMeter.h"
+#include "Ticks.h"
 
 EepromManager eepromManager;
 EepromAccess eepromAccess;
 
+static_assert(BREWPI_BEERS>=1 && BREWPI_BEERS<=ChamberBlock::MAX_BEERS, "BREWPI_BEERS out of range");
+
+#if defined(ESP8266) || !defined(ARDUINO)
+uint8_t ESPEepromAccess::recordIdOf(eptr_t offset)
+{
+	eptr_t chambers = offsetof(EepromFormat, chambers);
+	if (offset<chambers)
+		return 0;
+	offset -= chambers;
+	uint8_t chamber = offset/sizeof(ChamberBlock);
+	offset -= chamber*sizeof(ChamberBlock);
+	uint8_t beer = offset<offsetof(ChamberBlock, beer) ? 0 : (offset-offsetof(ChamberBlock, beer))/sizeof(BeerBlock);
+	return chamber + beer*SETTINGS_LOG_CHAMBERS;
+}
+#endif
+
+uint8_t EepromManager::dirty = 0;
+uint32_t EepromManager::dirtySince;
+
 #define pointerOffset(x) offsetof(EepromFormat, x)
 
 EepromManager::EepromManager()
@@ -37,18 +61,22 @@ EepromManager::EepromManager()
 }
 
 
-bool EepromManager::hasSettings()
+bool EepromManager::hasSettings(uint8_t chamber)
 {
 	// TODO - Technically, this acts as a version check as well.
 	// We're eliminating that by just returning if the settings exist
 //	uint8_t version = eepromAccess.readByte(pointerOffset(version));
 //	return (version==EEPROM_FORMAT_VERSION);
-	return eepromAccess.hasSettings();
+	return eepromAccess.hasSettings(chamber);
 }
 
 void EepromManager::zapEeprom()
 {
 	eepromAccess.zapData();
+	deviceRegistry.unload();
+	dirty = 0;		// pending writes would otherwise recreate the settings
+	beerProfile.load();
+	actuatorMeter.load();
 }
 
 
@@ -82,6 +110,7 @@ void EepromManager::initializeEeprom()
 
 	// set the version flag - so that storeDevice will work
 //	eepromAccess.writeByte(0, EEPROM_FORMAT_VERSION);  // We don't save the EEPROM version anywhere now
+	deviceRegistry.reset();
 		
 	saveDefaultDevices();  // noop
 	// set state to startup
@@ -108,14 +137,13 @@ bool EepromManager::applySettings()
 		
 	logDebug("Applying settings");
 
-	// load the one chamber and one beer for now
-	eptr_t pv = pointerOffset(chambers);
-	tempControl.loadConstants(pv+offsetof(ChamberBlock, chamberSettings.cc));	
-	tempControl.loadSettings(pv+offsetof(ChamberBlock, beer[0].cs));
+	// load the first chamber, and one beer for now. Other chambers load their settings as their devices
+	// are installed below.
+	loadChamberSettings(0);
 	
 	logDebug("Applied settings");
 	
-	
+	deviceRegistry.load();
 	DeviceConfig deviceConfig;
 	for (uint8_t index = 0; fetchDevice(deviceConfig, index); index++)
 	{	
@@ -129,41 +157,91 @@ bool EepromManager::applySettings()
 	return true;
 }
 
+eptr_t EepromManager::beerSettingsOffset(uint8_t chamber, uint8_t beer)
+{
+	return pointerOffset(chambers) + sizeof(ChamberBlock)*chamber + offsetof(ChamberBlock, beer)
+		+ sizeof(BeerBlock)*beer + offsetof(BeerBlock, cs);
+}
+
+bool EepromManager::loadChamberSettings(uint8_t chamber)
+{
+	// the other beers keep the INVALID_TEMP setting from TempControl::init until they are given one
+	for (uint8_t beer=1; beer<BREWPI_BEERS; beer++) {
+		eptr_t offset = beerSettingsOffset(chamber, beer);
+		if (eepromAccess.hasSettingsAt(offset))
+			eepromAccess.readControlSettings(tempControl.beers[beer].cs, offset, sizeof(ControlSettings));
+	}
+	if (!hasSettings(chamber)) {
+		tempControl.loadDefaultConstants();
+		tempControl.loadDefaultSettings();
+		return false;
+	}
+	eptr_t pv = pointerOffset(chambers) + sizeof(ChamberBlock)*chamber;
+	// the constants are only stored once they are changed, so settings can be stored without them
+	if (eepromAccess.hasConstants(chamber))
+		tempControl.loadConstants(pv+offsetof(ChamberBlock, chamberSettings.cc));
+	else
+		tempControl.loadDefaultConstants();
+	tempControl.loadSettings(pv+offsetof(ChamberBlock, beer[0].cs));
+	return true;
+}
+
+void EepromManager::storeBeerSettings(uint8_t beer)
+{
+	eptr_t offset = beerSettingsOffset(chamberManager.current(), beer);
+	eepromAccess.writeControlSettings(offset, tempControl.beers[beer].cs, sizeof(ControlSettings));
+}
+
 void EepromManager::storeTempConstantsAndSettings()
 {
-	uint8_t chamber = 0;
-	eptr_t pv = pointerOffset(chambers);
-	pv += sizeof(ChamberBlock)*chamber;
-	tempControl.storeConstants(pv+offsetof(ChamberBlock, chamberSettings.cc));
-		
-	storeTempSettings();
+	markDirty(DIRTY_CONSTANTS | DIRTY_SETTINGS);
 }
 
 void EepromManager::storeTempSettings()
 {
-	uint8_t chamber = 0;
-	eptr_t pv = pointerOffset(chambers);
-	pv += sizeof(ChamberBlock)*chamber;
-	// for now assume just one beer. 
-	tempControl.storeSettings(pv+offsetof(ChamberBlock, beer[0].cs));	
+	markDirty(DIRTY_SETTINGS);
+}
+
+void EepromManager::markDirty(uint8_t blocks)
+{
+	// the deadline runs from the first change, so a steady stream of changes can't postpone the write forever
+	if (!dirty)
+		dirtySince = ticks.millis();
+	dirty |= blocks << (DIRTY_BITS*chamberManager.current());
+}
+
+void EepromManager::flushIfDue()
+{
+	if (dirty && ticks.millis() - dirtySince >= SETTINGS_WRITE_DELAY)
+		flushSettings();
+}
+
+void EepromManager::flushSettings()
+{
+	for (uint8_t chamber = 0; dirty; chamber++) {
+		uint8_t blocks = (dirty >> (DIRTY_BITS*chamber)) & (DIRTY_SETTINGS | DIRTY_CONSTANTS);
+		if (!blocks)
+			continue;
+		dirty &= ~(blocks << (DIRTY_BITS*chamber));
+		ChamberSwitch swap(chamber+1);
+		eptr_t pv = pointerOffset(chambers);
+		pv += sizeof(ChamberBlock)*chamber;
+		if (blocks & DIRTY_CONSTANTS)
+			tempControl.storeConstants(pv+offsetof(ChamberBlock, chamberSettings.cc));
+		// for now assume just one beer. 
+		if (blocks & DIRTY_SETTINGS)
+			tempControl.storeSettings(pv+offsetof(ChamberBlock, beer[0].cs));
+	}
 }
 
 bool EepromManager::fetchDevice(DeviceConfig& config, int8_t deviceIndex)
 {
-	bool ok = (hasSettings() && deviceIndex<EepromFormat::MAX_DEVICES);
-	if (ok)
-		eepromAccess.readDeviceDefinition(config, deviceIndex, sizeof(DeviceConfig));
-//        eepromAccess.readDeviceDefinition(config, pointerOffset(devices)+sizeof(DeviceConfig)*deviceIndex, sizeof(DeviceConfig));
-	return ok;
+	return deviceRegistry.fetch(config, deviceIndex);
 }	
 
 bool EepromManager::storeDevice(const DeviceConfig& config, int8_t deviceIndex)
 {
-	bool ok = (hasSettings() && deviceIndex<EepromFormat::MAX_DEVICES);
-	if (ok)
-        eepromAccess.writeDeviceDefinition(deviceIndex, config, sizeof(DeviceConfig));
-//        eepromAccess.writeDeviceDefinition(pointerOffset(devices)+sizeof(DeviceConfig)*deviceIndex, config, sizeof(DeviceConfig));
-	return ok;
+	return deviceRegistry.store(config, deviceIndex);
 }
 
 
@@ -173,16 +251,15 @@ bool EepromManager::storeDevice(const DeviceConfig& config, int8_t deviceIndex)
 String EepromManager::fetchmDNSName()
 {
 	String mdns_id;
-	// The below loads the mDNS name from the file we saved it to (if the file exists)
-	if (SPIFFS.exists("/mdns.txt")) {
-		// The file exists - load it up
-		File dns_name_file = SPIFFS.open("/mdns.txt", "r");  //TODO - Break "mdns.txt" into something configurable
-		if (dns_name_file) {
-			// Assuming everything goes well, read in the mdns name
-			mdns_id = dns_name_file.readStringUntil('\n');
-			mdns_id.trim();
-			return mdns_id;
-		}
+	// The below loads the mDNS name from the file we saved it to. Opening fails if the file doesn't exist,
+	// so there is no need to check for it first.
+	File dns_name_file = SPIFFS.open("/mdns.txt", "r");  //TODO - Break "mdns.txt" into something configurable
+	if (dns_name_file) {
+		// Assuming everything goes well, read in the mdns name
+		mdns_id = dns_name_file.readStringUntil('\n');
+		dns_name_file.close();
+		mdns_id.trim();
+		return mdns_id;
 	}
 	// Moving the trigger for the default name here.
 	mdns_id = "ESP" + String(ESP.getChipId());
@@ -50,9 +50,9 @@ public:
 	static void initializeEeprom();
 	
 	/**
-	 * Determines if this eeprom has settings.
+	 * Determines if this eeprom has settings for the given chamber, counted from 0.
 	 */
-	static bool hasSettings();
+	static bool hasSettings(uint8_t chamber=0);
 
 	/**
 	 * Applies the settings from the eeprom
@@ -61,16 +61,41 @@ public:
 		
 	static void dumpEeprom(Print& stream, uint16_t offset);
 
+	/**
+	 * Loads the constants and beer settings of a chamber into TempControl, where the chamber must be swapped in.
+	 * If there are none stored, the defaults are loaded and false is returned.
+	 */
+	static bool loadChamberSettings(uint8_t chamber);
+
+	/**
+	 * Saves the setting of a beer after the first in the current chamber, counted from 0. Written right away,
+	 * since it only changes on request.
+	 */
+	static void storeBeerSettings(uint8_t beer);
+
 	/**
 	 * Save the chamber constants and beer settings to eeprom for the currently active chamber.
+	 * Like storeTempSettings(), the write is deferred.
 	 */
 	static void storeTempConstantsAndSettings();
 
 	/**
-	 * Save just the beer temp settings.
+	 * Save just the beer temp settings. The settings are only marked as changed here and written by flushIfDue(),
+	 * so that repeated changes are coalesced and the flash write stays out of the control update.
 	 */
 	static void storeTempSettings();
 
+	/**
+	 * Writes changed settings once they have been pending for SETTINGS_WRITE_DELAY milliseconds.
+	 * Called from the main loop when no control update is running.
+	 */
+	static void flushIfDue();
+
+	/**
+	 * Writes all changed settings now. Use before a reset, and for changes that must survive a power loss.
+	 */
+	static void flushSettings();
+
 	static bool fetchDevice(DeviceConfig& config, int8_t deviceIndex);
 	static bool storeDevice(const DeviceConfig& config, int8_t deviceIndex);
 	
@@ -81,6 +106,17 @@ public:
 	static void savemDNSName(String mdns_id);
 #endif
 
+private:
+	enum {
+		DIRTY_SETTINGS = 1,
+		DIRTY_CONSTANTS = 2,
+		DIRTY_BITS = 2			// flags per chamber
+	};
+	static void markDirty(uint8_t blocks);
+	static eptr_t beerSettingsOffset(uint8_t chamber, uint8_t beer);
+	static uint8_t dirty;				// DIRTY_ flags for blocks changed in RAM but not yet written, for each chamber
+	static uint32_t dirtySince;			// millis when the oldest pending change was made
+
 };
 
 class EepromStream 
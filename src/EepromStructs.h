@@ -1,11 +1,25 @@
 #pragma once
 
+#include "TemperatureFormats.h"
 #ifdef ARDUINO
 #include "DallasTemperature.h"	// for DeviceAddress
+#else
+typedef uint8_t DeviceAddress[8];
 #endif
 
 
 // These structs were moved from TempControl.h
+
+/*
+ * Layout version of each persisted struct. When changing one of the structs, bump its version and register a function
+ * in SettingsSchema.cpp that upgrades records from the previous version, so saved settings survive the firmware update.
+ */
+const uint8_t CONTROL_SETTINGS_VERSION = 0;
+const uint8_t CONTROL_CONSTANTS_VERSION = 0;
+const uint8_t DEVICE_CONFIG_VERSION = 0;
+const uint8_t BEER_PROFILE_VERSION = 0;
+const uint8_t PROFILE_PROGRESS_VERSION = 0;
+const uint8_t ACTUATOR_STATS_VERSION = 0;
 struct ControlSettings {
 	temperature beerSetting;
 	temperature fridgeSetting;
@@ -116,3 +130,43 @@ struct DeviceConfig {
 	} hw;
 	bool reserved2;
 };
+
+
+/*
+ * One point of a beer temperature profile. The setting moves in a straight line from one point to the next.
+ */
+struct ProfilePoint {
+	uint16_t minutes;		// since the start of the profile
+	temperature temp;		// the beer setting at that time
+};
+
+struct BeerProfileRecord {
+	static const uint8_t MAX_POINTS = 15;
+	uint8_t count;
+	uint8_t reserved;
+	ProfilePoint points[MAX_POINTS];	// in increasing order of time
+};
+
+/*
+ * How far a chamber is through its profile. Saved separately from the profile, since it changes as the profile runs.
+ */
+struct ProfileProgress {
+	uint32_t elapsed;		// seconds the profile has run for
+};
+
+/*
+ * Wear counters of one output, since they were last reset.
+ */
+struct ActuatorStats {
+	static const uint8_t RUN_BINS = 6;
+	uint32_t starts;
+	uint32_t onSeconds;
+	uint32_t offSeconds;
+	uint32_t minOffTime;		// shortest rest between two runs in seconds, 0 until one is seen
+	uint16_t runs[RUN_BINS];	// runs by length: under 3 and 10 minutes, under 1/2, 1 and 3 hours, and longer
+};
+
+struct ChamberActuatorStats {
+	ActuatorStats cooler;
+	ActuatorStats heater;		// or the light, when it is used as the heater
+};
@@ -0,0 +1,155 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "Forecast.h"
+#include "TempControl.h"
+
+extern ValueActuator defaultActuator;
+
+Forecast forecast;
+
+// whole model steps in the given number of seconds, rounded up for the minimum times
+static uint16_t stepsOf(ticks_seconds_t seconds, bool roundUp=false)
+{
+	ticks_seconds_t steps = (seconds + (roundUp ? MODEL_STEP-1 : 0))/MODEL_STEP;
+	return steps<UINT16_MAX ? uint16_t(steps) : UINT16_MAX;
+}
+
+static uint16_t incrementSaturated(uint16_t value)
+{
+	return value<UINT16_MAX ? value+1 : value;
+}
+
+bool Forecast::capture(ForecastStart& start)
+{
+	start.mode = tempControl.getMode();
+	if (start.mode==MODE_OFF || start.mode==MODE_TEST || !tempControl.beerSensor->isConnected()
+		|| !tempControl.fridgeSensor->isConnected())
+		return false;
+	start.beerSetting = tempControl.cs.beerSetting;
+	start.fridgeSetting = tempControl.cs.fridgeSetting;
+	if (start.mode==MODE_FRIDGE_CONSTANT ? start.fridgeSetting==INVALID_TEMP : start.beerSetting==INVALID_TEMP)
+		return false;
+
+	start.beerTemp = tempControl.beerSensor->readFastFiltered();
+	start.fridgeTemp = tempControl.fridgeSensor->readFastFiltered();
+	start.roomTemp = tempControl.ambientSensor->read();
+	start.diffIntegral = tempControl.cv.diffIntegral;
+	start.output = tempControl.stateIsHeating() ? MODEL_ACTION_HEAT
+		: (tempControl.stateIsCooling() ? MODEL_ACTION_COOL : MODEL_ACTION_IDLE);
+	start.sinceIdle = stepsOf(tempControl.timeSinceIdle());
+	start.sinceHeating = stepsOf(tempControl.timeSinceHeating());
+	start.sinceCooling = stepsOf(tempControl.timeSinceCooling());
+	start.canHeat = tempControl.heater!=&defaultActuator
+		|| (tempControl.cc.lightAsHeater && tempControl.light!=&defaultActuator);
+	start.canCool = tempControl.cooler!=&defaultActuator;
+	return true;
+}
+
+void Forecast::run(const ForecastStart& start, const ThermalModel& model, const ControlConstants& cc, uint16_t steps,
+	ForecastResult& result)
+{
+	bool pid = start.mode!=MODE_FRIDGE_CONSTANT;
+	temperature beerSetting = start.beerSetting;
+	const uint16_t minCoolOn = stepsOf(MIN_COOL_ON_TIME, true);
+	const uint16_t minHeatOn = stepsOf(MIN_HEAT_ON_TIME, true);
+	const uint16_t minCoolOff = stepsOf(pid ? MIN_COOL_OFF_TIME : MIN_COOL_OFF_TIME_FRIDGE_CONSTANT, true);
+	const uint16_t minHeatOff = stepsOf(MIN_HEAT_OFF_TIME, true);
+	const uint16_t minSwitch = stepsOf(MIN_SWITCH_TIME, true);
+	// the same bounds as the live PID
+	temperature lowerBound = (beerSetting <= cc.tempSettingMin + cc.pidMax) ? cc.tempSettingMin : beerSetting - cc.pidMax;
+	temperature upperBound = (beerSetting >= cc.tempSettingMax - cc.pidMax) ? cc.tempSettingMax : beerSetting + cc.pidMax;
+
+	ModelState state;
+	state.set(start.beerTemp, start.fridgeTemp);
+	temperature fridgeSetting = start.fridgeSetting;
+	long_temperature integral = start.diffIntegral;
+	uint8_t output = start.output;
+	uint16_t sinceIdle = start.sinceIdle;
+	uint16_t sinceHeating = start.sinceHeating;
+	uint16_t sinceCooling = start.sinceCooling;
+	// the beer reaches its setting when it gets to the other side of it, or is on it
+	bool startsAbove = start.beerTemp>beerSetting;
+
+	memset(&result, 0, sizeof(result));
+	result.steps = steps;
+	result.interval = steps>=ForecastResult::POINTS ? steps/ForecastResult::POINTS : 1;
+	result.reached = (pid && start.beerTemp==beerSetting) ? 0 : UINT16_MAX;
+
+	for (uint16_t i=0; i<steps; i++) {
+		temperature beer = state.beerTemp();
+		temperature fridge = state.fridgeTemp();
+		if (pid) {
+			temperature diff = beerSetting - beer;
+			// the live integral is summed once a minute, in idle
+			if (output==MODEL_ACTION_IDLE) {
+				if (abs(diff) < cc.iMaxError)
+					integral += long_temperature(diff)*MODEL_STEP/60;
+				else
+					integral -= integral>>3;
+			}
+			long_temperature setting = beerSetting;
+			setting += multiplyFactorTemperatureDiff(cc.Kp, diff);
+			setting += multiplyFactorTemperatureDiffLong(cc.Ki, integral);
+			fridgeSetting = constrain(constrainTemp16(setting), lowerBound, upperBound);
+		}
+
+		if (output==MODEL_ACTION_COOL) {
+			if (sinceIdle>=minCoolOn && fridge<=fridgeSetting)
+				output = MODEL_ACTION_IDLE;
+		}
+		else if (output==MODEL_ACTION_HEAT) {
+			if (sinceIdle>=minHeatOn && fridge>=fridgeSetting)
+				output = MODEL_ACTION_IDLE;
+		}
+		else if (fridge > fridgeSetting+cc.idleRangeHigh) {
+			// as live, the beer modes don't cool a beer that is already under its setting
+			if (start.canCool && sinceHeating>=minSwitch && sinceCooling>=minCoolOff && !(pid && beer < beerSetting+16))
+				output = MODEL_ACTION_COOL;
+		}
+		else if (fridge < fridgeSetting+cc.idleRangeLow) {
+			if (start.canHeat && sinceCooling>=minSwitch && sinceHeating>=minHeatOff && !(pid && beer > beerSetting-16))
+				output = MODEL_ACTION_HEAT;
+		}
+
+		model.step(state, start.roomTemp, output==MODEL_ACTION_HEAT ? TEMP_FIXED_POINT_SCALE : 0,
+			output==MODEL_ACTION_COOL ? TEMP_FIXED_POINT_SCALE : 0);
+		sinceIdle = output==MODEL_ACTION_IDLE ? 0 : incrementSaturated(sinceIdle);
+		if (output==MODEL_ACTION_HEAT) {
+			result.heatSteps++;
+			sinceHeating = 0;
+		}
+		else
+			sinceHeating = incrementSaturated(sinceHeating);
+		if (output==MODEL_ACTION_COOL) {
+			result.coolSteps++;
+			sinceCooling = 0;
+		}
+		else
+			sinceCooling = incrementSaturated(sinceCooling);
+
+		beer = state.beerTemp();
+		if (result.reached==UINT16_MAX && pid && (startsAbove ? beer<=beerSetting : beer>=beerSetting))
+			result.reached = i+1;
+		if ((i+1)%result.interval==0 && result.points<ForecastResult::POINTS) {
+			result.beer[result.points] = beer;
+			result.fridge[result.points] = state.fridgeTemp();
+			result.points++;
+		}
+	}
+}
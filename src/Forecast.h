@@ -0,0 +1,82 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "ChamberModel.h"
+#include "ModelPredictive.h"
+#include "EepromStructs.h"
+
+/**
+ * Where the forecast starts from: a copy of the parts of TempControl the forecast steps forward.
+ */
+struct ForecastStart {
+	char mode;
+	temperature beerTemp;
+	temperature fridgeTemp;
+	temperature roomTemp;				// INVALID_TEMP without a room sensor, which leaves the room out of the model
+	temperature beerSetting;
+	temperature fridgeSetting;
+	long_temperature diffIntegral;
+	uint8_t output;						// the ModelAction the fridge is carrying out
+	uint16_t sinceIdle;					// model steps since each event, saturating
+	uint16_t sinceHeating;
+	uint16_t sinceCooling;
+	bool canHeat;
+	bool canCool;
+};
+
+struct ForecastResult {
+	static const uint8_t POINTS = FORECAST_POINTS;
+	uint16_t steps;						// model steps forecast
+	uint16_t interval;					// model steps between the points of the trajectory
+	uint16_t reached;					// model steps until the beer reaches its setting, or UINT16_MAX if it doesn't
+	uint16_t heatSteps;					// model steps the heater is on
+	uint16_t coolSteps;
+	uint8_t points;						// points of the trajectory filled in
+	temperature beer[POINTS];			// at the end of every interval
+	temperature fridge[POINTS];
+};
+
+/**
+ * Forecasts how the current chamber will go: when the beer reaches its setting, and how long the heater and
+ * cooler will be on to get there and hold it.
+ *
+ * The control loop is run forward on a lightweight copy of its state, in whole model steps, against the
+ * ChamberModel learned for the chamber, with the room held at its current temperature. The copy has the beer PID
+ * without the derivative, and a fridge that heats and cools to its setting with the minimum on, off and switch
+ * times, but not the peak estimation. The model predictive and autotune modes are forecast as holding the beer with
+ * the PID. Nothing of the live controller is changed, and FORECAST_HOURS at one step a minute takes a few
+ * milliseconds, well within a control tick.
+ */
+class Forecast
+{
+public:
+	/**
+	 * Copies the state of the current chamber.
+	 * /return false if the forecast can't be made: the chamber is off or in test mode, or a sensor is missing.
+	 */
+	static bool capture(ForecastStart& start);
+
+	/**
+	 * Runs the forecast for the given number of model steps.
+	 */
+	static void run(const ForecastStart& start, const ThermalModel& model, const ControlConstants& cc, uint16_t steps,
+		ForecastResult& result);
+};
+
+extern Forecast forecast;
@@ -0,0 +1,298 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include "HistoryLog.h"
+#include "TempControl.h"
+#include "ChamberManager.h"
+#include "Ticks.h"
+
+#define HISTORY_BLOCK_MAGIC 0x49		// 0x48 was used by blocks without a time
+
+const uint16_t HISTORY_BLOCKS = HISTORY_LOG_SIZE/HISTORY_BLOCK_SIZE;
+
+// flags byte of an encoded sample. Bits 0-4 mark the temperature fields, in the order they appear in HistorySample.
+const uint8_t HISTORY_TEMPS = 5;
+const uint8_t HISTORY_FLAG_STATE = 1<<5;
+const uint8_t HISTORY_FLAG_MODE = 1<<6;
+const uint8_t HISTORY_END = 0xFF;			// erased flash, no more samples in the block
+const uint8_t HISTORY_MAX_SAMPLE = 1+HISTORY_TEMPS*3+2;
+
+HistoryLog historyLog;
+
+uint8_t HistoryLog::buffer[HISTORY_BLOCK_SIZE];
+HistorySample HistoryLog::last;
+uint32_t HistoryLog::seq;
+uint32_t HistoryLog::lastSampleTime;
+uint16_t HistoryLog::boot;
+uint16_t HistoryLog::block;
+uint16_t HistoryLog::used;
+bool HistoryLog::started;
+
+inline temperature* temps(HistorySample& s) { return &s.beerTemp; }
+inline const temperature* temps(const HistorySample& s) { return &s.beerTemp; }
+
+uint8_t HistoryLog::encode(uint8_t* p, const HistorySample& prev, const HistorySample& sample)
+{
+	uint8_t* start = p++;
+	uint8_t flags = 0;
+	for (uint8_t i=0; i<HISTORY_TEMPS; i++) {
+		int32_t delta = int32_t(temps(sample)[i]) - temps(prev)[i];
+		if (!delta)
+			continue;
+		flags |= 1<<i;
+		// zigzag, so small negative deltas are small too, then 7 bits a byte
+		uint32_t z = (uint32_t(delta)<<1) ^ uint32_t(delta>>31);
+		do {
+			uint8_t b = z & 0x7F;
+			z >>= 7;
+			*p++ = b | (z ? 0x80 : 0);
+		} while (z);
+	}
+	if (sample.state!=prev.state) {
+		flags |= HISTORY_FLAG_STATE;
+		*p++ = sample.state;
+	}
+	if (sample.mode!=prev.mode) {
+		flags |= HISTORY_FLAG_MODE;
+		*p++ = sample.mode;
+	}
+	*start = flags;
+	return p-start;
+}
+
+/**
+ * Decodes the sample at p, applying it to sample (which holds the previous sample).
+ * Returns the number of bytes used, or 0 when there are no more samples.
+ */
+uint8_t HistoryLog::decode(const uint8_t* p, const uint8_t* end, HistorySample& sample)
+{
+	const uint8_t* start = p;
+	if (p>=end || *p==HISTORY_END)
+		return 0;
+	uint8_t flags = *p++;
+	for (uint8_t i=0; i<HISTORY_TEMPS; i++) {
+		if (!(flags & (1<<i)))
+			continue;
+		uint32_t z = 0;
+		uint8_t shift = 0;
+		uint8_t b;
+		do {
+			if (p>=end)
+				return 0;
+			b = *p++;
+			z |= uint32_t(b & 0x7F)<<shift;
+			shift += 7;
+		} while (b & 0x80);
+		int32_t delta = int32_t(z>>1) ^ -int32_t(z&1);
+		temps(sample)[i] += delta;
+	}
+	if (flags & HISTORY_FLAG_STATE) {
+		if (p>=end)
+			return 0;
+		sample.state = *p++;
+	}
+	if (flags & HISTORY_FLAG_MODE) {
+		if (p>=end)
+			return 0;
+		sample.mode = *p++;
+	}
+	return p-start;
+}
+
+bool HistoryLog::readBlock(File& f, uint16_t index)
+{
+	return f.seek(uint32_t(index)*HISTORY_BLOCK_SIZE, SeekSet)
+		&& f.read(buffer, HISTORY_BLOCK_SIZE)==HISTORY_BLOCK_SIZE
+		&& ((HistoryBlockHeader*)buffer)->magic==HISTORY_BLOCK_MAGIC;
+}
+
+void HistoryLog::begin()
+{
+	seq = 0;
+	boot = 0;
+	block = HISTORY_BLOCKS-1;		// so the first block written is block 0
+	started = false;
+
+	File f = SPIFFS.open(HISTORY_LOG_FILE, "r");
+	if (f) {
+		int32_t newest = -1;
+		HistoryBlockHeader h;
+		for (uint16_t b=0; b<HISTORY_BLOCKS; b++) {
+			if (!f.seek(uint32_t(b)*HISTORY_BLOCK_SIZE, SeekSet) || f.read((uint8_t*)&h, sizeof(h))!=sizeof(h))
+				break;		// the file grows a block at a time until the ring first wraps
+			if (h.magic!=HISTORY_BLOCK_MAGIC)
+				continue;
+			if (newest<0 || int32_t(h.seq-seq)>0) {
+				newest = b;
+				seq = h.seq;
+			}
+			if (h.boot>boot)
+				boot = h.boot;
+		}
+		if (newest>=0 && readBlock(f, newest)) {
+			// count the samples in the newest block to find the next sequence number
+			HistorySample s;
+			memset(&s, 0, sizeof(s));
+			const uint8_t* p = buffer+sizeof(HistoryBlockHeader);
+			uint8_t n;
+			while ((n = decode(p, buffer+HISTORY_BLOCK_SIZE, s))) {
+				p += n;
+				seq++;
+			}
+			block = newest;
+		}
+		f.close();
+	}
+	boot++;
+	lastSampleTime = ticks.millis();
+}
+
+void HistoryLog::update()
+{
+	ticks_millis_t now = ticks.millis();
+	if (now-lastSampleTime < HISTORY_SAMPLE_INTERVAL*1000UL)
+		return;
+	if (now-lastSampleTime >= 2*HISTORY_SAMPLE_INTERVAL*1000UL) {
+		// a sample was missed: the block's time base no longer holds, so start a new block
+		lastSampleTime = now;
+		started = false;
+	}
+	else
+		lastSampleTime += HISTORY_SAMPLE_INTERVAL*1000UL;
+
+	ChamberSwitch chamber(1);		// the history is of the first chamber, whichever the Pi link has selected
+	HistorySample sample;
+	sample.beerTemp = tempControl.getBeerTemp();
+	sample.beerSetting = tempControl.getBeerSetting();
+	sample.fridgeTemp = tempControl.getFridgeTemp();
+	sample.fridgeSetting = tempControl.getFridgeSetting();
+	sample.roomTemp = tempControl.ambientSensor->isConnected() ? tempControl.getRoomTemp() : temperature(INVALID_TEMP);
+	sample.state = tempControl.getState();
+	sample.mode = tempControl.getMode();
+	record(sample);
+}
+
+void HistoryLog::record(const HistorySample& sample)
+{
+	// a new start always begins a new block, so each block holds samples from one boot
+	uint8_t encoded[HISTORY_MAX_SAMPLE];
+	uint8_t n = started ? encode(encoded, last, sample) : 0;
+	if (!started || used+n>HISTORY_BLOCK_SIZE) {
+		startBlock(sample);
+		return;
+	}
+
+	File f = SPIFFS.open(HISTORY_LOG_FILE, "r+");
+	if (!f)
+		return;
+	f.seek(uint32_t(block)*HISTORY_BLOCK_SIZE+used, SeekSet);
+	f.write(encoded, n);
+	f.close();
+	used += n;
+	last = sample;
+	seq++;
+}
+
+/**
+ * Erases the next block in the ring and writes its header and keyframe.
+ */
+void HistoryLog::startBlock(const HistorySample& sample)
+{
+	File f = SPIFFS.open(HISTORY_LOG_FILE, "r+");
+	if (!f)
+		f = SPIFFS.open(HISTORY_LOG_FILE, "w");
+	if (!f)
+		return;
+
+	block = (block+1) % HISTORY_BLOCKS;
+	uint32_t offset = uint32_t(block)*HISTORY_BLOCK_SIZE;
+	if (offset>f.size()) {
+		block = 0;		// the file was truncated
+		offset = 0;
+	}
+
+	memset(buffer, HISTORY_END, sizeof(buffer));
+	HistoryBlockHeader& h = *(HistoryBlockHeader*)buffer;
+	h.magic = HISTORY_BLOCK_MAGIC;
+	h.reserved = 0;
+	h.boot = boot;
+	h.seq = seq;
+	h.time = lastSampleTime/1000;
+	HistorySample zero;
+	memset(&zero, 0, sizeof(zero));
+	used = sizeof(h) + encode(buffer+sizeof(h), zero, sample);
+
+	f.seek(offset, SeekSet);
+	f.write(buffer, HISTORY_BLOCK_SIZE);
+	f.close();
+	started = true;
+	last = sample;
+	seq++;
+}
+
+void HistoryLog::forEach(uint32_t from, uint32_t to, HistoryCallback callback, void* data)
+{
+	visit(from, to, 0, 0, 0xFFFFFFFFUL, callback, data);
+}
+
+void HistoryLog::forEachInTime(uint16_t boot, uint32_t since, uint32_t until, HistoryCallback callback, void* data)
+{
+	visit(0, 0xFFFFFFFFUL, boot, since, until, callback, data);
+}
+
+/**
+ * Calls callback for the samples with from <= seq <= to, and if boot is not 0, taken in that boot with
+ * since <= time <= until.
+ */
+void HistoryLog::visit(uint32_t from, uint32_t to, uint16_t boot, uint32_t since, uint32_t until,
+	HistoryCallback callback, void* data)
+{
+	File f = SPIFFS.open(HISTORY_LOG_FILE, "r");
+	if (!f)
+		return;
+	// the oldest block is the one after the block being written
+	for (uint16_t k=1; k<=HISTORY_BLOCKS; k++) {
+		uint16_t b = (block+k) % HISTORY_BLOCKS;
+		if (!readBlock(f, b))
+			continue;
+		const HistoryBlockHeader& h = *(HistoryBlockHeader*)buffer;
+		uint32_t n = h.seq;
+		if (n>to)
+			break;
+		if (boot && (h.boot!=boot || h.time>until))
+			continue;
+		HistorySample s;
+		memset(&s, 0, sizeof(s));
+		const uint8_t* p = buffer+sizeof(h);
+		uint32_t time = h.time;
+		uint8_t len;
+		while (n<=to && (len = decode(p, buffer+HISTORY_BLOCK_SIZE, s))) {
+			if (n>=from && (!boot || (time>=since && time<=until)))
+				callback(n, h.boot, time, s, data);
+			p += len;
+			n++;
+			time += HISTORY_SAMPLE_INTERVAL;
+		}
+	}
+	f.close();
+}
+
+#endif
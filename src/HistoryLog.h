@@ -0,0 +1,123 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#ifdef ARDUINO
+#include <FS.h>
+#else
+#include "HostFS.h"
+#endif
+#include "TemperatureFormats.h"
+
+#define HISTORY_LOG_FILE "/history.log"
+
+/**
+ * One history sample. Temperatures are in the internal fixed7_9 format, INVALID_TEMP when not available.
+ */
+struct HistorySample {
+	temperature beerTemp;
+	temperature beerSetting;
+	temperature fridgeTemp;
+	temperature fridgeSetting;
+	temperature roomTemp;
+	uint8_t state;
+	char mode;
+};
+
+/**
+ * Starts each block of the history file.
+ */
+struct HistoryBlockHeader {
+	uint8_t magic;
+	uint8_t reserved;
+	uint16_t boot;				// incremented at each start, so gaps in the history can be detected
+	uint32_t seq;				// sequence number of the first sample in the block
+	uint32_t time;				// seconds since the boot when the first sample in the block was taken
+};
+
+const uint16_t HISTORY_BLOCK_SIZE = 256;
+
+typedef void (*HistoryCallback)(uint32_t seq, uint16_t boot, uint32_t time, const HistorySample& sample, void* data);
+
+/**
+ * Keeps a per-sample history of temperatures, settings and state in a ring of blocks on flash, so that
+ * the history survives the Pi or WiFi being down and can be fetched once the link is back.
+ *
+ * Each sample is numbered with a sequence number that keeps increasing across restarts. Samples are delta
+ * encoded against the previous sample: a flags byte marks the fields that changed, followed by a zigzag
+ * varint of the difference for each changed temperature and the new value of state or mode. A steady
+ * chamber costs one byte a sample. The history is of the first chamber. Each block starts with a keyframe (the first sample encoded against zero),
+ * so blocks decode independently and the oldest block can be overwritten when the ring wraps.
+ *
+ * There is no wall clock, so the time of a sample is counted in seconds since the boot it was taken in. Each block
+ * holds the time of its first sample, and the samples after it follow every HISTORY_SAMPLE_INTERVAL seconds;
+ * when sampling falls behind, a new block is started so the times stay exact.
+ */
+class HistoryLog
+{
+public:
+	/**
+	 * Finds the newest block and starts a new one after it. SPIFFS must be mounted.
+	 */
+	static void begin();
+
+	/**
+	 * Takes a sample every HISTORY_SAMPLE_INTERVAL seconds. Called from the control loop.
+	 */
+	static void update();
+
+	/**
+	 * Calls callback for each stored sample with from <= seq <= to, oldest first.
+	 */
+	static void forEach(uint32_t from, uint32_t to, HistoryCallback callback, void* data);
+
+	/**
+	 * Calls callback for each stored sample taken during the given boot, from since to until seconds after it
+	 * started, oldest first.
+	 */
+	static void forEachInTime(uint16_t boot, uint32_t since, uint32_t until, HistoryCallback callback, void* data);
+
+	static uint32_t nextSeq() { return seq; }
+	static uint16_t currentBoot() { return boot; }
+
+private:
+	static void record(const HistorySample& sample);
+	static void startBlock(const HistorySample& sample);
+	static bool readBlock(File& f, uint16_t block);
+	static uint8_t encode(uint8_t* p, const HistorySample& prev, const HistorySample& sample);
+	static uint8_t decode(const uint8_t* p, const uint8_t* end, HistorySample& sample);
+	static void visit(uint32_t from, uint32_t to, uint16_t boot, uint32_t since, uint32_t until,
+		HistoryCallback callback, void* data);
+
+	static uint8_t buffer[HISTORY_BLOCK_SIZE];	// block being read
+	static HistorySample last;					// previous sample written
+	static uint32_t seq;						// sequence number of the next sample
+	static uint32_t lastSampleTime;				// millis
+	static uint16_t boot;
+	static uint16_t block;						// block being written
+	static uint16_t used;						// bytes used in the block being written
+	static bool started;
+};
+
+extern HistoryLog historyLog;
+
+#endif
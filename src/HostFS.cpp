@@ -0,0 +1,436 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+
+#ifndef ARDUINO
+
+#include "HostFS.h"
+#include <stdio.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+fs::FS SPIFFS;
+
+namespace fs {
+
+struct Node {
+	std::string name;
+	std::vector<uint8_t> data;
+	std::vector<int32_t> pages;		// flash page holding each page of data
+	int32_t indexPage;				// flash page holding the object index, -1 if not yet written
+	bool removed;
+
+	Node(const std::string& name) : name(name), indexPage(-1), removed(false) { }
+};
+
+size_t File::write(const uint8_t* buf, size_t size)
+{
+	if (!node || !writable || node->removed || !size || !fs->powered)
+		return 0;
+	bool torn = false;
+	if (fs->powerLeft>=0 && int64_t(size)>fs->powerLeft) {
+		size = fs->powerLeft;
+		torn = fs->tear;
+		fs->powered = false;
+	}
+	else if (fs->powerLeft>=0)
+		fs->powerLeft -= size;
+	if (!size && !torn)
+		return 0;
+	if (!fs->programPages(*node, pos, pos+size+torn))
+		return 0;
+	if (pos+size+torn > node->data.size())
+		node->data.resize(pos+size+torn, 0xFF);
+	memcpy(&node->data[pos], buf, size);
+	if (torn)
+		node->data[pos+size] &= buf[size] | 0x5A;		// programming only clears bits, and it stopped part way
+	pos += size;
+	modified = true;
+	fs->flashStats.bytesWritten += size;
+	return size;
+}
+
+int File::read()
+{
+	uint8_t c;
+	return read(&c, 1) ? c : -1;
+}
+
+size_t File::read(uint8_t* buf, size_t size)
+{
+	if (!node || pos>=node->data.size())
+		return 0;
+	if (size > node->data.size()-pos)
+		size = node->data.size()-pos;
+	memcpy(buf, &node->data[pos], size);
+	uint16_t pageSize = fs->model.pageSize;
+	uint32_t pages = (pos+size-1)/pageSize - pos/pageSize + 1;
+	fs->flashStats.bytesRead += size;
+	fs->flashStats.pagesRead += pages;
+	fs->spend(pages*fs->model.readPageMicros);
+	pos += size;
+	return size;
+}
+
+bool File::seek(uint32_t offset, SeekMode mode)
+{
+	if (!node)
+		return false;
+	size_t target = offset;
+	if (mode==SeekCur)
+		target = pos+offset;
+	else if (mode==SeekEnd)
+		target = node->data.size()-offset;
+	if (target > node->data.size())
+		return false;
+	pos = target;
+	return true;
+}
+
+size_t File::size() const
+{
+	return node ? node->data.size() : 0;
+}
+
+void File::flush()
+{
+	if (!node || !modified || node->removed || !fs->powered)
+		return;
+	fs->updateIndex(*node);
+	fs->mirror(*node);
+	modified = false;
+}
+
+void File::close()
+{
+	flush();
+	node.reset();
+}
+
+const char* File::name() const
+{
+	return node ? node->name.c_str() : "";
+}
+
+bool FS::begin()
+{
+	if (erases.size()!=blockCount()) {
+		// first mount: start from freshly erased flash, then take in any files mirrored by an earlier run
+		freePages.assign(blockCount(), pagesPerBlock());
+		livePages.assign(blockCount(), 0);
+		erases.assign(blockCount(), 0);
+		writeBlock = 0;
+		files.clear();
+		load();
+	}
+	mounted = true;
+	powered = true;
+	powerLeft = -1;
+	return true;
+}
+
+bool FS::format()
+{
+	for (Files::iterator it = files.begin(); it!=files.end(); ++it) {
+		it->second->removed = true;
+		if (!directory.empty())
+			::remove(hostPath(it->first).c_str());
+	}
+	files.clear();
+	if (erases.size()!=blockCount())
+		erases.assign(blockCount(), 0);		// wear is only kept while the geometry stays the same
+	freePages.assign(blockCount(), pagesPerBlock());
+	livePages.assign(blockCount(), 0);
+	for (uint16_t block = 0; block<blockCount(); block++)
+		eraseBlock(block);
+	writeBlock = 0;
+	return true;
+}
+
+File FS::open(const char* path, const char* mode)
+{
+	File f;
+	if (!mounted)
+		return f;
+	flashStats.opens++;
+	spend(model.openMicros);
+
+	std::string name(path);
+	Files::iterator it = files.find(name);
+	bool plus = strchr(mode, '+')!=NULL;
+	if (mode[0]=='r') {
+		if (it==files.end())
+			return f;
+		f.node = it->second;
+		f.writable = plus;
+	}
+	else if (mode[0]=='w' || mode[0]=='a') {
+		if (!powered)
+			return f;
+		if (it==files.end())
+			it = files.insert(Files::value_type(name, std::make_shared<Node>(name))).first;
+		f.node = it->second;
+		f.writable = true;
+		if (mode[0]=='w') {
+			discard(*f.node);
+			f.node->data.clear();
+		}
+		else
+			f.pos = f.node->data.size();
+		if (!updateIndex(*f.node)) {
+			files.erase(it);
+			f.node.reset();
+			return f;
+		}
+		mirror(*f.node);
+	}
+	f.fs = this;
+	return f;
+}
+
+bool FS::exists(const char* path)
+{
+	spend(model.openMicros);
+	return mounted && files.count(path);
+}
+
+bool FS::remove(const char* path)
+{
+	Files::iterator it = files.find(path);
+	if (!mounted || !powered || it==files.end())
+		return false;
+	spend(model.openMicros);
+	discard(*it->second);
+	releasePage(it->second->indexPage);
+	it->second->removed = true;
+	files.erase(it);
+	if (!directory.empty())
+		::remove(hostPath(path).c_str());
+	return true;
+}
+
+bool FS::rename(const char* pathFrom, const char* pathTo)
+{
+	Files::iterator it = files.find(pathFrom);
+	if (!mounted || !powered || it==files.end() || files.count(pathTo))
+		return false;
+	std::shared_ptr<Node> node = it->second;
+	files.erase(it);
+	node->name = pathTo;
+	files[pathTo] = node;
+	updateIndex(*node);
+	if (!directory.empty())
+		::rename(hostPath(pathFrom).c_str(), hostPath(pathTo).c_str());
+	return true;
+}
+
+void FS::resetStats()
+{
+	memset(&flashStats, 0, sizeof(flashStats));
+	for (size_t block = 0; block<erases.size(); block++)
+		if (erases[block] > flashStats.maxBlockErases)
+			flashStats.maxBlockErases = erases[block];
+}
+
+/*
+ * Takes a free page, garbage collecting first if free pages are running low.
+ * Returns -1 when the flash is full of live data.
+ */
+int32_t FS::allocatePage()
+{
+	uint32_t free = 0;
+	for (uint16_t block = 0; block<blockCount(); block++)
+		free += freePages[block];
+	while (free < uint32_t(model.gcFreeBlocks)*pagesPerBlock()) {
+		uint32_t before = free;
+		if (!collectGarbage())
+			break;
+		free = 0;
+		for (uint16_t block = 0; block<blockCount(); block++)
+			free += freePages[block];
+		if (free==before)
+			break;
+	}
+
+	for (uint16_t i = 0; i<blockCount() && !freePages[writeBlock]; i++)
+		writeBlock = (writeBlock+1) % blockCount();
+	if (!freePages[writeBlock])
+		return -1;
+	int32_t page = int32_t(writeBlock)*pagesPerBlock() + pagesPerBlock() - freePages[writeBlock];
+	freePages[writeBlock]--;
+	livePages[writeBlock]++;
+	flashStats.pagesProgrammed++;
+	spend(model.programPageMicros);
+	return page;
+}
+
+void FS::releasePage(int32_t page)
+{
+	if (page>=0)
+		livePages[page/pagesPerBlock()]--;
+}
+
+void FS::eraseBlock(uint16_t block)
+{
+	erases[block]++;
+	flashStats.blocksErased++;
+	if (erases[block] > flashStats.maxBlockErases)
+		flashStats.maxBlockErases = erases[block];
+	spend(model.eraseBlockMicros);
+}
+
+/*
+ * Reclaims the block with the most superseded pages: its live pages are moved and the block erased.
+ * The moved pages are written back to the same block, which costs the same as moving them elsewhere
+ * and leaves the files' page maps valid.
+ */
+bool FS::collectGarbage()
+{
+	uint16_t victim = 0;
+	uint16_t mostDirty = 0;
+	for (uint16_t block = 0; block<blockCount(); block++) {
+		uint16_t dirty = pagesPerBlock() - freePages[block] - livePages[block];
+		if (dirty > mostDirty) {
+			mostDirty = dirty;
+			victim = block;
+		}
+	}
+	if (!mostDirty)
+		return false;
+
+	uint16_t live = livePages[victim];
+	uint32_t pause = model.eraseBlockMicros + uint32_t(live)*(model.readPageMicros+model.programPageMicros);
+	eraseBlock(victim);
+	freePages[victim] = pagesPerBlock() - live;
+	flashStats.pagesRead += live;
+	flashStats.pagesProgrammed += live;
+	spend(pause - model.eraseBlockMicros);
+	flashStats.gcRuns++;
+	flashStats.gcMicros += pause;
+	if (pause > flashStats.gcMaxMicros)
+		flashStats.gcMaxMicros = pause;
+	return true;
+}
+
+/*
+ * Accounts for writing bytes from..to of a file. Pages are only programmed once between erases, so
+ * appending into the unwritten end of the last page programs it in place, but changing any byte already
+ * written takes a fresh copy of the page.
+ */
+bool FS::programPages(Node& node, size_t from, size_t to)
+{
+	size_t oldSize = node.data.size();
+	for (size_t page = from/model.pageSize; page<=(to-1)/model.pageSize; page++) {
+		size_t start = page*model.pageSize;
+		if (start < from)
+			start = from;
+		if (page < node.pages.size() && start >= oldSize) {
+			flashStats.pagesProgrammed++;
+			spend(model.programPageMicros);
+			continue;
+		}
+		int32_t fresh = allocatePage();
+		if (fresh<0)
+			return false;
+		if (page < node.pages.size()) {
+			releasePage(node.pages[page]);
+			node.pages[page] = fresh;
+		}
+		else
+			node.pages.push_back(fresh);
+	}
+	return true;
+}
+
+/*
+ * Writes a new copy of the file's object index page, which records its size and pages.
+ */
+bool FS::updateIndex(Node& node)
+{
+	int32_t fresh = allocatePage();
+	if (fresh<0)
+		return false;
+	releasePage(node.indexPage);
+	node.indexPage = fresh;
+	return true;
+}
+
+/*
+ * Releases the data pages of a file.
+ */
+void FS::discard(Node& node)
+{
+	for (size_t page = 0; page<node.pages.size(); page++)
+		releasePage(node.pages[page]);
+	node.pages.clear();
+}
+
+/*
+ * Creates a file for each regular file in the host directory. This is not counted in the stats.
+ */
+void FS::load()
+{
+	if (directory.empty())
+		return;
+	DIR* dir = opendir(directory.c_str());
+	if (!dir)
+		return;
+	HostFlashStats saved = flashStats;
+	while (struct dirent* entry = readdir(dir)) {
+		std::string name = std::string("/") + entry->d_name;
+		struct stat info;
+		if (stat(hostPath(name).c_str(), &info) || !S_ISREG(info.st_mode))
+			continue;
+		std::vector<uint8_t> data(info.st_size);
+		FILE* in = fopen(hostPath(name).c_str(), "rb");
+		if (!in)
+			continue;
+		size_t loaded = data.empty() ? 0 : fread(&data[0], 1, data.size(), in);
+		fclose(in);
+		data.resize(loaded);
+
+		std::shared_ptr<Node> node = std::make_shared<Node>(name);
+		if (!updateIndex(*node) || (!data.empty() && !programPages(*node, 0, data.size())))
+			break;
+		node->data.swap(data);
+		files[name] = node;
+	}
+	closedir(dir);
+	flashStats = saved;
+}
+
+void FS::mirror(const Node& node)
+{
+	if (directory.empty())
+		return;
+	FILE* out = fopen(hostPath(node.name).c_str(), "wb");
+	if (!out)
+		return;
+	if (!node.data.empty())
+		fwrite(&node.data[0], 1, node.data.size(), out);
+	fclose(out);
+}
+
+std::string FS::hostPath(const std::string& name) const
+{
+	return directory + (name.empty() || name[0]!='/' ? "/" : "") + name;
+}
+
+}
+
+#endif
@@ -0,0 +1,202 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+
+#ifndef ARDUINO
+
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+/**
+ * Parameters of the simulated flash. The defaults are those of the SPIFFS partition on a 4MB ESP8266 module:
+ * 256 byte pages in 8KB logical blocks, with typical SPI NOR program and erase times.
+ */
+struct HostFlashModel {
+	uint32_t size;				// bytes of flash given to the file system
+	uint16_t pageSize;
+	uint16_t blockSize;
+	uint16_t openMicros;		// to look up a file in the object index
+	uint16_t readPageMicros;
+	uint16_t programPageMicros;
+	uint16_t eraseBlockMicros;
+	uint8_t gcFreeBlocks;		// garbage collection runs when fewer than this many blocks' worth of pages are free
+
+	HostFlashModel() : size(1024*1024), pageSize(256), blockSize(8192), openMicros(200), readPageMicros(30),
+		programPageMicros(700), eraseBlockMicros(45000), gcFreeBlocks(2) { }
+};
+
+struct HostFlashStats {
+	uint32_t opens;
+	uint32_t bytesRead;
+	uint32_t bytesWritten;		// as requested by the caller
+	uint32_t pagesRead;
+	uint32_t pagesProgrammed;	// includes pages moved by garbage collection and index updates
+	uint32_t blocksErased;
+	uint32_t gcRuns;
+	uint32_t gcMaxMicros;		// longest single garbage collection pause
+	uint64_t gcMicros;			// total time spent in garbage collection
+	uint64_t busyMicros;		// total simulated time spent in the file system, including gcMicros
+	uint32_t maxBlockErases;	// erase count of the most worn block
+};
+
+namespace fs {
+
+enum SeekMode {
+	SeekSet = 0,
+	SeekCur = 1,
+	SeekEnd = 2
+};
+
+class FS;
+struct Node;
+
+/**
+ * A handle to an open file. A file that is removed while open stays readable through the handle.
+ */
+class File
+{
+public:
+	File() : fs(NULL), pos(0), writable(false), modified(false) { }
+
+	size_t write(uint8_t c) { return write(&c, 1); }
+	size_t write(const uint8_t* buf, size_t size);
+	int read();
+	size_t read(uint8_t* buf, size_t size);
+	int available() { return node ? int(size()-pos) : 0; }
+	bool seek(uint32_t offset, SeekMode mode=SeekSet);
+	size_t position() const { return pos; }
+	size_t size() const;
+	void flush();
+	void close();
+	const char* name() const;
+	operator bool() const { return bool(node); }
+
+private:
+	friend class FS;
+	FS* fs;
+	std::shared_ptr<Node> node;
+	size_t pos;
+	bool writable;
+	bool modified;			// written since the last flush, so the object index must be rewritten
+};
+
+/**
+ * A host stand-in for the ESP8266 SPIFFS object, so code written against it can run and be measured off-device.
+ *
+ * Files are kept in memory and, optionally, mirrored to a directory on the host so they survive between runs.
+ * Alongside the data, the flash underneath is modelled the way SPIFFS uses it: data is written in pages,
+ * overwriting part of a page writes a fresh copy and leaves the old one to be reclaimed, and when free pages
+ * run low a block is garbage collected - its live pages moved and the block erased. Each operation adds its
+ * cost to a simulated clock rather than sleeping, and the erase count of every block is tracked, so the
+ * flash traffic and wear caused by a sequence of commands can be read back from stats().
+ */
+class FS
+{
+public:
+	FS() : mounted(false), powered(true), powerLeft(-1), tear(false), writeBlock(0) { resetStats(); }
+
+	/**
+	 * Sets the flash model. Takes effect at the next format or begin.
+	 */
+	void setModel(const HostFlashModel& model) { this->model = model; }
+	const HostFlashModel& getModel() const { return model; }
+
+	/**
+	 * Mirrors files to the given host directory, which must exist. Files already there are loaded at begin.
+	 * With no directory, files only live in memory.
+	 */
+	void setDirectory(const char* path) { directory = path ? path : ""; }
+
+	/**
+	 * Mounts the file system. This also restores power after cutPowerAfter().
+	 */
+	bool begin();
+	void end() { mounted = false; }
+	bool format();
+
+	File open(const char* path, const char* mode);
+	bool exists(const char* path);
+	bool remove(const char* path);
+	bool rename(const char* pathFrom, const char* pathTo);
+
+	const HostFlashStats& stats() const { return flashStats; }
+	void resetStats();
+
+	/**
+	 * Returns the number of times the given block has been erased since the last format.
+	 */
+	uint32_t blockErases(uint16_t block) const { return block<erases.size() ? erases[block] : 0; }
+
+	/**
+	 * Loses power once the given number of further bytes have been written. The write in progress stops there,
+	 * and with tear set the byte it stopped on is left half programmed. Until the next begin(), nothing more
+	 * reaches the flash: writes, opens for writing, removes and renames all fail.
+	 */
+	void cutPowerAfter(uint32_t bytes, bool tear=false) { powerLeft = bytes; this->tear = tear; }
+	bool hasPower() const { return powered; }
+
+private:
+	friend class File;
+
+	typedef std::map<std::string, std::shared_ptr<Node> > Files;
+
+	uint16_t pagesPerBlock() const { return model.blockSize/model.pageSize; }
+	uint16_t blockCount() const { return model.size/model.blockSize; }
+	void spend(uint32_t micros) { flashStats.busyMicros += micros; }
+	int32_t allocatePage();
+	void releasePage(int32_t page);
+	void eraseBlock(uint16_t block);
+	bool programPages(Node& node, size_t from, size_t to);
+	bool collectGarbage();
+	bool updateIndex(Node& node);
+	void discard(Node& node);
+	void load();
+	void mirror(const Node& node);
+	std::string hostPath(const std::string& name) const;
+
+	HostFlashModel model;
+	HostFlashStats flashStats;
+	std::string directory;
+	Files files;
+	bool mounted;
+	bool powered;
+	int64_t powerLeft;		// bytes that can still be written before power is lost, -1 for no limit
+	bool tear;
+
+	// flash bookkeeping, by block
+	std::vector<uint16_t> freePages;
+	std::vector<uint16_t> livePages;
+	std::vector<uint32_t> erases;
+	uint16_t writeBlock;		// block new pages are taken from
+};
+
+}
+
+using fs::FS;
+using fs::File;
+using fs::SeekMode;
+using fs::SeekSet;
+using fs::SeekCur;
+using fs::SeekEnd;
+
+extern fs::FS SPIFFS;
+
+#endif
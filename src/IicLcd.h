@@ -144,7 +144,7 @@ private:
 	uint8_t _cols;
 	uint8_t _rows;
 	uint8_t _backlightval;
-	uint16_t _backlightTime;
+	ticks_seconds_t _backlightTime;
 	bool _bufferOnly;
 
 	char content[4][21]; // always keep a copy of the display content in this variable
@@ -77,3 +77,96 @@ static const char JSONKEY_posPeak[] PROGMEM = "posPeak";
 
 static const char JSONKEY_logType[] PROGMEM = "logType";
 static const char JSONKEY_logID[] PROGMEM = "logID";
+
+// onewire sensor health
+static const char JSONKEY_address[] PROGMEM = "a";
+static const char JSONKEY_connected[] PROGMEM = "conn";
+static const char JSONKEY_crcFailures[] PROGMEM = "crcErr";
+static const char JSONKEY_resets[] PROGMEM = "resets";
+static const char JSONKEY_reconnectAttempts[] PROGMEM = "reconn";
+static const char JSONKEY_backoff[] PROGMEM = "backoff";
+static const char JSONKEY_reads[] PROGMEM = "reads";
+static const char JSONKEY_latencyMin[] PROGMEM = "latMin";
+static const char JSONKEY_latencyAvg[] PROGMEM = "latAvg";
+static const char JSONKEY_latencyMax[] PROGMEM = "latMax";
+
+// settings log
+static const char JSONKEY_logSize[] PROGMEM = "size";
+static const char JSONKEY_logUsed[] PROGMEM = "used";
+static const char JSONKEY_logLive[] PROGMEM = "live";
+static const char JSONKEY_logCompactions[] PROGMEM = "compactions";
+static const char JSONKEY_logAppends[] PROGMEM = "appends";
+static const char JSONKEY_logSkipped[] PROGMEM = "skipped";
+static const char JSONKEY_logBytesWritten[] PROGMEM = "written";
+
+// history range
+static const char JSONKEY_from[] PROGMEM = "from";
+static const char JSONKEY_to[] PROGMEM = "to";
+static const char JSONKEY_count[] PROGMEM = "n";
+static const char JSONKEY_boot[] PROGMEM = "boot";
+static const char JSONKEY_since[] PROGMEM = "since";
+static const char JSONKEY_until[] PROGMEM = "until";
+
+// configuration image
+static const char JSONKEY_result[] PROGMEM = "result";
+
+// beers in a chamber
+static const char JSONKEY_beer[] PROGMEM = "beer";
+static const char JSONKEY_beerTemp[] PROGMEM = "beerTemp";
+static const char JSONKEY_fridgeDemand[] PROGMEM = "fridgeDemand";
+static const char JSONKEY_heat[] PROGMEM = "heat";
+static const char JSONKEY_cool[] PROGMEM = "cool";
+static const char JSONKEY_lead[] PROGMEM = "lead";
+
+// main loop tasks
+static const char JSONKEY_task[] PROGMEM = "task";
+static const char JSONKEY_runs[] PROGMEM = "runs";
+static const char JSONKEY_misses[] PROGMEM = "misses";
+static const char JSONKEY_latenessMax[] PROGMEM = "lateMax";
+static const char JSONKEY_durationMax[] PROGMEM = "durMax";
+
+// beer profile
+static const char JSONKEY_elapsed[] PROGMEM = "elapsed";
+static const char JSONKEY_points[] PROGMEM = "points";
+
+// autotune
+static const char JSONKEY_status[] PROGMEM = "status";
+static const char JSONKEY_cycles[] PROGMEM = "cycles";
+static const char JSONKEY_ultimateGain[] PROGMEM = "Ku";
+static const char JSONKEY_ultimatePeriod[] PROGMEM = "Tu";
+static const char JSONKEY_apply[] PROGMEM = "apply";
+static const char JSONKEY_discard[] PROGMEM = "discard";
+static const char JSONKEY_chamber[] PROGMEM = "chamber";
+static const char JSONKEY_pending[] PROGMEM = "pending";
+
+// learned chamber model and model predictive control
+static const char JSONKEY_samples[] PROGMEM = "samples";
+static const char JSONKEY_fridgeError[] PROGMEM = "fridgeErr";
+static const char JSONKEY_beerError[] PROGMEM = "beerErr";
+static const char JSONKEY_kBeer[] PROGMEM = "kBeer";
+static const char JSONKEY_kRoom[] PROGMEM = "kRoom";
+static const char JSONKEY_heatRate[] PROGMEM = "heatRate";
+static const char JSONKEY_coolRate[] PROGMEM = "coolRate";
+static const char JSONKEY_kFridge[] PROGMEM = "kFridge";
+static const char JSONKEY_ferment[] PROGMEM = "ferment";
+static const char JSONKEY_action[] PROGMEM = "action";
+static const char JSONKEY_pulse[] PROGMEM = "pulse";
+
+// actuator wear
+static const char JSONKEY_output[] PROGMEM = "output";
+static const char JSONKEY_starts[] PROGMEM = "starts";
+static const char JSONKEY_startsLastHour[] PROGMEM = "startsHour";
+static const char JSONKEY_onTime[] PROGMEM = "onTime";
+static const char JSONKEY_duty[] PROGMEM = "duty";
+static const char JSONKEY_dutyLastHour[] PROGMEM = "dutyHour";
+static const char JSONKEY_minOffTime[] PROGMEM = "minOff";
+static const char JSONKEY_reset[] PROGMEM = "reset";
+
+// forecast
+static const char JSONKEY_hours[] PROGMEM = "hours";
+static const char JSONKEY_reach[] PROGMEM = "reach";
+static const char JSONKEY_heatTime[] PROGMEM = "heatTime";
+static const char JSONKEY_coolTime[] PROGMEM = "coolTime";
+static const char JSONKEY_interval[] PROGMEM = "interval";
+static const char JSONKEY_fridge[] PROGMEM = "fridge";
+static const char JSONKEY_calcTime[] PROGMEM = "calcUs";
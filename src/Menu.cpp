@@ -55,7 +55,7 @@ bool blinkLoop(
 	void (*hide)(),	// called to blank out the current value
 	void (*pushed)())	// handle selection
 {	
-	uint16_t lastChangeTime = ticks.seconds();
+	ticks_seconds_t lastChangeTime = ticks.seconds();
 	uint8_t blinkTimer = 0;
 	
 	while(ticks.timeSince(lastChangeTime) < MENU_TIMEOUT){ // time out at 10 seconds
@@ -178,7 +178,7 @@ void pickTempSetting(ReadTemp readTemp, WriteTemp writeTemp, const char* tempNam
 	rotaryEncoder.setRange(fixedToTenths(oldSetting), fixedToTenths(tempControl.cc.tempSettingMin), fixedToTenths(tempControl.cc.tempSettingMax));
 
 	uint8_t blinkTimer = 0;
-	uint16_t lastChangeTime = ticks.seconds();
+	ticks_seconds_t lastChangeTime = ticks.seconds();
 	while(ticks.timeSince(lastChangeTime) < MENU_TIMEOUT){ // time out at 10 seconds
 		if(rotaryEncoder.changed()){
 			lastChangeTime = ticks.seconds();
@@ -0,0 +1,117 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+#include "ModelPredictive.h"
+#include "ChamberManager.h"
+
+extern ValueActuator defaultActuator;
+
+ModelPredictiveControl modelPredictiveControl;
+
+ModelPredictiveControl::Decision ModelPredictiveControl::decisions[BREWPI_CHAMBERS];
+
+// lengths of the heating and cooling pulses tried, in model steps
+static const uint8_t MPC_PULSES[] = { 3, 6, 12, 24, 48, 96 };
+
+// how much further than the idle range the fridge setting is put to make the state machine heat or cool
+const temperature MPC_SETTING_MARGIN = TEMP_FIXED_POINT_SCALE/2;
+
+ModelAction ModelPredictiveControl::getAction()
+{
+	return ModelAction(decisions[chamberManager.current()].action);
+}
+
+uint8_t ModelPredictiveControl::getPulse()
+{
+	return decisions[chamberManager.current()].pulse;
+}
+
+int64_t ModelPredictiveControl::cost(const ThermalModel& model, ModelState state, temperature room,
+	temperature setting, ModelAction action, uint8_t pulse, bool running, const ControlConstants& cc)
+{
+	const int64_t squareDegree = int64_t(TEMP_FIXED_POINT_SCALE)*TEMP_FIXED_POINT_SCALE;
+	int64_t total = (action!=MODEL_ACTION_IDLE && !running) ? MPC_START_PENALTY*squareDegree : 0;
+	int32_t lowest = int32_t(setting)-cc.pidMax;
+	int32_t highest = int32_t(setting)+cc.pidMax;
+	for (uint16_t i=0; i<MPC_HORIZON; i++) {
+		bool on = i<pulse;
+		model.step(state, room, (on && action==MODEL_ACTION_HEAT) ? TEMP_FIXED_POINT_SCALE : 0,
+			(on && action==MODEL_ACTION_COOL) ? TEMP_FIXED_POINT_SCALE : 0);
+		int32_t error = int32_t(state.beerTemp())-setting;
+		total += int64_t(error)*error;
+		// the fridge is kept within pidMax of the beer setting, as with the PID
+		int32_t fridge = state.fridgeTemp();
+		int32_t excess = fridge<lowest ? lowest-fridge : (fridge>highest ? fridge-highest : 0);
+		total += int64_t(excess)*excess*16;
+	}
+	return total;
+}
+
+temperature ModelPredictiveControl::update(temperature beerSetting, const ControlConstants& cc)
+{
+	Decision& d = decisions[chamberManager.current()];
+	TempSensor* beerSensor = tempControl.beerSensor;
+	TempSensor* fridgeSensor = tempControl.fridgeSensor;
+	if (beerSetting==INVALID_TEMP || !beerSensor->isConnected() || !fridgeSensor->isConnected()) {
+		d.valid = false;
+		return INVALID_TEMP;
+	}
+	temperature fridge = fridgeSensor->readFastFiltered();
+
+	if (!d.valid || ++d.ticks>=MODEL_STEP) {
+		const ThermalModel& model = chamberModel.get();
+		ModelState state;
+		state.set(beerSensor->readFastFiltered(), fridge);
+		temperature room = tempControl.ambientSensor->read();
+		bool canHeat = tempControl.heater!=&defaultActuator || (cc.lightAsHeater && tempControl.light!=&defaultActuator);
+		bool canCool = tempControl.cooler!=&defaultActuator;
+
+		d.action = MODEL_ACTION_IDLE;
+		d.pulse = 0;
+		int64_t best = cost(model, state, room, beerSetting, MODEL_ACTION_IDLE, 0, false, cc);
+		for (uint8_t i=0; i<sizeof(MPC_PULSES); i++) {
+			if (canHeat) {
+				int64_t c = cost(model, state, room, beerSetting, MODEL_ACTION_HEAT, MPC_PULSES[i],
+					tempControl.stateIsHeating(), cc);
+				if (c<best) {
+					best = c;
+					d.action = MODEL_ACTION_HEAT;
+					d.pulse = MPC_PULSES[i];
+				}
+			}
+			if (canCool) {
+				int64_t c = cost(model, state, room, beerSetting, MODEL_ACTION_COOL, MPC_PULSES[i],
+					tempControl.stateIsCooling(), cc);
+				if (c<best) {
+					best = c;
+					d.action = MODEL_ACTION_COOL;
+					d.pulse = MPC_PULSES[i];
+				}
+			}
+		}
+		d.ticks = 0;
+		d.valid = true;
+	}
+
+	// set relative to where the fridge is now, so the state machine keeps doing the same until the next decision
+	int32_t setting = fridge;
+	if (d.action==MODEL_ACTION_COOL)
+		setting = int32_t(fridge)-cc.idleRangeHigh-MPC_SETTING_MARGIN;
+	else if (d.action==MODEL_ACTION_HEAT)
+		setting = int32_t(fridge)-cc.idleRangeLow+MPC_SETTING_MARGIN;
+	return temperature(constrain(setting, int32_t(cc.tempSettingMin), int32_t(cc.tempSettingMax)));
+}
@@ -0,0 +1,72 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "ChamberModel.h"
+#include "EepromStructs.h"
+
+enum ModelAction {
+	MODEL_ACTION_IDLE = 0,
+	MODEL_ACTION_HEAT = 1,
+	MODEL_ACTION_COOL = 2
+};
+
+/**
+ * Controls the beer in MODE_MODEL_PREDICTIVE from the learned ChamberModel, in place of the beer PID.
+ *
+ * Once every model step, it predicts the beer over the next MPC_HORIZON steps for a few candidate schedules:
+ * idle, or one pulse of heating or cooling of several lengths followed by idle. Each schedule costs the squared
+ * error of the beer over the horizon, plus MPC_START_PENALTY if it starts the heater or compressor, plus a steep cost
+ * for taking the fridge further than pidMax from the beer setting. The first step of the cheapest schedule is carried
+ * out, and the choice is made again at the next step, so the horizon recedes.
+ *
+ * The choice is carried out through the fridge setting: the fridge state machine is asked to heat, cool or idle from
+ * where the fridge is now, so the minimum on, off and switch times still protect the compressor and heater.
+ */
+class ModelPredictiveControl
+{
+public:
+	/**
+	 * Called once per control tick for the current chamber.
+	 * /return the fridge setting that carries out the chosen action, or INVALID_TEMP if the beer setting or a
+	 * sensor is missing.
+	 */
+	static temperature update(temperature beerSetting, const ControlConstants& cc);
+
+	/** The action chosen for the current chamber, and the length of its pulse in model steps. */
+	static ModelAction getAction();
+	static uint8_t getPulse();
+
+private:
+	/**
+	 * The cost of a schedule: action for pulse steps, then idle.
+	 */
+	static int64_t cost(const ThermalModel& model, ModelState state, temperature room, temperature setting,
+		ModelAction action, uint8_t pulse, bool running, const ControlConstants& cc);
+
+	struct Decision {
+		uint8_t action;		// ModelAction
+		uint8_t pulse;
+		uint8_t ticks;		// control ticks since the decision was made
+		bool valid;
+	};
+
+	static Decision decisions[BREWPI_CHAMBERS];
+};
+
+extern ModelPredictiveControl modelPredictiveControl;
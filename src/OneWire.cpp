@@ -115,7 +115,9 @@ sample code bearing this copyright.
 */
 
 #include "OneWire.h"
+#include "OneWireAsync.h"
 
+#ifdef ARDUINO
 
 OneWire::OneWire(uint8_t pin, bool pullup)
 {
@@ -147,6 +149,10 @@ uint8_t OneWire::reset(void)
 	uint8_t r;
 	uint8_t retries = 125;
 
+#ifdef ESP8266
+	OneWireAsync::waitIdle();	// transactions queued in the background may be using the wire
+#endif
+
 	noInterrupts();
 	DIRECT_MODE_INPUT(reg, mask);
 	interrupts();
@@ -221,6 +227,57 @@ uint8_t OneWire::read_bit(void)
 	return r;
 }
 
+#else // native build - same slot timing, against the line model
+
+OneWire::OneWire(OneWireLine* line, uint8_t pin)
+	: line(line), pin(pin)
+{
+#if ONEWIRE_SEARCH
+	reset_search();
+#endif
+}
+
+uint8_t OneWire::reset(void)
+{
+	OneWireAsync::waitIdle();
+	line->release();
+	line->pullLow();
+	line->advance(480);
+	line->release();
+	line->advance(70);
+	uint8_t r = !line->sample();
+	line->advance(410);
+	return r;
+}
+
+void OneWire::write_bit(uint8_t v)
+{
+	line->pullLow();
+	if (v & 1) {
+		line->advance(10);
+		line->release();
+		line->advance(55);
+	}
+	else {
+		line->advance(65);
+		line->release();
+		line->advance(5);
+	}
+}
+
+uint8_t OneWire::read_bit(void)
+{
+	line->pullLow();
+	line->advance(3);
+	line->release();
+	line->advance(10);
+	uint8_t r = line->sample();
+	line->advance(53);
+	return r;
+}
+
+#endif
+
 //
 // Write a byte. The writing code uses the active drivers to raise the
 // pin high, if you need power after the write (e.g. DS18S20 in
@@ -235,10 +292,7 @@ void OneWire::write(uint8_t v, uint8_t power /* = 0 */) {
 		OneWire::write_bit((bitMask & v) ? 1 : 0);
 	}
 	if (!power) {
-		noInterrupts();
-		DIRECT_MODE_INPUT(baseReg, bitmask);
-		DIRECT_WRITE_LOW(baseReg, bitmask);
-		interrupts();
+		depower();
 	}
 }
 
@@ -246,10 +300,7 @@ void OneWire::write_bytes(const uint8_t *buf, uint16_t count, bool power /* = 0
 	for (uint16_t i = 0; i < count; i++)
 		write(buf[i]);
 	if (!power) {
-		noInterrupts();
-		DIRECT_MODE_INPUT(baseReg, bitmask);
-		DIRECT_WRITE_LOW(baseReg, bitmask);
-		interrupts();
+		depower();
 	}
 }
 
@@ -293,9 +344,14 @@ void OneWire::skip()
 
 void OneWire::depower()
 {
+#ifdef ARDUINO
 	noInterrupts();
 	DIRECT_MODE_INPUT(baseReg, bitmask);
+	DIRECT_WRITE_LOW(baseReg, bitmask);
 	interrupts();
+#else
+	line->release();
+#endif
 }
 
 #if ONEWIRE_SEARCH
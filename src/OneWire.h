@@ -3,7 +3,10 @@
 
 #include <inttypes.h>
 
-#if ARDUINO >= 100
+#if !defined(ARDUINO)
+#include <stddef.h>
+#include "OneWireLine.h"   // native build: the bus is a model behind OneWireLine
+#elif ARDUINO >= 100
 #include "Arduino.h"       // for delayMicroseconds, digitalPinToBitMask, etc
 #else
 #include "WProgram.h"      // for delayMicroseconds
@@ -115,6 +118,15 @@
 #define DIRECT_WRITE_LOW(base, mask)    (GPOC = (mask))             //GPIO_OUT_W1TC_ADDRESS
 #define DIRECT_WRITE_HIGH(base, mask)   (GPOS = (mask))             //GPIO_OUT_W1TS_ADDRESS
 
+#elif !defined(ARDUINO)
+// no I/O registers on the native build
+#ifndef PROGMEM
+#define PROGMEM
+#endif
+#ifndef pgm_read_byte
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#endif
+
 #else
 #error "Please define I/O register types here"
 #endif
@@ -123,8 +135,12 @@
 class OneWire
 {
 private:
+#ifdef ARDUINO
 	IO_REG_TYPE bitmask;
 	volatile IO_REG_TYPE *baseReg;
+#else
+	OneWireLine* line;
+#endif
 	uint8_t pin;
 
 #if ONEWIRE_SEARCH
@@ -136,7 +152,12 @@ private:
 #endif
 
 public:
+#ifdef ARDUINO
 	OneWire(uint8_t pin, bool pullup = true);
+#else
+	// the pin number is only used for reporting
+	OneWire(OneWireLine* line, uint8_t pin = 0);
+#endif
 
 	uint8_t pinNr() const { return pin; }
 
@@ -0,0 +1,309 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "OneWireAsync.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+// slot timing, in microseconds. Same as the bit-banged OneWire implementation.
+#define RESET_LOW_TIME 480
+#define RESET_SAMPLE_TIME 70
+#define RESET_RECOVERY_TIME 410
+#define WRITE1_LOW_TIME 10
+#define WRITE1_RECOVERY_TIME 55
+#define WRITE0_LOW_TIME 65
+#define WRITE0_RECOVERY_TIME 5
+#define READ_LOW_TIME 3
+#define READ_SAMPLE_TIME 10
+#define READ_RECOVERY_TIME 53
+
+#define START_DELAY 10			// from one transaction to the next, and from submit to the first phase
+
+#ifdef ESP8266
+// timer1 runs at 80MHz/16
+#define TIMER_TICKS_PER_MICROSECOND 5
+#endif
+
+OneWireAsync::Transaction* volatile OneWireAsync::head = NULL;
+OneWireAsync::Transaction* OneWireAsync::tail = NULL;
+volatile OneWireAsync::Phase OneWireAsync::phase = OneWireAsync::PHASE_FINISH;
+uint16_t OneWireAsync::bitIndex = 0;
+
+#ifdef ARDUINO
+OneWireAsync::OneWireAsync(uint8_t pin)
+{
+	pinMode(pin, INPUT_PULLUP);
+	bitmask = PIN_TO_BITMASK(pin);
+	baseReg = PIN_TO_BASEREG(pin);
+}
+
+inline void OneWireAsync::pullLow()
+{
+	DIRECT_WRITE_LOW(baseReg, bitmask);
+	DIRECT_MODE_OUTPUT(baseReg, bitmask);
+}
+
+inline void OneWireAsync::release()
+{
+	DIRECT_MODE_INPUT(baseReg, bitmask);
+}
+
+inline uint8_t OneWireAsync::sample()
+{
+	return DIRECT_READ(baseReg, bitmask);
+}
+
+inline void OneWireAsync::shortDelay(uint8_t micros)
+{
+	// delayMicroseconds() may not be in IRAM, so count CPU cycles
+	uint32_t start, now;
+	__asm__ __volatile__("rsr %0, ccount" : "=a"(start));
+	do {
+		__asm__ __volatile__("rsr %0, ccount" : "=a"(now));
+	} while (now-start < uint32_t(micros)*(F_CPU/1000000));
+}
+#else
+OneWireAsync::OneWireAsync(OneWireLine* line) : line(line)
+{
+}
+
+inline void OneWireAsync::pullLow() { line->pullLow(); }
+inline void OneWireAsync::release() { line->release(); }
+inline uint8_t OneWireAsync::sample() { return line->sample(); }
+inline void OneWireAsync::shortDelay(uint8_t micros) { line->advance(micros); }
+#endif
+
+bool OneWireAsync::submit(Transaction& t)
+{
+	if (t.pending())
+		return false;
+	t.bus = this;
+	t.next = NULL;
+	if (!t.tx)
+		t.txLen = 0;
+	if (t.rx)
+		memset(t.rx, 0, t.rxLen);
+	else
+		t.rxLen = 0;
+
+	noInterrupts();
+	t.status = ONEWIRE_ASYNC_QUEUED;
+	bool start = !head;
+	if (start)
+		head = &t;
+	else
+		tail->next = &t;
+	tail = &t;
+	if (start)
+		begin();
+	interrupts();
+
+#ifdef ESP8266
+	if (start) {
+		// the first phase runs from the timer too, so interrupt context is the only place the line is touched
+		timer1_isr_init();
+		timer1_attachInterrupt(onTimer);
+		timer1_enable(TIM_DIV16, TIM_EDGE, TIM_SINGLE);
+		timer1_write(TIMER_TICKS_PER_MICROSECOND*START_DELAY);
+	}
+#endif
+	return true;
+}
+
+void OneWireAsync::cancel(Transaction& t)
+{
+	noInterrupts();
+	if (t.pending()) {
+		Transaction* volatile* link = &head;
+		Transaction* previous = NULL;
+		while (*link && *link!=&t) {
+			previous = *link;
+			link = &(*link)->next;
+		}
+		if (*link) {
+			*link = t.next;
+			if (tail==&t)
+				tail = previous;
+			if (t.status==ONEWIRE_ASYNC_BUSY) {
+				// the next transaction starts from the beginning when the timer fires, or the timer stops
+				t.bus->release();
+				if (head)
+					begin();
+			}
+		}
+		t.status = ONEWIRE_ASYNC_IDLE;
+	}
+	interrupts();
+}
+
+void OneWireAsync::wait(Transaction& t)
+{
+	while (t.pending()) {
+#ifdef ARDUINO
+		yield();
+#else
+		runStep();
+#endif
+	}
+}
+
+void OneWireAsync::waitIdle()
+{
+	while (head) {
+#ifdef ARDUINO
+		yield();
+#else
+		runStep();
+#endif
+	}
+}
+
+/*
+ * Puts the transaction at the head of the queue on the wire.
+ */
+void ICACHE_RAM_ATTR OneWireAsync::begin()
+{
+	Transaction* t = head;
+	t->status = ONEWIRE_ASYNC_BUSY;
+	bitIndex = 0;
+	phase = t->reset ? PHASE_RESET_LOW : (t->txLen+t->rxLen) ? PHASE_SLOT : PHASE_FINISH;
+}
+
+void ICACHE_RAM_ATTR OneWireAsync::nextBit(Transaction* t)
+{
+	bitIndex++;
+	if (bitIndex==uint16_t(t->txLen+t->rxLen)*8)
+		phase = PHASE_FINISH;
+	else
+		phase = PHASE_SLOT;
+}
+
+/*
+ * Completes the transaction at the head of the queue and starts the next.
+ * /return the microseconds until the next transaction starts, or 0 when the queue is empty.
+ */
+uint16_t ICACHE_RAM_ATTR OneWireAsync::finish(Status result)
+{
+	Transaction* t = head;
+	t->bus->release();
+	head = t->next;
+	if (!head)
+		tail = NULL;
+	// last, since the owner may submit the transaction again as soon as it sees the status
+	t->status = result;
+	if (!head)
+		return 0;
+	begin();
+	return START_DELAY;
+}
+
+/*
+ * Executes the next phase of the transaction on the wire.
+ * /return the number of microseconds until the following phase, or 0 when the queue is empty.
+ */
+uint16_t ICACHE_RAM_ATTR OneWireAsync::step()
+{
+	Transaction* t = head;
+	if (!t)
+		return 0;
+	OneWireAsync* bus = t->bus;
+	switch (phase) {
+		case PHASE_RESET_LOW:
+			bus->pullLow();
+			phase = PHASE_RESET_RELEASE;
+			return RESET_LOW_TIME;
+			
+		case PHASE_RESET_RELEASE:
+			bus->release();
+			phase = PHASE_RESET_SAMPLE;
+			return RESET_SAMPLE_TIME;
+			
+		case PHASE_RESET_SAMPLE:
+			if (bus->sample())
+				return finish(ONEWIRE_ASYNC_NO_PRESENCE);
+			phase = (t->txLen+t->rxLen) ? PHASE_SLOT : PHASE_FINISH;
+			return RESET_RECOVERY_TIME;
+			
+		case PHASE_SLOT: {
+			uint8_t byteIndex = bitIndex>>3;
+			uint8_t mask = 1<<(bitIndex&7);
+			if (byteIndex<t->txLen) {
+				if (t->tx[byteIndex] & mask) {
+					// the low pulse of a 1 is too short to hand back to the timer
+					noInterrupts();
+					bus->pullLow();
+					bus->shortDelay(WRITE1_LOW_TIME);
+					bus->release();
+					interrupts();
+					nextBit(t);
+					return WRITE1_RECOVERY_TIME;
+				}
+				bus->pullLow();
+				phase = PHASE_WRITE0_RELEASE;
+				return WRITE0_LOW_TIME;
+			}
+			// read slot
+			noInterrupts();
+			bus->pullLow();
+			bus->shortDelay(READ_LOW_TIME);
+			bus->release();
+			bus->shortDelay(READ_SAMPLE_TIME);
+			uint8_t bit = bus->sample();
+			interrupts();
+			if (bit)
+				t->rx[byteIndex-t->txLen] |= mask;
+			nextBit(t);
+			return READ_RECOVERY_TIME;
+		}
+		
+		case PHASE_WRITE0_RELEASE:
+			bus->release();
+			nextBit(t);
+			return WRITE0_RECOVERY_TIME;
+
+		case PHASE_FINISH:
+			return finish(ONEWIRE_ASYNC_DONE);
+	}
+	return 0;
+}
+
+#ifdef ESP8266
+void ICACHE_RAM_ATTR OneWireAsync::onTimer()
+{
+	uint16_t next = step();
+	if (next)
+		timer1_write(next*TIMER_TICKS_PER_MICROSECOND);
+	else
+		timer1_disable();
+}
+#endif
+
+#ifndef ARDUINO
+/*
+ * Runs one phase and lets the time until the next one pass on the line, as the timer would.
+ */
+void OneWireAsync::runStep()
+{
+	OneWireLine* line = head->bus->line;
+	uint16_t next = step();
+	if (next)
+		line->advance(next);
+}
+#endif
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#ifdef ARDUINO
+#include "OneWire.h"
+#else
+#include "OneWireLine.h"
+#endif
+
+/**
+ * A 1-Wire master that runs whole transactions (reset, bytes written, bytes read) in the background.
+ *
+ * Unlike OneWire, which busy-waits through every slot with interrupts masked, each slot is split into
+ * phases and the waits between phases are timed by a hardware timer (timer1 on the ESP8266). Interrupts
+ * are only masked for the few microseconds around the edge of a slot, so a 9 byte scratchpad read no
+ * longer takes ~5ms of CPU away from the main loop and the WiFi stack.
+ *
+ * Transactions are queued, and run one after another in the order they were submitted, across all instances
+ * since there is a single timer. Their owner polls the status - no user code runs in interrupt context, and
+ * everything the interrupt calls is kept in IRAM, so it is safe while the flash cache is off for SPIFFS writes.
+ * OneWire waits for the queue to empty before it uses the wire, so blocking and queued transactions can share a
+ * bus. Parasite power is not supported - the line is released (not driven high) between slots.
+ *
+ * On builds without hardware, the phases run against a OneWireLine, and the queue runs synchronously when it
+ * is waited on, so the same state machine can be exercised against a simulated bus.
+ */
+class OneWireAsync
+{
+public:
+	enum Status {
+		ONEWIRE_ASYNC_IDLE,			// not submitted, or cancelled
+		ONEWIRE_ASYNC_QUEUED,		// waiting for the transactions ahead of it
+		ONEWIRE_ASYNC_BUSY,			// on the wire
+		ONEWIRE_ASYNC_DONE,			// completed
+		ONEWIRE_ASYNC_NO_PRESENCE	// aborted because no device answered the reset
+	};
+
+	/**
+	 * An optional reset, then txLen bytes written, then rxLen bytes read into rx.
+	 * The transaction and its buffers belong to the caller, and must stay valid while it is pending.
+	 */
+	struct Transaction {
+		const uint8_t* tx;
+		uint8_t* rx;
+		uint8_t txLen;
+		uint8_t rxLen;
+		bool reset;
+		volatile Status status;
+		OneWireAsync* bus;
+		Transaction* next;
+
+		Transaction() : tx(NULL), rx(NULL), txLen(0), rxLen(0), reset(true), status(ONEWIRE_ASYNC_IDLE),
+			bus(NULL), next(NULL) { }
+		bool pending() const { return status==ONEWIRE_ASYNC_QUEUED || status==ONEWIRE_ASYNC_BUSY; }
+	};
+
+#ifdef ARDUINO
+	OneWireAsync(uint8_t pin);
+#else
+	OneWireAsync(OneWireLine* line);
+#endif
+
+	/*
+	 * Queues a transaction on this bus. The rx buffer is cleared.
+	 * /return false if the transaction is still pending.
+	 */
+	bool submit(Transaction& transaction);
+
+	/*
+	 * Takes a transaction out of the queue. A transaction on the wire is abandoned and the line released.
+	 */
+	static void cancel(Transaction& transaction);
+
+	/*
+	 * Waits until the transaction is no longer pending.
+	 */
+	static void wait(Transaction& transaction);
+
+	/*
+	 * Waits until all queued transactions have completed.
+	 */
+	static void waitIdle();
+	static bool idle() { return !head; }
+
+private:
+	enum Phase {
+		PHASE_RESET_LOW,
+		PHASE_RESET_RELEASE,
+		PHASE_RESET_SAMPLE,
+		PHASE_SLOT,
+		PHASE_WRITE0_RELEASE,
+		PHASE_FINISH
+	};
+
+	// the interrupt path
+	void pullLow() __attribute__((always_inline));
+	void release() __attribute__((always_inline));
+	uint8_t sample() __attribute__((always_inline));
+	void shortDelay(uint8_t micros) __attribute__((always_inline));
+	static uint16_t step();
+	static void begin();
+	static uint16_t finish(Status result);
+	static void nextBit(Transaction* t);
+
+#ifdef ARDUINO
+	IO_REG_TYPE bitmask;
+	volatile IO_REG_TYPE* baseReg;
+#else
+	OneWireLine* line;
+	static void runStep();
+#endif
+
+	// the queue, and the progress of the transaction at its head
+	static Transaction* volatile head;
+	static Transaction* tail;
+	static volatile Phase phase;
+	static uint16_t bitIndex;		// slots completed so far
+
+#ifdef ESP8266
+	static void onTimer();
+#endif
+};
+
+#endif
@@ -0,0 +1,43 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include <stdint.h>
+
+/**
+ * The electrical view of a 1-Wire bus, used in place of a GPIO pin on builds without hardware.
+ * The master either pulls the line low or releases it. Time on the line only moves forward when
+ * advance() is called, so a bus model sees exactly the slot timing the master produces.
+ */
+class OneWireLine
+{
+public:
+	virtual ~OneWireLine() {}
+
+	/* Drives the line low. */
+	virtual void pullLow() = 0;
+	
+	/* Stops driving the line. The pull-up raises it unless a device holds it low. */
+	virtual void release() = 0;
+	
+	/* Samples the line. Returns 1 when high. */
+	virtual uint8_t sample() = 0;
+	
+	/* Lets the given number of microseconds pass on the line. */
+	virtual void advance(uint16_t micros) = 0;
+};
@@ -27,10 +27,25 @@
 #include "Ticks.h"
 #include "TemperatureFormats.h"
 
+OneWireTempSensor* OneWireTempSensor::first = NULL;
+
 OneWireTempSensor::~OneWireTempSensor(){
+#if BREWPI_ONEWIRE_ASYNC
+	cancelQueued();
+#endif
 	delete sensor;
+	OneWireTempSensor** link = &first;
+	while (*link && *link!=this)
+		link = &(*link)->next;
+	if (*link)
+		*link = next;
 };
 
+static inline void incrementSaturated(uint16_t& counter) {
+	if (counter<UINT16_MAX)
+		counter++;
+}
+
 /**
  * Initializes the temperature sensor.
  * This method is called when the sensor is first created and also any time the sensor reports it's disconnected.
@@ -39,6 +54,16 @@ OneWireTempSensor::~OneWireTempSensor(){
  */
 bool OneWireTempSensor::init(){
 
+	// A sensor that keeps failing is retried with an increasing interval, so it doesn't
+	// hold up the bus (and the control loop) with a blocking init every second.
+	if (!connected && initBackoff && ticks.timeSince(lastInitAttempt)<initBackoff)
+		return false;
+	lastInitAttempt = ticks.seconds();
+	incrementSaturated(stats.reconnectAttempts);
+#if BREWPI_ONEWIRE_ASYNC
+	cancelQueued();		// init() talks to the sensor directly, and read() starts over afterwards
+#endif
+
 	// save address and pinNr for log messages
 	char addressString[17];
 	printBytes(sensorAddress, 8, addressString);
@@ -66,6 +91,10 @@ bool OneWireTempSensor::init(){
 		success = temp!=DEVICE_DISCONNECTED && requestConversion();
 	}	
 	setConnected(success);
+	if (success)
+		initBackoff = 0;
+	else
+		initBackoff = initBackoff ? min(initBackoff*2, ONEWIRE_TEMP_SENSOR_MAX_BACKOFF) : 1;
 	logDebug("init onewire sensor complete %d", success);
 	return success;
 }
@@ -100,7 +129,11 @@ temperature OneWireTempSensor::read(){
 	
 	if (!connected)
 		return TEMP_SENSOR_DISCONNECTED;
-	
+
+#if BREWPI_ONEWIRE_ASYNC
+	if (async)
+		return readQueued();
+#endif
 	temperature temp = readAndConstrainTemp();
 	requestConversion();
 	return temp;
@@ -108,13 +141,91 @@ temperature OneWireTempSensor::read(){
 
 temperature OneWireTempSensor::readAndConstrainTemp()
 {
-	temperature temp = sensor->getTempRaw(sensorAddress);
+	DallasTemperature::ReadStatus status;
+	ticks_micros_t start = ticks.micros();
+	temperature temp = sensor->getTempRaw(sensorAddress, status);
+	return constrainReading(temp, status, ticks.micros()-start);
+}
+
+/**
+ * Updates the stats and connected state for a reading, and converts a successful one to the temperature type.
+ * /param elapsed	microseconds the caller waited for the reading
+ */
+temperature OneWireTempSensor::constrainReading(temperature temp, DallasTemperature::ReadStatus status, ticks_micros_t elapsed)
+{
 	if(temp == DEVICE_DISCONNECTED){
+		incrementSaturated(status==DallasTemperature::READ_RESET_DETECTED ? stats.resets : stats.crcFailures);
 		setConnected(false);
 		return TEMP_SENSOR_DISCONNECTED;
 	}
 	
+	uint16_t latency = elapsed>UINT16_MAX ? UINT16_MAX : uint16_t(elapsed);
+	if (latency<stats.latencyMin)
+		stats.latencyMin = latency;
+	if (latency>stats.latencyMax)
+		stats.latencyMax = latency;
+	if (stats.reads==UINT16_MAX) {
+		// keep the average meaningful by halving the history
+		stats.reads /= 2;
+		stats.latencyTotal /= 2;
+	}
+	stats.reads++;
+	stats.latencyTotal += latency;
+	
 	const uint8_t shift = TEMP_FIXED_POINT_BITS-ONEWIRE_TEMP_SENSOR_PRECISION; // difference in precision between DS18B20 format and temperature adt
 	temp = constrainTemp(temp+calibrationOffset+(C_OFFSET>>shift), ((int) MIN_TEMP)>>shift, ((int) MAX_TEMP)>>shift)<<shift;
 	return temp;
 }
+
+#if BREWPI_ONEWIRE_ASYNC
+/**
+ * Returns the scratchpad read in the background since the previous call, and queues the next read and conversion.
+ * Readings are one call older than with the blocking read, but the caller only waits for the bus when the read
+ * has not finished yet, and the wire is driven from the timer interrupt rather than with interrupts masked.
+ */
+temperature OneWireTempSensor::readQueued()
+{
+	ticks_micros_t start = ticks.micros();
+	if (readTransaction.status==OneWireAsync::ONEWIRE_ASYNC_IDLE)
+		queueRead();		// the first read since init(), which started a conversion
+	OneWireAsync::wait(readTransaction);
+
+	DallasTemperature::ReadStatus status = DallasTemperature::READ_CRC_ERROR;
+	temperature temp = DEVICE_DISCONNECTED;
+	if (readTransaction.status==OneWireAsync::ONEWIRE_ASYNC_DONE)
+		temp = sensor->decodeScratchPad(sensorAddress, scratchPad, status);
+	temp = constrainReading(temp, status, ticks.micros()-start);
+	if (connected)
+		queueRead();
+	else
+		cancelQueued();
+	return temp;
+}
+
+void OneWireTempSensor::queueRead()
+{
+	readCommand[0] = convertCommand[0] = 0x55;	// match rom
+	memcpy(readCommand+1, sensorAddress, 8);
+	memcpy(convertCommand+1, sensorAddress, 8);
+	readCommand[9] = READSCRATCH;
+	convertCommand[9] = STARTCONVO;
+
+	readTransaction.tx = readCommand;
+	readTransaction.txLen = sizeof(readCommand);
+	readTransaction.rx = scratchPad;
+	readTransaction.rxLen = sizeof(scratchPad);
+	async->submit(readTransaction);
+
+	OneWireAsync::wait(convertTransaction);		// queued after the previous read, so it has normally finished
+	convertTransaction.tx = convertCommand;
+	convertTransaction.txLen = sizeof(convertCommand);
+	async->submit(convertTransaction);
+}
+
+void OneWireTempSensor::cancelQueued()
+{
+	OneWireAsync::cancel(readTransaction);
+	OneWireAsync::cancel(convertTransaction);
+	readTransaction.status = convertTransaction.status = OneWireAsync::ONEWIRE_ASYNC_IDLE;
+}
+#endif
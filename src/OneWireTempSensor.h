@@ -25,12 +25,33 @@
 #include "FastDigitalPin.h"
 #include "DallasTemperature.h"
 #include "Ticks.h"
+#if BREWPI_ONEWIRE_ASYNC
+#include "OneWireAsync.h"
+#endif
 
 class DallasTemperature;
 class OneWire;
+class OneWireAsync;
 
 #define ONEWIRE_TEMP_SENSOR_PRECISION (4)
 
+/**
+ * Health counters for a onewire temp sensor. All counters saturate rather than wrap.
+ */
+struct OneWireTempSensorStats {
+	uint16_t crcFailures;			// scratchpad reads with a bad CRC (a missing sensor also reads as a CRC failure)
+	uint16_t resets;				// power-on resets detected via the alarm register
+	uint16_t reconnectAttempts;		// calls to init() that went out on the bus
+	uint16_t reads;					// successful reads
+	uint16_t latencyMin;			// microseconds the caller waited for a scratchpad read
+	uint16_t latencyMax;
+	uint32_t latencyTotal;			// sum over all successful reads, for the average
+	
+	uint16_t latencyAvg() const {
+		return reads ? uint16_t(latencyTotal/reads) : 0;
+	}
+};
+
 class OneWireTempSensor : public BasicTempSensor {
 public:	
 	/**
@@ -39,12 +60,20 @@ public:
 	 * /param address	The onewire address for this sensor. If all bytes are 0 in the address, the first temp sensor
 	 *    on the bus is used.
 	 * /param calibration	A temperature value that is added to all readings. This can be used to calibrate the sensor.	 
+	 * /param async	The same bus, to read the sensor in the background with. When NULL, every read waits for the bus.
 	 */
-	OneWireTempSensor(OneWire* bus, DeviceAddress address, fixed4_4 calibrationOffset)
-	: oneWire(bus), sensor(NULL) {		
+	OneWireTempSensor(OneWire* bus, DeviceAddress address, fixed4_4 calibrationOffset, OneWireAsync* async=NULL)
+	: oneWire(bus), sensor(NULL), async(async) {		
 		connected = true;  // assume connected. Transition from connected to disconnected prints a message.
 		memcpy(sensorAddress, address, sizeof(DeviceAddress));
 		this->calibrationOffset = calibrationOffset;
+		memset(&stats, 0, sizeof(stats));
+		stats.latencyMin = UINT16_MAX;
+		initBackoff = 0;
+		lastInitAttempt = 0;
+		// register so the stats can be listed without going through the device manager
+		next = first;
+		first = this;
 	};
 	
 	~OneWireTempSensor();
@@ -56,6 +85,20 @@ public:
 	bool init();
 	temperature read();
 	
+	const OneWireTempSensorStats& getStats() { return stats; }
+	uint8_t* getAddress() { return sensorAddress; }
+	
+	/**
+	 * Seconds to wait after the last failed init() before the bus is tried again. 0 when connected.
+	 */
+	uint8_t getBackoff() { return initBackoff; }
+	
+	/**
+	 * Iterates over all sensors that currently exist, in reverse order of creation.
+	 */
+	static OneWireTempSensor* firstSensor() { return first; }
+	OneWireTempSensor* nextSensor() { return next; }
+	
 	private:
 
 	void setConnected(bool connected);
@@ -71,12 +114,34 @@ public:
 	 * updates lastRequestTime. On successful, leaves lastRequestTime alone and returns DEVICE_DISCONNECTED.
 	 */
 	temperature readAndConstrainTemp();
-	
+	temperature constrainReading(temperature temp, DallasTemperature::ReadStatus status, ticks_micros_t elapsed);
+
+#if BREWPI_ONEWIRE_ASYNC
+	temperature readQueued();
+	void queueRead();
+	void cancelQueued();
+
+	OneWireAsync::Transaction readTransaction;		// reset, match rom, read scratchpad
+	OneWireAsync::Transaction convertTransaction;	// reset, match rom, convert
+	uint8_t readCommand[10];
+	uint8_t convertCommand[10];
+	uint8_t scratchPad[9];
+#endif
+
 	OneWire * oneWire;
 	DallasTemperature * sensor;
+	OneWireAsync * async;
 	DeviceAddress sensorAddress;
 
 	fixed4_4 calibrationOffset;		
 	bool connected;
 	
+	OneWireTempSensorStats stats;
+	
+	// reinit backoff - doubled after every failed init() up to ONEWIRE_TEMP_SENSOR_MAX_BACKOFF
+	uint8_t initBackoff;
+	ticks_seconds_t lastInitAttempt;
+	
+	static OneWireTempSensor* first;
+	OneWireTempSensor* next;
 };
@@ -49,6 +49,25 @@
 #if BREWPI_SIMULATE
 #include "Simulator.h"
 #endif
+
+#include "RecentHistory.h"
+#include "StateTrace.h"
+#include "ActuatorMeter.h"
+#include "Forecast.h"
+#include "ChamberManager.h"
+#include "Scheduler.h"
+#include "BeerProfile.h"
+#include "Autotune.h"
+#include "ModelPredictive.h"
+
+#ifdef ARDUINO
+#include "OneWireTempSensor.h"
+#include "OneWireDevices.h"
+#endif
+#ifdef ESP8266
+#include "HistoryLog.h"
+#include "ConfigImage.h"
+#endif
 //#include <VM_DBG/VM_DBG.h>
  // Rename Serial to piStream, to abstract it for later platform independence
 
@@ -84,6 +103,8 @@ extern WiFiClient serverClient;
 #define piStream Serial
 #endif
 
+int readNext();
+
 bool PiLink::firstPair;
 char PiLink::printfBuff[PRINTF_BUFFER_SIZE];
 #ifdef BUFFER_PILINK_PRINTS
@@ -336,6 +357,48 @@ void PiLink::receive(void){
 			settingsManager.loadSettings();
 			break;
 
+		case '@': // select the chamber the other commands work on, as @1 to @BREWPI_CHAMBERS
+			inByte = readNext();
+			if (!chamberManager.switchChamber(inByte-'1'))
+				logWarningInt(WARNING_INVALID_COMMAND, inByte);
+			break;
+
+		case 'B': // the beers in the current chamber, after setting one if given, e.g. B{"beer":2,"beerSet":18.5}
+			sendBeers();
+			break;
+
+		case 'P': // the beer profile stored for the chamber, after replacing it if given, e.g. P[[0,18.0],[4320,18.0],[5760,21.0]]
+			receiveBeerProfile();
+			break;
+
+		case 'k': // autotune progress and proposed constants, applied to the tuned chamber with k{"apply":1} or dropped with k{"discard":1}. Started by setting mode 'a'
+			sendAutotune();
+			break;
+
+		case 'm': // the learned model of the chamber, and the action the model predictive mode 'm' has chosen
+			sendChamberModel();
+			break;
+
+		case 'r': // recent control ticks, e.g. r{"n":60} for the last minute or r{"from":1234}, of the first chamber
+			sendRecentHistory();
+			break;
+
+		case 'g': // recent fridge state transitions of all chambers, optionally g{"from":seq,"n":count}
+			sendStateTrace();
+			break;
+
+		case 'u': // start and run time counters of the cooler and heater, cleared with u{"reset":1}
+			sendActuatorStats();
+			break;
+
+		case 'o': // forecast of the beer reaching its setting and the heater and cooler time, e.g. o{"hours":24}
+			sendForecast();
+			break;
+
+		case 'T': // main loop task timing, answered with W as T is the temperatures response
+			sendTaskStats();
+			break;
+
 		case 'd': // list devices in eeprom order
 			openListResponse('d');
 			deviceManager.listDevices();
@@ -354,7 +417,29 @@ void PiLink::receive(void){
 			closeListResponse();
 			break;
 
+#ifdef ARDUINO
+		case 'H': // onewire sensor health statistics
+			sendSensorStats();
+			break;
+#endif
+
 #ifdef ESP8266
+		case 'F': // settings log (flash) statistics
+			sendSettingsLogStats();
+			break;
+
+		case 'q': // query the flash history, e.g. q{"from":1200,"to":1300} or q{"since":3600,"until":7200}, of the first chamber
+			sendHistory();
+			break;
+
+		case 'x': // export the whole configuration as one base64 image
+			sendConfigImage();
+			break;
+
+		case 'i': // import a configuration image, as i"<base64>"
+			receiveConfigImage();
+			break;
+
 		case 'w': // Reset WiFi settings
 			WiFi.disconnect(true);
 			break;
@@ -397,9 +482,9 @@ void PiLink::receive(void){
 	temperature beerTemp = -1, beerSet = -1, fridgeTemp = -1, fridgeSet = -1;
 	double roomTemp = -1;
 	uint8_t state = 0xFF;
-	char* beerAnn; char* fridgeAnn;
+	const char* beerAnn; const char* fridgeAnn;
 	
-	typedef char* PChar;
+	typedef const char* PChar;
 	inline bool changed(uint8_t &a, uint8_t b) { uint8_t c = a; a=b; return b!=c; }
 	inline bool changed(temperature &a, temperature b) { temperature c = a; a=b; return b!=c; }
 	inline bool changed(double &a, double b) { double c = a; a=b; return b!=c; }
@@ -473,6 +558,15 @@ void PiLink::sendJsonTemp(const char* name, temperature temp)
 	print(tempString);
 }
 
+void PiLink::sendJsonFixed16(const char* name, int32_t val)
+{
+	uint32_t magnitude = val<0 ? -int64_t(val) : val;
+	uint32_t fraction = ((magnitude & 0xFFFF)*10000UL + 0x8000) >> 16;
+	uint32_t whole = (magnitude >> 16) + fraction/10000;
+	printJsonName(name);
+	print_P(PSTR("%s%lu.%04lu"), val<0 ? "-" : "", (unsigned long)whole, (unsigned long)(fraction%10000));
+}
+
 void PiLink::printTemperatures(void){
 	// print all temperatures with empty annotations
 	printTemperaturesJSON(0, 0);
@@ -552,6 +646,568 @@ void PiLink::sendControlSettings(void){
 	sendJsonClose();
 }
 
+#ifdef ARDUINO
+/**
+ * Lists the health counters of all onewire temp sensors, one object per sensor.
+ */
+void PiLink::sendSensorStats() {
+	openListResponse('H');
+	char addressString[17];
+	bool firstSensor = true;
+	for (OneWireTempSensor* sensor = OneWireTempSensor::firstSensor(); sensor; sensor = sensor->nextSensor()) {
+		if (!firstSensor)
+			print(',');
+		firstSensor = false;
+		firstPair = true;
+		const OneWireTempSensorStats& stats = sensor->getStats();
+		printBytes(sensor->getAddress(), 8, addressString);
+		printJsonName(JSONKEY_address);
+		print_P(PSTR("\"%s\""), addressString);
+		sendJsonPair(JSONKEY_connected, uint8_t(sensor->isConnected()));
+		sendJsonPair(JSONKEY_crcFailures, stats.crcFailures);
+		sendJsonPair(JSONKEY_resets, stats.resets);
+		sendJsonPair(JSONKEY_reconnectAttempts, stats.reconnectAttempts);
+		sendJsonPair(JSONKEY_backoff, sensor->getBackoff());
+		sendJsonPair(JSONKEY_reads, stats.reads);
+		sendJsonPair(JSONKEY_latencyMin, stats.reads ? stats.latencyMin : uint16_t(0));
+		sendJsonPair(JSONKEY_latencyAvg, stats.latencyAvg());
+		sendJsonPair(JSONKEY_latencyMax, stats.latencyMax);
+		print('}');
+	}
+	closeListResponse();
+}
+#endif
+
+#ifdef ESP8266
+/**
+ * Reports how the settings log is using its flash file.
+ */
+void PiLink::sendSettingsLogStats() {
+	const SettingsLogStats& stats = settingsLog.getStats();
+	printResponse('F');
+	sendJsonPair(JSONKEY_logSize, uint16_t(SETTINGS_LOG_SIZE));
+	sendJsonPair(JSONKEY_logUsed, stats.used);
+	sendJsonPair(JSONKEY_logLive, stats.live);
+	sendJsonPair(JSONKEY_logCompactions, stats.compactions);
+	sendJsonPair(JSONKEY_logAppends, stats.appends);
+	sendJsonPair(JSONKEY_logSkipped, stats.skipped);
+	sendJsonPair(JSONKEY_logBytesWritten, stats.bytesWritten);
+	sendJsonPair(JSONKEY_crcFailures, stats.crcErrors);
+	sendJsonClose();
+}
+#endif
+
+struct RecentHistoryRange {
+	uint32_t from;
+	uint16_t n;
+};
+
+void HandleRecentHistoryRange(const char* key, const char* val, void* pv)
+{
+	RecentHistoryRange& range = *(RecentHistoryRange*)pv;
+	if (strcmp_P(key, JSONKEY_from)==0)
+		range.from = strtoul(val, NULL, 10);
+	else if (strcmp_P(key, JSONKEY_count)==0)
+		range.n = atoi(val);
+}
+
+/**
+ * Sends the recent control ticks from the RAM history as one list.
+ * Each tick is [seq,beerTemp,fridgeTemp,beerSlope,p,i,d,state,outputs].
+ */
+void PiLink::sendRecentHistory() {
+	RecentHistoryRange range = { 0, RECENT_HISTORY_TICKS };
+	parseJsonIfGiven(HandleRecentHistoryRange, &range);
+
+	uint32_t end = recentHistory.next();
+	uint32_t start = end>range.n ? end-range.n : 0;
+	start = max(start, max(range.from, recentHistory.oldest()));
+
+	char buf[12];
+	openListResponse('r');
+	for (uint32_t seq=start; seq<end; seq++) {
+		const TickRecord& r = recentHistory.get(seq);
+		if (seq!=start)
+			print(',');
+		print_P(PSTR("[%lu"), (unsigned long)seq);
+		print_P(PSTR(",%s"), tempToString(buf, r.beerTemp, 2, 12));
+		print_P(PSTR(",%s"), tempToString(buf, r.fridgeTemp, 2, 12));
+		print_P(PSTR(",%s"), tempDiffToString(buf, r.beerSlope, 3, 12));
+		print_P(PSTR(",%s"), fixedPointToString(buf, r.p, 3, 12));
+		print_P(PSTR(",%s"), fixedPointToString(buf, r.i, 3, 12));
+		print_P(PSTR(",%s"), fixedPointToString(buf, r.d, 3, 12));
+		print_P(PSTR(",%u,%u]"), r.state, r.outputs);
+#ifdef ESP8266
+		yield();
+#endif
+	}
+	closeListResponse();
+}
+
+/**
+ * Sends the recent fridge state transitions as one list, oldest first.
+ * Each is [seq,time,chamber,from,to,rule,fridgeTemp,fridgeSet,beerTemp,beerSet], where rule is the index of the
+ * rule in the state table of TempControl that made the transition.
+ */
+void PiLink::sendStateTrace() {
+	RecentHistoryRange range = { 0, STATE_TRACE_SIZE };
+	parseJsonIfGiven(HandleRecentHistoryRange, &range);
+
+	uint32_t end = stateTrace.next();
+	uint32_t start = end>range.n ? end-range.n : 0;
+	start = max(start, max(range.from, stateTrace.oldest()));
+
+	char buf[12];
+	openListResponse('G');
+	for (uint32_t seq=start; seq<end; seq++) {
+		const StateTransition& t = stateTrace.get(seq);
+		if (seq!=start)
+			print(',');
+		print_P(PSTR("[%lu,%lu"), (unsigned long)seq, (unsigned long)t.time);
+		print_P(PSTR(",%u,%u,%u,%u"), t.chamber, t.from, t.to, t.rule);
+		print_P(PSTR(",%s"), tempToString(buf, t.fridgeTemp, 2, 12));
+		print_P(PSTR(",%s"), tempToString(buf, t.fridgeSetting, 2, 12));
+		print_P(PSTR(",%s"), tempToString(buf, t.beerTemp, 2, 12));
+		print_P(PSTR(",%s]"), tempToString(buf, t.beerSetting, 2, 12));
+	}
+	closeListResponse();
+}
+
+void HandleActuatorStatsReset(const char* key, const char* val, void* pv)
+{
+	if (strcmp_P(key, JSONKEY_reset)==0)
+		*(bool*)pv = atoi(val)!=0;
+}
+
+/**
+ * Lists the wear counters of the cooler and heater of the current chamber, after clearing them if asked to.
+ * The duty is in percent, the on time in seconds, and runs counts the runs by length, as in ActuatorStats.
+ */
+void PiLink::sendActuatorStats() {
+	bool reset = false;
+	parseJsonIfGiven(HandleActuatorStatsReset, &reset);
+	if (reset)
+		actuatorMeter.reset();
+
+	openListResponse('u');
+	for (uint8_t i=0; i<METERED_OUTPUTS; i++) {
+		const ActuatorStats& stats = actuatorMeter.get(i);
+		uint64_t total = uint64_t(stats.onSeconds)+stats.offSeconds;
+		if (i)
+			print(',');
+		firstPair = true;
+		sendJsonPair(JSONKEY_output, i==METERED_COOLER ? 'c' : 'h');
+		sendJsonPair(JSONKEY_starts, stats.starts);
+		sendJsonPair(JSONKEY_startsLastHour, actuatorMeter.startsLastHour(i));
+		sendJsonPair(JSONKEY_onTime, stats.onSeconds);
+		sendJsonPair(JSONKEY_duty, uint8_t(total ? uint64_t(stats.onSeconds)*100/total : 0));
+		sendJsonPair(JSONKEY_dutyLastHour, uint8_t(uint32_t(actuatorMeter.onLastHour(i))*100/3600));
+		sendJsonPair(JSONKEY_minOffTime, stats.minOffTime);
+		printJsonName(JSONKEY_runs);
+		for (uint8_t bin=0; bin<ActuatorStats::RUN_BINS; bin++)
+			print_P(PSTR("%c%u"), bin ? ',' : '[', stats.runs[bin]);
+		print_P(PSTR("]}"));
+	}
+	closeListResponse();
+}
+
+void HandleForecastHours(const char* key, const char* val, void* pv)
+{
+	if (strcmp_P(key, JSONKEY_hours)==0)
+		*(uint16_t*)pv = atoi(val);
+}
+
+void PiLink::sendTemperatureList(const char* name, const temperature* temps, uint8_t count) {
+	char buf[12];
+	printJsonName(name);
+	print('[');
+	for (uint8_t i=0; i<count; i++)
+		print_P(PSTR("%s%s"), i ? "," : "", tempToString(buf, temps[i], 2, 12));
+	print(']');
+}
+
+/**
+ * Forecasts the current chamber from the learned model, without changing the live controller, for hours up to
+ * FORECAST_MAX_HOURS. reach is the minutes until the beer reaches its setting, or null if it doesn't within the
+ * forecast. The heater and cooler times are in
+ * minutes, and the beer and fridge temperatures are given every interval minutes.
+ */
+void PiLink::sendForecast() {
+	uint16_t hours = FORECAST_HOURS;
+	parseJsonIfGiven(HandleForecastHours, &hours);
+	hours = constrain(hours, 1, FORECAST_MAX_HOURS);
+	uint16_t steps = uint16_t(min(uint32_t(hours)*3600/MODEL_STEP, uint32_t(UINT16_MAX)));
+
+	ForecastStart start;
+	printResponse('O');
+	if (!Forecast::capture(start)) {
+		sendJsonPair(JSONKEY_result, uint8_t(1));
+		sendJsonClose();
+		return;
+	}
+	ForecastResult result;
+	ticks_micros_t began = ticks.micros();
+	Forecast::run(start, chamberModel.get(), tempControl.cc, steps, result);
+	ticks_micros_t took = ticks.micros()-began;
+
+	sendJsonPair(JSONKEY_result, uint8_t(0));
+	sendJsonPair(JSONKEY_hours, hours);
+	sendJsonPair(JSONKEY_samples, chamberModel.get().samples);
+	sendJsonTemp(JSONKEY_beerSetting, start.beerSetting);
+	if (result.reached==UINT16_MAX)
+		sendJsonPair(JSONKEY_reach, PSTR("null"));
+	else
+		sendJsonPair(JSONKEY_reach, uint32_t(result.reached)*MODEL_STEP/60);
+	sendJsonPair(JSONKEY_heatTime, uint32_t(result.heatSteps)*MODEL_STEP/60);
+	sendJsonPair(JSONKEY_coolTime, uint32_t(result.coolSteps)*MODEL_STEP/60);
+	sendJsonPair(JSONKEY_interval, uint32_t(result.interval)*MODEL_STEP/60);
+	sendTemperatureList(JSONKEY_beer, result.beer, result.points);
+	sendTemperatureList(JSONKEY_fridge, result.fridge, result.points);
+	sendJsonPair(JSONKEY_calcTime, uint32_t(took));
+	sendJsonClose();
+}
+
+struct BeerUpdate {
+	uint8_t beer;
+	temperature setting;
+	bool settingGiven;		// a beer can be named without changing its setting
+};
+
+void HandleBeerUpdate(const char* key, const char* val, void* pv)
+{
+	BeerUpdate& update = *(BeerUpdate*)pv;
+	if (strcmp_P(key, JSONKEY_beer)==0)
+		update.beer = atoi(val);
+	else if (strcmp_P(key, JSONKEY_beerSetting)==0) {
+		update.setting = strcmp_P(val, PSTR("null"))==0 ? INVALID_TEMP : stringToTemp(val);
+		update.settingGiven = true;
+	}
+}
+
+/**
+ * Applies a new beer setting if one is given, and lists the beers of the current chamber: their temperature,
+ * setting, the fridge setting each asks for, and their own outputs. The first beer's setting is the chamber's.
+ */
+void PiLink::sendBeers() {
+	BeerUpdate update = { 0, INVALID_TEMP, false };
+	parseJsonIfGiven(HandleBeerUpdate, &update);
+	if (update.settingGiven) {
+		if (update.beer==1)
+			tempControl.setBeerTemp(update.setting);
+		else if (update.beer>1 && update.beer<=BREWPI_BEERS) {
+			tempControl.beers[update.beer-1].cs.beerSetting = update.setting;
+			eepromManager.storeBeerSettings(update.beer-1);
+		}
+	}
+
+	openListResponse('B');
+	for (uint8_t i=0; i<BREWPI_BEERS; i++) {
+		const BeerControl& beer = tempControl.beers[i];
+		if (i)
+			print(',');
+		firstPair = true;
+		sendJsonPair(JSONKEY_beer, uint8_t(i+1));
+		sendJsonTemp(JSONKEY_beerTemp, beer.sensor->isConnected() ? beer.sensor->readFastFiltered() : INVALID_TEMP);
+		sendJsonTemp(JSONKEY_beerSetting, tempControl.getBeerSetting(i));
+		sendJsonTemp(JSONKEY_fridgeDemand, beer.fridgeDemand);
+		sendJsonPair(JSONKEY_heat, uint8_t(beer.heater->isActive()));
+		sendJsonPair(JSONKEY_cool, uint8_t(beer.cooler->isActive()));
+		sendJsonPair(JSONKEY_lead, uint8_t(i==tempControl.getLeadBeer()));
+		print('}');
+	}
+	closeListResponse();
+}
+
+/**
+ * Lists the timing counters of the scheduled main loop tasks, one object per task.
+ */
+void PiLink::sendTaskStats() {
+	openListResponse('W');
+	bool firstTask = true;
+	for (uint8_t i=0; i<scheduler.capacity(); i++) {
+		const char* name = scheduler.name(i);
+		if (!name)
+			continue;
+		if (!firstTask)
+			print(',');
+		firstTask = false;
+		firstPair = true;
+		const TaskStats& stats = scheduler.stats(i);
+		printJsonName(JSONKEY_task);
+		print_P(PSTR("\"%s\""), name);
+		sendJsonPair(JSONKEY_runs, stats.runs);
+		sendJsonPair(JSONKEY_misses, stats.misses);
+		sendJsonPair(JSONKEY_latenessMax, stats.latenessMax);
+		sendJsonPair(JSONKEY_durationMax, stats.durationMax);
+		print('}');
+	}
+	closeListResponse();
+}
+
+/**
+ * Reads a profile as a list of [minutes, temperature] points up to the end of the line, where the temperatures are
+ * in the current format. Any character other than a number separates values, so the list can be sent as JSON.
+ * The profile is replaced, and restarted, only if the whole list is valid.
+ */
+void PiLink::receiveBeerProfile() {
+	int c = readNext();
+	bool replace = c=='[';
+	bool valid = true;
+	ProfilePoint points[BeerProfileRecord::MAX_POINTS];
+	uint8_t count = 0;
+	uint8_t values = 0;
+	char number[12];
+	uint8_t length = 0;
+	while (replace) {
+		c = readNext();
+		if ((c>='0' && c<='9') || c=='.' || c=='-') {
+			if (length<sizeof(number)-1)
+				number[length++] = c;
+			else
+				valid = false;
+			continue;
+		}
+		if (length) {
+			number[length] = 0;
+			length = 0;
+			if (count==BeerProfileRecord::MAX_POINTS)
+				valid = false;
+			else if (values++ & 1)
+				points[count++].temp = stringToTemp(number);
+			else {
+				long minutes = atol(number);
+				valid &= minutes>=0 && minutes<=UINT16_MAX;
+				points[count].minutes = minutes;
+			}
+		}
+		if (c==-1 || c=='\n' || c=='\r')
+			break;
+	}
+
+	printResponse('P');
+	if (replace) {
+		// a temperature missing from the last point makes the list invalid too
+		bool ok = valid && !(values & 1) && beerProfile.set(points, count);
+		sendJsonPair(JSONKEY_result, uint8_t(ok ? 0 : 1));
+	}
+	sendJsonPair(JSONKEY_elapsed, beerProfile.elapsed());
+	sendJsonTemp(JSONKEY_beerSetting, beerProfile.setting());
+	printJsonName(JSONKEY_points);
+	print('[');
+	for (uint8_t i=0; i<beerProfile.count(); i++) {
+		char temp[9];
+		const ProfilePoint& point = beerProfile.point(i);
+		tempToString(temp, point.temp, 2, 9);
+		print_P(PSTR("%s[%u,%s]"), i ? "," : "", point.minutes, temp);
+	}
+	print(']');
+	sendJsonClose();
+}
+
+struct AutotuneRequest {
+	bool apply;
+	bool discard;
+};
+
+void HandleAutotuneRequest(const char* key, const char* val, void* pv)
+{
+	AutotuneRequest& request = *(AutotuneRequest*)pv;
+	if (strcmp_P(key, JSONKEY_apply)==0)
+		request.apply = atoi(val)!=0;
+	else if (strcmp_P(key, JSONKEY_discard)==0)
+		request.discard = atoi(val)!=0;
+}
+
+/**
+ * Reports the autotune run, and the constants it proposes once done. The proposal only replaces the Kp, Ki and
+ * Kd of the tuned chamber when applied with that chamber selected. Until it is applied or discarded, no other
+ * chamber is tuned.
+ */
+void PiLink::sendAutotune() {
+	AutotuneRequest request = { false, false };
+	parseJsonIfGiven(HandleAutotuneRequest, &request);
+	if (request.apply && pidAutotune.apply(tempControl.cc))
+		eepromManager.storeTempConstantsAndSettings();
+	else if (request.discard)
+		pidAutotune.discard();
+	AutotuneStatus status = pidAutotune.getStatus();
+	const ControlConstants& proposal = pidAutotune.getProposal();
+
+	char buf[12];
+	printResponse('K');
+	sendJsonPair(JSONKEY_status, uint8_t(status));
+	sendJsonPair(JSONKEY_cycles, pidAutotune.getCycles());
+	if (status!=AUTOTUNE_IDLE)
+		sendJsonPair(JSONKEY_chamber, uint8_t(pidAutotune.getChamber()+1));
+	if (status==AUTOTUNE_DONE)
+		sendJsonPair(JSONKEY_pending, uint8_t(pidAutotune.isPending()));
+	if (status==AUTOTUNE_DONE) {
+		sendJsonPair(JSONKEY_ultimateGain, fixedPointToString(buf, pidAutotune.getUltimateGain(), 3, 12));
+		sendJsonPair(JSONKEY_ultimatePeriod, pidAutotune.getUltimatePeriod());
+		sendJsonPair(JSONKEY_Kp, fixedPointToString(buf, proposal.Kp, 3, 12));
+		sendJsonPair(JSONKEY_Ki, fixedPointToString(buf, proposal.Ki, 3, 12));
+		sendJsonPair(JSONKEY_Kd, fixedPointToString(buf, proposal.Kd, 3, 12));
+	}
+	sendJsonClose();
+}
+
+/**
+ * Reports the model learned for the current chamber. The coefficients are per model step of MODEL_STEP seconds.
+ */
+void PiLink::sendChamberModel() {
+	const ThermalModel& model = chamberModel.get();
+	printResponse('M');
+	sendJsonPair(JSONKEY_samples, model.samples);
+	sendJsonTemp(JSONKEY_fridgeError, model.fridgeError);
+	sendJsonTemp(JSONKEY_beerError, model.beerError);
+	sendJsonFixed16(JSONKEY_kBeer, model.fridge[ThermalModel::FRIDGE_BEER]);
+	sendJsonFixed16(JSONKEY_kRoom, model.fridge[ThermalModel::FRIDGE_ROOM]);
+	sendJsonFixed16(JSONKEY_heatRate, model.fridge[ThermalModel::FRIDGE_HEAT]);
+	sendJsonFixed16(JSONKEY_coolRate, model.fridge[ThermalModel::FRIDGE_COOL]);
+	sendJsonFixed16(JSONKEY_kFridge, model.beer[ThermalModel::BEER_FRIDGE]);
+	sendJsonFixed16(JSONKEY_ferment, model.beer[ThermalModel::BEER_FERMENT]);
+	sendJsonPair(JSONKEY_action, uint8_t(modelPredictiveControl.getAction()));
+	sendJsonPair(JSONKEY_pulse, modelPredictiveControl.getPulse());
+	sendJsonClose();
+}
+
+#ifdef ESP8266
+struct HistoryRange {
+	uint32_t from;
+	uint32_t to;
+	uint16_t boot;
+	uint32_t since;
+	uint32_t until;
+	bool byTime;
+};
+
+void HandleHistoryRange(const char* key, const char* val, void* pv)
+{
+	HistoryRange& range = *(HistoryRange*)pv;
+	if (strcmp_P(key, JSONKEY_from)==0)
+		range.from = strtoul(val, NULL, 10);
+	else if (strcmp_P(key, JSONKEY_to)==0)
+		range.to = strtoul(val, NULL, 10);
+	else if (strcmp_P(key, JSONKEY_boot)==0) {
+		range.boot = atoi(val);
+		range.byTime = true;
+	}
+	else if (strcmp_P(key, JSONKEY_since)==0) {
+		range.since = strtoul(val, NULL, 10);
+		range.byTime = true;
+	}
+	else if (strcmp_P(key, JSONKEY_until)==0) {
+		range.until = strtoul(val, NULL, 10);
+		range.byTime = true;
+	}
+}
+
+/**
+ * Streams the stored history samples as one list, either in a range of sequence numbers (from, to), or taken in a
+ * range of time (since, until). There is no wall clock, so time is in seconds since the start of a boot, the current
+ * one unless boot is given.
+ * Each sample is [seq,boot,time,beerTemp,beerSet,fridgeTemp,fridgeSet,roomTemp,state,mode].
+ */
+void PiLink::sendHistory() {
+	HistoryRange range = { 0, 0xFFFFFFFFUL, historyLog.currentBoot(), 0, 0xFFFFFFFFUL, false };
+	parseJsonIfGiven(HandleHistoryRange, &range);
+	bool first = true;
+	openListResponse('q');
+	if (range.byTime)
+		historyLog.forEachInTime(range.boot, range.since, range.until, printHistorySample, &first);
+	else
+		historyLog.forEach(range.from, range.to, printHistorySample, &first);
+	closeListResponse();
+}
+
+void PiLink::printHistorySample(uint32_t seq, uint16_t boot, uint32_t time, const HistorySample& sample, void* data) {
+	bool& first = *(bool*)data;
+	if (!first)
+		print(',');
+	first = false;
+	print_P(PSTR("[%lu,%u,%lu"), (unsigned long)seq, boot, (unsigned long)time);
+	char tempString[12];
+	const temperature* temps = &sample.beerTemp;
+	for (uint8_t i=0; i<5; i++)
+		print_P(PSTR(",%s"), tempToString(tempString, temps[i], 2, 12));
+	print_P(PSTR(",%u,"), sample.state);
+	if (sample.mode)
+		print_P(PSTR("\"%c\"]"), sample.mode);
+	else
+		print_P(PSTR("null]"));
+	yield();	// a long range takes a while to send, keep WiFi serviced
+}
+
+static const char base64Chars[] PROGMEM = "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789+/";
+
+static int8_t base64Value(char c)
+{
+	if (c>='A' && c<='Z') return c-'A';
+	if (c>='a' && c<='z') return c-'a'+26;
+	if (c>='0' && c<='9') return c-'0'+52;
+	if (c=='+') return 62;
+	if (c=='/') return 63;
+	return -1;
+}
+
+// too large for the stack, and only one image is handled at a time
+static uint8_t image[CONFIG_IMAGE_MAX];
+
+void PiLink::sendConfigImage() {
+	uint16_t length = ConfigImage::build(image, sizeof(image));
+	printResponse('X');
+	print('"');
+	for (uint16_t i=0; i<length; i+=3) {
+		uint32_t group = uint32_t(image[i])<<16;
+		if (i+1<length) group |= uint16_t(image[i+1])<<8;
+		if (i+2<length) group |= image[i+2];
+		for (uint8_t j=0; j<4; j++)
+			print(i+j<=length ? char(pgm_read_byte(base64Chars + ((group>>(18-6*j)) & 0x3F))) : '=');
+	}
+	print('"');
+	printNewLine();
+}
+
+void PiLink::receiveConfigImage() {
+	uint16_t length = 0;
+	uint32_t group = 0;
+	uint8_t bits = 0;
+	ConfigImageResult result = CONFIG_IMAGE_OK;
+	// read up to the end of the line even after an error, so the rest of the image is not taken as commands
+	for (;;) {
+		int c = readNext();
+		if (c==-1 || c=='\n' || c=='\r' || (c=='"' && (length || bits)))
+			break;
+		if (c=='"' || c==' ' || c=='=' || result!=CONFIG_IMAGE_OK)
+			continue;
+		int8_t value = base64Value(c);
+		if (value<0) {
+			result = CONFIG_IMAGE_BAD_ENCODING;
+			continue;
+		}
+		group = (group<<6) | value;
+		bits += 6;
+		if (bits>=8) {
+			bits -= 8;
+			if (length==sizeof(image))
+				result = CONFIG_IMAGE_TOO_LARGE;
+			else
+				image[length++] = group>>bits;
+		}
+	}
+	if (result==CONFIG_IMAGE_OK)
+		result = ConfigImage::apply(image, length);
+
+	printResponse('I');
+	sendJsonPair(JSONKEY_result, uint8_t(result));
+	sendJsonClose();
+	if (result==CONFIG_IMAGE_OK) {
+		sendControlSettings();
+		sendControlConstants();
+	}
+}
+#endif
+
 // where the offset is relative to. This saves having to store a full 16-bit pointer.
 // becasue the structs are static, we can only compute an offset relative to the struct (cc,cs,cv etc..)
 // rather than offset from tempControl. 
@@ -715,11 +1371,19 @@ void PiLink::sendJsonPair(const char * name, uint16_t val){
 	print_P(PSTR("%u"), val);
 }
 
+void PiLink::sendJsonPair(const char * name, uint32_t val){
+	printJsonName(name);
+	print_P(PSTR("%lu"), (unsigned long)val);
+}
+
 void PiLink::sendJsonPair(const char * name, uint8_t val) {
 	sendJsonPair(name, (uint16_t)val);
 }
 
-int readNext()
+/**
+ * Waits briefly for the next character. Returns false if none arrives.
+ */
+static bool waitNext()
 {
 	uint8_t retries = 0;
 	while (piStream.available()==0) {
@@ -727,15 +1391,22 @@ int readNext()
 		// changing to delay as delayMicroseconds doesn't yield like delay does
 		delay(1);
 		yield();
-#else
+#elif defined(ARDUINO)
 		_delay_us(100);
+#else
+		delayMicroseconds(100);
 #endif
 		retries++;
 		if (retries >= 10) {
-			return -1;
+			return false;
 		}
 	}
-	return piLink.read();		
+	return true;
+}
+
+int readNext()
+{
+	return waitNext() ? piLink.read() : -1;
 }
 /**
  * Parses a token from the piStream.
@@ -785,6 +1456,14 @@ void PiLink::parseJson(ParseJsonCallback fn, void* data)
 	} while (next);
 }
 
+bool PiLink::parseJsonIfGiven(ParseJsonCallback fn, void* data)
+{
+	if (!waitNext() || piStream.peek()!='{')
+		return false;
+	parseJson(fn, data);
+	return true;
+}
+
 void PiLink::receiveJson(void){
 
 	parseJson(&processJsonPair, NULL);	
@@ -30,6 +30,7 @@
 #define PRINTF_BUFFER_SIZE 128
 
 class DeviceConfig;
+struct HistorySample;
 
 
 class PiLink{
@@ -51,6 +52,11 @@ class PiLink{
 	typedef void (*ParseJsonCallback)(const char* key, const char* val, void* data);
 
 	static void parseJson(ParseJsonCallback fn, void* data=NULL);
+	/**
+	 * Parses the JSON object that follows a command, if there is one. Commands whose arguments are optional use this,
+	 * so their bare form doesn't log a missing bracket or swallow the end of the line.
+	 */
+	static bool parseJsonIfGiven(ParseJsonCallback fn, void* data=NULL);
 
 	static int read(void);  // Adding so we can completely abstract away piStream outside of piLink
 
@@ -60,17 +66,35 @@ class PiLink{
 	static void receiveControlConstants(void);
 	static void sendControlConstants(void);
 	static void sendControlVariables(void);
+#ifdef ARDUINO
+	static void sendSensorStats(void);
+#endif
+	static void sendRecentHistory(void);
+	static void sendStateTrace(void);
+	static void sendActuatorStats(void);
+	static void sendForecast(void);
+	static void sendTemperatureList(const char* name, const temperature* temps, uint8_t count);
+	static void sendBeers(void);
+	static void sendTaskStats(void);
+	static void receiveBeerProfile(void);
+	static void sendAutotune(void);
+	static void sendChamberModel(void);
+#ifdef ESP8266
+	static void sendSettingsLogStats(void);
+	static void sendHistory(void);
+	static void printHistorySample(uint32_t seq, uint16_t boot, uint32_t time, const HistorySample& sample, void* data);
+	static void sendConfigImage(void);
+	static void receiveConfigImage(void);
+#endif
 	
 	static void receiveJson(void); // receive settings as JSON key:value pairs
 	
 	static void print(char *fmt, ...); // use when format string is stored in RAM
-#ifdef ARDUINO
+#if defined(ARDUINO) && !defined(ESP8266)
 	static void print(char c)       // inline for arduino
-#ifndef ESP8266
 	{ Serial.print(c); }
 #else
-		;
-#endif
+	static void print(char c);
 #endif
 
 	static void test_functionality(void);
@@ -91,8 +115,10 @@ private:
 	static void sendJsonPair(const char * name, char val); // send one JSON pair with a char value as name:val,
 	static void sendJsonPair(const char * name, uint16_t val); // send one JSON pair with a uint16_t value as name:val,
 	static void sendJsonPair(const char * name, uint8_t val); // send one JSON pair with a uint8_t value as name:val,
+	static void sendJsonPair(const char * name, uint32_t val); // send one JSON pair with a uint32_t value as name:val,
 	static void sendJsonAnnotation(const char* name, const char* annotation);
 	static void sendJsonTemp(const char* name, temperature temp);
+	static void sendJsonFixed16(const char* name, int32_t val); // send a 16.16 fixed point value with 4 decimals
 	
 	static void processJsonPair(const char * key, const char * val, void* pv); // process one pair
 	
@@ -0,0 +1,44 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "RecentHistory.h"
+#include "TempControl.h"
+#include "ChamberManager.h"
+
+RecentHistory recentHistory;
+
+TickRecord RecentHistory::records[RECENT_HISTORY_TICKS];
+uint32_t RecentHistory::count = 0;
+
+void RecentHistory::update()
+{
+	ChamberSwitch chamber(1);		// the ticks are of the first chamber, whichever the Pi link has selected
+	TickRecord& r = records[count % RECENT_HISTORY_TICKS];
+	r.beerTemp = tempControl.getBeerTemp();
+	r.fridgeTemp = tempControl.getFridgeTemp();
+	r.beerSlope = tempControl.cv.beerSlope;
+	r.p = tempControl.cv.p;
+	r.i = tempControl.cv.i;
+	r.d = tempControl.cv.d;
+	r.state = tempControl.getState();
+	r.outputs = (tempControl.heater->isActive() ? TICK_OUTPUT_HEATER : 0)
+		| (tempControl.cooler->isActive() ? TICK_OUTPUT_COOLER : 0)
+		| (tempControl.light->isActive() ? TICK_OUTPUT_LIGHT : 0)
+		| (tempControl.fan->isActive() ? TICK_OUTPUT_FAN : 0);
+	count++;
+}
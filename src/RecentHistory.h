@@ -0,0 +1,77 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+
+/**
+ * The outputs that were active during a control tick.
+ */
+enum TickOutputs {
+	TICK_OUTPUT_HEATER = 1,
+	TICK_OUTPUT_COOLER = 2,
+	TICK_OUTPUT_LIGHT = 4,
+	TICK_OUTPUT_FAN = 8
+};
+
+struct TickRecord {
+	temperature beerTemp;		// fast filtered
+	temperature fridgeTemp;		// fast filtered
+	temperature beerSlope;
+	temperature p;
+	temperature i;
+	temperature d;
+	uint8_t state;
+	uint8_t outputs;			// TickOutputs flags
+};
+
+/**
+ * Keeps the last RECENT_HISTORY_TICKS control ticks in RAM at full resolution, so that after a reconnect
+ * the script can fetch the recent minutes in one response rather than one data point per request.
+ * Each tick is numbered with a sequence number, counted from startup. The ticks are of the first chamber.
+ */
+class RecentHistory
+{
+public:
+	/**
+	 * Records the current control tick. Called after the outputs have been updated.
+	 */
+	static void update();
+
+	/**
+	 * Sequence number of the next tick to be recorded.
+	 */
+	static uint32_t next() { return count; }
+
+	/**
+	 * Sequence number of the oldest tick still held.
+	 */
+	static uint32_t oldest() { return count>RECENT_HISTORY_TICKS ? count-RECENT_HISTORY_TICKS : 0; }
+
+	/**
+	 * The tick with the given sequence number, which must be between oldest() and next().
+	 */
+	static const TickRecord& get(uint32_t seq) { return records[seq % RECENT_HISTORY_TICKS]; }
+
+private:
+	static TickRecord records[RECENT_HISTORY_TICKS];
+	static uint32_t count;
+};
+
+extern RecentHistory recentHistory;
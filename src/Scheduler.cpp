@@ -0,0 +1,112 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "Scheduler.h"
+
+Scheduler scheduler;
+
+Scheduler::Task Scheduler::tasks[SCHEDULER_TASKS];
+
+static inline void incrementSaturated(uint16_t& counter, uint32_t amount=1) {
+	counter = (counter+amount > UINT16_MAX) ? UINT16_MAX : counter+amount;
+}
+
+static inline uint16_t saturate16(uint32_t value) {
+	return value>UINT16_MAX ? UINT16_MAX : uint16_t(value);
+}
+
+uint8_t Scheduler::add(const char* name, TaskFunction fn, ticks_millis_t period, uint8_t priority, uint16_t deadline,
+	ticks_millis_t delay)
+{
+	for (uint8_t i=0; i<SCHEDULER_TASKS; i++) {
+		Task& t = tasks[i];
+		if (t.fn)
+			continue;
+		memset(&t, 0, sizeof(t));
+		t.name = name;
+		t.fn = fn;
+		t.due = ticks.millis()+delay;
+		t.period = period;
+		t.deadline = deadline;
+		t.priority = priority;
+		return i;
+	}
+	return NO_TASK;
+}
+
+uint8_t Scheduler::every(const char* name, TaskFunction fn, ticks_millis_t period, uint8_t priority, uint16_t deadline,
+	ticks_millis_t delay)
+{
+	return add(name, fn, period ? period : 1, priority, deadline, delay);
+}
+
+uint8_t Scheduler::once(const char* name, TaskFunction fn, ticks_millis_t delay, uint8_t priority)
+{
+	return add(name, fn, 0, priority, NO_DEADLINE, delay);
+}
+
+void Scheduler::cancel(uint8_t task)
+{
+	if (task<SCHEDULER_TASKS)
+		tasks[task].fn = NULL;
+}
+
+bool Scheduler::run()
+{
+	ticks_millis_t now = ticks.millis();
+	Task* next = NULL;
+	for (uint8_t i=0; i<SCHEDULER_TASKS; i++) {
+		Task& t = tasks[i];
+		if (!t.fn || int32_t(now-t.due)<0)
+			continue;
+		if (!next || t.priority>next->priority || (t.priority==next->priority && int32_t(t.due-next->due)<0))
+			next = &t;
+	}
+	if (!next)
+		return false;
+
+	TaskFunction fn = next->fn;
+	if (!next->period) {
+		next->fn = NULL;		// freed first, so the task can schedule itself again
+		fn();
+		return true;
+	}
+
+	TaskStats& stats = next->stats;
+	uint32_t lateness = now-next->due;
+	bool counted = next->deadline!=NO_DEADLINE;
+	if (counted && lateness>next->deadline)
+		incrementSaturated(stats.misses);
+	if (lateness>stats.latenessMax)
+		stats.latenessMax = saturate16(lateness);
+	next->due += next->period;
+	if (int32_t(now-next->due)>=0) {
+		// whole periods have gone by: skip them to keep the cadence, instead of catching up back to back
+		uint32_t skipped = (now-next->due)/next->period + 1;
+		if (counted)
+			incrementSaturated(stats.misses, skipped);
+		next->due += skipped*next->period;
+	}
+
+	fn();
+	uint16_t duration = saturate16(ticks.millis()-now);
+	if (duration>stats.durationMax)
+		stats.durationMax = duration;
+	incrementSaturated(stats.runs);
+	return true;
+}
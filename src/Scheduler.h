@@ -0,0 +1,100 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+#include "Ticks.h"
+
+typedef void (*TaskFunction)();
+
+/**
+ * Timing counters of a task. All counters saturate rather than wrap.
+ */
+struct TaskStats {
+	uint16_t runs;
+	uint16_t misses;			// runs that started after their deadline, plus periods that were skipped entirely. 0 for NO_DEADLINE tasks
+	uint16_t latenessMax;		// milliseconds from when the task was due until it started
+	uint16_t durationMax;		// milliseconds the task took
+};
+
+/**
+ * A small cooperative scheduler for the main loop, with a fixed number of task slots.
+ *
+ * Each call to run() runs the one most urgent task that is due: the highest priority, and among equal
+ * priorities the one that has been due the longest. Returning to the loop after each task lets the core service
+ * WiFi, and a long run of low priority work (such as the Pi sending commands) can't hold back a task of higher
+ * priority by more than the length of one task.
+ *
+ * Periodic tasks are due again a period after they were last due, rather than after they last ran, so the cadence
+ * doesn't drift. When a task falls more than a period behind, the periods it missed are counted and skipped rather
+ * than run back to back. One-shot tasks free their slot when they run, and keep no stats.
+ */
+class Scheduler
+{
+public:
+	static const uint8_t NO_TASK = 0xFF;
+	/** The deadline of a task that is only polled, where starting late or skipping a period is not a miss. */
+	static const uint16_t NO_DEADLINE = 0xFFFF;
+
+	/**
+	 * Adds a periodic task, first due after delay milliseconds.
+	 * /param deadline how late in milliseconds the task may start before it counts as a miss.
+	 * /return the task, or NO_TASK if all slots are taken.
+	 */
+	static uint8_t every(const char* name, TaskFunction fn, ticks_millis_t period, uint8_t priority, uint16_t deadline,
+		ticks_millis_t delay=0);
+
+	/**
+	 * Adds a task that runs once, after delay milliseconds.
+	 */
+	static uint8_t once(const char* name, TaskFunction fn, ticks_millis_t delay, uint8_t priority);
+
+	static void cancel(uint8_t task);
+
+	/**
+	 * Runs the most urgent task that is due.
+	 * /return false if no task was due.
+	 */
+	static bool run();
+
+	static uint8_t capacity() { return SCHEDULER_TASKS; }
+
+	/**
+	 * The name of the task in the slot, or NULL when the slot is free.
+	 */
+	static const char* name(uint8_t task) { return tasks[task].fn ? tasks[task].name : NULL; }
+	static const TaskStats& stats(uint8_t task) { return tasks[task].stats; }
+
+private:
+	struct Task {
+		const char* name;
+		TaskFunction fn;		// NULL when the slot is free
+		ticks_millis_t due;
+		ticks_millis_t period;	// 0 for a one-shot task
+		uint16_t deadline;
+		uint8_t priority;		// higher runs first
+		TaskStats stats;
+	};
+
+	static uint8_t add(const char* name, TaskFunction fn, ticks_millis_t period, uint8_t priority, uint16_t deadline,
+		ticks_millis_t delay);
+
+	static Task tasks[SCHEDULER_TASKS];
+};
+
+extern Scheduler scheduler;
@@ -0,0 +1,571 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include "SettingsLog.h"
+#include "EepromStructs.h"
+#include "EepromFormat.h"
+#include "OneWire.h"
+#include "SettingsSchema.h"
+
+#define SETTINGS_LOG_MAGIC 0x4C535042UL		// "BPSL"
+
+static_assert(SETTINGS_LOG_DEVICES==EepromFormat::MAX_DEVICES, "settings log must hold every device slot");
+static_assert(SETTINGS_LOG_CHAMBERS==EepromFormat::MAX_CHAMBERS, "settings log must hold every chamber");
+static_assert(SETTINGS_LOG_BEERS==ChamberBlock::MAX_BEERS, "settings log must hold every beer");
+static_assert(sizeof(BeerProfileRecord)<=SETTINGS_RECORD_MAX_PAYLOAD, "a beer profile must fit in one record");
+static_assert(sizeof(ChamberActuatorStats)<=SETTINGS_RECORD_MAX_PAYLOAD, "actuator stats must fit in one record");
+
+#define SETTINGS_LOG_BEER_RECORDS (SETTINGS_LOG_CHAMBERS*SETTINGS_LOG_BEERS)
+#define SETTINGS_LOG_PROFILE_BASE (SETTINGS_LOG_BEER_RECORDS+SETTINGS_LOG_CHAMBERS+SETTINGS_LOG_DEVICES)
+
+SettingsLog settingsLog;
+
+uint16_t SettingsLog::offsets[SETTINGS_LOG_RECORDS];
+uint8_t SettingsLog::lengths[SETTINGS_LOG_RECORDS];
+uint8_t SettingsLog::versions[SETTINGS_LOG_RECORDS];
+uint16_t SettingsLog::tail;
+uint8_t SettingsLog::active = 1;		// so the first format writes file A
+SettingsLogStats SettingsLog::stats;
+
+const uint8_t SETTINGS_RECORD_MAX = sizeof(SettingsRecordHeader)+SETTINGS_RECORD_MAX_PAYLOAD;
+
+int8_t SettingsLog::indexOf(uint8_t type, uint8_t id)
+{
+	switch (type) {
+		case SETTINGS_RECORD_CONTROL_SETTINGS:
+			return id<SETTINGS_LOG_BEER_RECORDS ? id : -1;
+		case SETTINGS_RECORD_CONTROL_CONSTANTS:
+			return id<SETTINGS_LOG_CHAMBERS ? SETTINGS_LOG_BEER_RECORDS+id : -1;
+		case SETTINGS_RECORD_DEVICE:
+			return id<SETTINGS_LOG_DEVICES ? SETTINGS_LOG_BEER_RECORDS+SETTINGS_LOG_CHAMBERS+id : -1;
+		case SETTINGS_RECORD_BEER_PROFILE:
+			return id<SETTINGS_LOG_CHAMBERS ? SETTINGS_LOG_PROFILE_BASE+id : -1;
+		case SETTINGS_RECORD_PROFILE_PROGRESS:
+			return id<SETTINGS_LOG_CHAMBERS ? SETTINGS_LOG_PROFILE_BASE+SETTINGS_LOG_CHAMBERS+id : -1;
+		case SETTINGS_RECORD_ACTUATOR_STATS:
+			return id<SETTINGS_LOG_CHAMBERS ? SETTINGS_LOG_PROFILE_BASE+2*SETTINGS_LOG_CHAMBERS+id : -1;
+		default:
+			return -1;
+	}
+}
+
+/**
+ * A record is readable when it is present, and not written by newer firmware in a layout this one doesn't know.
+ */
+bool SettingsLog::readable(uint8_t type, int8_t index)
+{
+	return index>=0 && offsets[index] && versions[index]<=SettingsSchema::version(type);
+}
+
+/**
+ * The inverse of indexOf.
+ */
+void SettingsLog::recordAt(uint8_t index, uint8_t& type, uint8_t& id)
+{
+	if (index<SETTINGS_LOG_BEER_RECORDS) {
+		type = SETTINGS_RECORD_CONTROL_SETTINGS;
+		id = index;
+	}
+	else if (index<SETTINGS_LOG_BEER_RECORDS+SETTINGS_LOG_CHAMBERS) {
+		type = SETTINGS_RECORD_CONTROL_CONSTANTS;
+		id = index-SETTINGS_LOG_BEER_RECORDS;
+	}
+	else if (index<SETTINGS_LOG_PROFILE_BASE) {
+		type = SETTINGS_RECORD_DEVICE;
+		id = index-SETTINGS_LOG_BEER_RECORDS-SETTINGS_LOG_CHAMBERS;
+	}
+	else if (index<SETTINGS_LOG_PROFILE_BASE+SETTINGS_LOG_CHAMBERS) {
+		type = SETTINGS_RECORD_BEER_PROFILE;
+		id = index-SETTINGS_LOG_PROFILE_BASE;
+	}
+	else if (index<SETTINGS_LOG_PROFILE_BASE+2*SETTINGS_LOG_CHAMBERS) {
+		type = SETTINGS_RECORD_PROFILE_PROGRESS;
+		id = index-SETTINGS_LOG_PROFILE_BASE-SETTINGS_LOG_CHAMBERS;
+	}
+	else {
+		type = SETTINGS_RECORD_ACTUATOR_STATS;
+		id = index-SETTINGS_LOG_PROFILE_BASE-2*SETTINGS_LOG_CHAMBERS;
+	}
+}
+
+uint8_t SettingsLog::recordCrc(const uint8_t* record)
+{
+	const SettingsRecordHeader& h = *(const SettingsRecordHeader*)record;
+	const uint8_t skip = offsetof(SettingsRecordHeader, type);
+	return OneWire::crc8(record+skip, sizeof(SettingsRecordHeader)-skip+h.length);
+}
+
+/**
+ * Reads the record at offset into record, which must hold SETTINGS_RECORD_MAX bytes.
+ * Returns false if there is no valid record there.
+ */
+bool SettingsLog::readRecord(File& f, uint16_t offset, uint8_t* record)
+{
+	SettingsRecordHeader& h = *(SettingsRecordHeader*)record;
+	if (!f.seek(offset, SeekSet) || f.read(record, sizeof(h))!=sizeof(h) || h.magic!=SETTINGS_RECORD_MAGIC)
+		return false;
+	return h.length<=SETTINGS_RECORD_MAX_PAYLOAD && offset+sizeof(h)+h.length<=SETTINGS_LOG_SIZE
+		&& f.read(record+sizeof(h), h.length)==h.length && h.crc==recordCrc(record);
+}
+
+bool SettingsLog::readHeader(uint8_t which, SettingsLogHeader& header)
+{
+	File f = SPIFFS.open(fileName(which), "r");
+	if (!f)
+		return false;
+	bool ok = f.read((uint8_t*)&header, sizeof(header))==sizeof(header);
+	f.close();
+	return ok && header.magic==SETTINGS_LOG_MAGIC
+		&& header.crc==OneWire::crc8((const uint8_t*)&header, offsetof(SettingsLogHeader, crc));
+}
+
+/**
+ * Indexes the log from start to end. Later versions of a record replace earlier ones.
+ * A corrupt record, or one without its magic byte (from power being lost mid-append), ends the log. The previous
+ * version of that record, if any, is still in the log.
+ */
+bool SettingsLog::scan(File& f)
+{
+	uint8_t record[SETTINGS_RECORD_MAX];
+	SettingsRecordHeader& h = *(SettingsRecordHeader*)record;
+	uint16_t offset = sizeof(SettingsLogHeader);
+	if (!f.seek(offset, SeekSet))
+		return false;
+	while (offset+sizeof(h)<=SETTINGS_LOG_SIZE) {
+		if (f.read(record, sizeof(h))!=sizeof(h))
+			break;
+		if (h.magic!=SETTINGS_RECORD_MAGIC) {
+			// erased space, unless an append lost power before its magic byte was written
+			for (uint8_t i=1; i<sizeof(h); i++) {
+				if (record[i]!=0xFF) {
+					stats.crcErrors++;
+					break;
+				}
+			}
+			break;
+		}
+		if (h.length>SETTINGS_RECORD_MAX_PAYLOAD || offset+sizeof(h)+h.length>SETTINGS_LOG_SIZE
+			|| f.read(record+sizeof(h), h.length)!=h.length || h.crc!=recordCrc(record)) {
+			stats.crcErrors++;
+			break;
+		}
+		int8_t i = indexOf(h.type, h.id);
+		if (i>=0) {
+			stats.live -= offsets[i] ? sizeof(h)+lengths[i] : 0;
+			offsets[i] = 0;
+			if (h.version!=SETTINGS_RECORD_DELETED) {
+				stats.live += sizeof(h)+h.length;
+				offsets[i] = offset;
+				lengths[i] = h.length;
+				versions[i] = h.version;
+			}
+		}
+		offset += sizeof(h)+h.length;
+	}
+	tail = offset;
+	stats.used = tail;
+	return true;
+}
+
+/**
+ * Fills the file with erased (0xFF) bytes from the given position up to the full log size.
+ */
+void SettingsLog::pad(File& f, uint16_t from)
+{
+	uint8_t erased[32];
+	memset(erased, 0xFF, sizeof(erased));
+	while (from<SETTINGS_LOG_SIZE) {
+		uint16_t n = min(uint16_t(sizeof(erased)), uint16_t(SETTINGS_LOG_SIZE-from));
+		f.write(erased, n);
+		from += n;
+	}
+}
+
+/**
+ * Writes a new generation of the log to the inactive file and makes it the active one.
+ * records holds length bytes of records, which are placed directly after the header.
+ */
+bool SettingsLog::rewrite(const uint8_t* records, uint16_t length)
+{
+	uint8_t target = !active;
+	File f = SPIFFS.open(fileName(target), "w");
+	if (!f)
+		return false;
+
+	// the header stays erased until everything else is on flash, so a partly written file is never picked
+	SettingsLogHeader header;
+	memset(&header, 0xFF, sizeof(header));
+	bool ok = f.write((const uint8_t*)&header, sizeof(header))==sizeof(header);
+	if (length)
+		ok = ok && f.write(records, length)==length;
+	pad(f, sizeof(header)+length);
+	f.flush();
+
+	header.magic = SETTINGS_LOG_MAGIC;
+	header.generation = stats.compactions+1;
+	header.crc = OneWire::crc8((const uint8_t*)&header, offsetof(SettingsLogHeader, crc));
+	ok = ok && f.seek(0, SeekSet) && f.write((const uint8_t*)&header, sizeof(header))==sizeof(header);
+	f.close();
+	if (ok) {
+		active = target;
+		stats.compactions = header.generation;
+		tail = stats.used = sizeof(header)+length;
+	}
+	return ok;
+}
+
+bool SettingsLog::format()
+{
+	if (!rewrite(NULL, 0))
+		return false;
+	memset(offsets, 0, sizeof(offsets));
+	stats.live = 0;
+	return true;
+}
+
+void SettingsLog::importLegacyFile(const char* name, uint8_t type, uint8_t id, uint8_t length)
+{
+	File f = SPIFFS.open(name, "r");
+	if (!f)
+		return;
+	uint8_t data[SETTINGS_RECORD_MAX_PAYLOAD];
+	bool ok = f.read(data, length)==length;
+	f.close();
+	// the old files hold the layout from before records were versioned
+	if (ok && write(type, id, data, length, 0))
+		SPIFFS.remove(name);
+}
+
+bool SettingsLog::begin()
+{
+	memset(offsets, 0, sizeof(offsets));
+	memset(&stats, 0, sizeof(stats));
+
+	SettingsLogHeader a, b;
+	bool validA = readHeader(0, a);
+	bool validB = readHeader(1, b);
+	bool ok = false;
+	if (validA || validB) {
+		// the generation only ever increases, but compare by difference in case it wraps
+		active = validB && (!validA || int32_t(b.generation-a.generation)>0);
+		stats.compactions = active ? b.generation : a.generation;
+		File f = SPIFFS.open(fileName(active), "r");
+		ok = f && scan(f);
+		if (f)
+			f.close();
+	}
+	if (!ok && !format())
+		return false;
+	if (stats.crcErrors)
+		compact();		// drop the torn tail, so the next append doesn't land behind garbage
+
+	// settings from firmware that stored each struct in its own file
+	if (!contains(SETTINGS_RECORD_CONTROL_SETTINGS, 0) && SPIFFS.exists("/controlSettings")) {
+		importLegacyFile("/controlConstants", SETTINGS_RECORD_CONTROL_CONSTANTS, 0, sizeof(ControlConstants));
+		char name[8];
+		for (uint8_t i=0; i<SETTINGS_LOG_DEVICES; i++) {
+			sprintf(name, "/dev%d", i);
+			importLegacyFile(name, SETTINGS_RECORD_DEVICE, i, sizeof(DeviceConfig));
+		}
+		// settings last, since its presence marks the import as complete
+		importLegacyFile("/controlSettings", SETTINGS_RECORD_CONTROL_SETTINGS, 0, sizeof(ControlSettings));
+	}
+	upgradeRecords();
+	return true;
+}
+
+/**
+ * Brings records written by earlier firmware up to the current layout, so that settings survive a firmware
+ * upgrade. Records that cannot be upgraded are removed, and defaults are used in their place.
+ * Records from newer firmware are left as they are.
+ */
+void SettingsLog::upgradeRecords()
+{
+	for (uint8_t i=0; i<SETTINGS_LOG_RECORDS; i++) {
+		uint8_t type, id;
+		recordAt(i, type, id);
+		uint8_t version = versions[i];
+		if (!offsets[i] || version>=SettingsSchema::version(type))
+			continue;
+
+		uint8_t data[SETTINGS_RECORD_MAX_PAYLOAD];
+		uint8_t length = lengths[i];
+		if (read(type, id, data, length) && SettingsSchema::upgrade(type, version, data, length))
+			write(type, id, data, length, version);
+		else
+			remove(type, id);
+	}
+}
+
+bool SettingsLog::read(uint8_t type, uint8_t id, void* data, uint8_t length)
+{
+	int8_t i = indexOf(type, id);
+	if (!readable(type, i))
+		return false;
+
+	File f = SPIFFS.open(fileName(active), "r");
+	if (!f)
+		return false;
+	uint8_t record[SETTINGS_RECORD_MAX];
+	bool ok = readRecord(f, offsets[i], record);
+	f.close();
+	if (ok) {
+		uint8_t n = min(length, ((SettingsRecordHeader*)record)->length);
+		memcpy(data, record+sizeof(SettingsRecordHeader), n);
+		memset((uint8_t*)data+n, 0, length-n);
+	}
+	else
+		stats.crcErrors++;
+	return ok;
+}
+
+uint8_t SettingsLog::readAll(uint8_t type, uint8_t count, void* data, uint8_t length)
+{
+	memset(data, 0, uint16_t(count)*length);
+	int8_t first = indexOf(type, 0);
+	if (first<0 || indexOf(type, count-1)<0)
+		return 0;
+
+	// visit the records in file order, so the reads only ever move forward
+	uint8_t order[SETTINGS_LOG_RECORDS];
+	uint8_t found = 0;
+	for (uint8_t id=0; id<count; id++) {
+		uint16_t offset = offsets[first+id];
+		if (!readable(type, first+id))
+			continue;
+		uint8_t j = found++;
+		for (; j>0 && offsets[first+order[j-1]]>offset; j--)
+			order[j] = order[j-1];
+		order[j] = id;
+	}
+	if (!found)
+		return 0;
+
+	File f = SPIFFS.open(fileName(active), "r");
+	if (!f)
+		return 0;
+	uint8_t record[SETTINGS_RECORD_MAX];
+	uint8_t loaded = 0;
+	for (uint8_t k=0; k<found; k++) {
+		uint8_t id = order[k];
+		if (!readRecord(f, offsets[first+id], record)) {
+			stats.crcErrors++;
+			continue;
+		}
+		uint8_t n = min(length, ((SettingsRecordHeader*)record)->length);
+		memcpy((uint8_t*)data+uint16_t(id)*length, record+sizeof(SettingsRecordHeader), n);
+		loaded++;
+	}
+	f.close();
+	return loaded;
+}
+
+/**
+ * Copies the latest version of each record, except those of the types in skip, into image, which holds size bytes,
+ * back to back as they are stored in the log. If offsets is given, it receives the offset each record would have in
+ * a rewritten log.
+ * Returns false if a record cannot be read or the records do not fit.
+ */
+bool SettingsLog::collect(uint8_t* image, uint16_t size, uint16_t& length, uint16_t* compacted, uint8_t skip)
+{
+	length = 0;
+	File f = SPIFFS.open(fileName(active), "r");
+	if (!f)
+		return false;
+	bool ok = true;
+	for (uint8_t i=0; i<SETTINGS_LOG_RECORDS && ok; i++) {
+		if (compacted)
+			compacted[i] = 0;
+		uint8_t type, id;
+		recordAt(i, type, id);
+		if (!offsets[i] || (skip & SETTINGS_RECORD_BIT(type)))
+			continue;
+		uint8_t record[SETTINGS_RECORD_MAX];
+		uint8_t n = sizeof(SettingsRecordHeader)+lengths[i];
+		ok = length+n<=size && readRecord(f, offsets[i], record);
+		if (ok) {
+			memcpy(image+length, record, n);
+			if (compacted)
+				compacted[i] = sizeof(SettingsLogHeader)+length;
+			length += n;
+		}
+	}
+	f.close();
+	return ok;
+}
+
+/**
+ * Rewrites the log with just the latest version of each record.
+ */
+bool SettingsLog::compact()
+{
+	uint8_t* image = (uint8_t*)malloc(stats.live ? stats.live : 1);
+	if (!image)
+		return false;
+	uint16_t compacted[SETTINGS_LOG_RECORDS];
+	uint16_t length;
+	bool ok = collect(image, stats.live, length, compacted) && rewrite(image, length);
+	if (ok)
+		memcpy(offsets, compacted, sizeof(offsets));
+	free(image);
+	return ok;
+}
+
+uint16_t SettingsLog::exportRecords(uint8_t* image, uint16_t size, uint8_t skip)
+{
+	uint16_t length;
+	return collect(image, size, length, NULL, skip) ? length : 0;
+}
+
+bool SettingsLog::validRecords(const uint8_t* records, uint16_t length)
+{
+	if (sizeof(SettingsLogHeader)+length>SETTINGS_LOG_SIZE)
+		return false;
+	for (uint16_t offset = 0; offset<length; ) {
+		const SettingsRecordHeader& h = *(const SettingsRecordHeader*)(records+offset);
+		if (offset+sizeof(h)>length || h.magic!=SETTINGS_RECORD_MAGIC || h.length>SETTINGS_RECORD_MAX_PAYLOAD
+			|| offset+sizeof(h)+h.length>length || h.crc!=recordCrc(records+offset)
+			|| indexOf(h.type, h.id)<0 || h.version==SETTINGS_RECORD_DELETED)
+			return false;
+		offset += sizeof(h)+h.length;
+	}
+	return true;
+}
+
+bool SettingsLog::replace(const uint8_t* records, uint16_t length, uint8_t keep)
+{
+	// check everything before writing anything
+	if (!validRecords(records, length))
+		return false;
+	if (keep) {
+		// the given records without the kept types, followed by the stored records of those types
+		uint16_t size = length+stats.live;
+		uint8_t* merged = (uint8_t*)malloc(size ? size : 1);
+		if (!merged)
+			return false;
+		uint16_t used = 0;
+		for (uint16_t offset = 0; offset<length; ) {
+			const SettingsRecordHeader& h = *(const SettingsRecordHeader*)(records+offset);
+			uint16_t n = sizeof(h)+h.length;
+			if (!(keep & SETTINGS_RECORD_BIT(h.type))) {
+				memcpy(merged+used, records+offset, n);
+				used += n;
+			}
+			offset += n;
+		}
+		uint16_t kept;
+		bool ok = collect(merged+used, size-used, kept, NULL, uint8_t(~keep)) && rewrite(merged, used+kept);
+		free(merged);
+		if (!ok)
+			return false;
+	}
+	else if (!rewrite(records, length))
+		return false;
+
+	memset(offsets, 0, sizeof(offsets));
+	stats.live = 0;
+	File f = SPIFFS.open(fileName(active), "r");
+	bool ok = f && scan(f);
+	if (f)
+		f.close();
+	upgradeRecords();
+	return ok;
+}
+
+bool SettingsLog::write(uint8_t type, uint8_t id, const void* data, uint8_t length, uint8_t version)
+{
+	int8_t i = indexOf(type, id);
+	if (i<0 || length>SETTINGS_RECORD_MAX_PAYLOAD)
+		return false;
+
+	uint8_t record[SETTINGS_RECORD_MAX];
+	SettingsRecordHeader& h = *(SettingsRecordHeader*)record;
+
+	// flash writes are the expensive part, so skip the write when nothing changed
+	if (offsets[i] && lengths[i]==length) {
+		File f = SPIFFS.open(fileName(active), "r");
+		bool same = f && readRecord(f, offsets[i], record) && h.version==version
+			&& !memcmp(record+sizeof(h), data, length);
+		if (f)
+			f.close();
+		if (same) {
+			stats.skipped++;
+			return true;
+		}
+	}
+
+	h.magic = SETTINGS_RECORD_MAGIC;
+	h.type = type;
+	h.id = id;
+	h.version = version;
+	h.length = length;
+	if (length)
+		memcpy(record+sizeof(h), data, length);
+	h.crc = recordCrc(record);
+
+	uint16_t size = sizeof(h)+length;
+	if (tail+size>SETTINGS_LOG_SIZE && !compact())
+		return false;
+	if (tail+size>SETTINGS_LOG_SIZE)
+		return false;	// the live records alone fill the log
+
+	// the magic byte goes on flash last, so an append cut short by a power loss reads as erased space and is never
+	// mistaken for a record whose crc happens to match
+	File f = SPIFFS.open(fileName(active), "r+");
+	if (!f)
+		return false;
+	h.magic = 0xFF;
+	bool ok = f.seek(tail, SeekSet) && f.write(record, size)==size;
+	h.magic = SETTINGS_RECORD_MAGIC;
+	ok = ok && f.seek(tail, SeekSet) && f.write(record, 1)==1;
+	f.close();
+	if (ok) {
+		stats.live += size - (offsets[i] ? sizeof(h)+lengths[i] : 0);
+		offsets[i] = tail;
+		lengths[i] = length;
+		versions[i] = version;
+		tail += size;
+		stats.used = tail;
+		stats.appends++;
+		stats.bytesWritten += size;
+	}
+	return ok;
+}
+
+bool SettingsLog::remove(uint8_t type, uint8_t id)
+{
+	int8_t i = indexOf(type, id);
+	if (i<0 || !offsets[i])
+		return i>=0;
+	if (!write(type, id, NULL, 0, SETTINGS_RECORD_DELETED))
+		return false;
+	// the marker itself is not live - it is dropped by the next compaction
+	stats.live -= sizeof(SettingsRecordHeader);
+	offsets[i] = 0;
+	return true;
+}
+
+void SettingsLog::erase()
+{
+	format();
+}
+
+#endif
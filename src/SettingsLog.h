@@ -0,0 +1,201 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#ifdef ARDUINO
+#include <FS.h>
+#else
+#include "HostFS.h"
+#endif
+
+#define SETTINGS_LOG_FILE_A "/settings.a"
+#define SETTINGS_LOG_FILE_B "/settings.b"
+#define SETTINGS_RECORD_MAGIC 0xA5
+
+/**
+ * The kinds of record kept in the settings log. The values are persisted, so only append to this list.
+ */
+enum SettingsRecordType {
+	SETTINGS_RECORD_CONTROL_SETTINGS = 1,	// id is the chamber, counted from 0, plus SETTINGS_LOG_CHAMBERS for each beer after the first
+	SETTINGS_RECORD_CONTROL_CONSTANTS = 2,	// id is the chamber
+	SETTINGS_RECORD_DEVICE = 3,			// id is the device slot
+	SETTINGS_RECORD_BEER_PROFILE = 4,		// id is the chamber
+	SETTINGS_RECORD_PROFILE_PROGRESS = 5,	// id is the chamber
+	SETTINGS_RECORD_ACTUATOR_STATS = 6,		// id is the chamber
+};
+
+#define SETTINGS_RECORD_BIT(type) (1<<(type))
+
+/**
+ * Starts each of the two log files. The file with the highest generation and a valid header is the active one.
+ */
+struct SettingsLogHeader {
+	uint32_t magic;
+	uint32_t generation;		// incremented each time the log is rewritten, so also counts compactions
+	uint8_t crc;				// crc8 of the fields above
+	uint8_t reserved[3];
+};
+
+/**
+ * Every record is written as this header followed by length bytes of payload.
+ * The crc covers the header from type onwards, and the payload.
+ */
+struct SettingsRecordHeader {
+	uint8_t magic;
+	uint8_t crc;
+	uint8_t type;
+	uint8_t id;
+	uint8_t version;
+	uint8_t length;
+};
+
+const uint8_t SETTINGS_RECORD_MAX_PAYLOAD = 64;
+const uint8_t SETTINGS_RECORD_DELETED = 0xFF;	// version of a record that marks the record as removed
+const uint8_t SETTINGS_LOG_CHAMBERS = 4;		// must match EepromFormat::MAX_CHAMBERS
+const uint8_t SETTINGS_LOG_BEERS = 6;			// must match ChamberBlock::MAX_BEERS
+const uint8_t SETTINGS_LOG_DEVICES = 16;		// must match EepromFormat::MAX_DEVICES
+const uint8_t SETTINGS_LOG_RECORDS = SETTINGS_LOG_CHAMBERS*SETTINGS_LOG_BEERS + SETTINGS_LOG_CHAMBERS + SETTINGS_LOG_DEVICES
+	+ 3*SETTINGS_LOG_CHAMBERS;
+
+struct SettingsLogStats {
+	uint32_t compactions;		// generation of the active file
+	uint16_t appends;			// records written since boot
+	uint16_t skipped;			// writes dropped since boot because the record was unchanged
+	uint16_t bytesWritten;		// since boot
+	uint16_t used;				// bytes of the log in use, including superseded records
+	uint16_t live;				// bytes taken by the latest version of each record
+	uint8_t crcErrors;			// records found corrupt
+};
+
+/**
+ * An append-only store for the persisted settings, kept in one preallocated SPIFFS file.
+ *
+ * Each write appends a new version of a record; the latest version wins. When the file is full, it is
+ * compacted by rewriting only the latest version of each record. Compared to one file per struct, this
+ * turns each settings change into a small append, and at boot the whole store is indexed in a
+ * single sequential read.
+ *
+ * The log is double buffered over two files, so no write ever destroys the last good copy of a record:
+ * appends leave earlier versions in place, and compaction writes the inactive file, whose header is
+ * written last. If power is lost part way, the header is not valid and the previous file is used at boot.
+ * Likewise the magic byte of an appended record is written after the rest of it.
+ */
+class SettingsLog
+{
+public:
+	/**
+	 * Opens the log, creating it if needed. Settings saved by earlier firmware as separate files are imported.
+	 * SPIFFS must be mounted.
+	 */
+	static bool begin();
+
+	/**
+	 * Reads the latest version of a record. If the stored record is shorter than length, the remainder is zeroed.
+	 * A record written by newer firmware, in a layout newer than SettingsSchema::version(type), is not read.
+	 */
+	static bool read(uint8_t type, uint8_t id, void* data, uint8_t length);
+
+	/**
+	 * Reads records 0..count-1 of the given type into an array of count elements of length bytes each,
+	 * with the file opened once and read front to back. Missing records, and those in a newer layout, are zeroed.
+	 * Returns the number of records found.
+	 */
+	static uint8_t readAll(uint8_t type, uint8_t count, void* data, uint8_t length);
+
+	/**
+	 * Appends a new version of a record, unless it is identical to the current version.
+	 * version is the layout version of the payload, see SettingsSchema.
+	 */
+	static bool write(uint8_t type, uint8_t id, const void* data, uint8_t length, uint8_t version);
+
+	/**
+	 * Removes a record, by appending a marker that hides all earlier versions.
+	 */
+	static bool remove(uint8_t type, uint8_t id);
+
+	/**
+	 * Tells if read() would find the record.
+	 */
+	static bool contains(uint8_t type, uint8_t id) {
+		return readable(type, indexOf(type, id));
+	}
+
+	/**
+	 * Discards all records.
+	 */
+	static void erase();
+
+	/**
+	 * Copies the latest version of every record into image, in the format they are stored in, leaving out the types
+	 * in skip (a mask of SETTINGS_RECORD_BIT).
+	 * Returns the number of bytes used, or 0 if the records do not fit in size bytes.
+	 */
+	static uint16_t exportRecords(uint8_t* image, uint16_t size, uint8_t skip=0);
+
+	/**
+	 * Checks that records holds well formed records of known types, that fit in the log.
+	 */
+	static bool validRecords(const uint8_t* records, uint16_t length);
+
+	/**
+	 * Replaces all records with the given ones, as produced by exportRecords(). The records are all checked
+	 * before anything is written, and are then committed in a single rewrite of the log, so either all or
+	 * none of them are stored. Records from earlier layouts are upgraded.
+	 * The stored records of the types in keep (a mask of SETTINGS_RECORD_BIT) stay as they are, and records of those
+	 * types in records are ignored.
+	 */
+	static bool replace(const uint8_t* records, uint16_t length, uint8_t keep=0);
+
+	static const SettingsLogStats& getStats() { return stats; }
+
+	/**
+	 * The crc of a record, which is a SettingsRecordHeader followed by its payload.
+	 */
+	static uint8_t recordCrc(const uint8_t* record);
+
+private:
+	static int8_t indexOf(uint8_t type, uint8_t id);
+	static bool readable(uint8_t type, int8_t index);
+	static void recordAt(uint8_t index, uint8_t& type, uint8_t& id);
+	static bool readRecord(File& f, uint16_t offset, uint8_t* record);
+	static const char* fileName(uint8_t which) { return which ? SETTINGS_LOG_FILE_B : SETTINGS_LOG_FILE_A; }
+	static bool readHeader(uint8_t which, SettingsLogHeader& header);
+	static bool scan(File& f);
+	static bool rewrite(const uint8_t* records, uint16_t length);
+	static bool format();
+	static bool collect(uint8_t* image, uint16_t size, uint16_t& length, uint16_t* compacted, uint8_t skip=0);
+	static bool compact();
+	static void pad(File& f, uint16_t from);
+	static void upgradeRecords();
+	static void importLegacyFile(const char* name, uint8_t type, uint8_t id, uint8_t length);
+
+	static uint16_t offsets[SETTINGS_LOG_RECORDS];		// 0 when the record is not present
+	static uint8_t lengths[SETTINGS_LOG_RECORDS];
+	static uint8_t versions[SETTINGS_LOG_RECORDS];
+	static uint16_t tail;
+	static uint8_t active;			// file being appended to, 0 for A, 1 for B
+	static SettingsLogStats stats;
+};
+
+extern SettingsLog settingsLog;
+
+#endif
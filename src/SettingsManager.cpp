@@ -23,11 +23,15 @@
 #include "TempControl.h"
 #include "PiLink.h"
 #include "TempSensorExternal.h"
+#include "BeerProfile.h"
+#include "ActuatorMeter.h"
 
 void SettingsManager::loadSettings()
 {
 	logDebug("loading settings");
 
+	beerProfile.load();
+	actuatorMeter.load();
 
 	if (!eepromManager.applySettings())
 	{
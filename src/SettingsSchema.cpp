@@ -0,0 +1,78 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include "SettingsSchema.h"
+#include "SettingsLog.h"
+#include "EepromStructs.h"
+
+/*
+ * Upgrade functions, one per version step. For example, when a field is added to the end of ControlConstants:
+ *
+ *	static bool controlConstantsFrom0(uint8_t* data, uint8_t& length) {
+ *		ControlConstants& cc = *(ControlConstants*)data;	// fields past the old length read as 0
+ *		cc.newField = defaultValue;
+ *		length = sizeof(ControlConstants);
+ *		return true;
+ *	}
+ *
+ * and add { SETTINGS_RECORD_CONTROL_CONSTANTS, 0, controlConstantsFrom0 } below.
+ */
+const SettingsUpgrade SettingsSchema::upgrades[] = {
+	{ 0, 0, NULL }		// end of list
+};
+
+uint8_t SettingsSchema::version(uint8_t type)
+{
+	switch (type) {
+		case SETTINGS_RECORD_CONTROL_SETTINGS:
+			return CONTROL_SETTINGS_VERSION;
+		case SETTINGS_RECORD_CONTROL_CONSTANTS:
+			return CONTROL_CONSTANTS_VERSION;
+		case SETTINGS_RECORD_DEVICE:
+			return DEVICE_CONFIG_VERSION;
+		case SETTINGS_RECORD_BEER_PROFILE:
+			return BEER_PROFILE_VERSION;
+		case SETTINGS_RECORD_PROFILE_PROGRESS:
+			return PROFILE_PROGRESS_VERSION;
+		case SETTINGS_RECORD_ACTUATOR_STATS:
+			return ACTUATOR_STATS_VERSION;
+		default:
+			return 0;
+	}
+}
+
+bool SettingsSchema::upgrade(uint8_t type, uint8_t& version, uint8_t* data, uint8_t& length)
+{
+	uint8_t current = SettingsSchema::version(type);
+	// the payload buffer is zero beyond the stored length, so new fields start out as 0
+	memset(data+length, 0, SETTINGS_RECORD_MAX_PAYLOAD-length);
+	while (version<current) {
+		const SettingsUpgrade* u = upgrades;
+		while (u->fn && !(u->type==type && u->from==version))
+			u++;
+		if (!u->fn || !u->fn(data, length) || length>SETTINGS_RECORD_MAX_PAYLOAD)
+			return false;
+		version++;
+	}
+	return true;
+}
+
+#endif
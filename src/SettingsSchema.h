@@ -0,0 +1,51 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+
+/**
+ * Upgrades a record payload from one layout version to the next, in place.
+ * data has room for SETTINGS_RECORD_MAX_PAYLOAD bytes. length holds the size of the old payload on entry,
+ * and should be set to the size of the new one. Returns false if the record cannot be upgraded.
+ */
+typedef bool (*SettingsUpgradeFn)(uint8_t* data, uint8_t& length);
+
+struct SettingsUpgrade {
+	uint8_t type;				// SettingsRecordType
+	uint8_t from;				// version the function upgrades from, to from+1
+	SettingsUpgradeFn fn;
+};
+
+/**
+ * Knows the current layout version of each persisted record type, and how to upgrade older layouts.
+ */
+class SettingsSchema
+{
+public:
+	static uint8_t version(uint8_t type);
+
+	/**
+	 * Applies the registered upgrades one version at a time until the record is at the current version.
+	 * On success, version is the current version.
+	 */
+	static bool upgrade(uint8_t type, uint8_t& version, uint8_t* data, uint8_t& length);
+
+private:
+	static const SettingsUpgrade upgrades[];
+};
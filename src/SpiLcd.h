@@ -164,7 +164,7 @@ class SpiLcd : public Print {
 	uint8_t _numlines;
 	
 	bool	_bufferOnly;
-	uint16_t _backlightTime;
+	ticks_seconds_t _backlightTime;
 
 	char content[4][21]; // always keep a copy of the display content in this variable
 	
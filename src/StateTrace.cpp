@@ -0,0 +1,30 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "StateTrace.h"
+
+StateTrace stateTrace;
+
+StateTransition StateTrace::transitions[STATE_TRACE_SIZE];
+uint32_t StateTrace::count = 0;
+
+void StateTrace::record(const StateTransition& transition)
+{
+	transitions[count % STATE_TRACE_SIZE] = transition;
+	count++;
+}
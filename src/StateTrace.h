@@ -0,0 +1,68 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+#include "TemperatureFormats.h"
+#include "Ticks.h"
+
+/**
+ * A change of the fridge state, and what it was decided on.
+ */
+struct StateTransition {
+	ticks_seconds_t time;		// ticks.seconds() when the state changed
+	uint8_t chamber;			// counted from 0
+	uint8_t from;
+	uint8_t to;
+	uint8_t rule;				// index of the rule in the state table of TempControl that made the change
+	temperature fridgeTemp;		// fast filtered
+	temperature fridgeSetting;
+	temperature beerTemp;		// fast filtered, of the beer the fridge is following
+	temperature beerSetting;
+};
+
+/**
+ * Keeps the last STATE_TRACE_SIZE state transitions of all chambers in RAM, so compressor cycling can be looked
+ * into after the fact, and a simulation run can check which rules of the state table it has covered.
+ * Each transition is numbered with a sequence number, counted from startup.
+ */
+class StateTrace
+{
+public:
+	static void record(const StateTransition& transition);
+
+	/**
+	 * Sequence number of the next transition to be recorded.
+	 */
+	static uint32_t next() { return count; }
+
+	/**
+	 * Sequence number of the oldest transition still held.
+	 */
+	static uint32_t oldest() { return count>STATE_TRACE_SIZE ? count-STATE_TRACE_SIZE : 0; }
+
+	/**
+	 * The transition with the given sequence number, which must be between oldest() and next().
+	 */
+	static const StateTransition& get(uint32_t seq) { return transitions[seq % STATE_TRACE_SIZE]; }
+
+private:
+	static StateTransition transitions[STATE_TRACE_SIZE];
+	static uint32_t count;
+};
+
+extern StateTrace stateTrace;
@@ -31,6 +31,16 @@
 #include "EepromManager.h"
 #include "TempSensorDisconnected.h"
 #include "RotaryEncoder.h"
+#include "BeerProfile.h"
+#include "Autotune.h"
+#include "ChamberModel.h"
+#include "ModelPredictive.h"
+#include "StateTrace.h"
+#include "ActuatorMeter.h"
+#include "ChamberManager.h"
+#if BREWPI_DS2413 && !BREWPI_SIMULATE
+#include "DS2413.h"
+#endif
 
 TempControl tempControl;
 
@@ -54,6 +64,7 @@ Actuator* TempControl::fan = &defaultActuator;
 ValueActuator cameraLightState;		
 AutoOffActuator TempControl::cameraLight(600, &cameraLightState);	// timeout 10 min
 Sensor<bool>* TempControl::door = &defaultSensor;
+BeerControl TempControl::beers[BREWPI_BEERS];
 	
 // Control parameters
 ControlConstants TempControl::cc;
@@ -65,15 +76,16 @@ uint8_t TempControl::state;
 bool TempControl::doPosPeakDetect;
 bool TempControl::doNegPeakDetect;
 bool TempControl::doorOpen;
+uint8_t TempControl::leadBeer;
 	
 	// keep track of beer setting stored in EEPROM
 temperature TempControl::storedBeerSetting;
 	
 	// Timers
-uint16_t TempControl::lastIdleTime;
-uint16_t TempControl::lastHeatTime;
-uint16_t TempControl::lastCoolTime;
-uint16_t TempControl::waitTime;
+ticks_seconds_t TempControl::lastIdleTime;
+ticks_seconds_t TempControl::lastHeatTime;
+ticks_seconds_t TempControl::lastCoolTime;
+ticks_seconds_t TempControl::waitTime;
 #endif
 
 
@@ -103,6 +115,24 @@ void TempControl::init(void){
 		fridgeSensor->init();
 	}
 	
+	beers[0].sensor = beerSensor;
+	for (uint8_t i=0; i<BREWPI_BEERS; i++) {
+		BeerControl& beer = beers[i];
+		if (beer.sensor==NULL) {
+			beer.sensor = new TempSensor(TEMP_SENSOR_TYPE_BEER, &defaultTempSensor);
+			beer.sensor->init();
+		}
+		if (beer.heater==NULL)
+			beer.heater = &defaultActuator;
+		if (beer.cooler==NULL)
+			beer.cooler = &defaultActuator;
+		if (i)
+			beer.cs.beerSetting = INVALID_TEMP;
+		beer.reset();
+	}
+	leadBeer = 0;
+	chamberModel.reset();
+	
 	updateTemperatures();
 	reset();
 	
@@ -129,6 +159,8 @@ void TempControl::updateTemperatures(void){
 	
 	updateSensor(beerSensor);
 	updateSensor(fridgeSensor);
+	for (uint8_t i=1; i<BREWPI_BEERS; i++)
+		updateSensor(beers[i].sensor);
 	
 	// Read ambient sensor to keep the value up to date. If no sensor is connected, this does nothing.
 	// This prevents a delay in serial response because the value is not up to date.
@@ -139,11 +171,19 @@ void TempControl::updateTemperatures(void){
 
 void TempControl::updatePID(void){
 	static unsigned char integralUpdateCounter = 0;
+	// the outputs were last set for the state the previous tick left
+	chamberModel.update(stateIsHeating(), stateIsCooling(), doorOpen || cs.mode == MODE_TEST);
+	// a profile stored on the controller takes the place of the setting sent by the Pi
+	temperature profileSetting = beerProfile.advance(cs.mode == MODE_BEER_PROFILE);
+	if(profileSetting != INVALID_TEMP){
+		cs.beerSetting = profileSetting;
+	}
 	if(tempControl.modeIsBeer()){
 		if(cs.beerSetting == INVALID_TEMP){
 			// beer setting is not updated yet
 			// set fridge to unknown too
 			cs.fridgeSetting = INVALID_TEMP;
+			leadBeer = 0;
 			return;
 		}
 		
@@ -162,7 +202,7 @@ void TempControl::updatePID(void){
 			if(state != IDLE){
 				integratorUpdate = 0;
 			}
-			else if(abs(integratorUpdate) < cc.iMaxError){
+			else if(abs(integratorUpdate) < cc.iMaxError && leadBeer == 0){
 				// difference is smaller than iMaxError				
 				// check additional conditions to see if integrator should be active to prevent windup
 				bool updateSign = (integratorUpdate > 0); // 1 = positive, 0 = negative
@@ -189,7 +229,8 @@ void TempControl::updatePID(void){
 				}	
 			}
 			else{
-				// decrease integral by 1/8 when far from the end value to reset the integrator
+				// decrease integral by 1/8 when far from the end value, or when another beer sets the fridge,
+				// to reset the integrator
 				integratorUpdate = -(cv.diffIntegral >> 3);		
 			}
 			cv.diffIntegral = cv.diffIntegral + integratorUpdate;
@@ -209,17 +250,153 @@ void TempControl::updatePID(void){
 		// constrain to tempSettingMax or beerSetting + pidMAx, whichever is higher.
 		temperature upperBound = (cs.beerSetting >= cc.tempSettingMax - cc.pidMax) ? cc.tempSettingMax : cs.beerSetting + cc.pidMax;
 		
-		cs.fridgeSetting = constrain(constrainTemp16(newFridgeSetting), lowerBound, upperBound);
+		beers[0].fridgeDemand = constrain(constrainTemp16(newFridgeSetting), lowerBound, upperBound);
+		arbitrateBeers();
+	}
+	else {
+		leadBeer = 0;
+		if(cs.mode == MODE_FRIDGE_CONSTANT){
+			// FridgeTemperature is set manually, use INVALID_TEMP to indicate beer temp is not active
+			cs.beerSetting = INVALID_TEMP;
+		}
+		else if(cs.mode == MODE_AUTOTUNE){
+			updateAutotune();
+		}
+		else if(cs.mode == MODE_MODEL_PREDICTIVE){
+			cs.fridgeSetting = modelPredictiveControl.update(cs.beerSetting, cc);
+		}
+	}
+}
+
+/**
+ * Sets the fridge from the autotune relay. When the run ends, the chamber holds the beer at the setting in
+ * MODE_BEER_CONSTANT, with the constants it had, until the proposed constants are applied.
+ */
+void TempControl::updateAutotune(void){
+	temperature beer = beerSensor->isConnected() ? beerSensor->readSlowFiltered() : INVALID_TEMP;
+	if(cs.beerSetting == INVALID_TEMP){
+		cs.beerSetting = beer; // tune around the temperature the beer is at
+	}
+	if(!pidAutotune.isRunning()){
+		if(!pidAutotune.mayStart()){
+			// the proposal for another chamber has not been applied yet: hold the fridge at the beer until it is
+			cs.fridgeSetting = cs.beerSetting;
+			return;
+		}
+		pidAutotune.start(cc);
+	}
+	cs.fridgeSetting = pidAutotune.update(beer, cs.beerSetting, cc);
+
+	AutotuneStatus status = pidAutotune.getStatus();
+	if(status == AUTOTUNE_DONE || status == AUTOTUNE_FAILED){
+		// not setMode(), which writes the settings right away: this may be a chamber other than the current one
+		cs.mode = MODE_BEER_CONSTANT;
+		state = IDLE;
+		eepromManager.storeTempSettings();
+#ifdef ESP8266  // ESP8266 Doesn't support %S
+		piLink.printTemperaturesJSON(status == AUTOTUNE_DONE ? "Autotune done" : "Autotune failed", 0);
+#else
+		piLink.printBeerAnnotation(PSTR("Autotune %S"), status == AUTOTUNE_DONE ? PSTR("done") : PSTR("failed"));
+#endif
 	}
-	else if(cs.mode == MODE_FRIDGE_CONSTANT){
-		// FridgeTemperature is set manually, use INVALID_TEMP to indicate beer temp is not active
-		cs.beerSetting = INVALID_TEMP;
+}
+
+/**
+ * Runs the PID of the other beers, and sets the fridge to the coldest demand of all beers. The beers that
+ * would like it warmer are brought up by their own heaters, if they have one.
+ */
+void TempControl::arbitrateBeers(void){
+	temperature fridgeSetting = beers[0].fridgeDemand;
+	uint8_t lead = 0;
+	for (uint8_t i=1; i<BREWPI_BEERS; i++) {
+		BeerControl& beer = beers[i];
+		beer.updatePID(cc, cs.fridgeSetting, state == IDLE, i == leadBeer);
+		if (beer.fridgeDemand != INVALID_TEMP && beer.fridgeDemand < fridgeSetting) {
+			fridgeSetting = beer.fridgeDemand;
+			lead = i;
+		}
+	}
+	cs.fridgeSetting = fridgeSetting;
+	leadBeer = lead;
+}
+
+/*
+ * Conditions that guard the rules of the state table. They are worked out each tick, after the activity of
+ * the current state, which updates the wait time and the estimated peak.
+ */
+enum StateCondition {
+	CONDITION_NONE = 0,
+	CONDITION_NO_CONTROL = 1<<0,		// the fridge setting, the fridge sensor or a beer sensor the mode needs is missing
+	CONDITION_OFF = 1<<1,
+	CONDITION_FRIDGE_HIGH = 1<<2,		// the fridge is above the idle range
+	CONDITION_FRIDGE_LOW = 1<<3,		// the fridge is below the idle range
+	CONDITION_BEER_COLD = 1<<4,			// beer modes: the beer is already under target. 1/2 sensor bit idle zone
+	CONDITION_BEER_WARM = 1<<5,			// beer modes: the beer is already over target
+	CONDITION_NO_COOLER = 1<<6,
+	CONDITION_NO_HEATER = 1<<7,
+	CONDITION_WAITING = 1<<8,			// a minimum off or switch time has not passed
+	CONDITION_PEAK_PENDING = 1<<9,		// the peak of the last heating or cooling has not been detected yet
+	CONDITION_PEAK_REACHED = 1<<10,		// the estimated fridge peak lands on target, or the beer has gone past it
+	CONDITION_MIN_ON_PASSED = 1<<11		// heating or cooling for longer than the minimum on time
+};
+
+#define STATE_BIT(s) (1<<(s))
+#define STATES_ANY 0xFFFF
+#define STATES_IDLE (STATE_BIT(IDLE) | STATE_BIT(STATE_OFF) | STATE_BIT(WAITING_TO_COOL) | STATE_BIT(WAITING_TO_HEAT) \
+	| STATE_BIT(WAITING_FOR_PEAK_DETECT))
+#define STATES_COOLING (STATE_BIT(COOLING) | STATE_BIT(COOLING_MIN_TIME))
+#define STATES_HEATING (STATE_BIT(HEATING) | STATE_BIT(HEATING_MIN_TIME))
+#define STATE_UNCHANGED NUM_STATES
+
+struct StateRule {
+	uint16_t from;		// the states the rule applies in, as STATE_BIT flags
+	uint16_t when;		// the StateCondition flags that must all hold
+	uint8_t to;			// the next state, or STATE_UNCHANGED
+};
+
+/*
+ * The first rule that matches the state and conditions decides the next state. Rule indexes are recorded in the
+ * state trace, so add new rules where they don't renumber the others if the order allows.
+ * The first STATE_RULES_ANY rules take the chamber out of control from any state, and are checked before the
+ * activity of the state, so a state that is left this way doesn't update its timers.
+ */
+static const StateRule stateRules[] = {
+	/* 0 */ { STATES_ANY, CONDITION_NO_CONTROL, IDLE },
+	/* 1 */ { STATES_ANY, CONDITION_OFF, STATE_OFF },
+	/* 2 */ { STATES_IDLE, CONDITION_FRIDGE_HIGH | CONDITION_BEER_COLD, IDLE },
+	/* 3 */ { STATES_IDLE, CONDITION_FRIDGE_HIGH | CONDITION_NO_COOLER, STATE_UNCHANGED },
+	/* 4 */ { STATES_IDLE, CONDITION_FRIDGE_HIGH | CONDITION_WAITING, WAITING_TO_COOL },
+	/* 5 */ { STATES_IDLE, CONDITION_FRIDGE_HIGH | CONDITION_PEAK_PENDING, WAITING_FOR_PEAK_DETECT },
+	/* 6 */ { STATES_IDLE, CONDITION_FRIDGE_HIGH, COOLING },
+	/* 7 */ { STATES_IDLE, CONDITION_FRIDGE_LOW | CONDITION_BEER_WARM, IDLE },
+	/* 8 */ { STATES_IDLE, CONDITION_FRIDGE_LOW | CONDITION_NO_HEATER, STATE_UNCHANGED },
+	/* 9 */ { STATES_IDLE, CONDITION_FRIDGE_LOW | CONDITION_WAITING, WAITING_TO_HEAT },
+	/* 10 */ { STATES_IDLE, CONDITION_FRIDGE_LOW | CONDITION_PEAK_PENDING, WAITING_FOR_PEAK_DETECT },
+	/* 11 */ { STATES_IDLE, CONDITION_FRIDGE_LOW, HEATING },
+	/* 12 */ { STATES_IDLE, CONDITION_NONE, IDLE },	// within the idle range
+	/* 13 */ { STATES_COOLING, CONDITION_PEAK_REACHED | CONDITION_MIN_ON_PASSED, IDLE },
+	/* 14 */ { STATES_COOLING, CONDITION_PEAK_REACHED, COOLING_MIN_TIME },
+	/* 15 */ { STATES_COOLING, CONDITION_NONE, COOLING },
+	/* 16 */ { STATES_HEATING, CONDITION_PEAK_REACHED | CONDITION_MIN_ON_PASSED, IDLE },
+	/* 17 */ { STATES_HEATING, CONDITION_PEAK_REACHED, HEATING_MIN_TIME },
+	/* 18 */ { STATES_HEATING, CONDITION_NONE, HEATING }
+};
+#define STATE_RULES_ANY 2
+#define STATE_RULES (sizeof(stateRules)/sizeof(stateRules[0]))
+
+static uint8_t matchStateRule(uint8_t state, uint16_t conditions, uint8_t first, uint8_t last)
+{
+	for(uint8_t i = first; i < last; i++){
+		const StateRule& rule = stateRules[i];
+		if((rule.from & STATE_BIT(state)) && (rule.when & conditions) == rule.when){
+			return i;
+		}
 	}
+	return last;
 }
 
 void TempControl::updateState(void){
 	//update state
-	bool stayIdle = false;
 	bool newDoorOpen = door->sense();
 		
 	if(newDoorOpen!=doorOpen) {
@@ -234,141 +411,130 @@ void TempControl::updateState(void){
 #endif
 	}
 
+	uint16_t conditions = CONDITION_NONE;
 	if(cs.mode == MODE_OFF){
-		state = STATE_OFF;
-		stayIdle = true;
+		conditions |= CONDITION_OFF;
 	}
 	// stay idle when one of the required sensors is disconnected, or the fridge setting is INVALID_TEMP
 	if( cs.fridgeSetting == INVALID_TEMP || 
 		!fridgeSensor->isConnected() || 
-		(!beerSensor->isConnected() && tempControl.modeIsBeer())){
-		state = IDLE;
-		stayIdle = true;
+		(!beerSensor->isConnected() && tempControl.modeNeedsBeer())){
+		conditions |= CONDITION_NO_CONTROL;
 	}
 	
-	uint16_t sinceIdle = timeSinceIdle();
-	uint16_t sinceCooling = timeSinceCooling();
-	uint16_t sinceHeating = timeSinceHeating();
+	ticks_seconds_t sinceIdle = timeSinceIdle();
+	ticks_seconds_t sinceCooling = timeSinceCooling();
+	ticks_seconds_t sinceHeating = timeSinceHeating();
 	temperature fridgeFast = fridgeSensor->readFastFiltered();
-	temperature beerFast = beerSensor->readFastFiltered();
+	// the beer checks follow the beer whose demand the fridge is set to
+	temperature beerFast = beers[leadBeer].sensor->readFastFiltered();
+	temperature beerSetting = getBeerSetting(leadBeer);
 	ticks_seconds_t secs = ticks.seconds();
-	switch(state)
-	{
-		case IDLE:
-		case STATE_OFF:
-		case WAITING_TO_COOL:
-		case WAITING_TO_HEAT:
-		case WAITING_FOR_PEAK_DETECT:
-		{
-			lastIdleTime=secs;		
-			// set waitTime to zero. It will be set to the maximum required waitTime below when wait is in effect.
-			if(stayIdle){
-				break;
-			}
-			resetWaitTime();
-			if(fridgeFast > (cs.fridgeSetting+cc.idleRangeHigh) ){  // fridge temperature is too high			
-				tempControl.updateWaitTime(MIN_SWITCH_TIME, sinceHeating);			
-				if(cs.mode==MODE_FRIDGE_CONSTANT){
-					tempControl.updateWaitTime(MIN_COOL_OFF_TIME_FRIDGE_CONSTANT, sinceCooling);
-				}
-				else{
-					if(beerFast < (cs.beerSetting + 16) ){ // If beer is already under target, stay/go to idle. 1/2 sensor bit idle zone
-						state = IDLE; // beer is already colder than setting, stay in or go to idle
-						break;
-					}
-					tempControl.updateWaitTime(MIN_COOL_OFF_TIME, sinceCooling);
-				}
-				if(tempControl.cooler != &defaultActuator){
-					if(getWaitTime() > 0){
-						state = WAITING_TO_COOL;
-					}
-					else{
-						state = COOLING;	
-					}
-				}
+	uint8_t from = state;
+
+	uint8_t rule = matchStateRule(state, conditions, 0, STATE_RULES_ANY);
+	if(rule < STATE_RULES_ANY){
+		lastIdleTime = secs;
+	}
+	else if(stateIsCooling()){
+		doNegPeakDetect = true;
+		lastCoolTime = secs;
+		updateEstimatedPeak(cc.maxCoolTimeForEstimate, cs.coolEstimator, sinceIdle);
+		// stop cooling when estimated fridge temp peak lands on target or if beer is already too cold (1/2 sensor bit idle zone)
+		if(cv.estimatedPeak <= cs.fridgeSetting || (modeIsBeer() && beerFast < (beerSetting - 16))){
+			conditions |= CONDITION_PEAK_REACHED;
+		}
+		if(sinceIdle > MIN_COOL_ON_TIME){
+			conditions |= CONDITION_MIN_ON_PASSED;
+		}
+	}
+	else if(stateIsHeating()){
+		doPosPeakDetect = true;
+		lastHeatTime = secs;
+		updateEstimatedPeak(cc.maxHeatTimeForEstimate, cs.heatEstimator, sinceIdle);
+		// stop heating when estimated fridge temp peak lands on target or if beer is already too warm (1/2 sensor bit idle zone)
+		if(cv.estimatedPeak >= cs.fridgeSetting || (modeIsBeer() && beerFast > (beerSetting + 16))){
+			conditions |= CONDITION_PEAK_REACHED;
+		}
+		if(sinceIdle > MIN_HEAT_ON_TIME){
+			conditions |= CONDITION_MIN_ON_PASSED;
+		}
+	}
+	else{
+		lastIdleTime = secs;
+		// set waitTime to zero. It will be set to the maximum required waitTime below when wait is in effect.
+		resetWaitTime();
+		if(fridgeFast > (cs.fridgeSetting+cc.idleRangeHigh)){  // fridge temperature is too high
+			conditions |= CONDITION_FRIDGE_HIGH;
+			tempControl.updateWaitTime(MIN_SWITCH_TIME, sinceHeating);
+			if(cs.mode == MODE_FRIDGE_CONSTANT){
+				tempControl.updateWaitTime(MIN_COOL_OFF_TIME_FRIDGE_CONSTANT, sinceCooling);
 			}
-			else if(fridgeFast < (cs.fridgeSetting+cc.idleRangeLow)){  // fridge temperature is too low
-				tempControl.updateWaitTime(MIN_SWITCH_TIME, sinceCooling);
-				tempControl.updateWaitTime(MIN_HEAT_OFF_TIME, sinceHeating);
-				if(cs.mode!=MODE_FRIDGE_CONSTANT){
-					if(beerFast > (cs.beerSetting - 16)){ // If beer is already over target, stay/go to idle. 1/2 sensor bit idle zone
-						state = IDLE;  // beer is already warmer than setting, stay in or go to idle
-						break;
-					}
-				}
-				if(tempControl.heater != &defaultActuator || (cc.lightAsHeater && (tempControl.light != &defaultActuator))){
-					if(getWaitTime() > 0){
-						state = WAITING_TO_HEAT;
-					}
-					else{
-						state = HEATING;
-					}
-				}
+			// autotune and the model predictive mode set the fridge past the beer setting on purpose, so only the PID modes check the beer
+			else if(modeIsBeer() && beerFast < (beerSetting + 16)){
+				conditions |= CONDITION_BEER_COLD;
 			}
 			else{
-				state = IDLE; // within IDLE range, always go to IDLE
-				break;
-			}
-			if(state == HEATING || state == COOLING){	
-				if(doNegPeakDetect == true || doPosPeakDetect == true){
-					// If peak detect is not finished, but the fridge wants to switch to heat/cool
-					// Wait for peak detection and display 'Await peak detect' on display
-					state = WAITING_FOR_PEAK_DETECT;
-					break;
-				}
-			}
-		}			
-		break; 
-		case COOLING:
-		case COOLING_MIN_TIME:
-		{
-			doNegPeakDetect=true;
-			lastCoolTime = secs;
-			updateEstimatedPeak(cc.maxCoolTimeForEstimate, cs.coolEstimator, sinceIdle);
-			state = COOLING; // set to cooling here, so the display of COOLING/COOLING_MIN_TIME is correct
-			
-			// stop cooling when estimated fridge temp peak lands on target or if beer is already too cold (1/2 sensor bit idle zone)
-			if(cv.estimatedPeak <= cs.fridgeSetting || (cs.mode != MODE_FRIDGE_CONSTANT && beerFast < (cs.beerSetting - 16))){
-				if(sinceIdle > MIN_COOL_ON_TIME){
-					cv.negPeakEstimate = cv.estimatedPeak; // remember estimated peak when I switch to IDLE, to adjust estimator later
-					state=IDLE;
-					break;
-				}
-				else{
-					state = COOLING_MIN_TIME;
-					break;
-				}				
+				tempControl.updateWaitTime(MIN_COOL_OFF_TIME, sinceCooling);
 			}
 		}
-		break;
-		case HEATING:
-		case HEATING_MIN_TIME:
-		{
-			doPosPeakDetect=true;
-			lastHeatTime=secs;
-			updateEstimatedPeak(cc.maxHeatTimeForEstimate, cs.heatEstimator, sinceIdle);
-			state = HEATING; // reset to heating here, so the display of HEATING/HEATING_MIN_TIME is correct
-			
-			// stop heating when estimated fridge temp peak lands on target or if beer is already too warm (1/2 sensor bit idle zone)
-			if(cv.estimatedPeak >= cs.fridgeSetting || (cs.mode != MODE_FRIDGE_CONSTANT && beerFast > (cs.beerSetting + 16))){
-				if(sinceIdle > MIN_HEAT_ON_TIME){
-					cv.posPeakEstimate=cv.estimatedPeak; // remember estimated peak when I switch to IDLE, to adjust estimator later
-					state=IDLE;
-					break;
-				}
-				else{
-					state = HEATING_MIN_TIME;
-					break;
-				}
+		else if(fridgeFast < (cs.fridgeSetting+cc.idleRangeLow)){  // fridge temperature is too low
+			conditions |= CONDITION_FRIDGE_LOW;
+			tempControl.updateWaitTime(MIN_SWITCH_TIME, sinceCooling);
+			tempControl.updateWaitTime(MIN_HEAT_OFF_TIME, sinceHeating);
+			if(modeIsBeer() && beerFast > (beerSetting - 16)){
+				conditions |= CONDITION_BEER_WARM;
 			}
 		}
-		break;
-	}			
+		if(tempControl.cooler == &defaultActuator){
+			conditions |= CONDITION_NO_COOLER;
+		}
+		if(tempControl.heater == &defaultActuator && !(cc.lightAsHeater && (tempControl.light != &defaultActuator))){
+			conditions |= CONDITION_NO_HEATER;
+		}
+		if(getWaitTime() > 0){
+			conditions |= CONDITION_WAITING;
+		}
+		if(doNegPeakDetect || doPosPeakDetect){
+			// the fridge would like to switch to heat/cool, but peak detection is not finished
+			conditions |= CONDITION_PEAK_PENDING;
+		}
+	}
+	if(rule >= STATE_RULES_ANY){
+		rule = matchStateRule(state, conditions, STATE_RULES_ANY, STATE_RULES);
+	}
+	if(rule < STATE_RULES && stateRules[rule].to != STATE_UNCHANGED){
+		state = stateRules[rule].to;
+	}
+	if(state == from){
+		return;
+	}
+
+	if(state == IDLE && rule >= STATE_RULES_ANY){
+		// remember the estimated peak when switching to idle, to adjust the estimator when the real peak is detected
+		if(STATE_BIT(from) & STATES_COOLING){
+			cv.negPeakEstimate = cv.estimatedPeak;
+		}
+		else if(STATE_BIT(from) & STATES_HEATING){
+			cv.posPeakEstimate = cv.estimatedPeak;
+		}
+	}
+	StateTransition transition;
+	transition.time = secs;
+	transition.chamber = chamberManager.current();
+	transition.from = from;
+	transition.to = state;
+	transition.rule = rule;
+	transition.fridgeTemp = fridgeFast;
+	transition.fridgeSetting = cs.fridgeSetting;
+	transition.beerTemp = beerFast;
+	transition.beerSetting = beerSetting;
+	stateTrace.record(transition);
 }
 
-void TempControl::updateEstimatedPeak(uint16_t timeLimit, temperature estimator, uint16_t sinceIdle)
+void TempControl::updateEstimatedPeak(uint16_t timeLimit, temperature estimator, ticks_seconds_t sinceIdle)
 {
-	uint16_t activeTime = min(timeLimit, sinceIdle); // heat or cool time in seconds
+	uint16_t activeTime = sinceIdle<timeLimit ? sinceIdle : timeLimit; // heat or cool time in seconds
 	temperature estimatedOvershoot = ((long_temperature) estimator * activeTime)/3600; // overshoot estimator is in overshoot per hour
 	if(stateIsCooling()){
 		estimatedOvershoot = -estimatedOvershoot; // when cooling subtract overshoot from fridge temperature
@@ -383,10 +549,21 @@ void TempControl::updateOutputs(void) {
 	cameraLight.update();
 	bool heating = stateIsHeating();
 	bool cooling = stateIsCooling();
+#if BREWPI_DS2413 && !BREWPI_SIMULATE
+	// outputs sharing a DS2413 are written together, and only when they change
+	DS2413::beginBatch();
+#endif
 	cooler->setActive(cooling);		
 	heater->setActive(!cc.lightAsHeater && heating);	
 	light->setActive(isDoorOpen() || (cc.lightAsHeater && heating) || cameraLightState.isActive());	
 	fan->setActive(heating || cooling);
+	bool beerMode = modeIsBeer();
+	for (uint8_t i=0; i<BREWPI_BEERS; i++)
+		beers[i].updateOutputs(getBeerSetting(i), beerMode);
+#if BREWPI_DS2413 && !BREWPI_SIMULATE
+	DS2413::endBatch();
+#endif
+	actuatorMeter.update(cooling, heating);
 }
 
 
@@ -501,15 +678,15 @@ void TempControl::decreaseEstimator(temperature * estimator, temperature error){
 	eepromManager.storeTempSettings();
 }
 
-uint16_t TempControl::timeSinceCooling(void){
+ticks_seconds_t TempControl::timeSinceCooling(void){
 	return ticks.timeSince(lastCoolTime);
 }
 
-uint16_t TempControl::timeSinceHeating(void){
+ticks_seconds_t TempControl::timeSinceHeating(void){
 	return ticks.timeSince(lastHeatTime);
 }
 
-uint16_t TempControl::timeSinceIdle(void){
+ticks_seconds_t TempControl::timeSinceIdle(void){
 	return ticks.timeSince(lastIdleTime);
 }
 
@@ -571,12 +748,16 @@ void TempControl::setMode(char newMode, bool force){
 		force = true;
 	}
 	if (force) {
+		if(newMode != MODE_AUTOTUNE){
+			pidAutotune.stop();
+		}
 		cs.mode = newMode;
 		if(newMode == MODE_OFF){
 			cs.beerSetting = INVALID_TEMP;
 			cs.fridgeSetting = INVALID_TEMP;
 		}
 		eepromManager.storeTempSettings();
+		eepromManager.flushSettings();	// the mode must survive a power loss
 	}
 }
 
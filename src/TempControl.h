@@ -28,6 +28,7 @@
 #include "EepromManager.h"
 #include "ActuatorAutoOff.h"
 #include "EepromStructs.h"
+#include "BeerControl.h"
 
 
 // Set minimum off time to prevent short cycling the compressor in seconds
@@ -73,6 +74,8 @@ struct ControlVariables{
 #define MODE_BEER_PROFILE 'p'
 #define MODE_OFF 'o'
 #define MODE_TEST 't'
+#define MODE_AUTOTUNE 'a'
+#define MODE_MODEL_PREDICTIVE 'm'
 
 
 enum states{
@@ -134,9 +137,9 @@ class TempControl{
 	
 	//TEMP_CONTROL_METHOD void loadSettingsAndConstants(void);
 		
-	TEMP_CONTROL_METHOD uint16_t timeSinceCooling(void);
- 	TEMP_CONTROL_METHOD uint16_t timeSinceHeating(void);
-  	TEMP_CONTROL_METHOD uint16_t timeSinceIdle(void);
+	TEMP_CONTROL_METHOD ticks_seconds_t timeSinceCooling(void);
+ 	TEMP_CONTROL_METHOD ticks_seconds_t timeSinceHeating(void);
+  	TEMP_CONTROL_METHOD ticks_seconds_t timeSinceIdle(void);
 	  
 	TEMP_CONTROL_METHOD temperature getBeerTemp(void);
 	TEMP_CONTROL_METHOD temperature getBeerSetting(void);
@@ -159,7 +162,7 @@ class TempControl{
 		return state;
 	}
 	
-	TEMP_CONTROL_METHOD uint16_t getWaitTime(void){
+	TEMP_CONTROL_METHOD ticks_seconds_t getWaitTime(void){
 		return waitTime;
 	}
 	
@@ -167,10 +170,9 @@ class TempControl{
 		waitTime = 0;
 	}
 	
-	// TEMP_CONTROL_METHOD void updateWaitTime(uint16_t newTimeLimit, uint16_t newTimeSince);
-	TEMP_CONTROL_METHOD void updateWaitTime(uint16_t newTimeLimit, uint16_t newTimeSince){
+	TEMP_CONTROL_METHOD void updateWaitTime(ticks_seconds_t newTimeLimit, ticks_seconds_t newTimeSince){
 		if(newTimeSince < newTimeLimit){
-			uint16_t newWaitTime = newTimeLimit - newTimeSince;
+			ticks_seconds_t newWaitTime = newTimeLimit - newTimeSince;
 			if(newWaitTime > waitTime){
 				waitTime = newWaitTime;
 			}
@@ -182,6 +184,10 @@ class TempControl{
 	TEMP_CONTROL_METHOD bool modeIsBeer(void){
 		return (cs.mode == MODE_BEER_CONSTANT || cs.mode == MODE_BEER_PROFILE);
 	}
+	// the modes that control the beer, with or without the beer PID
+	TEMP_CONTROL_METHOD bool modeNeedsBeer(void){
+		return modeIsBeer() || cs.mode == MODE_AUTOTUNE || cs.mode == MODE_MODEL_PREDICTIVE;
+	}
 		
 	TEMP_CONTROL_METHOD void initFilters();
 	
@@ -191,11 +197,25 @@ class TempControl{
 		return isDoorOpen() ? DOOR_OPEN : getState();
 	}
 
+	/**
+	 * The setting of a beer in the chamber, counted from 0.
+	 */
+	TEMP_CONTROL_METHOD temperature getBeerSetting(uint8_t beer) {
+		return beer ? beers[beer].cs.beerSetting : cs.beerSetting;
+	}
+
+	/**
+	 * The beer whose fridge demand the chamber is following, counted from 0.
+	 */
+	TEMP_CONTROL_METHOD uint8_t getLeadBeer() { return leadBeer; }
+
 	private:
 	TEMP_CONTROL_METHOD void increaseEstimator(temperature * estimator, temperature error);
 	TEMP_CONTROL_METHOD void decreaseEstimator(temperature * estimator, temperature error);
 	
-	TEMP_CONTROL_METHOD void updateEstimatedPeak(uint16_t estimate, temperature estimator, uint16_t sinceIdle);
+	TEMP_CONTROL_METHOD void updateEstimatedPeak(uint16_t estimate, temperature estimator, ticks_seconds_t sinceIdle);
+	TEMP_CONTROL_METHOD void arbitrateBeers(void);
+	TEMP_CONTROL_METHOD void updateAutotune(void);
 	public:
 	TEMP_CONTROL_FIELD TempSensor* beerSensor;
 	TEMP_CONTROL_FIELD TempSensor* fridgeSensor;
@@ -206,6 +226,7 @@ class TempControl{
 	TEMP_CONTROL_FIELD Actuator* fan;
 	TEMP_CONTROL_FIELD AutoOffActuator cameraLight;
 	TEMP_CONTROL_FIELD Sensor<bool>* door;
+	TEMP_CONTROL_FIELD BeerControl beers[BREWPI_BEERS];	// beers[0] is the first beer, also beerSensor, cs and cv
 	
 	// Control parameters
 	TEMP_CONTROL_FIELD ControlConstants cc;
@@ -219,11 +240,11 @@ class TempControl{
 	// keep track of beer setting stored in EEPROM
 	TEMP_CONTROL_FIELD temperature storedBeerSetting;
 
-	// Timers
-	TEMP_CONTROL_FIELD uint16_t lastIdleTime;
-	TEMP_CONTROL_FIELD uint16_t lastHeatTime;
-	TEMP_CONTROL_FIELD uint16_t lastCoolTime;
-	TEMP_CONTROL_FIELD uint16_t waitTime;
+	// Timers, in ticks.seconds()
+	TEMP_CONTROL_FIELD ticks_seconds_t lastIdleTime;
+	TEMP_CONTROL_FIELD ticks_seconds_t lastHeatTime;
+	TEMP_CONTROL_FIELD ticks_seconds_t lastCoolTime;
+	TEMP_CONTROL_FIELD ticks_seconds_t waitTime;
 	
 	
 	// State variables
@@ -231,8 +252,10 @@ class TempControl{
 	TEMP_CONTROL_FIELD bool doPosPeakDetect;
 	TEMP_CONTROL_FIELD bool doNegPeakDetect;
 	TEMP_CONTROL_FIELD bool doorOpen;
+	TEMP_CONTROL_FIELD uint8_t leadBeer;
 	
 	friend class TempControlState;
+	friend class Chamber;
 };
 	
 extern TempControl tempControl;
@@ -0,0 +1,206 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include <stddef.h>
+#include "TempControlState.h"
+#include "OneWire.h"
+#include "Ticks.h"
+#include "Logger.h"
+#include "ChamberManager.h"
+
+TempControlState tempControlState;
+
+uint32_t TempControlState::sequence = 0;
+
+#define SNAPSHOT_WORDS(type) ((sizeof(type)+3)/4)
+#define SNAPSHOT_HEADER_WORDS SNAPSHOT_WORDS(TempControlSnapshotHeader)
+#define SNAPSHOT_CHAMBER_WORDS SNAPSHOT_WORDS(ChamberSnapshot)
+#define TEMP_CONTROL_SNAPSHOT_WORDS (SNAPSHOT_HEADER_WORDS + BREWPI_CHAMBERS*SNAPSHOT_CHAMBER_WORDS)
+
+// The first 128 bytes (32 blocks) of RTC user memory are used by the OTA bootloader
+#define TEMP_CONTROL_SNAPSHOT_RTC_OFFSET 32
+static_assert(TEMP_CONTROL_SNAPSHOT_RTC_OFFSET*4 + TEMP_CONTROL_SNAPSHOT_WORDS*4 <= 512,
+	"snapshot does not fit in RTC user memory");
+
+#ifndef ESP8266
+// Off-device, RAM stands in for RTC memory, so a simulated reboot can resume within the same process
+static uint32_t snapshotWords[TEMP_CONTROL_SNAPSHOT_WORDS];
+#endif
+
+/**
+ * crc16 of a snapshot from the field after its crc, which is at the given offset.
+ */
+template<class T> static uint16_t snapshotCrc(const T& snapshot, size_t crcOffset)
+{
+	size_t start = crcOffset + sizeof(uint16_t);
+	return OneWire::crc16((const uint8_t*)&snapshot + start, sizeof(T) - start);
+}
+
+bool TempControlState::read(uint16_t offset, void* data, uint16_t size)
+{
+	uint32_t words[SNAPSHOT_CHAMBER_WORDS > SNAPSHOT_HEADER_WORDS ? SNAPSHOT_CHAMBER_WORDS : SNAPSHOT_HEADER_WORDS];
+#ifdef ESP8266
+	if (!ESP.rtcUserMemoryRead(TEMP_CONTROL_SNAPSHOT_RTC_OFFSET + offset, words, (size+3)&~3))
+		return false;
+#else
+	memcpy(words, snapshotWords + offset, (size+3)&~3);
+#endif
+	memcpy(data, words, size);
+	return true;
+}
+
+void TempControlState::write(uint16_t offset, const void* data, uint16_t size)
+{
+	uint32_t words[SNAPSHOT_CHAMBER_WORDS > SNAPSHOT_HEADER_WORDS ? SNAPSHOT_CHAMBER_WORDS : SNAPSHOT_HEADER_WORDS];
+	words[(size-1)/4] = 0;
+	memcpy(words, data, size);
+#ifdef ESP8266
+	ESP.rtcUserMemoryWrite(TEMP_CONTROL_SNAPSHOT_RTC_OFFSET + offset, words, (size+3)&~3);
+#else
+	memcpy(snapshotWords + offset, words, (size+3)&~3);
+#endif
+}
+
+void TempControlState::saveChamber(ChamberSnapshot& s)
+{
+	memset(&s, 0, sizeof(s));		// clear the padding, which is covered by the crc
+	s.sequence = uint16_t(sequence);
+	s.mode = tempControl.cs.mode;
+	s.state = tempControl.state;
+	s.leadBeer = tempControl.leadBeer;
+	s.doPosPeakDetect = tempControl.doPosPeakDetect;
+	s.doNegPeakDetect = tempControl.doNegPeakDetect;
+	s.beerSetting = tempControl.cs.beerSetting;
+	s.fridgeSetting = tempControl.cs.fridgeSetting;
+	s.sinceIdle = tempControl.timeSinceIdle();
+	s.sinceHeating = tempControl.timeSinceHeating();
+	s.sinceCooling = tempControl.timeSinceCooling();
+	s.waitTime = tempControl.waitTime;
+	const ControlVariables& cv = tempControl.cv;
+	s.diffIntegral = cv.diffIntegral;
+	s.estimatedPeak = cv.estimatedPeak;
+	s.negPeakEstimate = cv.negPeakEstimate;
+	s.posPeakEstimate = cv.posPeakEstimate;
+	s.negPeak = cv.negPeak;
+	s.posPeak = cv.posPeak;
+	tempControl.beerSensor->saveState(s.beerSensor);
+	tempControl.fridgeSensor->saveState(s.fridgeSensor);
+	for (uint8_t i=1; i<BREWPI_BEERS; i++) {
+		const BeerControl& beer = tempControl.beers[i];
+		BeerSnapshot& b = s.beers[i-1];
+		b.diffIntegral = beer.diffIntegral;
+		b.beerSetting = beer.cs.beerSetting;
+		b.integralUpdateCounter = beer.integralUpdateCounter;
+		beer.sensor->saveState(b.sensor);
+	}
+	s.crc = snapshotCrc(s, offsetof(ChamberSnapshot, crc));
+}
+
+void TempControlState::save()
+{
+	sequence++;
+	uint8_t selected = chamberManager.current();
+	TempControlSnapshotHeader h;
+	memset(&h, 0, sizeof(h));
+	h.magic = TEMP_CONTROL_SNAPSHOT_MAGIC;
+	h.sequence = sequence;
+	h.chambers = chamberManager.count();
+	h.current = selected;
+	for (uint8_t i=0; i<h.chambers; i++) {
+		chamberManager.switchChamber(i);
+		ChamberSnapshot s;
+		saveChamber(s);
+		write(SNAPSHOT_HEADER_WORDS + i*SNAPSHOT_CHAMBER_WORDS, &s, sizeof(s));
+	}
+	chamberManager.switchChamber(selected);
+	h.crc = snapshotCrc(h, offsetof(TempControlSnapshotHeader, crc));
+	write(0, &h, sizeof(h));
+}
+
+bool TempControlState::restoreChamber(const ChamberSnapshot& s)
+{
+	if (s.mode!=tempControl.cs.mode)
+		return false;
+
+	// a beer profile setting sent by the script is not always persisted, so take the one in use before the reset
+	tempControl.cs.beerSetting = s.beerSetting;
+	tempControl.cs.fridgeSetting = s.fridgeSetting;
+
+	ticks_seconds_t now = ticks.seconds();
+	tempControl.lastIdleTime = now - s.sinceIdle;
+	tempControl.lastHeatTime = now - s.sinceHeating;
+	tempControl.lastCoolTime = now - s.sinceCooling;
+	tempControl.waitTime = s.waitTime;
+	tempControl.state = s.state;
+	tempControl.leadBeer = s.leadBeer<BREWPI_BEERS ? s.leadBeer : 0;
+	tempControl.doPosPeakDetect = s.doPosPeakDetect;
+	tempControl.doNegPeakDetect = s.doNegPeakDetect;
+	ControlVariables& cv = tempControl.cv;
+	cv.diffIntegral = s.diffIntegral;
+	cv.estimatedPeak = s.estimatedPeak;
+	cv.negPeakEstimate = s.negPeakEstimate;
+	cv.posPeakEstimate = s.posPeakEstimate;
+	cv.negPeak = s.negPeak;
+	cv.posPeak = s.posPeak;
+	tempControl.beerSensor->restoreState(s.beerSensor);
+	tempControl.fridgeSensor->restoreState(s.fridgeSensor);
+	for (uint8_t i=1; i<BREWPI_BEERS; i++) {
+		BeerControl& beer = tempControl.beers[i];
+		const BeerSnapshot& b = s.beers[i-1];
+		beer.diffIntegral = b.diffIntegral;
+		beer.cs.beerSetting = b.beerSetting;
+		beer.integralUpdateCounter = b.integralUpdateCounter;
+		beer.sensor->restoreState(b.sensor);
+	}
+	logDebug("resumed control state %d", s.state);
+	return true;
+}
+
+uint8_t TempControlState::restore()
+{
+	TempControlSnapshotHeader h;
+	if (!read(0, &h, sizeof(h)) || h.magic!=TEMP_CONTROL_SNAPSHOT_MAGIC
+		|| h.crc!=snapshotCrc(h, offsetof(TempControlSnapshotHeader, crc))
+		|| !h.chambers || h.chambers>BREWPI_CHAMBERS || h.current>=h.chambers)
+		return 0;
+	sequence = h.sequence;
+
+#ifdef ESP8266
+	// RTC memory holds garbage after power up, and if the crc happens to match, the timings would be stale anyway
+	if (ESP.getResetInfoPtr()->reason==REASON_DEFAULT_RST)
+		return 0;
+#endif
+
+	uint8_t resumed = 0;
+	for (uint8_t i=0; i<h.chambers; i++) {
+		ChamberSnapshot s;
+		// a reset during the save can leave a record one save newer than the header
+		if (!read(SNAPSHOT_HEADER_WORDS + i*SNAPSHOT_CHAMBER_WORDS, &s, sizeof(s))
+			|| s.crc!=snapshotCrc(s, offsetof(ChamberSnapshot, crc)) || uint16_t(s.sequence-uint16_t(h.sequence))>1)
+			continue;
+		chamberManager.switchChamber(i);	// brings the chamber into use, with its stored settings
+		if (restoreChamber(s))
+			resumed++;
+	}
+	chamberManager.switchChamber(h.current);
+	return resumed;
+}
+
+#endif
@@ -0,0 +1,119 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+#pragma once
+
+#include "Brewpi.h"
+
+#if defined(ESP8266) || !defined(ARDUINO)
+
+#include "TempControl.h"
+
+#define TEMP_CONTROL_SNAPSHOT_MAGIC 0x42505454UL
+
+/**
+ * Which chambers were snapshotted, written after their records.
+ */
+struct TempControlSnapshotHeader {
+	uint32_t magic;
+	uint32_t sequence;			// incremented on every save, carried over when the state is resumed
+	uint16_t crc;				// crc16 of the fields below
+	uint8_t chambers;			// chambers in use, each with a record
+	uint8_t current;			// the chamber selected, counted from 0
+};
+
+/**
+ * The PID state of a beer other than the first, which uses the chamber's ControlVariables.
+ */
+struct BeerSnapshot {
+	long_temperature diffIntegral;
+	temperature beerSetting;
+	uint8_t integralUpdateCounter;
+	TempSensorState sensor;
+};
+
+/**
+ * The runtime state of the control loop of one chamber. The timers are kept as the time elapsed since each
+ * event, since the seconds counter starts again from zero after a reset. Of the ControlVariables, only the
+ * ones carried from tick to tick are kept: the rest are worked out again by the next tick.
+ */
+struct ChamberSnapshot {
+	uint16_t sequence;			// low bits of the sequence of the save it was written in
+	uint16_t crc;				// crc16 of the fields below
+	char mode;
+	uint8_t state;
+	uint8_t leadBeer;
+	bool doPosPeakDetect;
+	bool doNegPeakDetect;
+	temperature beerSetting;
+	temperature fridgeSetting;
+	ticks_seconds_t sinceIdle;
+	ticks_seconds_t sinceHeating;
+	ticks_seconds_t sinceCooling;
+	ticks_seconds_t waitTime;
+	long_temperature diffIntegral;
+	temperature estimatedPeak;
+	temperature negPeakEstimate;
+	temperature posPeakEstimate;
+	temperature negPeak;
+	temperature posPeak;
+	TempSensorState beerSensor;
+	TempSensorState fridgeSensor;
+	BeerSnapshot beers[BREWPI_BEERS>1 ? BREWPI_BEERS-1 : 1];
+};
+
+/**
+ * Keeps a snapshot of the control loop's runtime state where it survives a watchdog reset or a restart,
+ * so that after the reboot control carries on within a tick: the state machine, peak detection, the PID
+ * integrals and the filters of every chamber in use pick up where they were, and the minimum on/off times of the
+ * compressors and heaters are still counted from when they last switched. The chamber that was selected is
+ * selected again.
+ *
+ * On the ESP8266 the snapshot is kept in RTC user memory, which is retained across resets but not power loss,
+ * and costs no flash wear. It is saved each control tick: a record per chamber, each with its own crc, and then
+ * the header. A record torn by a reset during a save fails its crc, and only that chamber starts afresh, as after
+ * power up. Time spent rebooting is not counted, which errs on the side of waiting longer.
+ */
+class TempControlState
+{
+public:
+	/**
+	 * Saves the state of all chambers in use. Called once per control tick, after the outputs of all chambers
+	 * have been updated.
+	 */
+	static void save();
+
+	/**
+	 * Resumes each chamber from its record, unless the chip was powered up rather than reset, or the mode of the
+	 * chamber has changed since, and selects the chamber that was selected. Call after the settings and devices
+	 * have been loaded.
+	 * Returns the number of chambers resumed.
+	 */
+	static uint8_t restore();
+
+private:
+	static void saveChamber(ChamberSnapshot& snapshot);
+	static bool restoreChamber(const ChamberSnapshot& snapshot);
+
+	static bool read(uint16_t offset, void* data, uint16_t size);
+	static void write(uint16_t offset, const void* data, uint16_t size);
+
+	static uint32_t sequence;
+};
+
+extern TempControlState tempControlState;
+
+#endif
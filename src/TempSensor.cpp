@@ -107,3 +107,20 @@ void TempSensor::setSlopeFilterCoefficients(uint8_t b){
 BasicTempSensor& TempSensor::sensor() {
 	return *_sensor;
 }
+
+void TempSensor::saveState(TempSensorState& state){
+	state.fast = fastFilter.readOutput();
+	state.slow = slowFilter.readOutput();
+	state.slope = readSlope();
+}
+
+bool TempSensor::restoreState(const TempSensorState& state){
+	if (failedReadCount!=0 || state.fast==INVALID_TEMP || state.slow==INVALID_TEMP)
+		return false;
+	fastFilter.init(state.fast);
+	slowFilter.init(state.slow);
+	slopeFilter.init(state.slope);
+	prevOutputForSlope = slowFilter.readOutputDoublePrecision();
+	updateCounter = 3;
+	return true;
+}
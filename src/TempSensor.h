@@ -38,6 +38,17 @@ typedef FixedFilter TempSensorFilter;
 #endif
 
 
+/**
+ * The state of a sensor's filters, reduced to their outputs. Restoring it lets filtering continue after a
+ * reset without waiting for the filters, and the slope, to settle again. The slope picks up from the slow
+ * output at the time of the restore.
+ */
+struct TempSensorState {
+	temperature fast;
+	temperature slow;
+	temperature slope;
+};
+
 enum TempSensorType {
 	TEMP_SENSOR_TYPE_FRIDGE=1,
 	TEMP_SENSOR_TYPE_BEER
@@ -85,6 +96,13 @@ class TempSensor {
 	void setSlopeFilterCoefficients(uint8_t b);
 	
 	BasicTempSensor& sensor();
+
+	void saveState(TempSensorState& state);
+
+	/**
+	 * Restarts the filters from a saved state. Returns false if the state holds no reading.
+	 */
+	bool restoreState(const TempSensorState& state);
 	 
 	private:	
 	BasicTempSensor* _sensor;
@@ -121,7 +121,7 @@ long_temperature stringToFixedPoint(const char * numberString){
 	long_temperature intPart = 0;
 	long_temperature fracPart = 0;
 	
-	char * fractPtr = 0; //pointer to the point in the string
+	const char * fractPtr = 0; //pointer to the point in the string
 	bool negative = 0;
 	if(numberString[0] == '-'){
 		numberString++;
@@ -129,10 +129,10 @@ long_temperature stringToFixedPoint(const char * numberString){
 	}
 	
 	// find the point in the string to split in the integer part and the fraction part
-	fractPtr = strchrnul(numberString, '.'); // returns pointer to the point.
+	fractPtr = strchrnul(numberString, '.'); // returns pointer to the point, or to the terminator when there is none.
 	
 	intPart = atol(numberString);
-	if(fractPtr != 0){
+	if(*fractPtr == '.'){
 		// decimal point was found
 		fractPtr++; // add 1 to pointer to skip point
 		int8_t numDecimals = (int8_t) strlen(fractPtr);
@@ -21,15 +21,9 @@
 #include "Brewpi.h"
 #include "Ticks.h"
 
-// return time that has passed since timeStamp, take overflow into account
+// return time that has passed since timeStamp, unsigned subtraction takes overflow into account
 inline ticks_seconds_t timeSince(ticks_seconds_t currentTime, ticks_seconds_t previousTime){
-	if(currentTime>=previousTime){
-		return currentTime - previousTime;
-	}
-	else{
-		// overflow has occurred
-		return (currentTime + 1440) - (previousTime +1440); // add a day to both for calculation
-	}
+	return currentTime - previousTime;
 }
 
 // return time that has passed since timeStamp, take overflow into account
@@ -47,7 +41,19 @@ ticks_seconds_t HardwareTicks::timeSince(ticks_seconds_t previousTime){
 	return ::timeSince(currentTime, previousTime);
 }
 
-ticks_seconds_t HardwareTicks::seconds() { return ::millis()/1000; }
+ticks_seconds_t HardwareTicks::seconds() { return ticks_seconds_t(micros64()/1000000); }
+
+#ifndef ESP8266
+// extends micros() by counting its wraps, so it has to be called at least once every 71 minutes. seconds() is called
+// every control tick.
+ticks_micros64_t HardwareTicks::micros64() {
+	ticks_micros_t now = ::micros();
+	if (now<lastMicros)
+		microsWraps++;
+	lastMicros = now;
+	return (ticks_micros64_t(microsWraps)<<32) | now;
+}
+#endif
 	
 
 void HardwareDelay::millis(uint16_t millis) { ::delay(millis); }
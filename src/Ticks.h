@@ -24,12 +24,16 @@
 
 typedef uint32_t ticks_millis_t;
 typedef uint32_t ticks_micros_t;
-typedef uint16_t ticks_seconds_t;
+typedef uint64_t ticks_micros64_t;	// does not wrap
+typedef uint32_t ticks_seconds_t;	// wraps after 136 years, differences are overflow safe
 typedef uint8_t ticks_seconds_tiny_t;
 
 /**
  * Ticks - interface to a millisecond timer
  *
+ * millis() and micros() wrap, so only the difference of two readings is meaningful. seconds() and micros64() count
+ * from power up without wrapping, so they can time control intervals of any length and profile the loop.
+ *
  * With more code space, Ticks would have been a virtual base class, so all implementations can easily provide the same interface.
  * Here, the different implementations have no common (virtual) base class to save code space. 
  * Instead, a typedef is used to compile-time select the implementation to use.
@@ -46,8 +50,9 @@ public:
 
 	ticks_millis_t millis() { return _ticks+=_increment; }
 	ticks_micros_t micros() { return _ticks+=_increment; }	
+	ticks_micros64_t micros64() { return micros(); }
 	ticks_seconds_t seconds() { return millis()>>10; }	
-	ticks_seconds_t timeSince(ticks_seconds_t timeStamp) { return timeStamp-seconds(); }
+	ticks_seconds_t timeSince(ticks_seconds_t timeStamp) { return seconds()-timeStamp; }
 private:
 
 	uint32_t _increment;
@@ -62,15 +67,16 @@ class ExternalTicks {
 	public:
 	ExternalTicks() : _ticks(0) { }
 
-	ticks_millis_t millis() { return _ticks; }
-	ticks_micros_t micros() { return _ticks*1000; }	
-	ticks_seconds_t seconds() { return millis()/1000; }	
+	ticks_millis_t millis() { return ticks_millis_t(_ticks); }
+	ticks_micros_t micros() { return ticks_micros_t(_ticks*1000); }	
+	ticks_micros64_t micros64() { return _ticks*1000; }
+	ticks_seconds_t seconds() { return ticks_seconds_t(_ticks/1000); }	
 	ticks_seconds_t timeSince(ticks_seconds_t timeStamp);
 			
-	void setMillis(ticks_millis_t now)	{ _ticks = now; }
+	void setMillis(uint64_t now)	{ _ticks = now; }
 	void incMillis(ticks_millis_t advance)	{ _ticks += advance; }
 private:
-	ticks_millis_t _ticks;			
+	uint64_t _ticks;			// kept wider than millis(), so simulations can run for longer than 49 days
 };
 
 
@@ -90,8 +96,9 @@ public:
 // Determine the type of Ticks needed
 // TICKS_IMPL_CONFIG is the code string passed to the constructor of the Ticks implementation
 
-#if BREWPI_SIMULATE				
-/** For simulation, by the simulator - each step in the simulator advances the time by one second. */    
+#if BREWPI_SIMULATE || !defined(ARDUINO)
+/** For simulation, by the simulator - each step in the simulator advances the time by one second.
+	Without hardware, time only passes when the native build advances it. */    
 	typedef ExternalTicks TicksImpl;
 	#define TICKS_IMPL_CONFIG		// no configuration of ExternalTicks necessary
 
@@ -31,9 +31,21 @@ class HardwareTicks {
 public:
 	ticks_millis_t millis() { return ::millis(); }
 	ticks_micros_t micros() { return ::micros(); }	
+#ifdef ESP8266
+	ticks_micros64_t micros64() { return ::micros64(); }
+#else
+	HardwareTicks() : lastMicros(0), microsWraps(0) {}
+	ticks_micros64_t micros64();
+#endif
 	ticks_seconds_t seconds();
 		
 	ticks_seconds_t timeSince(ticks_seconds_t timeStamp);
+
+#ifndef ESP8266
+private:
+	ticks_micros_t lastMicros;
+	uint32_t microsWraps;
+#endif
 };
 
 
@@ -0,0 +1,494 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Brewpi.h"
+#include "VirtualOneWireBus.h"
+
+#ifndef ARDUINO
+
+#include "OneWire.h"
+
+// bus timing, in microseconds
+#define RESET_MIN_LOW_TIME 480		// a low pulse at least this long is a reset
+#define WRITE_ONE_MAX_LOW_TIME 15	// devices sample the line 15us after the falling edge
+#define DEVICE_ZERO_HOLD_TIME 30	// how long a device holds the line low to send a 0
+#define PRESENCE_DELAY 30
+#define PRESENCE_DURATION 120
+
+#define ROM_SEARCH_CMD 0xF0
+#define ROM_READ_CMD 0x33
+#define ROM_MATCH_CMD 0x55
+#define ROM_SKIP_CMD 0xCC
+#define ROM_ALARM_SEARCH_CMD 0xEC
+
+VirtualOneWireDevice::VirtualOneWireDevice(uint8_t family, uint64_t serial)
+	: connected(true), bus(NULL), romState(ROM_IDLE)
+{
+	_rom[0] = family;
+	for (uint8_t i=1; i<7; i++) {
+		_rom[i] = uint8_t(serial);
+		serial >>= 8;
+	}
+	_rom[7] = OneWire::crc8(_rom, 7);
+	txHead = txLength = txBit = 0;
+	rxBits = rxByte = 0;
+}
+
+void VirtualOneWireDevice::setConnected(bool connected)
+{
+	if (connected && !this->connected)
+		powerCycle();
+	this->connected = connected;
+}
+
+void VirtualOneWireDevice::powerCycle()
+{
+	romState = ROM_IDLE;
+	txLength = 0;
+	powerOn();
+}
+
+uint64_t VirtualOneWireDevice::now() const
+{
+	return bus ? bus->micros() : 0;
+}
+
+void VirtualOneWireDevice::transmit(const uint8_t* data, uint8_t len)
+{
+	if (txLength==0)
+		txHead = txBit = 0;
+	while (len-- && txLength<TX_BUFFER_SIZE)
+		txBuffer[(txHead+txLength++)%TX_BUFFER_SIZE] = *data++;
+}
+
+void VirtualOneWireDevice::resetPulse()
+{
+	romState = ROM_COMMAND;
+	rxBits = rxByte = 0;
+	txLength = 0;
+	busReset();
+}
+
+int8_t VirtualOneWireDevice::nextTxBit()
+{
+	if (txLength==0)
+		transmitDone();
+	if (txLength==0)
+		return statusBit();
+	int8_t bit = (txBuffer[txHead]>>txBit)&1;
+	if (++txBit==8) {
+		txBit = 0;
+		txHead = (txHead+1)%TX_BUFFER_SIZE;
+		txLength--;
+	}
+	return bit;
+}
+
+/*
+ * Called on the falling edge of a slot. Returns true when the device holds the line low, i.e. it sends a 0.
+ */
+bool VirtualOneWireDevice::slotStart()
+{
+	receiving = false;
+	int8_t bit = -1;
+	switch (romState) {
+		case ROM_IDLE:
+			return false;
+		case ROM_SEARCH:
+			if (searchPhase<2) {
+				bit = (_rom[romBit>>3]>>(romBit&7))&1;
+				if (searchPhase==1)
+					bit = !bit;
+				searchPhase++;
+				return bit==0;
+			}
+			receiving = true;
+			return false;
+		case ROM_FUNCTION:
+			bit = nextTxBit();
+			if (bit>=0)
+				return bit==0;
+			receiving = true;
+			return false;
+		default:
+			receiving = true;
+			return false;
+	}
+}
+
+void VirtualOneWireDevice::slotEnd(uint16_t lowTime)
+{
+	if (receiving)
+		receiveBit(lowTime<WRITE_ONE_MAX_LOW_TIME);
+}
+
+void VirtualOneWireDevice::receiveBit(uint8_t bit)
+{
+	switch (romState) {
+		case ROM_MATCH:
+			if (bit!=((_rom[romBit>>3]>>(romBit&7))&1))
+				romState = ROM_IDLE;
+			else if (++romBit==64)
+				romState = ROM_FUNCTION;
+			return;
+		case ROM_SEARCH: {
+			uint8_t mine = (_rom[romBit>>3]>>(romBit&7))&1;
+			if (bit!=mine)
+				romState = ROM_IDLE;		// master chose the other branch
+			else if (++romBit==64)
+				romState = ROM_FUNCTION;
+			searchPhase = 0;
+			return;
+		}
+		default:
+			break;
+	}
+	
+	rxByte |= bit<<rxBits;
+	if (++rxBits<8)
+		return;
+	uint8_t b = rxByte;
+	rxBits = rxByte = 0;
+	if (romState==ROM_COMMAND)
+		romCommand(b);
+	else if (romState==ROM_FUNCTION)
+		functionByte(b);
+}
+
+void VirtualOneWireDevice::romCommand(uint8_t command)
+{
+	romBit = 0;
+	searchPhase = 0;
+	switch (command) {
+		case ROM_READ_CMD:
+			romState = ROM_FUNCTION;
+			transmit(_rom, 8);
+			break;
+		case ROM_MATCH_CMD:
+			romState = ROM_MATCH;
+			break;
+		case ROM_SKIP_CMD:
+			romState = ROM_FUNCTION;
+			break;
+		case ROM_ALARM_SEARCH_CMD:
+			romState = alarmed() ? ROM_SEARCH : ROM_IDLE;
+			break;
+		case ROM_SEARCH_CMD:
+			romState = ROM_SEARCH;
+			break;
+		default:
+			romState = ROM_IDLE;
+	}
+}
+
+VirtualOneWireBus::VirtualOneWireBus(uint16_t capacity)
+	: resets(0), slots(0), bitErrors(0), count(0), capacity(capacity),
+	now(0), masterLow(false), lowSince(0), devicesLowUntil(0), presenceStart(0), presenceEnd(0),
+	noise(0), seed(1)
+{
+	devices = new VirtualOneWireDevice*[capacity];
+}
+
+VirtualOneWireBus::~VirtualOneWireBus()
+{
+	for (uint16_t i=0; i<count; i++)
+		devices[i]->bus = NULL;
+	delete[] devices;
+}
+
+bool VirtualOneWireBus::attach(VirtualOneWireDevice* device)
+{
+	if (count==capacity)
+		return false;
+	devices[count++] = device;
+	device->bus = this;
+	device->powerCycle();
+	return true;
+}
+
+void VirtualOneWireBus::detach(VirtualOneWireDevice* device)
+{
+	for (uint16_t i=0; i<count; i++) {
+		if (devices[i]==device) {
+			devices[i] = devices[--count];
+			device->bus = NULL;
+			return;
+		}
+	}
+}
+
+void VirtualOneWireBus::setNoise(uint32_t errorsPerMillion, uint32_t seed)
+{
+	noise = errorsPerMillion;
+	this->seed = seed ? seed : 1;
+}
+
+uint32_t VirtualOneWireBus::random()
+{
+	// xorshift32 - deterministic for a given seed, so failures can be reproduced
+	seed ^= seed<<13;
+	seed ^= seed>>17;
+	seed ^= seed<<5;
+	return seed;
+}
+
+void VirtualOneWireBus::pullLow()
+{
+	if (masterLow)
+		return;
+	masterLow = true;
+	lowSince = now;
+	for (uint16_t i=0; i<count; i++) {
+		VirtualOneWireDevice* d = devices[i];
+		if (d->connected && d->slotStart())
+			devicesLowUntil = now+DEVICE_ZERO_HOLD_TIME;
+	}
+}
+
+void VirtualOneWireBus::release()
+{
+	if (!masterLow)
+		return;
+	masterLow = false;
+	uint64_t lowTime = now-lowSince;
+	if (lowTime>=RESET_MIN_LOW_TIME) {
+		resets++;
+		bool present = false;
+		for (uint16_t i=0; i<count; i++) {
+			VirtualOneWireDevice* d = devices[i];
+			if (d->connected) {
+				d->resetPulse();
+				present = true;
+			}
+		}
+		if (present) {
+			presenceStart = now+PRESENCE_DELAY;
+			presenceEnd = presenceStart+PRESENCE_DURATION;
+		}
+		return;
+	}
+	slots++;
+	for (uint16_t i=0; i<count; i++) {
+		VirtualOneWireDevice* d = devices[i];
+		if (d->connected)
+			d->slotEnd(uint16_t(lowTime));
+	}
+}
+
+uint8_t VirtualOneWireBus::sample()
+{
+	bool low = masterLow || now<devicesLowUntil || (now>=presenceStart && now<presenceEnd);
+	uint8_t level = !low;
+	if (noise && (random()%1000000)<noise) {
+		bitErrors++;
+		level = !level;
+	}
+	return level;
+}
+
+#define DS18B20_FAMILY_ID 0x28
+#define DS2413_FAMILY_ID 0x3A
+
+#define CMD_CONVERT 0x44
+#define CMD_READ_SCRATCHPAD 0xBE
+#define CMD_WRITE_SCRATCHPAD 0x4E
+#define CMD_COPY_SCRATCHPAD 0x48
+#define CMD_RECALL 0xB8
+#define CMD_READ_POWER 0xB4
+#define CMD_ACCESS_READ 0xF5
+#define CMD_ACCESS_WRITE 0x5A
+#define CMD_NONE 0
+
+VirtualDS18B20::VirtualDS18B20(uint64_t serial)
+	: VirtualOneWireDevice(DS18B20_FAMILY_ID, serial), temperature(20*16), parasite(false)
+{
+	// factory defaults
+	eeprom[0] = 75;
+	eeprom[1] = 70;
+	eeprom[2] = 0x7F;
+	powerOn();
+}
+
+void VirtualDS18B20::powerOn()
+{
+	scratchpad[0] = 0x50;		// 85C, the power-on value
+	scratchpad[1] = 0x05;
+	scratchpad[2] = eeprom[0];
+	scratchpad[3] = eeprom[1];
+	scratchpad[4] = eeprom[2];
+	scratchpad[5] = 0xFF;
+	scratchpad[6] = 0x0C;
+	scratchpad[7] = 0x10;
+	converting = false;
+	command = CMD_NONE;
+}
+
+void VirtualDS18B20::busReset()
+{
+	updateConversion();
+	command = CMD_NONE;
+}
+
+uint32_t VirtualDS18B20::conversionTime()
+{
+	// 93.75ms at 9 bits, doubling for each extra bit
+	return 93750UL<<((scratchpad[4]>>5)&3);
+}
+
+void VirtualDS18B20::updateConversion()
+{
+	if (!converting || now()<conversionEnd)
+		return;
+	converting = false;
+	// lower resolutions leave the least significant bits undefined - clear them like the device does
+	uint8_t unusedBits = 3-((scratchpad[4]>>5)&3);
+	int16_t t = temperature & ~((1<<unusedBits)-1);
+	scratchpad[0] = uint8_t(t);
+	scratchpad[1] = uint8_t(t>>8);
+}
+
+void VirtualDS18B20::functionByte(uint8_t b)
+{
+	if (command==CMD_WRITE_SCRATCHPAD) {
+		if (index<3) {
+			scratchpad[2+index] = index==2 ? ((b&0x60)|0x1F) : b;
+			index++;
+		}
+		return;
+	}
+	if (command!=CMD_NONE)
+		return;
+	command = b;
+	index = 0;
+	switch (b) {
+		case CMD_CONVERT:
+			updateConversion();
+			converting = true;
+			conversionEnd = now()+conversionTime();
+			break;
+		case CMD_READ_SCRATCHPAD:
+			updateConversion();
+			scratchpad[8] = OneWire::crc8(scratchpad, 8);
+			transmit(scratchpad, 9);
+			break;
+		case CMD_COPY_SCRATCHPAD:
+			eeprom[0] = scratchpad[2];
+			eeprom[1] = scratchpad[3];
+			eeprom[2] = scratchpad[4];
+			break;
+		case CMD_RECALL:
+			scratchpad[2] = eeprom[0];
+			scratchpad[3] = eeprom[1];
+			scratchpad[4] = eeprom[2];
+			break;
+	}
+}
+
+int8_t VirtualDS18B20::statusBit()
+{
+	switch (command) {
+		case CMD_CONVERT:
+			updateConversion();
+			return !converting;
+		case CMD_READ_POWER:
+			return !parasite;
+		case CMD_RECALL:
+		case CMD_COPY_SCRATCHPAD:
+			return 1;		// done
+		case CMD_READ_SCRATCHPAD:
+			return 1;		// past the end of the scratchpad
+		default:
+			return -1;
+	}
+}
+
+bool VirtualDS18B20::alarmed()
+{
+	updateConversion();
+	int8_t t = int16_t(scratchpad[0] | scratchpad[1]<<8)>>4;
+	return t>=int8_t(scratchpad[2]) || t<=int8_t(scratchpad[3]);
+}
+
+VirtualDS2413::VirtualDS2413(uint64_t serial)
+	: VirtualOneWireDevice(DS2413_FAMILY_ID, serial), inputs(0x3)
+{
+	powerOn();
+}
+
+void VirtualDS2413::setInput(uint8_t pio, bool high)
+{
+	if (high)
+		inputs |= 1<<pio;
+	else
+		inputs &= ~(1<<pio);
+}
+
+void VirtualDS2413::powerOn()
+{
+	latchState = 0x3;		// both outputs off
+	command = CMD_NONE;
+}
+
+void VirtualDS2413::busReset()
+{
+	command = CMD_NONE;
+}
+
+uint8_t VirtualDS2413::status()
+{
+	// a pin only follows its input when the output transistor is off
+	uint8_t pins = latchState & inputs;
+	uint8_t s = (pins&1) | (latchState&1)<<1 | (pins&2)<<1 | (latchState&2)<<2;
+	return s | ((~s)&0xF)<<4;
+}
+
+void VirtualDS2413::functionByte(uint8_t b)
+{
+	switch (command) {
+		case CMD_NONE:
+			command = b;
+			index = 0;
+			if (command==CMD_ACCESS_READ)
+				transmit(status());
+			break;
+		case CMD_ACCESS_WRITE:
+			if (index==0) {
+				value = b;
+				index = 1;
+			}
+			else {
+				index = 0;
+				if (uint8_t(~b)==value) {
+					latchState = value & 0x3;
+					transmit(0xAA);
+					transmit(status());
+				}
+				else
+					transmit(0xFF);
+			}
+			break;
+	}
+}
+
+void VirtualDS2413::transmitDone()
+{
+	// access read repeats the status until the next reset
+	if (command==CMD_ACCESS_READ)
+		transmit(status());
+}
+
+#endif
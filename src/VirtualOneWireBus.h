@@ -0,0 +1,250 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+#include "Brewpi.h"
+
+#ifndef ARDUINO
+
+#include "OneWireLine.h"
+
+class VirtualOneWireBus;
+
+/**
+ * A device on a VirtualOneWireBus.
+ * The ROM layer (read, match, skip and search ROM) is implemented here at the bit level, including the
+ * wired-AND arbitration of search. Subclasses implement the function commands: they receive whole bytes
+ * through functionByte() and answer by queueing bytes with transmit().
+ */
+class VirtualOneWireDevice
+{
+public:
+	/*
+	 * /param family the family code (first ROM byte)
+	 * /param serial the 48 bit serial number. The ROM CRC is computed.
+	 */
+	VirtualOneWireDevice(uint8_t family, uint64_t serial);
+	virtual ~VirtualOneWireDevice() {}
+	
+	const uint8_t* rom() const { return _rom; }
+	
+	/*
+	 * A disconnected device ignores the bus. Reconnecting the device powers it up again.
+	 */
+	void setConnected(bool connected);
+	bool isConnected() const { return connected; }
+	
+	/*
+	 * Simulates a brief loss of power. Volatile state reverts to its power-on value.
+	 */
+	void powerCycle();
+
+protected:
+	/* Called at power up. Restores the power-on state. */
+	virtual void powerOn() {}
+	
+	/* Called on every reset pulse, after the ROM layer has been reset. */
+	virtual void busReset() {}
+	
+	/* A byte written by the master after this device was selected. */
+	virtual void functionByte(uint8_t b) = 0;
+	
+	/* Called when all queued bytes have been sent. The device may queue more. */
+	virtual void transmitDone() {}
+	
+	/*
+	 * The bit the device answers in a read slot when nothing is queued, or -1 if the device expects the
+	 * master to write. E.g. a DS18B20 answers 0 while a conversion is running.
+	 */
+	virtual int8_t statusBit() { return -1; }
+	
+	/* Whether the device answers an alarm search. */
+	virtual bool alarmed() { return false; }
+	
+	void transmit(const uint8_t* data, uint8_t len);
+	void transmit(uint8_t data) { transmit(&data, 1); }
+	
+	uint64_t now() const;
+
+	static const uint8_t TX_BUFFER_SIZE = 16;
+
+private:
+	enum RomState {
+		ROM_IDLE,			// not selected, waiting for a reset
+		ROM_COMMAND,		// receiving the ROM command
+		ROM_MATCH,			// receiving the ROM to match
+		ROM_SEARCH,			// taking part in a search
+		ROM_FUNCTION		// selected, function command layer
+	};
+	
+	// called by the bus
+	void resetPulse();
+	bool slotStart();
+	void slotEnd(uint16_t lowTime);
+	
+	int8_t nextTxBit();
+	void receiveBit(uint8_t bit);
+	void romCommand(uint8_t command);
+	
+	uint8_t _rom[8];
+	bool connected;
+	VirtualOneWireBus* bus;
+	
+	RomState romState;
+	uint8_t rxByte;
+	uint8_t rxBits;
+	uint8_t romBit;			// bit index during match and search
+	uint8_t searchPhase;	// 0: send bit, 1: send complement, 2: receive direction
+	bool receiving;			// the current slot is a write slot for this device
+	
+	uint8_t txBuffer[TX_BUFFER_SIZE];
+	uint8_t txHead;
+	uint8_t txLength;
+	uint8_t txBit;
+	
+	friend class VirtualOneWireBus;
+};
+
+/**
+ * A bit-accurate 1-Wire bus model for the native build.
+ * The master (OneWire or OneWireAsync) drives the line through the OneWireLine interface. Devices decode
+ * slots from the length of the low pulse, and answer read slots and resets by holding the line low, the
+ * same way they do on the wire. Time only passes when the master advances it, so the time a transaction
+ * takes on the bus can be measured exactly with micros().
+ *
+ * Every edge visits all devices, but devices that are not selected return immediately, so buses with
+ * hundreds of devices remain practical for benchmarking search and enumeration.
+ */
+class VirtualOneWireBus : public OneWireLine
+{
+public:
+	VirtualOneWireBus(uint16_t capacity);
+	~VirtualOneWireBus();
+	
+	/*
+	 * Adds a device to the bus. The bus does not take ownership.
+	 * /return false if the bus is full
+	 */
+	bool attach(VirtualOneWireDevice* device);
+	void detach(VirtualOneWireDevice* device);
+	uint16_t deviceCount() const { return count; }
+	
+	/*
+	 * Flips sampled bits at random, with the given probability in errors per million samples.
+	 */
+	void setNoise(uint32_t errorsPerMillion, uint32_t seed=1);
+	
+	uint64_t micros() const { return now; }
+	
+	// statistics
+	uint32_t resets;
+	uint32_t slots;
+	uint32_t bitErrors;
+
+	// OneWireLine
+	void pullLow();
+	void release();
+	uint8_t sample();
+	void advance(uint16_t micros) { now += micros; }
+
+private:
+	uint32_t random();
+
+	VirtualOneWireDevice** devices;
+	uint16_t count;
+	uint16_t capacity;
+	
+	uint64_t now;
+	bool masterLow;
+	uint64_t lowSince;
+	uint64_t devicesLowUntil;		// a device is sending a 0 until this time
+	uint64_t presenceStart;
+	uint64_t presenceEnd;
+	
+	uint32_t noise;
+	uint32_t seed;
+};
+
+/**
+ * DS18B20 temperature sensor model.
+ * Supports convert, read/write/copy scratchpad, recall and read power supply. The alarm bytes and configuration
+ * are backed by a simulated EEPROM, so the reset detection used by DallasTemperature::initConnection() works:
+ * after powerCycle() the high alarm byte reverts to its EEPROM value.
+ */
+class VirtualDS18B20 : public VirtualOneWireDevice
+{
+public:
+	VirtualDS18B20(uint64_t serial);
+	
+	/* Sets the temperature measured by the next conversion, in 1/16 degrees C. */
+	void setTemperature(int16_t raw) { temperature = raw; }
+	void setParasitePowered(bool parasite) { this->parasite = parasite; }
+
+protected:
+	void powerOn();
+	void busReset();
+	void functionByte(uint8_t b);
+	int8_t statusBit();
+	bool alarmed();
+
+private:
+	void updateConversion();
+	uint32_t conversionTime();
+
+	uint8_t scratchpad[9];
+	uint8_t eeprom[3];			// high alarm, low alarm, configuration
+	int16_t temperature;
+	bool parasite;
+	bool converting;
+	uint64_t conversionEnd;
+	uint8_t command;
+	uint8_t index;
+};
+
+/**
+ * DS2413 dual channel switch model.
+ * Supports PIO access read and access write. A PIO with the latch off (1) reads the level set with setInput().
+ */
+class VirtualDS2413 : public VirtualOneWireDevice
+{
+public:
+	VirtualDS2413(uint64_t serial);
+	
+	/* The level seen on a PIO when its output transistor is off. */
+	void setInput(uint8_t pio, bool high);
+	
+	/* The output latch, bit 0 PIOA, bit 1 PIOB. 0 is on (pulling the pin low). */
+	uint8_t latch() const { return latchState; }
+
+protected:
+	void powerOn();
+	void busReset();
+	void functionByte(uint8_t b);
+	void transmitDone();
+
+private:
+	uint8_t status();
+
+	uint8_t latchState;
+	uint8_t inputs;
+	uint8_t command;
+	uint8_t index;
+	uint8_t value;
+};
+
+#endif
@@ -37,6 +37,14 @@
 #include "Sensor.h"
 #include "SettingsManager.h"
 #include "EepromFormat.h"
+#include "SettingsLog.h"
+#include "HistoryLog.h"
+#include "RecentHistory.h"
+#include "TempControlState.h"
+#include "ChamberManager.h"
+#include "Scheduler.h"
+#include "BeerProfile.h"
+#include "ActuatorMeter.h"
 
 #if BREWPI_SIMULATE
 #include "Simulator.h"
@@ -90,12 +98,154 @@ void onStationConnected(const WiFiEventSoftAPModeStationConnected& evt) {
 
 void handleReset()
 {
+	eepromManager.flushSettings();
+	beerProfile.flush();
+	actuatorMeter.flush(true);	// not only the chambers due, or up to an hour of counts is lost
 	// The asm volatile method doesn't work on ESP8266. Instead, use ESP.restart
 	ESP.restart();
 }
 
 
 
+#ifdef ESP8266_WiFi
+	int reconnectPoll = 0;
+	void connectClients() {
+
+    if(WiFi.isConnected()) {
+        if (server.hasClient()) {
+            // If we show a client as already being disconnected, force a disconnect
+            if (serverClient) serverClient.stop();
+            serverClient = server.available();
+            serverClient.flush();
+        }
+    } else {
+        // This might be unnecessary, but let's go ahead and disconnect any "clients" we show as connected given that
+        // WiFi isn't connected
+		// If we show a client as already being disconnected, force a disconnect
+		if (serverClient) {
+			serverClient.stop();
+			serverClient = server.available();
+			serverClient.flush();
+		}
+    }
+}
+
+#endif
+
+// Main loop tasks. The control step is split into sensors, control and outputs, which are due together and run
+// in that order by priority, each in its own pass of the loop.
+
+// task priorities, higher runs first when several are due
+enum {
+	PRIORITY_COMMS,
+	PRIORITY_PERSIST,
+	PRIORITY_DISPLAY,
+	PRIORITY_HISTORY,
+	PRIORITY_OUTPUTS,
+	PRIORITY_CONTROL,
+	PRIORITY_SENSORS
+};
+
+#define CONTROL_PERIOD 1000
+#define CONTROL_DEADLINE 100		// the control step may start this late before it counts as a miss
+#define COMMS_PERIOD 10				// how often the Pi link and the WiFi clients are polled
+
+void sensorsTask()
+{
+	tempControl.updateTemperatures();
+}
+
+void controlTask()
+{
+#if BREWPI_BUZZER
+	buzzer.setActive(alarm.isActive() && !buzzer.isActive());
+#endif			
+	tempControl.detectPeaks();
+	tempControl.updatePID();
+	uint8_t oldState = tempControl.getState();
+	tempControl.updateState();
+	if (oldState != tempControl.getState()) {
+		piLink.printTemperatures(); // add a data point at every state transition
+	}
+}
+
+void outputsTask()
+{
+	tempControl.updateOutputs();
+	chamberManager.update();	// the other chambers, after which the current one is swapped back in
+}
+
+void historyTask()
+{
+	recentHistory.update();
+	historyLog.update();
+	tempControlState.save();
+}
+
+void displayTask()
+{
+#if BREWPI_MENU
+	if (rotaryEncoder.pushed()) {
+		rotaryEncoder.resetPushed();
+		menu.pickSettingToChange();
+	}
+#endif
+
+	// update the lcd for the chamber being displayed
+	display.printState();
+	display.printAllTemperatures();
+	display.printMode();
+	display.updateBacklight();
+}
+
+void displayResetTask()
+{
+	// reset lcd every 180 seconds as a workaround for screen scramble
+	display.init();
+	display.printStationaryText();
+	display.printState();
+
+	rotaryEncoder.init();
+}
+
+void showStatus()
+{
+	display.clear();
+	display.printStationaryText();
+	display.printState();
+	scheduler.every("display", displayTask, 1000, PRIORITY_DISPLAY, 500);
+}
+
+void persistTask()
+{
+	// write settings changed by the control update or the Pi outside of the update
+	eepromManager.flushIfDue();
+	beerProfile.flush();
+	actuatorMeter.flush();
+}
+
+void commsTask()
+{
+	//listen for incoming serial connections while waiting to update
+#ifdef ESP8266_WiFi
+	connectClients();
+	yield();
+#endif
+	piLink.receive();
+}
+
+void scheduleTasks()
+{
+	scheduler.every("sensors", sensorsTask, CONTROL_PERIOD, PRIORITY_SENSORS, CONTROL_DEADLINE);
+	scheduler.every("control", controlTask, CONTROL_PERIOD, PRIORITY_CONTROL, CONTROL_DEADLINE);
+	scheduler.every("outputs", outputsTask, CONTROL_PERIOD, PRIORITY_OUTPUTS, CONTROL_DEADLINE);
+	scheduler.every("history", historyTask, CONTROL_PERIOD, PRIORITY_HISTORY, CONTROL_PERIOD/2);
+	scheduler.every("lcdReset", displayResetTask, 180000, PRIORITY_DISPLAY, 1000, 180000);
+	scheduler.every("persist", persistTask, 100, PRIORITY_PERSIST, 1000);
+	// polled: a command waits at most a period, and falling behind under load is expected rather than a miss
+	scheduler.every("comms", commsTask, COMMS_PERIOD, PRIORITY_COMMS, Scheduler::NO_DEADLINE);
+}
+
 void setup()
 {
     // Let's get the display going so that we can provide the user a bit of feedback on what's happening
@@ -116,6 +266,10 @@ void setup()
         f.close();
     }
 
+    // Index the settings log, importing settings saved by earlier firmware as separate files
+    settingsLog.begin();
+    historyLog.begin();
+
 #ifdef ESP8266_WiFi
     display.printWiFiStartup();
 	String mdns_id;
@@ -213,101 +367,29 @@ void setup()
 	tempControl.fridgeSensor->init();
 #endif	
 
+	// after a watchdog reset or restart, carry on where control left off
+	tempControlState.restore();
+
+	scheduleTasks();
 #ifdef ESP8266_WiFi
 	display.printWiFi();  // Print the WiFi info (mDNS name & IP address)
     WiFi.setAutoReconnect(true);
     stationConnectedHandler = WiFi.onSoftAPModeStationConnected(&onStationConnected);
-	delay(8000);
+	// leave the WiFi info up for a while, without holding up control
+	scheduler.once("showStatus", showStatus, 8000, PRIORITY_DISPLAY);
+#else
+	showStatus();
 #endif
-	display.clear();
-	display.printStationaryText();
-	display.printState();
 
 //	rotaryEncoder.init();
 
 	logDebug("init complete");
 }
 
-#ifdef ESP8266_WiFi
-	int reconnectPoll = 0;
-	void connectClients() {
-
-    if(WiFi.isConnected()) {
-        if (server.hasClient()) {
-            // If we show a client as already being disconnected, force a disconnect
-            if (serverClient) serverClient.stop();
-            serverClient = server.available();
-            serverClient.flush();
-        }
-    } else {
-        // This might be unnecessary, but let's go ahead and disconnect any "clients" we show as connected given that
-        // WiFi isn't connected
-		// If we show a client as already being disconnected, force a disconnect
-		if (serverClient) {
-			serverClient.stop();
-			serverClient = server.available();
-			serverClient.flush();
-		}
-    }
-}
-
-#endif
 
 void brewpiLoop(void)
 {
-	static unsigned long lastUpdate = 0;
-    static unsigned long lastLcdUpdate = 0;
-
-	uint8_t oldState;
-    if(ticks.millis() - lastLcdUpdate >= (180000)) { //reset lcd every 180 seconds as a workaround for screen scramble
-        lastLcdUpdate = ticks.millis();
-
-        display.init();
-        display.printStationaryText();
-        display.printState();
-
-        rotaryEncoder.init();
-    }
-
-    if (ticks.millis() - lastUpdate >= (1000)) { //update settings every second
-		lastUpdate = ticks.millis();
-
-#if BREWPI_BUZZER
-		buzzer.setActive(alarm.isActive() && !buzzer.isActive());
-#endif			
-
-		tempControl.updateTemperatures();
-		tempControl.detectPeaks();
-		tempControl.updatePID();
-		oldState = tempControl.getState();
-		tempControl.updateState();
-		if (oldState != tempControl.getState()) {
-			piLink.printTemperatures(); // add a data point at every state transition
-		}
-		tempControl.updateOutputs();
-
-#if BREWPI_MENU
-		if (rotaryEncoder.pushed()) {
-			rotaryEncoder.resetPushed();
-			menu.pickSettingToChange();
-		}
-#endif
-
-		// update the lcd for the chamber being displayed
-		display.printState();
-		display.printAllTemperatures();
-		display.printMode();
-		display.updateBacklight();
-	}
-
-	//listen for incoming serial connections while waiting to update
-#ifdef ESP8266_WiFi
-	yield();
-	connectClients();
-	yield();
-#endif
-	piLink.receive();
-
+	scheduler.run();
 }
 
 void loop() {
@@ -0,0 +1,163 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Autotune against the Simulator: a relay run on a known chamber, after which the proposed constants are applied
+ * and must hold a step of the beer setting at least as well as the default constants. A second chamber neither
+ * takes the proposal nor starts its own run until the proposal has been applied to the tuned chamber.
+ */
+
+#include "Sketch.h"
+#include "Autotune.h"
+#include "ChamberManager.h"
+#include "HostFS.h"
+#include "Simulator.h"
+#include "TempControl.h"
+#include "Ticks.h"
+#include "Check.h"
+
+#include <string>
+
+/* How the beer follows a step of its setting. */
+struct StepResponse {
+	double overshoot;		// degrees past the new setting
+	uint32_t settle;		// seconds until the beer stays within 0.25 degrees of the setting
+};
+
+static StepResponse step(double from, double to, uint32_t hours)
+{
+	char cmd[40];
+	snprintf(cmd, sizeof(cmd), "j{mode:b, beerSet:%.1f}", from);
+	piLinkFeed(cmd);
+	sketchRun(24*3600);		// settled at the old setting
+	snprintf(cmd, sizeof(cmd), "j{beerSet:%.1f}", to);
+	piLinkFeed(cmd);
+
+	StepResponse response = { 0, 0 };
+	double direction = to<from ? -1 : 1;
+	for (uint32_t s=1; s<=hours*3600; s++) {
+		sketchRun(1);
+		double beer = simulator.getBeerTemp();
+		response.overshoot = max(response.overshoot, (beer-to)*direction);
+		if (fabs(beer-to)>0.25)
+			response.settle = s;
+	}
+	piLinkOutput();
+	return response;
+}
+
+/*
+ * Relays a beer that swings around 20 degrees with the given period, updated the given number of times a
+ * second. Returns the period the run measures.
+ */
+static uint32_t relayPeriod(uint32_t period, uint8_t updatesPerSecond)
+{
+	const ControlConstants& cc = tempControl.cc;
+	pidAutotune.start(cc);
+	for (uint32_t ms=0; pidAutotune.isRunning() && ms<48*3600000UL; ms += 1000/updatesPerSecond) {
+		ticks.incMillis(1000/updatesPerSecond);
+		double beer = 20 + sin(TWO_PI*ms/(period*1000.0));
+		pidAutotune.update(doubleToTemp(beer), intToTemp(20), cc);
+	}
+	CHECK_EQUAL(AUTOTUNE_DONE, pidAutotune.getStatus());
+	return pidAutotune.getUltimatePeriod();
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	// the known plant: 20 l of beer in a 400 l fridge, at a constant room temperature and not fermenting
+	simulator.setMinRoomTemp(18);
+	simulator.setMaxRoomTemp(18);
+	simulator.setFermentMaxPowerOutput(0);
+	simulator.setBeerTemp(20);
+	simulator.setFridgeTemp(20);
+	sketchRun(60);
+
+	// the relay times cycles by the clock, not by how often it is updated
+	uint32_t once = relayPeriod(3600, 1);
+	CHECK(once>=3590 && once<=3610);
+	CHECK_EQUAL(once, relayPeriod(3600, 4));
+
+	ControlConstants defaults = tempControl.cc;
+	StepResponse before = step(20, 17, 48);
+
+	piLinkFeed("j{mode:a, beerSet:20}");
+	uint32_t hours = 0;
+	sketchRun(1);
+	while (pidAutotune.isRunning() && hours<AUTOTUNE_TIMEOUT) {
+		sketchRun(3600);
+		hours++;
+	}
+	CHECK_EQUAL(AUTOTUNE_DONE, pidAutotune.getStatus());
+	CHECK_EQUAL(MODE_BEER_CONSTANT, tempControl.cs.mode);
+	const ControlConstants& proposal = pidAutotune.getProposal();
+	// this chamber oscillates at about two hours under the relay
+	CHECK(pidAutotune.getUltimatePeriod()>3600 && pidAutotune.getUltimatePeriod()<3*3600);
+	CHECK(proposal.Kp>0 && proposal.Ki>0 && proposal.Kd<0);
+	printf("autotune: %u h, %u cycles, Ku %.3f, Tu %u s, proposed Kp %.3f Ki %.3f Kd %.3f (defaults %.3f %.3f %.3f)\n",
+		hours, pidAutotune.getCycles(), pidAutotune.getUltimateGain()/512.0, pidAutotune.getUltimatePeriod(),
+		proposal.Kp/512.0, proposal.Ki/512.0, proposal.Kd/512.0, defaults.Kp/512.0, defaults.Ki/512.0,
+		defaults.Kd/512.0);
+	piLinkOutput();
+
+	// the second chamber in autotune mode waits, and cannot take the proposal
+	piLinkFeed("@2");
+	piLinkFeed("j{mode:a, beerSet:20}");
+	sketchRun(60);
+	ControlConstants second = tempControl.cc;
+	CHECK_EQUAL(AUTOTUNE_DONE, pidAutotune.getStatus());
+	CHECK_EQUAL(0, pidAutotune.getChamber());
+	piLinkFeed("k{apply:1}");
+	sketchRun(1);
+	std::string refused = piLinkOutput();
+	CHECK(refused.find("\"chamber\":1")!=std::string::npos);
+	CHECK(refused.find("\"pending\":1")!=std::string::npos);
+	CHECK_EQUAL(second.Kp, tempControl.cc.Kp);
+	CHECK_EQUAL(second.Ki, tempControl.cc.Ki);
+	CHECK(pidAutotune.isPending());
+
+	piLinkFeed("@1");
+	piLinkFeed("k{apply:1}");
+	sketchRun(1);
+	std::string applied = piLinkOutput();
+	CHECK_EQUAL(0, applied.find("K:{"));
+	CHECK(applied.find("\"pending\":0")!=std::string::npos);
+	CHECK_EQUAL(proposal.Kp, tempControl.cc.Kp);
+	CHECK_EQUAL(proposal.Ki, tempControl.cc.Ki);
+	CHECK_EQUAL(proposal.Kd, tempControl.cc.Kd);
+
+	// with the proposal applied, the second chamber starts its run
+	sketchRun(1);
+	CHECK(pidAutotune.isRunning());
+	CHECK_EQUAL(1, pidAutotune.getChamber());
+	piLinkFeed("@2");
+	piLinkFeed("j{mode:o}");
+	piLinkFeed("@1");
+	sketchRun(1);
+	CHECK(!pidAutotune.isRunning());
+	piLinkOutput();
+
+	StepResponse after = step(20, 17, 48);
+	printf("step 20 -> 17: defaults overshoot %.2f, settled in %.1f h; tuned overshoot %.2f, settled in %.1f h\n",
+		before.overshoot, before.settle/3600.0, after.overshoot, after.settle/3600.0);
+	CHECK(after.overshoot<0.25);
+	CHECK(after.settle<=before.settle);
+
+	return CHECK_RESULT();
+}
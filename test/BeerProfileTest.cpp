@@ -0,0 +1,97 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A beer profile uploaded with P and run on the simulated clock: the setting is interpolated between the points
+ * and held after the last one, the profile's clock only runs in MODE_BEER_PROFILE, and the progress read back
+ * from flash is at most BEER_PROFILE_SAVE_INTERVAL behind.
+ */
+
+#include "Sketch.h"
+#include "BeerProfile.h"
+#include "HostFS.h"
+#include "Simulator.h"
+#include "TempControl.h"
+#include "Check.h"
+
+#include <string>
+
+/* The setting a profile from 18 to 20 degrees over an hour should have after the given seconds. */
+static temperature rising(uint32_t seconds)
+{
+	return intToTemp(18) + temperature(int32_t(intToTempDiff(2))*int32_t(seconds)/3600);
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	simulator.setMinRoomTemp(18);
+	simulator.setMaxRoomTemp(18);
+	simulator.setFermentMaxPowerOutput(0);
+	simulator.setBeerTemp(18);
+	simulator.setFridgeTemp(18);
+
+	// 18 degrees rising to 20 over the first hour, then held for an hour
+	piLinkFeed("P[[0,18.0],[60,20.0],[120,20.0]]");
+	sketchRun(1);
+	std::string uploaded = piLinkOutput();
+	CHECK(uploaded.find("P:{")!=std::string::npos);
+	CHECK_EQUAL(3, beerProfile.count());
+	CHECK_EQUAL(60, beerProfile.point(1).minutes);
+	CHECK_EQUAL(intToTemp(20), beerProfile.point(1).temp);
+	CHECK_EQUAL(0, beerProfile.elapsed());
+
+	// half way up the ramp, the beer setting follows the profile
+	piLinkFeed("j{mode:p}");
+	sketchRun(1800);
+	uint32_t elapsed = beerProfile.elapsed();
+	CHECK(elapsed>=1798 && elapsed<=1800);
+	CHECK_EQUAL(rising(elapsed), beerProfile.setting());
+	CHECK_EQUAL(beerProfile.setting(), tempControl.cs.beerSetting);
+	CHECK(beerProfile.setting()>intToTemp(18) && beerProfile.setting()<intToTemp(20));
+
+	// the clock stops in another mode, and carries on where it was when the profile mode is back
+	piLinkFeed("j{mode:b, beerSet:18.5}");
+	sketchRun(3600);
+	CHECK_EQUAL(elapsed, beerProfile.elapsed());
+	CHECK_EQUAL(intToTemp(18)+intToTempDiff(1)/2, tempControl.cs.beerSetting);
+	piLinkFeed("j{mode:p}");
+	sketchRun(600);
+	CHECK(beerProfile.elapsed()>elapsed && beerProfile.elapsed()<=elapsed+600);
+	CHECK_EQUAL(rising(beerProfile.elapsed()), tempControl.cs.beerSetting);
+
+	// past the last point, the profile holds its last setting and its clock stays at the end
+	sketchRun(3*3600);
+	CHECK_EQUAL(120*60UL, beerProfile.elapsed());
+	CHECK_EQUAL(intToTemp(20), beerProfile.setting());
+	CHECK_EQUAL(intToTemp(20), tempControl.cs.beerSetting);
+
+	// a new profile starts from the beginning; after a restart, its progress is read back from flash
+	piLinkFeed("P[[0,18.0],[600,22.0]]");
+	sketchRun(4321);
+	uint32_t before = beerProfile.elapsed();
+	CHECK(before>=4300);
+	beerProfile.load();
+	uint32_t after = beerProfile.elapsed();
+	CHECK(after<=before && before-after<BEER_PROFILE_SAVE_INTERVAL);
+	CHECK_EQUAL(2, beerProfile.count());
+	CHECK_EQUAL(intToTemp(22), beerProfile.point(1).temp);
+	printf("progress %u s before the restart, %u s after\n", before, after);
+
+	return CHECK_RESULT();
+}
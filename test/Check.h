@@ -0,0 +1,36 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Minimal checks for the native tests. A failed CHECK prints the location and counts the failure;
+ * CHECK_RESULT() is returned from main() so ctest sees the outcome.
+ */
+
+#include <stdio.h>
+
+static int checkFailures = 0;
+
+#define CHECK(condition) do { if(!(condition)) { \
+	fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); checkFailures++; } } while(0)
+
+#define CHECK_EQUAL(expected, actual) do { long long e_ = (long long)(expected), a_ = (long long)(actual); if(e_ != a_) { \
+	fprintf(stderr, "%s:%d: CHECK_EQUAL(%s, %s) failed: %lld != %lld\n", __FILE__, __LINE__, #expected, #actual, e_, a_); \
+	checkFailures++; } } while(0)
+
+#define CHECK_RESULT() (checkFailures ? (fprintf(stderr, "%d check(s) failed\n", checkFailures), 1) : 0)
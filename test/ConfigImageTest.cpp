@@ -0,0 +1,78 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * A configuration image leaves out the records of the running controller, and applying one keeps them.
+ */
+
+#include "Sketch.h"
+#include "HostFS.h"
+#include "ConfigImage.h"
+#include "SettingsSchema.h"
+#include "TempControl.h"
+#include "Check.h"
+
+static bool writeRuntime(uint8_t type, uint8_t fill)
+{
+	uint8_t data[16];
+	memset(data, fill, sizeof(data));
+	return SettingsLog::write(type, 0, data, sizeof(data), SettingsSchema::version(type));
+}
+
+static uint8_t readRuntime(uint8_t type)
+{
+	uint8_t data[16];
+	return SettingsLog::read(type, 0, data, sizeof(data)) ? data[0] : 0;
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	piLinkFeed("j{mode:b, beerSet:18, Kp:7}");
+	sketchRun(60);
+	CHECK(writeRuntime(SETTINGS_RECORD_PROFILE_PROGRESS, 1));
+	CHECK(writeRuntime(SETTINGS_RECORD_ACTUATOR_STATS, 1));
+
+	static uint8_t image[CONFIG_IMAGE_MAX];
+	uint16_t length = ConfigImage::build(image, sizeof(image));
+	CHECK(length>sizeof(ConfigImageHeader));
+	for (uint16_t offset = sizeof(ConfigImageHeader); offset<length; ) {
+		const SettingsRecordHeader& h = *(const SettingsRecordHeader*)(image+offset);
+		CHECK(!(CONFIG_IMAGE_SKIPPED_RECORDS & SETTINGS_RECORD_BIT(h.type)));
+		offset += sizeof(h)+h.length;
+	}
+
+	// the controller runs on and is reconfigured, then the image is restored
+	piLinkFeed("j{beerSet:21, Kp:3}");
+	sketchRun(60);
+	CHECK(writeRuntime(SETTINGS_RECORD_PROFILE_PROGRESS, 2));
+	CHECK(writeRuntime(SETTINGS_RECORD_ACTUATOR_STATS, 2));
+	CHECK_EQUAL(CONFIG_IMAGE_OK, ConfigImage::apply(image, length));
+	CHECK_EQUAL(intToTemp(18), tempControl.getBeerSetting());
+	CHECK_EQUAL(intToTempDiff(7), tempControl.cc.Kp);
+	CHECK_EQUAL(2, readRuntime(SETTINGS_RECORD_PROFILE_PROGRESS));
+	CHECK_EQUAL(2, readRuntime(SETTINGS_RECORD_ACTUATOR_STATS));
+
+	// and all of it survives a restart
+	sketchRun(60);
+	sketchSetup();
+	CHECK_EQUAL(intToTemp(18), tempControl.getBeerSetting());
+	CHECK_EQUAL(2, readRuntime(SETTINGS_RECORD_ACTUATOR_STATS));
+
+	return CHECK_RESULT();
+}
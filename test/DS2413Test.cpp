@@ -0,0 +1,80 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The shared DS2413 latch: writes only go out when the state changes, and a chip that lost its latch is written again.
+ */
+
+#include "Brewpi.h"
+#include "OneWire.h"
+#include "DS2413.h"
+#include "Ticks.h"
+#include "VirtualOneWireBus.h"
+#include "Check.h"
+
+int main()
+{
+	VirtualOneWireBus bus(2);
+	VirtualDS2413 chip(0x3001);
+	bus.attach(&chip);
+	OneWire oneWire(&bus);
+	DeviceAddress address;
+	memcpy(address, chip.rom(), 8);
+
+	// two outputs on one chip, as OneWireActuator drives them: 0 turns the output on
+	DS2413 outputA, outputB;
+	outputA.init(&oneWire, address);
+	outputB.init(&oneWire, address);
+	CHECK(outputA.channelWrite(0, false));
+	CHECK(outputB.channelWrite(1, true));
+	CHECK_EQUAL(0x2, chip.latch());
+	CHECK(!outputA.channelRead(0, true));
+
+	// an unchanged latch is not written again
+	uint32_t resets = bus.resets;
+	ticks.incMillis(1000);
+	outputA.channelWrite(0, false);
+	outputB.channelWrite(1, true);
+	CHECK(!outputA.channelRead(0, true));
+	CHECK_EQUAL(resets, bus.resets);
+
+	// a brown-out turns both outputs off: the periodic check finds it and writes the latch again
+	chip.powerCycle();
+	CHECK_EQUAL(0x3, chip.latch());
+	ticks.incMillis(DS2413_LATCH_CHECK_INTERVAL);
+	outputA.channelWrite(0, false);
+	CHECK_EQUAL(0x2, chip.latch());
+
+	// a read that shows another latch forgets the confirmed state, so the next write goes out at once
+	chip.powerCycle();
+	DS2413 device;
+	device.init(&oneWire, address);
+	CHECK(device.isConnected());
+	CHECK(outputA.channelRead(0, false));
+	outputA.channelWrite(0, false);
+	CHECK_EQUAL(0x2, chip.latch());
+
+	// as does a failed read
+	chip.setConnected(false);
+	CHECK(!device.isConnected());
+	chip.powerCycle();
+	chip.setConnected(true);
+	outputA.channelWrite(0, false);
+	CHECK_EQUAL(0x2, chip.latch());
+
+	return CHECK_RESULT();
+}
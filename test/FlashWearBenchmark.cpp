@@ -0,0 +1,97 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Flash traffic and wear caused by a day of control with typical Pi traffic, measured on HostFS. Every file the
+ * firmware writes is counted: the settings log, the history log and the control state.
+ */
+
+#include "Sketch.h"
+#include "HostFS.h"
+#include "SettingsLog.h"
+#include "TempControl.h"
+#include "Check.h"
+
+const uint32_t HOURS = 24;
+const uint32_t ERASE_CYCLES = 100000;		// rated endurance of the SPI NOR flash on ESP8266 modules
+
+/**
+ * A day of the Pi talking to the controller. The script asks for temperatures every minute. In a beer profile it
+ * also sends the profile's setting every minute, and a user tuning the controller changes a constant every
+ * ten minutes.
+ */
+enum Traffic {
+	TRAFFIC_IDLE,
+	TRAFFIC_PROFILE,
+	TRAFFIC_TUNING
+};
+
+static void runDay(Traffic traffic, const char* name)
+{
+	SPIFFS.format();
+	sketchSetup();
+	piLinkFeed("j{mode:b, beerSet:18}");
+	sketchRun(600);
+	SPIFFS.resetStats();
+	uint32_t compactions = settingsLog.getStats().compactions;
+
+	char command[48];
+	for(uint32_t minute = 0; minute < HOURS * 60; minute++){
+		piLinkFeed("t");
+		if(traffic == TRAFFIC_PROFILE){
+			// a ramp of 2 degrees over the day, sent with two decimals like the script does
+			snprintf(command, sizeof(command), "j{beerSet:%.2f}", 18.0 + 2.0 * minute / (HOURS * 60));
+			piLinkFeed(command);
+		}
+		if(traffic == TRAFFIC_TUNING && minute % 10 == 0){
+			snprintf(command, sizeof(command), "j{Kp:%.2f}", 5.0 + 0.05 * (minute / 10 % 20));
+			piLinkFeed(command);
+		}
+		sketchRun(60);
+		piLinkOutput();
+	}
+
+	const HostFlashStats& stats = SPIFFS.stats();
+	const HostFlashModel& model = SPIFFS.getModel();
+	uint16_t blocks = model.size / model.blockSize;
+	double erasesPerHour = double(stats.blocksErased) / HOURS;
+	printf("%-8s per hour: %6.0f bytes, %4.0f pages programmed, %5.2f blocks erased, %.1f s busy; "
+		"%u log compactions, longest gc %u ms",
+		name, stats.bytesWritten / double(HOURS), stats.pagesProgrammed / double(HOURS), erasesPerHour,
+		stats.busyMicros / 1e6 / HOURS, settingsLog.getStats().compactions - compactions, stats.gcMaxMicros / 1000);
+	// SPIFFS spreads the erases over all blocks
+	if(stats.blocksErased)
+		printf(", %.0f years to %u cycles\n", ERASE_CYCLES * blocks / erasesPerHour / 24 / 365, ERASE_CYCLES);
+	else
+		printf("\n");
+
+	// the settings written last come back after a reboot
+	temperature beerSetting = tempControl.getBeerSetting();
+	ControlConstants constants = tempControl.cc;
+	sketchSetup();
+	CHECK_EQUAL(beerSetting, tempControl.getBeerSetting());
+	CHECK_EQUAL(constants.Kp, tempControl.cc.Kp);
+	CHECK_EQUAL('b', tempControl.getMode());
+}
+
+int main()
+{
+	runDay(TRAFFIC_IDLE, "idle");
+	runDay(TRAFFIC_PROFILE, "profile");
+	runDay(TRAFFIC_TUNING, "tuning");
+	return CHECK_RESULT();
+}
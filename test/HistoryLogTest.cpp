@@ -0,0 +1,117 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Time queries on the flash history: samples carry their time since boot, which stays exact when sampling
+ * falls behind and is kept per boot across a restart. The history stays that of the first chamber when the Pi
+ * link selects another.
+ */
+
+#include "Sketch.h"
+#include "HostFS.h"
+#include "HistoryLog.h"
+#include "RecentHistory.h"
+#include "ChamberManager.h"
+#include "TempControl.h"
+#include "Ticks.h"
+#include "Check.h"
+
+#include <vector>
+
+struct Collected {
+	std::vector<uint32_t> seqs;
+	std::vector<uint32_t> times;
+	std::vector<HistorySample> samples;
+	uint16_t boot;
+};
+
+static void collect(uint32_t seq, uint16_t boot, uint32_t time, const HistorySample& sample, void* data)
+{
+	Collected& c = *(Collected*)data;
+	c.seqs.push_back(seq);
+	c.times.push_back(time);
+	c.samples.push_back(sample);
+	c.boot = boot;
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	piLinkFeed("j{mode:b, beerSet:18}");
+	sketchRun(3*3600);
+	uint16_t boot = historyLog.currentBoot();
+
+	Collected all;
+	historyLog.forEach(0, 0xFFFFFFFFUL, collect, &all);
+	CHECK_EQUAL(3*3600/HISTORY_SAMPLE_INTERVAL, all.times.size());
+	uint32_t first = all.times.front();
+	for (size_t i=1; i<all.times.size(); i++)
+		CHECK_EQUAL(first + i*HISTORY_SAMPLE_INTERVAL, all.times[i]);
+	CHECK_EQUAL(ticks.seconds(), all.times.back());
+
+	// both ends of a time range are included
+	Collected range;
+	historyLog.forEachInTime(boot, first+600, first+1200, collect, &range);
+	CHECK_EQUAL(1200/HISTORY_SAMPLE_INTERVAL - 600/HISTORY_SAMPLE_INTERVAL + 1, range.times.size());
+	CHECK_EQUAL(first+600, range.times.front());
+	CHECK_EQUAL(first+1200, range.times.back());
+	CHECK_EQUAL(all.seqs[600/HISTORY_SAMPLE_INTERVAL], range.seqs.front());
+
+	// the loop stalls for five minutes: the samples after it keep their true time
+	ticks.incMillis(5*60*1000UL);
+	uint32_t resumed = ticks.seconds()+1;
+	sketchRun(600);
+	Collected late;
+	historyLog.forEachInTime(boot, resumed-HISTORY_SAMPLE_INTERVAL, ticks.seconds(), collect, &late);
+	CHECK_EQUAL(600/HISTORY_SAMPLE_INTERVAL, late.times.size());
+	CHECK_EQUAL(resumed, late.times.front());
+	CHECK_EQUAL(resumed + 9*HISTORY_SAMPLE_INTERVAL, late.times.back());
+
+	// after a restart, the earlier boot can still be asked for by its own time
+	sketchSetup();
+	sketchRun(600);
+	CHECK_EQUAL(boot+1, historyLog.currentBoot());
+	Collected before;
+	historyLog.forEachInTime(boot, first, first+1200, collect, &before);
+	CHECK_EQUAL(1200/HISTORY_SAMPLE_INTERVAL + 1, before.times.size());
+	CHECK_EQUAL(boot, before.boot);
+	Collected current;
+	historyLog.forEachInTime(historyLog.currentBoot(), 0, 0xFFFFFFFFUL, collect, &current);
+	CHECK_EQUAL(600/HISTORY_SAMPLE_INTERVAL, current.times.size());
+	CHECK_EQUAL(historyLog.currentBoot(), current.boot);
+
+	// with the second chamber selected, both histories keep sampling the first
+	piLinkFeed("@2");
+	piLinkFeed("j{mode:f, fridgeSet:10}");
+	uint32_t selected = ticks.seconds()+1;
+	sketchRun(600);
+	CHECK_EQUAL(1, chamberManager.current());
+	Collected other;
+	historyLog.forEachInTime(historyLog.currentBoot(), selected, ticks.seconds(), collect, &other);
+	CHECK_EQUAL(600/HISTORY_SAMPLE_INTERVAL, other.samples.size());
+	for (size_t i=0; i<other.samples.size(); i++) {
+		CHECK_EQUAL(MODE_BEER_CONSTANT, other.samples[i].mode);
+		CHECK_EQUAL(intToTemp(18), other.samples[i].beerSetting);
+	}
+	const TickRecord& tick = recentHistory.get(recentHistory.next()-1);
+	chamberManager.switchChamber(0);
+	CHECK_EQUAL(tempControl.getBeerTemp(), tick.beerTemp);
+	CHECK_EQUAL(tempControl.getFridgeTemp(), tick.fridgeTemp);
+
+	return CHECK_RESULT();
+}
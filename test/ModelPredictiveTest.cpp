@@ -0,0 +1,108 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The model predictive mode against the beer PID on the Simulator: the same step of the beer setting on the same
+ * chamber, once the model has been learned. Prints how each follows the step and holds the beer after it, and
+ * checks that the model predictive mode trades a little of the accuracy of the PID for fewer starts.
+ */
+
+#include "Sketch.h"
+#include "ChamberModel.h"
+#include "HostFS.h"
+#include "Simulator.h"
+#include "TempControl.h"
+#include "Check.h"
+
+#include <math.h>
+
+struct Response {
+	double overshoot;		// degrees past the new setting
+	uint32_t settle;		// seconds until the beer stays within 0.25 degrees of the setting
+	double holdError;		// rms error of the beer over the last half of the run
+	uint16_t starts;		// of the heater and the compressor
+};
+
+static Response follow(char mode, double from, double to, uint32_t hours)
+{
+	char cmd[40];
+	snprintf(cmd, sizeof(cmd), "j{mode:%c, beerSet:%.1f}", mode, from);
+	piLinkFeed(cmd);
+	sketchRun(24*3600);		// settled at the old setting
+	snprintf(cmd, sizeof(cmd), "j{beerSet:%.1f}", to);
+	piLinkFeed(cmd);
+
+	Response response = { 0, 0, 0, 0 };
+	double direction = to<from ? -1 : 1;
+	double squares = 0;
+	bool wasOn = false;
+	uint32_t seconds = hours*3600;
+	for (uint32_t s=1; s<=seconds; s++) {
+		sketchRun(1);
+		double beer = simulator.getBeerTemp();
+		response.overshoot = max(response.overshoot, (beer-to)*direction);
+		if (fabs(beer-to)>0.25)
+			response.settle = s;
+		if (s>seconds/2)
+			squares += (beer-to)*(beer-to);
+		bool on = tempControl.stateIsCooling() || tempControl.stateIsHeating();
+		if (on && !wasOn)
+			response.starts++;
+		wasOn = on;
+	}
+	response.holdError = sqrt(squares/(seconds-seconds/2));
+	piLinkOutput();
+	return response;
+}
+
+static void print(const char* name, const Response& r)
+{
+	printf("%-4s overshoot %.2f, settled in %4.1f h, rms error after %.3f, %u starts\n", name, r.overshoot,
+		r.settle/3600.0, r.holdError, r.starts);
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	// 20 l of beer in a 400 l fridge, not fermenting, in a room that swings between 15 and 21 degrees a day
+	simulator.setMinRoomTemp(15);
+	simulator.setMaxRoomTemp(21);
+	simulator.setFermentMaxPowerOutput(0);
+	simulator.setBeerTemp(20);
+	simulator.setFridgeTemp(20);
+
+	// the model is learned in every mode, so let it learn under the PID first
+	piLinkFeed("j{mode:b, beerSet:20}");
+	sketchRun(48*3600);
+	const ThermalModel& model = chamberModel.get();
+	printf("model: %u samples, one step ahead error fridge %.3f, beer %.3f\n", model.samples,
+		model.fridgeError/512.0, model.beerError/512.0);
+
+	Response pid = follow('b', 20, 17, 48);
+	Response mpc = follow('m', 20, 17, 48);
+	print("pid", pid);
+	print("mpc", mpc);
+
+	// it gets there sooner, and holds the beer nearly as closely with fewer starts of the compressor and heater
+	CHECK(mpc.settle<=pid.settle);
+	CHECK(mpc.overshoot<0.25);
+	CHECK(mpc.holdError<0.1);
+	CHECK(mpc.starts<pid.starts);
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,163 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * OneWireAsync and the background read of OneWireTempSensor, against the VirtualOneWireBus.
+ */
+
+#include "Brewpi.h"
+#include "OneWire.h"
+#include "OneWireAsync.h"
+#include "OneWireTempSensor.h"
+#include "DallasTemperature.h"
+#include "VirtualOneWireBus.h"
+#include "TemperatureFormats.h"
+#include "Check.h"
+
+static void advanceSeconds(VirtualOneWireBus& bus, uint16_t seconds)
+{
+	for(uint32_t ms = 0; ms < seconds * 1000UL; ms++)
+		bus.advance(1000);
+}
+
+static void setReadScratchpad(OneWireAsync::Transaction& t, uint8_t* command, const uint8_t* rom, uint8_t* scratchpad)
+{
+	command[0] = 0x55;
+	memcpy(command + 1, rom, 8);
+	command[9] = READSCRATCH;
+	t.tx = command;
+	t.txLen = 10;
+	t.rx = scratchpad;
+	t.rxLen = 9;
+}
+
+static void testQueue()
+{
+	VirtualOneWireBus bus(4);
+	VirtualDS18B20 a(0x1001), b(0x1002);
+	bus.attach(&a);
+	bus.attach(&b);
+	OneWireAsync async(&bus);
+
+	uint8_t commands[3][10], scratchpads[3][9];
+	OneWireAsync::Transaction reads[3];
+	setReadScratchpad(reads[0], commands[0], a.rom(), scratchpads[0]);
+	setReadScratchpad(reads[1], commands[1], b.rom(), scratchpads[1]);
+	setReadScratchpad(reads[2], commands[2], a.rom(), scratchpads[2]);
+	for(uint8_t i = 0; i < 3; i++)
+		CHECK(async.submit(reads[i]));
+	CHECK(!async.submit(reads[0]));		// still pending
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_BUSY, reads[0].status);
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_QUEUED, reads[2].status);
+
+	// a queued transaction can be taken out, the rest still run in order
+	OneWireAsync::cancel(reads[1]);
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_IDLE, reads[1].status);
+	uint32_t resets = bus.resets;
+	OneWireAsync::wait(reads[2]);
+	CHECK(OneWireAsync::idle());
+	CHECK_EQUAL(resets + 2, bus.resets);
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_DONE, reads[0].status);
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_DONE, reads[2].status);
+	CHECK_EQUAL(OneWire::crc8(scratchpads[0], 8), scratchpads[0][8]);
+	CHECK_EQUAL(0x50, scratchpads[0][0]);		// the power-on 85C
+	CHECK(!memcmp(scratchpads[0], scratchpads[2], 9));
+
+	// a blocking transaction waits for the queue to empty first, so they don't interleave on the wire
+	CHECK(async.submit(reads[1]));
+	OneWire oneWire(&bus);
+	CHECK(oneWire.reset());
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_DONE, reads[1].status);
+	CHECK_EQUAL(OneWire::crc8(scratchpads[1], 8), scratchpads[1][8]);
+
+	// no presence pulse ends the transaction after the reset
+	a.setConnected(false);
+	b.setConnected(false);
+	CHECK(async.submit(reads[0]));
+	OneWireAsync::wait(reads[0]);
+	CHECK_EQUAL(OneWireAsync::ONEWIRE_ASYNC_NO_PRESENCE, reads[0].status);
+}
+
+static uint64_t readSensor(VirtualOneWireBus& bus, OneWireTempSensor& sensor, temperature& temp)
+{
+	uint64_t start = bus.micros();
+	temp = sensor.read();
+	OneWireAsync::waitIdle();	// what runs in the background on the device, to count its bus time too
+	return bus.micros() - start;
+}
+
+static void testSensor()
+{
+	VirtualOneWireBus bus(4);
+	VirtualDS18B20 device(0x2001);
+	bus.attach(&device);
+	OneWire oneWire(&bus);
+	OneWireAsync async(&bus);
+	DeviceAddress address;
+	memcpy(address, device.rom(), 8);
+
+	OneWireTempSensor blocking(&oneWire, address, 0);
+	OneWireTempSensor queued(&oneWire, address, 0, &async);
+	device.setTemperature(20 * 16);
+	CHECK(blocking.init());
+	CHECK(queued.init());
+	advanceSeconds(bus, 1);
+
+	temperature temp;
+	uint64_t blockingTime = 0, queuedTime = 0;
+	for(uint8_t i = 0; i < 5; i++){
+		blockingTime += readSensor(bus, blocking, temp);
+		queuedTime += readSensor(bus, queued, temp);
+		advanceSeconds(bus, 1);
+	}
+	CHECK_EQUAL(intToTemp(20), temp);
+	printf("bus time per read: blocking %.2f ms, queued %.2f ms\n", blockingTime / 5000.0, queuedTime / 5000.0);
+
+	// a new temperature shows up one read later than with the blocking read
+	device.setTemperature(21 * 16);
+	advanceSeconds(bus, 1);
+	CHECK_EQUAL(intToTemp(21), blocking.read());
+	CHECK_EQUAL(intToTemp(20), queued.read());
+	advanceSeconds(bus, 1);
+	CHECK_EQUAL(intToTemp(21), queued.read());
+
+	// a power-on reset is detected from the alarm byte, and init() recovers
+	device.powerCycle();
+	advanceSeconds(bus, 1);
+	queued.read();
+	advanceSeconds(bus, 1);
+	CHECK_EQUAL(TEMP_SENSOR_DISCONNECTED, queued.read());
+	CHECK(!queued.isConnected());
+	CHECK_EQUAL(1, queued.getStats().resets);
+	CHECK(queued.init());
+	advanceSeconds(bus, 1);
+	CHECK_EQUAL(intToTemp(21), queued.read());
+
+	// a missing sensor reads as a crc failure
+	device.setConnected(false);
+	queued.read();
+	CHECK_EQUAL(TEMP_SENSOR_DISCONNECTED, queued.read());
+	CHECK(queued.getStats().crcFailures >= 1);
+	CHECK(OneWireAsync::idle());
+}
+
+int main()
+{
+	testQueue();
+	testSensor();
+	return CHECK_RESULT();
+}
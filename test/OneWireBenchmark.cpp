@@ -0,0 +1,134 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Search and enumeration of large 1-Wire buses on the VirtualOneWireBus, timed in bus microseconds.
+ * Checks that every device is found with a valid ROM and read back correctly, with and without bit errors on
+ * the line, and prints the bus time each step takes.
+ */
+
+#include "Brewpi.h"
+#include "OneWire.h"
+#include "DallasTemperature.h"
+#include "VirtualOneWireBus.h"
+#include "Check.h"
+
+#include <set>
+#include <vector>
+
+static uint64_t romKey(const uint8_t* rom)
+{
+	uint64_t key = 0;
+	for(uint8_t i = 0; i < 8; i++)
+		key = (key << 8) | rom[i];
+	return key;
+}
+
+/* Lets a conversion finish. OneWireLine::advance() only takes up to 65ms at a time. */
+static void waitForConversion(VirtualOneWireBus& bus)
+{
+	for(uint16_t ms = 0; ms < 750; ms++)
+		bus.advance(1000);
+}
+
+static void benchmark(uint16_t sensors, uint32_t noise)
+{
+	VirtualOneWireBus bus(sensors + 1);
+	std::vector<VirtualDS18B20*> devices;
+	for(uint16_t i = 0; i < sensors; i++){
+		VirtualDS18B20* device = new VirtualDS18B20(0x1000 + i * 7919ULL);
+		device->setTemperature(int16_t(i * 4 - 200));
+		devices.push_back(device);
+		bus.attach(device);
+	}
+	VirtualDS2413 actuator(0xABCDEF);
+	bus.attach(&actuator);
+	bus.setNoise(noise);
+
+	OneWire oneWire(&bus);
+	DallasTemperature dallas(&oneWire);
+
+	/*
+	 * A bit error ends a search pass early or takes it down the wrong branch, so search again until every device
+	 * is found. Each pass starts from the beginning, so on a long noisy bus the last devices may never be reached.
+	 */
+	std::set<uint64_t> found;
+	uint8_t rom[8];
+	uint16_t passes = 0, badRoms = 0;
+	uint64_t start = bus.micros();
+	for(; found.size() < devices.size() + 1 && passes < 10; passes++){
+		oneWire.reset_search();
+		while(oneWire.search(rom)){
+			if(OneWire::crc8(rom, 7) == rom[7])
+				found.insert(romKey(rom));
+			else
+				badRoms++;
+		}
+	}
+	uint64_t searchTime = bus.micros() - start;
+	if(!noise){
+		CHECK_EQUAL(1, passes);
+		for(size_t i = 0; i < devices.size(); i++)
+			CHECK(found.count(romKey(devices[i]->rom())));
+		CHECK(found.count(romKey(actuator.rom())));
+	}
+
+	// what a sensor costs: initConnection() once, then a conversion request and a scratchpad read every second
+	uint16_t readFailures = 0;
+	uint64_t initTime = 0, requestTime = 0, readTime = 0;
+	for(size_t i = 0; i < devices.size(); i++){
+		const uint8_t* address = devices[i]->rom();
+		start = bus.micros();
+		bool ok = dallas.initConnection(address);
+		initTime += bus.micros() - start;
+		start = bus.micros();
+		ok = ok && dallas.requestTemperaturesByAddress(address);
+		requestTime += bus.micros() - start;
+		if(!ok){
+			readFailures++;
+			continue;
+		}
+		waitForConversion(bus);
+		start = bus.micros();
+		DallasTemperature::ReadStatus status;
+		int16_t raw = dallas.getTempRaw(address, status);
+		readTime += bus.micros() - start;
+		if(status != DallasTemperature::READ_OK || raw != int16_t(i * 4 - 200))
+			readFailures++;
+	}
+	if(!noise)
+		CHECK_EQUAL(0, readFailures);
+
+	double perSensor = 1000.0 * devices.size();
+	printf("%3u devices, %3u ppm bit errors: found %3u in %2u passes, %7.1f ms (%u bad ROMs); "
+		"per sensor init %5.2f ms, request %5.2f ms, read %5.2f ms (%u failed)\n",
+		sensors + 1, noise, unsigned(found.size()), passes, searchTime / 1000.0, badRoms,
+		initTime / perSensor, requestTime / perSensor, readTime / perSensor, readFailures);
+
+	for(size_t i = 0; i < devices.size(); i++)
+		delete devices[i];
+}
+
+int main()
+{
+	const uint16_t sizes[] = { 10, 100, 300 };
+	for(uint8_t i = 0; i < 3; i++){
+		benchmark(sizes[i], 0);
+		benchmark(sizes[i], 200);
+	}
+	return CHECK_RESULT();
+}
@@ -0,0 +1,119 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Pi link commands whose arguments are optional, sent bare and with arguments.
+ */
+
+#include "Sketch.h"
+#include "ActuatorMeter.h"
+#include "HostFS.h"
+#include "StateTrace.h"
+#include "Check.h"
+
+#include <string>
+
+static std::string command(const char* text)
+{
+	piLinkFeed(text);
+	sketchRun(1);
+	return piLinkOutput();
+}
+
+static size_t count(const std::string& s, const char* what)
+{
+	size_t n = 0;
+	for (size_t at = s.find(what); at!=std::string::npos; at = s.find(what, at+1))
+		n++;
+	return n;
+}
+
+/*
+ * The object of the given beer in the output of B.
+ */
+static std::string beer(const std::string& output, int number)
+{
+	char start[16];
+	snprintf(start, sizeof(start), "{\"beer\":%d,", number);
+	size_t from = output.find(start);
+	return from==std::string::npos ? "" : output.substr(from, output.find('}', from)-from);
+}
+
+/*
+ * The bare command answers with its defaults, logs nothing and leaves the next command alone.
+ */
+static void checkBare(const char* name, const char* response)
+{
+	piLinkFeed(name);
+	std::string output = command("t");
+	CHECK_EQUAL(0, output.find(response));
+	CHECK_EQUAL(0, count(output, "D:"));
+	CHECK_EQUAL(1, count(output, "T:"));
+	if (output.find(response)!=0 || count(output, "D:"))
+		printf("%s: %s\n", name, output.c_str());
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	sketchRun(10);
+	piLinkOutput();
+
+	checkBare("r", "r:[");
+	std::string recent = command("r{n:2}");
+	CHECK_EQUAL(0, recent.find("r:["));
+	CHECK_EQUAL(3, count(recent, "["));		// the list and its two ticks
+	CHECK_EQUAL(0, count(recent, "D:"));
+
+	// naming a beer without a setting leaves its setting alone
+	checkBare("B", "B:[");
+	command("B{beer:2, beerSet:19}");
+	CHECK(beer(command("B{beer:2}"), 2).find("\"beerSet\": 19.00")!=std::string::npos);
+	CHECK(beer(command("B{beer:1}"), 1).find("\"beerSet\": 20.00")!=std::string::npos);
+
+	checkBare("k", "K:{");
+
+	checkBare("g", "G:[");
+	CHECK(stateTrace.next()>=1);
+	CHECK_EQUAL(2, count(command("g{n:1}"), "["));	// the list and one transition
+
+	// the bare form lists the counters without clearing them
+	const ActuatorStats& cooler = actuatorMeter.get(METERED_COOLER);
+	checkBare("u", "u:[");
+	CHECK(cooler.onSeconds+cooler.offSeconds>1);
+	command("u{reset:1}");
+	CHECK(cooler.onSeconds+cooler.offSeconds<=1);
+
+	// before a reset, the counts since the last save are saved too
+	sketchRun(600);
+	ticks_seconds_t counted = cooler.onSeconds+cooler.offSeconds;
+	CHECK(counted>=600);
+	actuatorMeter.flush(true);
+	actuatorMeter.load();
+	CHECK_EQUAL(counted, cooler.onSeconds+cooler.offSeconds);
+
+	// the forecast runs within the command, so it is held to FORECAST_MAX_HOURS
+	command("j{mode:b}");
+	checkBare("o", "O:{");
+	CHECK(command("o").find("\"hours\":48,")!=std::string::npos);
+	char longest[16];
+	snprintf(longest, sizeof(longest), "\"hours\":%u,", FORECAST_MAX_HOURS);
+	CHECK(command("o{hours:60000}").find(longest)!=std::string::npos);
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,150 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The main loop tasks on the Scheduler, with simulated task lengths and a Pi that keeps the link busy.
+ * Checks that the control step keeps its 1 s cadence under load and that comms, which is only polled, never
+ * counts misses, and prints the stats of each task and how long a dispatch takes on the host.
+ */
+
+#include <chrono>		// before the Arduino min() and max() macros
+
+#include "Brewpi.h"
+#include "Scheduler.h"
+#include "Ticks.h"
+#include "Check.h"
+
+/* Milliseconds a task takes, roughly what it takes on the device with three sensors and a 20x4 LCD. */
+static ticks_millis_t sensorsCost = 25, controlCost = 3, outputsCost = 2, historyCost = 4, displayCost = 35,
+	persistCost = 0;
+
+/* The Pi sends a command every commandInterval ms that takes commandCost ms to answer. */
+static ticks_millis_t commandInterval, commandCost;
+static ticks_millis_t nextCommand;
+
+static void work(ticks_millis_t ms) { ticks.incMillis(ms); }
+
+static void sensorsTask() { work(sensorsCost); }
+static void controlTask() { work(controlCost); }
+static void outputsTask() { work(outputsCost); }
+static void historyTask() { work(historyCost); }
+static void displayTask() { work(displayCost); }
+static void persistTask()
+{
+	// a settings record is written now and then
+	work(persistCost);
+	persistCost = (ticks.millis()%7000 < 100) ? 15 : 0;
+}
+
+static void commsTask()
+{
+	if (commandInterval && int32_t(ticks.millis()-nextCommand)>=0) {
+		nextCommand += commandInterval;
+		work(commandCost);
+	}
+}
+
+enum { PRIORITY_COMMS, PRIORITY_PERSIST, PRIORITY_DISPLAY, PRIORITY_HISTORY, PRIORITY_OUTPUTS, PRIORITY_CONTROL,
+	PRIORITY_SENSORS };
+
+/* The same tasks as scheduleTasks() in the sketch. */
+static uint8_t control, comms;
+static void schedule()
+{
+	for (uint8_t i=0; i<scheduler.capacity(); i++)
+		scheduler.cancel(i);
+	scheduler.every("sensors", sensorsTask, 1000, PRIORITY_SENSORS, 100);
+	control = scheduler.every("control", controlTask, 1000, PRIORITY_CONTROL, 100);
+	scheduler.every("outputs", outputsTask, 1000, PRIORITY_OUTPUTS, 100);
+	scheduler.every("history", historyTask, 1000, PRIORITY_HISTORY, 500);
+	scheduler.every("display", displayTask, 1000, PRIORITY_DISPLAY, 500);
+	scheduler.every("persist", persistTask, 100, PRIORITY_PERSIST, 1000);
+	comms = scheduler.every("comms", commsTask, 10, PRIORITY_COMMS, Scheduler::NO_DEADLINE);
+}
+
+/* Runs the loop for the given simulated time, where an idle pass takes a millisecond. */
+static void runFor(uint32_t seconds)
+{
+	ticks_millis_t end = ticks.millis() + seconds*1000;
+	while (int32_t(ticks.millis()-end)<0) {
+		if (!scheduler.run())
+			work(1);
+	}
+}
+
+static void benchmark(const char* load, ticks_millis_t interval, ticks_millis_t cost, bool keepsDeadline)
+{
+	const uint32_t seconds = 3600;
+	commandInterval = interval;
+	commandCost = cost;
+	nextCommand = ticks.millis();
+	schedule();
+	runFor(seconds);
+
+	printf("%s\n", load);
+	for (uint8_t i=0; i<scheduler.capacity(); i++) {
+		const char* name = scheduler.name(i);
+		if (!name)
+			continue;
+		const TaskStats& stats = scheduler.stats(i);
+		printf("  %-8s %6u runs %5u misses, late max %4u ms, duration max %4u ms\n", name, stats.runs, stats.misses,
+			stats.latenessMax, stats.durationMax);
+	}
+
+	// the cadence is kept whatever the load: one control step per second, none run back to back
+	const TaskStats& stats = scheduler.stats(control);
+	CHECK(stats.runs + stats.misses >= seconds - 1 && stats.runs <= seconds);
+	if (keepsDeadline) {
+		CHECK_EQUAL(0, stats.misses);
+		CHECK(stats.latenessMax <= 100);
+	}
+	CHECK_EQUAL(0, scheduler.stats(comms).misses);
+	CHECK(scheduler.stats(comms).runs > 0);
+}
+
+/* Host nanoseconds per run() with all slots taken and one task due, the cost of the dispatch itself. */
+static void dispatchTime()
+{
+	for (uint8_t i=0; i<scheduler.capacity(); i++)
+		scheduler.cancel(i);
+	for (uint8_t i=0; i<scheduler.capacity(); i++)
+		scheduler.every("idle", controlTask, 1000000, PRIORITY_COMMS, Scheduler::NO_DEADLINE, 1000000);
+	scheduler.cancel(0);
+	controlCost = 0;
+	scheduler.every("busy", controlTask, 1, PRIORITY_CONTROL, Scheduler::NO_DEADLINE);
+
+	const uint32_t calls = 1000000;
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (uint32_t i=0; i<calls; i++) {
+		scheduler.run();
+		ticks.incMillis(1);
+	}
+	double ns = std::chrono::duration<double, std::nano>(std::chrono::steady_clock::now()-start).count();
+	printf("dispatch over %u slots: %.1f ns per run() on the host\n", scheduler.capacity(), ns/calls);
+}
+
+int main()
+{
+	benchmark("idle link", 0, 0, true);
+	// intervals that don't divide a second, so the commands land at every point of the control period
+	benchmark("a command every 97 ms taking 20 ms", 97, 20, true);
+	benchmark("a command every 53 ms taking 40 ms", 53, 40, true);
+	// one task can't be interrupted, so a command longer than the deadline makes the control step late
+	benchmark("a command every 4999 ms taking 300 ms", 4999, 300, false);
+	dispatchTime();
+	return CHECK_RESULT();
+}
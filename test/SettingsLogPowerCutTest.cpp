@@ -0,0 +1,136 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Loses power at every byte of a settings log append and of a compaction, on HostFS, and checks that each record
+ * comes back after the reboot as either its old or its new version, and that the log can still be written.
+ */
+
+#include "Brewpi.h"
+#include "HostFS.h"
+#include "SettingsLog.h"
+#include "SettingsSchema.h"
+#include "Check.h"
+
+const uint8_t RECORDS = 8;
+const uint8_t PAYLOAD = 40;
+
+static uint8_t version(uint8_t type)
+{
+	return SettingsSchema::version(type);
+}
+
+static void fill(uint8_t* data, uint8_t id, uint8_t generation)
+{
+	for (uint8_t i=0; i<PAYLOAD; i++)
+		data[i] = uint8_t(id*31 + generation*7 + i);
+}
+
+static bool store(uint8_t id, uint8_t generation)
+{
+	uint8_t data[PAYLOAD];
+	fill(data, id, generation);
+	return SettingsLog::write(SETTINGS_RECORD_CONTROL_SETTINGS, id, data, PAYLOAD, version(SETTINGS_RECORD_CONTROL_SETTINGS));
+}
+
+/*
+ * Returns the generation the record was read back as, or -1 if it is missing or matches none of them.
+ */
+static int stored(uint8_t id)
+{
+	uint8_t data[PAYLOAD], expected[PAYLOAD];
+	if (!SettingsLog::read(SETTINGS_RECORD_CONTROL_SETTINGS, id, data, PAYLOAD))
+		return -1;
+	for (uint8_t generation=0; generation<255; generation++) {
+		fill(expected, id, generation);
+		if (!memcmp(data, expected, PAYLOAD))
+			return generation;
+	}
+	return -1;
+}
+
+static void reboot()
+{
+	SPIFFS.end();
+	SPIFFS.begin();
+	SettingsLog::begin();
+}
+
+/*
+ * A fresh log holding every record at generation 1, with record 0 written again count times.
+ */
+static void prepare(uint16_t count)
+{
+	SPIFFS.format();
+	SPIFFS.begin();
+	SettingsLog::begin();
+	for (uint8_t id=0; id<RECORDS; id++)
+		store(id, 1);
+	for (uint16_t i=0; i<count; i++)
+		store(0, 2 + i%2);
+}
+
+/*
+ * Writes record 1 at generation 9 after preparing the log, losing power after every possible number of bytes,
+ * and checks what survives each time. Returns the number of bytes the complete write took.
+ */
+static uint32_t cutEveryByte(uint16_t count, bool tear)
+{
+	prepare(count);
+	int before = stored(0);
+	uint32_t start = SPIFFS.stats().bytesWritten;
+	uint32_t compactions = SettingsLog::getStats().compactions;
+	CHECK(store(1, 9));
+	uint32_t bytes = SPIFFS.stats().bytesWritten - start;
+	bool compacted = SettingsLog::getStats().compactions!=compactions;
+
+	for (uint32_t cut=0; cut<bytes; cut++) {
+		prepare(count);
+		SPIFFS.cutPowerAfter(cut, tear);
+		CHECK(!store(1, 9));
+		CHECK(!SPIFFS.hasPower());
+		reboot();
+		CHECK_EQUAL(1, stored(1));
+		CHECK_EQUAL(before, stored(0));
+		for (uint8_t id=2; id<RECORDS; id++)
+			CHECK_EQUAL(1, stored(id));
+
+		// the log is usable again, and the new version survives the next reboot
+		CHECK(store(1, 10));
+		reboot();
+		CHECK_EQUAL(10, stored(1));
+		CHECK_EQUAL(before, stored(0));
+	}
+	printf("%s of %u bytes, power cut after each byte%s: recovered\n", compacted ? "compaction and append" : "append",
+		bytes, tear ? ", the last byte torn" : "");
+	CHECK(compacted==(count>0));
+	return bytes;
+}
+
+int main()
+{
+	// an append into free space
+	cutEveryByte(0, false);
+	cutEveryByte(0, true);
+
+	// an append that finds the log full, so compacts it first
+	uint16_t perRecord = sizeof(SettingsRecordHeader)+PAYLOAD;
+	uint16_t fill = (SETTINGS_LOG_SIZE-sizeof(SettingsLogHeader))/perRecord - RECORDS;
+	cutEveryByte(fill, false);
+	cutEveryByte(fill, true);
+	return CHECK_RESULT();
+}
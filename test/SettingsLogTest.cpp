@@ -0,0 +1,64 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * Records in a layout newer than this firmware knows are kept, but not read.
+ */
+
+#include "Brewpi.h"
+#include "HostFS.h"
+#include "SettingsLog.h"
+#include "SettingsSchema.h"
+#include "Check.h"
+
+int main()
+{
+	SPIFFS.format();
+	SPIFFS.begin();
+	CHECK(SettingsLog::begin());
+
+	uint8_t type = SETTINGS_RECORD_DEVICE;
+	uint8_t current = SettingsSchema::version(type);
+	uint8_t data[8] = { 1, 2, 3, 4, 5, 6, 7, 8 };
+	uint8_t newer[8] = { 9, 9, 9, 9, 9, 9, 9, 9 };
+	CHECK(SettingsLog::write(type, 0, data, sizeof(data), current));
+	CHECK(SettingsLog::write(type, 1, newer, sizeof(newer), current+1));
+
+	uint8_t read[8];
+	CHECK(SettingsLog::contains(type, 0));
+	CHECK(SettingsLog::read(type, 0, read, sizeof(read)));
+	CHECK(!memcmp(read, data, sizeof(data)));
+	CHECK(!SettingsLog::contains(type, 1));
+	CHECK(!SettingsLog::read(type, 1, read, sizeof(read)));
+
+	uint8_t all[2][8];
+	CHECK_EQUAL(1, SettingsLog::readAll(type, 2, all, 8));
+	CHECK(!memcmp(all[0], data, sizeof(data)));
+	CHECK_EQUAL(0, all[1][0]);
+
+	// a reboot leaves the newer record for the firmware that wrote it
+	SPIFFS.end();
+	SPIFFS.begin();
+	CHECK(SettingsLog::begin());
+	CHECK(!SettingsLog::contains(type, 1));
+	uint8_t image[256];
+	uint16_t length = SettingsLog::exportRecords(image, sizeof(image));
+	CHECK_EQUAL(2*(sizeof(SettingsRecordHeader)+8), length);
+	CHECK_EQUAL(0, SettingsLog::getStats().crcErrors);
+
+	return CHECK_RESULT();
+}
@@ -0,0 +1,210 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The state table of TempControl against the Simulator: a chamber cooling, heating, with its door open, switched
+ * off and losing its fridge sensor. The state trace of each scenario is printed, and checked for the states it
+ * goes through and the rules that made the changes.
+ */
+
+#include "Sketch.h"
+#include "DeviceManager.h"
+#include "HostFS.h"
+#include "Simulator.h"
+#include "StateTrace.h"
+#include "TempControl.h"
+#include "Check.h"
+
+#include <set>
+#include <vector>
+
+static uint32_t traced = 0;
+
+static double degrees(temperature t)
+{
+	return double(t-C_OFFSET)/TEMP_FIXED_POINT_SCALE;
+}
+
+/* Runs the chamber, and returns the transitions made meanwhile. */
+static std::vector<StateTransition> run(const char* scenario, uint32_t seconds)
+{
+	std::vector<StateTransition> transitions;
+	while (seconds) {
+		// the trace only holds the last few transitions, so collect them often
+		uint32_t n = seconds<60 ? seconds : 60;
+		sketchRun(n);
+		seconds -= n;
+		CHECK(stateTrace.oldest()<=traced);
+		for (; traced<stateTrace.next(); traced++)
+			transitions.push_back(stateTrace.get(traced));
+	}
+	printf("%s:\n", scenario);
+	for (size_t i=0; i<transitions.size(); i++) {
+		const StateTransition& t = transitions[i];
+		printf("  %6u s  %u -> %u  rule %2u  fridge %6.2f set %6.2f\n", t.time, t.from, t.to, t.rule,
+			degrees(t.fridgeTemp), degrees(t.fridgeSetting));
+	}
+	piLinkOutput();
+	return transitions;
+}
+
+static std::set<uint8_t> rules(const std::vector<StateTransition>& transitions)
+{
+	std::set<uint8_t> result;
+	for (size_t i=0; i<transitions.size(); i++)
+		result.insert(transitions[i].rule);
+	return result;
+}
+
+static std::set<uint8_t> reached(const std::vector<StateTransition>& transitions)
+{
+	std::set<uint8_t> result;
+	for (size_t i=0; i<transitions.size(); i++)
+		result.insert(transitions[i].to);
+	return result;
+}
+
+/* Each transition starts from the state the one before it ended in. */
+static void checkChained(const std::vector<StateTransition>& transitions)
+{
+	for (size_t i=1; i<transitions.size(); i++)
+		CHECK_EQUAL(transitions[i-1].to, transitions[i].from);
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	simulator.setMinRoomTemp(20);
+	simulator.setMaxRoomTemp(20);
+	simulator.setFermentMaxPowerOutput(0);
+	simulator.setBeerTemp(20);
+	simulator.setFridgeTemp(20);
+
+	// a door switch, opened and closed through the simulator
+	DeviceConfig cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.chamber = 1;
+	cfg.deviceFunction = DEVICE_CHAMBER_DOOR;
+	cfg.deviceHardware = DEVICE_HARDWARE_PIN;
+	cfg.hw.pinNr = 7;
+	deviceManager.installDevice(cfg);
+	std::set<uint8_t> covered;
+
+	// off with the default settings in place
+	std::vector<StateTransition> start = run("start", 60);
+	CHECK_EQUAL(1, start.size());
+	CHECK_EQUAL(IDLE, start[0].from);
+	CHECK_EQUAL(STATE_OFF, start[0].to);
+	CHECK_EQUAL(1, start[0].rule);
+	covered.insert(1);
+
+	// cooling cycles: cool until the estimated peak lands on the setting, then wait out the minimum off time
+	piLinkFeed("j{mode:f, fridgeSet:4}");
+	std::vector<StateTransition> cool = run("cool", 6*3600);
+	checkChained(cool);
+	CHECK(cool.size()>=6);
+	// the minimum off time of the compressor counts from the boot
+	CHECK_EQUAL(WAITING_TO_COOL, cool[0].to);
+	CHECK_EQUAL(4, cool[0].rule);
+	CHECK_EQUAL(COOLING, cool[1].to);
+	std::set<uint8_t> coolRules = rules(cool);
+	CHECK(coolRules.count(4) && coolRules.count(6) && coolRules.count(13));
+	for (size_t i=0; i<cool.size(); i++) {
+		CHECK(cool[i].to==COOLING || cool[i].to==COOLING_MIN_TIME || cool[i].to==IDLE || cool[i].to==WAITING_TO_COOL
+			|| cool[i].to==WAITING_FOR_PEAK_DETECT);
+		if (cool[i].to==COOLING)
+			CHECK_EQUAL(6, cool[i].rule);
+	}
+	covered.insert(coolRules.begin(), coolRules.end());
+
+	// heating: the compressor stops, and the heater waits out the minimum switch time
+	piLinkFeed("j{fridgeSet:30}");
+	std::vector<StateTransition> heat = run("heat", 6*3600);
+	checkChained(heat);
+	CHECK(reached(heat).count(HEATING));
+	CHECK(!reached(heat).count(COOLING));
+	std::set<uint8_t> heatRules = rules(heat);
+	CHECK(heatRules.count(9) && heatRules.count(11));
+	covered.insert(heatRules.begin(), heatRules.end());
+	CHECK_EQUAL(HEATING, tempControl.getState());
+
+	piLinkFeed("j{fridgeSet:4}");
+	std::vector<StateTransition> back = run("back to cooling", 6*3600);
+	checkChained(back);
+	CHECK(back.size()>=3);
+	CHECK_EQUAL(HEATING, back[0].from);
+	CHECK_EQUAL(16, back[0].rule);
+	covered.insert(16);
+
+	// an open door warms the fridge, but the state table goes on as before
+	simulator.setSwitch(tempControl.door, true);
+	std::vector<StateTransition> door = run("door open", 1800);
+	CHECK_EQUAL(DOOR_OPEN, tempControl.getDisplayState());
+	checkChained(door);
+	std::set<uint8_t> doorRules = rules(door);
+	for (std::set<uint8_t>::iterator i=doorRules.begin(); i!=doorRules.end(); ++i)
+		CHECK(coolRules.count(*i));
+	simulator.setSwitch(tempControl.door, false);
+	run("door closed", 60);
+	CHECK(tempControl.getDisplayState()!=DOOR_OPEN);
+
+	// switching off clears the settings: the chamber is held idle without control, rather than switched off
+	piLinkFeed("j{mode:o}");
+	std::vector<StateTransition> off = run("off", 600);
+	CHECK(off.empty());
+	CHECK_EQUAL(IDLE, tempControl.getState());
+	CHECK(!tempControl.stateIsCooling() && !tempControl.stateIsHeating());
+
+	piLinkFeed("j{mode:f, fridgeSet:4}");
+	std::vector<StateTransition> on = run("on", 600);
+	CHECK(!on.empty());
+	CHECK_EQUAL(IDLE, on[0].from);
+	CHECK_EQUAL(COOLING, on[0].to);
+
+	// losing the fridge sensor while cooling stops the compressor at once
+	simulator.setFridgeTemp(20);
+	for (uint16_t i=0; i<3600 && tempControl.getState()!=COOLING; i++)
+		sketchRun(1);
+	CHECK_EQUAL(COOLING, tempControl.getState());
+	run("cooling", 60);
+	simulator.setConnected(tempControl.fridgeSensor, false);
+	std::vector<StateTransition> lost = run("fridge sensor lost", 600);
+	CHECK_EQUAL(1, lost.size());
+	CHECK_EQUAL(COOLING, lost[0].from);
+	CHECK_EQUAL(IDLE, lost[0].to);
+	CHECK_EQUAL(0, lost[0].rule);
+	covered.insert(0);
+
+	// once it is back, the peak of the cut short cooling is waited for before cooling again
+	simulator.setConnected(tempControl.fridgeSensor, true);
+	std::vector<StateTransition> found = run("fridge sensor back", 3600);
+	checkChained(found);
+	CHECK(found.size()>=2);
+	CHECK_EQUAL(WAITING_FOR_PEAK_DETECT, found[0].to);
+	CHECK_EQUAL(5, found[0].rule);
+	CHECK_EQUAL(COOLING, found[1].to);
+	covered.insert(5);
+
+	printf("rules covered:");
+	for (std::set<uint8_t>::iterator i=covered.begin(); i!=covered.end(); ++i)
+		printf(" %u", *i);
+	printf("\n");
+	CHECK(covered.size()>=9);
+
+	return CHECK_RESULT();
+}
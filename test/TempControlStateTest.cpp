@@ -0,0 +1,122 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The control state snapshot across a simulated reboot with two chambers in use: both resume their state, timers
+ * and integrators, and the chamber selected before the reboot is selected again.
+ */
+
+#include "Sketch.h"
+#include "ChamberManager.h"
+#include "HostFS.h"
+#include "Simulator.h"
+#include "TempControl.h"
+#include "TempControlState.h"
+#include "Check.h"
+
+/* What a chamber should resume with. */
+struct Resumed {
+	char mode;
+	uint8_t state;
+	ticks_seconds_t sinceIdle, sinceCooling, waitTime;
+	temperature beerSetting, fridgeSetting;
+	long_temperature diffIntegral;
+	long_temperature secondBeerIntegral;
+	temperature secondBeerSetting;
+};
+
+static Resumed capture(uint8_t chamber)
+{
+	chamberManager.switchChamber(chamber);
+	Resumed r;
+	r.mode = tempControl.cs.mode;
+	r.state = tempControl.getState();
+	r.sinceIdle = tempControl.timeSinceIdle();
+	r.sinceCooling = tempControl.timeSinceCooling();
+	r.waitTime = tempControl.getWaitTime();
+	r.beerSetting = tempControl.cs.beerSetting;
+	r.fridgeSetting = tempControl.cs.fridgeSetting;
+	r.diffIntegral = tempControl.cv.diffIntegral;
+	r.secondBeerIntegral = tempControl.beers[1].diffIntegral;
+	r.secondBeerSetting = tempControl.beers[1].cs.beerSetting;
+	return r;
+}
+
+static void checkResumed(const Resumed& expected, uint8_t chamber)
+{
+	Resumed r = capture(chamber);
+	CHECK_EQUAL(expected.mode, r.mode);
+	CHECK_EQUAL(expected.state, r.state);
+	CHECK_EQUAL(expected.sinceIdle, r.sinceIdle);
+	CHECK_EQUAL(expected.sinceCooling, r.sinceCooling);
+	CHECK_EQUAL(expected.waitTime, r.waitTime);
+	CHECK_EQUAL(expected.beerSetting, r.beerSetting);
+	CHECK_EQUAL(expected.fridgeSetting, r.fridgeSetting);
+	CHECK_EQUAL(expected.diffIntegral, r.diffIntegral);
+	CHECK_EQUAL(expected.secondBeerIntegral, r.secondBeerIntegral);
+	CHECK_EQUAL(expected.secondBeerSetting, r.secondBeerSetting);
+}
+
+int main()
+{
+	SPIFFS.format();
+	sketchSetup();
+	simulator.setMinRoomTemp(22);
+	simulator.setMaxRoomTemp(22);
+	simulator.setBeerTemp(22);
+	simulator.setFridgeTemp(22);
+
+	// the first chamber cools its beer, the second holds its fridge and is left selected
+	piLinkFeed("j{mode:b, beerSet:18}");
+	sketchRun(3600);
+	piLinkFeed("@2");
+	piLinkFeed("j{mode:f, fridgeSet:10}");
+	sketchRun(3600);
+	CHECK_EQUAL(1, chamberManager.current());
+	CHECK_EQUAL(2, chamberManager.count());
+
+	// distinct integrators in both chambers, including those of the second beer
+	chamberManager.switchChamber(0);
+	tempControl.cv.diffIntegral = 2468;
+	tempControl.beers[1].diffIntegral = 1234;
+	chamberManager.switchChamber(1);
+	tempControl.cv.diffIntegral = -4321;
+	tempControl.beers[1].diffIntegral = 5678;
+	tempControlState.save();
+
+	Resumed first = capture(0);
+	Resumed second = capture(1);
+	chamberManager.switchChamber(1);
+	CHECK_EQUAL(MODE_BEER_CONSTANT, first.mode);
+	CHECK(first.state==COOLING || first.state==IDLE);
+	CHECK(first.sinceIdle>0);
+	piLinkOutput();
+
+	sketchSetup();
+	CHECK_EQUAL(1, chamberManager.current());
+	CHECK_EQUAL(2, chamberManager.count());
+	checkResumed(first, 0);
+	checkResumed(second, 1);
+
+	// a record saved in another mode than the chamber now has is not resumed, and that chamber starts afresh
+	chamberManager.switchChamber(0);
+	tempControl.cs.mode = MODE_FRIDGE_CONSTANT;
+	CHECK_EQUAL(1, tempControlState.restore());
+	CHECK_EQUAL(1, chamberManager.current());
+
+	return CHECK_RESULT();
+}
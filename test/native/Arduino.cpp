@@ -0,0 +1,304 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <thread>
+
+#include "Arduino.h"
+
+#include <poll.h>
+#include <unistd.h>
+
+static std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+unsigned long millis()
+{
+	return std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+}
+
+unsigned long micros()
+{
+	return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now()-start).count();
+}
+
+void delay(unsigned long ms)
+{
+	std::this_thread::sleep_for(std::chrono::milliseconds(ms));
+}
+
+void delayMicroseconds(unsigned int us)
+{
+	std::this_thread::sleep_for(std::chrono::microseconds(us));
+}
+
+void yield()
+{
+}
+
+void pinMode(uint8_t pin, uint8_t mode)
+{
+}
+
+void digitalWrite(uint8_t pin, uint8_t val)
+{
+}
+
+int digitalRead(uint8_t pin)
+{
+	return LOW;
+}
+
+int analogRead(uint8_t pin)
+{
+	return 0;
+}
+
+long random(long howbig)
+{
+	return howbig ? ::random() % howbig : 0;
+}
+
+long random(long howsmall, long howbig)
+{
+	return howsmall>=howbig ? howsmall : howsmall + random(howbig-howsmall);
+}
+
+void randomSeed(unsigned long seed)
+{
+	if (seed)
+		srandom(seed);
+}
+
+static char* formatNumber(unsigned long value, bool negative, char* result, int base)
+{
+	char digits[sizeof(unsigned long)*8+2];
+	char* p = digits + sizeof(digits);
+	*--p = 0;
+	do {
+		uint8_t digit = value % base;
+		*--p = char(digit<10 ? '0'+digit : 'a'+digit-10);
+		value /= base;
+	} while (value);
+	if (negative)
+		*--p = '-';
+	strcpy(result, p);
+	return result;
+}
+
+char* ltoa(long value, char* result, int base)
+{
+	bool negative = value<0 && base==10;
+	return formatNumber(negative ? 0UL-(unsigned long)value : (unsigned long)value, negative, result, base);
+}
+
+char* itoa(int value, char* result, int base)
+{
+	if (base!=10)
+		return formatNumber((unsigned int)value, false, result, base);
+	return ltoa(value, result, base);
+}
+
+#if NATIVE_STRLCPY
+size_t strlcpy(char* dst, const char* src, size_t size)
+{
+	size_t len = strlen(src);
+	if (size) {
+		size_t n = len<size ? len : size-1;
+		memcpy(dst, src, n);
+		dst[n] = 0;
+	}
+	return len;
+}
+#endif
+
+String::String(int value, unsigned char base)
+{
+	char buf[34];
+	s = ltoa(value, buf, base);
+}
+
+String::String(unsigned int value, unsigned char base)
+{
+	char buf[34];
+	s = formatNumber(value, false, buf, base);
+}
+
+String::String(long value, unsigned char base)
+{
+	char buf[66];
+	s = ltoa(value, buf, base);
+}
+
+String::String(unsigned long value, unsigned char base)
+{
+	char buf[66];
+	s = formatNumber(value, false, buf, base);
+}
+
+int String::indexOf(char c, unsigned int from) const
+{
+	size_t pos = s.find(c, from);
+	return pos==std::string::npos ? -1 : int(pos);
+}
+
+bool String::endsWith(const String& suffix) const
+{
+	return s.size()>=suffix.s.size() && s.compare(s.size()-suffix.s.size(), suffix.s.size(), suffix.s)==0;
+}
+
+String String::substring(unsigned int from, unsigned int to) const
+{
+	if (from>to)
+		std::swap(from, to);
+	if (from>=s.size())
+		return String();
+	return String(s.substr(from, to-from));
+}
+
+void String::toCharArray(char* buf, unsigned int size) const
+{
+	if (size)
+		strlcpy(buf, s.c_str(), size);
+}
+
+void String::trim()
+{
+	size_t begin = s.find_first_not_of(" \t\r\n");
+	size_t end = s.find_last_not_of(" \t\r\n");
+	s = begin==std::string::npos ? std::string() : s.substr(begin, end-begin+1);
+}
+
+void String::toLowerCase()
+{
+	for (size_t i=0; i<s.size(); i++)
+		s[i] = char(tolower(s[i]));
+}
+
+size_t Print::write(const uint8_t* buffer, size_t size)
+{
+	size_t n = 0;
+	while (size--)
+		n += write(*buffer++);
+	return n;
+}
+
+size_t Print::print(long value, int base)
+{
+	char buf[66];
+	return write(ltoa(value, buf, base));
+}
+
+size_t Print::print(unsigned long value, int base)
+{
+	char buf[66];
+	return write(formatNumber(value, false, buf, base));
+}
+
+size_t Print::print(double value, int digits)
+{
+	char buf[64];
+	snprintf(buf, sizeof(buf), "%.*f", digits, value);
+	return write(buf);
+}
+
+size_t Print::printf(const char* format, ...)
+{
+	char buf[256];
+	va_list args;
+	va_start(args, format);
+	int len = vsnprintf(buf, sizeof(buf), format, args);
+	va_end(args);
+	return len<0 ? 0 : write((const uint8_t*)buf, size_t(len)<sizeof(buf) ? size_t(len) : sizeof(buf)-1);
+}
+
+size_t Stream::readBytes(char* buffer, size_t length)
+{
+	size_t count = 0;
+	unsigned long startMillis = millis();
+	while (count<length && millis()-startMillis<timeout) {
+		int c = read();
+		if (c<0)
+			continue;
+		buffer[count++] = char(c);
+	}
+	return count;
+}
+
+String Stream::readStringUntil(char terminator)
+{
+	std::string result;
+	unsigned long startMillis = millis();
+	while (millis()-startMillis<timeout) {
+		int c = read();
+		if (c<0)
+			continue;
+		if (c==terminator)
+			break;
+		result += char(c);
+	}
+	return String(result);
+}
+
+StdIO::StdIO() : lookahead(-1), sink(NULL)
+{
+}
+
+size_t StdIO::write(uint8_t c)
+{
+	return write(&c, 1);
+}
+
+size_t StdIO::write(const uint8_t* buffer, size_t size)
+{
+	if (sink) {
+		sink->append((const char*)buffer, size);
+		return size;
+	}
+	return fwrite(buffer, 1, size, stdout);
+}
+
+void StdIO::flush()
+{
+	fflush(stdout);
+}
+
+int StdIO::peek()
+{
+	if (lookahead<0 && !pending.empty()) {
+		lookahead = uint8_t(pending[0]);
+		pending.erase(0, 1);
+	}
+	if (lookahead<0) {
+		struct pollfd fd = { STDIN_FILENO, POLLIN, 0 };
+		uint8_t c;
+		if (poll(&fd, 1, 0)==1 && (fd.revents & POLLIN) && ::read(STDIN_FILENO, &c, 1)==1)
+			lookahead = c;
+	}
+	return lookahead;
+}
+
+int StdIO::available()
+{
+	return peek()<0 ? 0 : 1;
+}
+
+int StdIO::read()
+{
+	int c = peek();
+	lookahead = -1;
+	return c;
+}
@@ -0,0 +1,212 @@
+/*
+ * This file is part of BrewPi.
+ *
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * The parts of the Arduino core API the firmware uses, for the native (host) build.
+ * Time comes from the host clock, pins read low, and Print/Stream/String are plain implementations over the
+ * C library. Nothing here is timing accurate - code that needs simulated time uses ticks or a OneWireLine.
+ */
+
+// the standard headers come first, so the macros below can't break them when they are included later
+#include <algorithm>
+#include <limits>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <ctype.h>
+#include <math.h>
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "pgmspace.h"
+
+typedef uint8_t byte;
+typedef bool boolean;
+
+#define HIGH 1
+#define LOW 0
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define PI 3.1415926535897932384626433832795
+#define HALF_PI 1.5707963267948966192313216916398
+#define TWO_PI 6.283185307179586476925286766559
+
+#define DEC 10
+#define HEX 16
+
+#define ICACHE_RAM_ATTR
+#define ICACHE_FLASH_ATTR
+
+#define min(a,b) ((a)<(b)?(a):(b))
+#define max(a,b) ((a)>(b)?(a):(b))
+#define abs(x) ((x)>0?(x):-(x))
+#define constrain(amt,low,high) ((amt)<(low)?(low):((amt)>(high)?(high):(amt)))
+#define bitRead(value, bit) (((value) >> (bit)) & 0x01)
+#define bitSet(value, bit) ((value) |= (1UL << (bit)))
+#define bitClear(value, bit) ((value) &= ~(1UL << (bit)))
+#define bitWrite(value, bit, bitvalue) ((bitvalue) ? bitSet(value, bit) : bitClear(value, bit))
+#define makeWord(h, l) uint16_t(((h) << 8) | (l))
+
+unsigned long millis();
+unsigned long micros();
+void delay(unsigned long ms);
+void delayMicroseconds(unsigned int us);
+void yield();
+
+void pinMode(uint8_t pin, uint8_t mode);
+void digitalWrite(uint8_t pin, uint8_t val);
+int digitalRead(uint8_t pin);
+int analogRead(uint8_t pin);
+
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+long random(long howbig);
+long random(long howsmall, long howbig);
+void randomSeed(unsigned long seed);
+
+char* itoa(int value, char* result, int base);
+char* ltoa(long value, char* result, int base);
+
+class __FlashStringHelper;
+#define F(s) (reinterpret_cast<const __FlashStringHelper*>(PSTR(s)))
+
+class String {
+public:
+	String(const char* s="") : s(s ? s : "") {}
+	String(const __FlashStringHelper* s) : s(reinterpret_cast<const char*>(s)) {}
+	String(const std::string& s) : s(s) {}
+	explicit String(char c) : s(1, c) {}
+	String(int value, unsigned char base=10);
+	String(unsigned int value, unsigned char base=10);
+	String(long value, unsigned char base=10);
+	String(unsigned long value, unsigned char base=10);
+
+	const char* c_str() const { return s.c_str(); }
+	unsigned int length() const { return s.length(); }
+	void reserve(unsigned int size) { s.reserve(size); }
+
+	String& operator+=(const String& rhs) { s += rhs.s; return *this; }
+	String& operator+=(const char* rhs) { s += rhs; return *this; }
+	String& operator+=(char c) { s += c; return *this; }
+	String& operator+=(int value) { return *this += String(value); }
+	String& operator+=(unsigned int value) { return *this += String(value); }
+	String& operator+=(long value) { return *this += String(value); }
+	String& operator+=(unsigned long value) { return *this += String(value); }
+	bool concat(const String& rhs) { s += rhs.s; return true; }
+
+	friend String operator+(const String& lhs, const String& rhs) { return String(lhs.s + rhs.s); }
+	friend String operator+(const String& lhs, const char* rhs) { return String(lhs.s + rhs); }
+	friend String operator+(const char* lhs, const String& rhs) { return String(lhs + rhs.s); }
+	bool operator==(const String& rhs) const { return s==rhs.s; }
+	bool operator==(const char* rhs) const { return s==rhs; }
+	bool operator!=(const String& rhs) const { return s!=rhs.s; }
+	bool operator!=(const char* rhs) const { return s!=rhs; }
+	char operator[](unsigned int index) const { return index<s.size() ? s[index] : 0; }
+	char charAt(unsigned int index) const { return (*this)[index]; }
+
+	int indexOf(char c, unsigned int from=0) const;
+	bool startsWith(const String& prefix) const { return s.compare(0, prefix.s.size(), prefix.s)==0; }
+	bool endsWith(const String& suffix) const;
+	String substring(unsigned int from) const { return substring(from, s.size()); }
+	String substring(unsigned int from, unsigned int to) const;
+	void toCharArray(char* buf, unsigned int size) const;
+	long toInt() const { return atol(s.c_str()); }
+	void trim();
+	void toLowerCase();
+
+private:
+	std::string s;
+};
+
+class Print {
+public:
+	virtual ~Print() {}
+	virtual size_t write(uint8_t c) = 0;
+	virtual size_t write(const uint8_t* buffer, size_t size);
+	size_t write(const char* str) { return str ? write((const uint8_t*)str, strlen(str)) : 0; }
+	size_t write(const char* buffer, size_t size) { return write((const uint8_t*)buffer, size); }
+	virtual void flush() {}
+
+	size_t print(const __FlashStringHelper* s) { return write(reinterpret_cast<const char*>(s)); }
+	size_t print(const String& s) { return write(s.c_str()); }
+	size_t print(const char* s) { return write(s); }
+	size_t print(char c) { return write(uint8_t(c)); }
+	size_t print(unsigned char value, int base=DEC) { return print((unsigned long)value, base); }
+	size_t print(int value, int base=DEC) { return print((long)value, base); }
+	size_t print(unsigned int value, int base=DEC) { return print((unsigned long)value, base); }
+	size_t print(long value, int base=DEC);
+	size_t print(unsigned long value, int base=DEC);
+	size_t print(double value, int digits=2);
+
+	size_t println() { return write("\r\n"); }
+	template<typename T> size_t println(const T& value) { size_t n = print(value); return n + println(); }
+	template<typename T> size_t println(const T& value, int format) { size_t n = print(value, format); return n + println(); }
+
+	size_t printf(const char* format, ...);
+};
+
+class Stream : public Print {
+public:
+	virtual int available() = 0;
+	virtual int read() = 0;
+	virtual int peek() = 0;
+
+	void setTimeout(unsigned long timeout) { this->timeout = timeout; }
+	size_t readBytes(char* buffer, size_t length);
+	size_t readBytes(uint8_t* buffer, size_t length) { return readBytes((char*)buffer, length); }
+	String readStringUntil(char terminator);
+
+protected:
+	Stream() : timeout(1000) {}
+	unsigned long timeout;
+};
+
+/**
+ * The PiLink stream of the native build: stdin and stdout, read without blocking.
+ * Tests can queue input ahead of stdin with feed(), and collect the output with capture().
+ */
+class StdIO : public Stream {
+public:
+	StdIO();
+	void feed(const char* input) { pending += input; }
+	void capture(std::string* sink) { this->sink = sink; }
+	void begin(unsigned long baud) {}
+	operator bool() const { return true; }
+	size_t write(uint8_t c);
+	size_t write(const uint8_t* buffer, size_t size);
+	using Print::write;
+	void flush();
+	int available();
+	int read();
+	int peek();
+
+private:
+	int lookahead;
+	std::string pending;
+	std::string* sink;
+};
@@ -0,0 +1,43 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * The firmware objects that the sketch (brewpi-esp8266.cpp) defines on the device, for programs built against the
+ * native library. Their main() takes the place of setup() and loop().
+ */
+
+#include "Brewpi.h"
+#include "Ticks.h"
+#include "Display.h"
+#include "EepromManager.h"
+#include "BeerProfile.h"
+#include "ActuatorMeter.h"
+
+TicksImpl ticks = TicksImpl(TICKS_IMPL_CONFIG);
+DelayImpl wait = DelayImpl(DELAY_IMPL_CONFIG);
+
+DisplayType realDisplay;
+DisplayType DISPLAY_REF display = realDisplay;
+
+ValueActuator alarm;
+
+void handleReset()
+{
+	eepromManager.flushSettings();
+	beerProfile.flush();
+	actuatorMeter.flush();
+}
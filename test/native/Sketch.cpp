@@ -0,0 +1,106 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "Sketch.h"
+#include "ActuatorMeter.h"
+#include "BeerProfile.h"
+#include "ChamberManager.h"
+#include "DeviceManager.h"
+#include "EepromManager.h"
+#include "HistoryLog.h"
+#include "PiLink.h"
+#include "RecentHistory.h"
+#include "SettingsLog.h"
+#include "SettingsManager.h"
+#include "Simulator.h"
+#include "TempControl.h"
+#include "TempControlState.h"
+#include "Ticks.h"
+
+extern StdIO stdIO;		// the Pi link stream, in PiLink.cpp
+
+static std::string output;
+
+static void installActuator(DeviceFunction function, uint8_t pin)
+{
+	DeviceConfig cfg;
+	memset(&cfg, 0, sizeof(cfg));
+	cfg.chamber = 1;
+	cfg.deviceFunction = function;
+	cfg.deviceHardware = DEVICE_HARDWARE_PIN;
+	cfg.hw.pinNr = pin;
+	deviceManager.uninstallDevice(cfg);
+	deviceManager.installDevice(cfg);
+}
+
+void sketchSetup()
+{
+	stdIO.capture(&output);
+	SPIFFS.begin();
+	settingsLog.begin();
+	historyLog.begin();
+	piLink.init();
+
+	chamberManager.reset();		// after a reboot only the first chamber is in use, and selected
+	tempControl.init();
+	settingsManager.loadSettings();
+	installActuator(DEVICE_CHAMBER_COOL, 5);
+	installActuator(DEVICE_CHAMBER_HEAT, 6);
+
+	simulator.step();
+	simulator.setConnected(tempControl.beerSensor, true);
+	simulator.setConnected(tempControl.fridgeSensor, true);
+	simulator.step();
+	tempControl.beerSensor->init();
+	tempControl.fridgeSensor->init();
+	tempControlState.restore();
+}
+
+void sketchRun(uint32_t seconds)
+{
+	while (seconds--) {
+		piLink.receive();
+		ticks.incMillis(1000);
+		// sensors, control, outputs, history and persist, in the order of their priorities
+		tempControl.updateTemperatures();
+		tempControl.detectPeaks();
+		tempControl.updatePID();
+		tempControl.updateState();
+		tempControl.updateOutputs();
+		chamberManager.update();
+		recentHistory.update();
+		historyLog.update();
+		tempControlState.save();
+		eepromManager.flushIfDue();
+		beerProfile.flush();
+		actuatorMeter.flush();
+		simulator.step();
+	}
+}
+
+void piLinkFeed(const char* command)
+{
+	stdIO.feed(command);
+	stdIO.feed("\n");
+}
+
+std::string piLinkOutput()
+{
+	std::string result;
+	result.swap(output);
+	return result;
+}
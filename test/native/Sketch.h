@@ -0,0 +1,43 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * setup() and the scheduled tasks of the sketch (brewpi-esp8266.cpp), for native programs that run the firmware
+ * against the Simulator. The chamber has simulated fridge, beer and room sensors, and a cooler and heater.
+ */
+
+#include "Brewpi.h"
+
+/**
+ * Mounts the file system, loads the settings and sets up the simulated devices, like setup() does on the device.
+ * The file system keeps its contents between calls, so calling this again simulates a reboot.
+ */
+void sketchSetup();
+
+/**
+ * Advances the simulated time and runs the control, history and persistence tasks once a second, with the
+ * Pi link read in between. Commands queued with piLinkFeed() are handled at the start of the next second.
+ */
+void sketchRun(uint32_t seconds);
+
+/**
+ * Queues a command for the Pi link, and returns the output produced since the last call.
+ */
+void piLinkFeed(const char* command);
+std::string piLinkOutput();
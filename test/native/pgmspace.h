@@ -0,0 +1,53 @@
+/*
+ * This file is part of BrewPi.
+ * 
+ * BrewPi is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * BrewPi is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with BrewPi.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#pragma once
+
+/*
+ * Program memory is ordinary memory on the native build.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <string.h>
+
+#define PROGMEM
+#define PGM_P const char*
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t*)(addr))
+#define pgm_read_word(addr) (*(const uint16_t*)(addr))
+#define pgm_read_dword(addr) (*(const uint32_t*)(addr))
+#define pgm_read_ptr(addr) (*(void* const*)(addr))
+
+#define memcpy_P memcpy
+#define strcpy_P strcpy
+#define strncpy_P strncpy
+#define strcat_P strcat
+#define strcmp_P strcmp
+#define strncmp_P strncmp
+#define strlen_P strlen
+#define sprintf_P sprintf
+#define snprintf_P snprintf
+#define vsnprintf_P vsnprintf
+
+// glibc only has strlcpy from 2.38
+#if defined(__GLIBC__) && !__GLIBC_PREREQ(2, 38)
+#define NATIVE_STRLCPY 1
+size_t strlcpy(char* dst, const char* src, size_t size);
+#endif
+#define strlcpy_P strlcpy